@@ -0,0 +1,164 @@
+#include <anim.h>
+
+/*
+Easing curves as 33 point tables, linearly interpolated between the points:
+cubic in, cubic out and half a cosine for in-out.
+*/
+
+#define EASE_SHIFT 11 // progress bits between table points
+
+static const uint16_t _ease_tables[][33] = {
+    [AnimEaseIn - AnimEaseIn] = {
+        0, 2, 16, 54, 128, 250, 432, 686, 1024, 1458, 2000, 2662, 3456, 4394, 5488, 6750, 8192,
+        9826, 11664, 13718, 16000, 18522, 21296, 24334, 27648, 31250, 35151, 39365, 43903, 48777, 53999, 59581, 65535 },
+    [AnimEaseOut - AnimEaseIn] = {
+        0, 5954, 11536, 16758, 21632, 26170, 30384, 34285, 37887, 41201, 44239, 47013, 49535, 51817, 53871, 55709, 57343,
+        58785, 60047, 61141, 62079, 62873, 63535, 64077, 64511, 64849, 65103, 65285, 65407, 65481, 65519, 65533, 65535 },
+    [AnimEaseInOut - AnimEaseIn] = {
+        0, 158, 630, 1411, 2494, 3869, 5522, 7438, 9597, 11980, 14563, 17321, 20228, 23256, 26375, 29556, 32767,
+        35979, 39160, 42279, 45307, 48214, 50972, 53555, 55938, 58097, 60013, 61666, 63041, 64124, 64905, 65377, 65535 }
+};
+
+// Eased progress 0..65535 of a segment
+uint16_t anim_ease( uint8_t ease, uint16_t progress ) {
+    if( ease == AnimLinear ) return progress;
+    if( ease == AnimStep ) return 0;
+    if( progress == 65535 ) return 65535; // interpolation stops a step short of the last point
+    const uint16_t *table = _ease_tables[ease - AnimEaseIn];
+    uint32_t i = progress >> EASE_SHIFT;
+    int32_t frac = progress & ((1U << EASE_SHIFT) - 1);
+    return table[i] + (((int32_t)table[i + 1] - table[i]) * frac >> EASE_SHIFT);
+}
+
+// a + (b - a) * p / 65535 without overflow, p 65535 is b
+static inline uint16_t mix( uint16_t a, uint16_t b, uint16_t p ) {
+    return a + (((int32_t)b - a) * ((p + 1) >> 1) >> 15);
+}
+
+// Hue 0..65535 is one turn from red over green and blue, six sectors of 65536/6
+void anim_hsv_rgb( const uint16_t hsv[3], uint16_t rgb[3] ) {
+    uint32_t h6 = (uint32_t)hsv[0] * 6;
+    uint32_t sector = h6 >> 16;
+    uint32_t f = h6 & 0xffff;
+    uint32_t s = hsv[1];
+    uint32_t v = hsv[2];
+    uint16_t p = v * (65535 - s) >> 16;
+    uint16_t q = v * (65535 - (s * f >> 16)) >> 16;
+    uint16_t t = v * (65535 - (s * (65535 - f) >> 16)) >> 16;
+    switch( sector ) {
+        case 0:  rgb[0] = v; rgb[1] = t; rgb[2] = p; break;
+        case 1:  rgb[0] = q; rgb[1] = v; rgb[2] = p; break;
+        case 2:  rgb[0] = p; rgb[1] = v; rgb[2] = t; break;
+        case 3:  rgb[0] = p; rgb[1] = q; rgb[2] = v; break;
+        case 4:  rgb[0] = t; rgb[1] = p; rgb[2] = v; break;
+        default: rgb[0] = v; rgb[1] = p; rgb[2] = q; break;
+    }
+}
+
+// Rgb color of a track at time into key
+static void eval( const struct anim_track *track, uint32_t key, uint32_t time, uint16_t rgb[3] ) {
+    const struct anim_key *a = &track->keys[key];
+    uint32_t next = key + 1;
+    if( next == track->count ) next = track->loop ? 0 : key;
+    const struct anim_key *b = &track->keys[next];
+
+    uint16_t p = anim_ease(a->ease, (time * a->inv) >> 16); // time < a->time: no overflow
+    if( track->space == AnimHsv ) {
+        uint16_t hsv[3];
+        hsv[0] = a->color[0] + ((int32_t)(int16_t)(b->color[0] - a->color[0]) * ((p + 1) >> 1) >> 15); // shorter way
+        hsv[1] = mix(a->color[1], b->color[1], p);
+        hsv[2] = mix(a->color[2], b->color[2], p);
+        anim_hsv_rgb(hsv, rgb);
+    }
+    else {
+        for( int c = 0; c < 3; c++ ) {
+            rgb[c] = mix(a->color[c], b->color[c], p);
+        }
+    }
+}
+
+// Blend one channel value onto the frame
+static inline uint16_t blend( uint8_t mode, uint16_t below, uint16_t value, uint16_t opacity ) {
+    uint32_t scaled;
+    switch( mode ) {
+        case AnimAdd:
+            scaled = below + ((uint32_t)value * opacity >> 16);
+            return scaled > 65535 ? 65535 : scaled;
+        case AnimMultiply:
+            return mix(below, (uint32_t)below * value >> 16, opacity);
+        case AnimMax:
+            scaled = (uint32_t)value * opacity >> 16;
+            return scaled > below ? scaled : below;
+        default:
+            return mix(below, value, opacity);
+    }
+}
+
+// Play the track of a layer from its first key
+void anim_start( struct anim_layer *layer ) {
+    layer->time = 0;
+    layer->key = 0;
+    layer->length = 0;
+    for( uint32_t k = 0; k < layer->track->count; k++ ) {
+        layer->length += layer->track->keys[k].time;
+    }
+}
+
+// Move the playhead forward, keys with time 0 are skipped
+static void advance( struct anim_layer *layer, uint32_t elapsed ) {
+    const struct anim_track *track = layer->track;
+    layer->time += elapsed;
+    while( layer->time >= track->keys[layer->key].time ) {
+        if( layer->key + 1 == track->count ) {
+            if( !track->loop || layer->length == 0 ) { // hold the last key
+                layer->time = 0;
+                return;
+            }
+            layer->time -= track->keys[layer->key].time;
+            layer->key = 0;
+        }
+        else {
+            layer->time -= track->keys[layer->key].time;
+            layer->key++;
+        }
+    }
+}
+
+// Render one layer: groups walk back in time from the playhead, lag by lag
+static void render( const struct anim_layer *layer, uint16_t *frame, uint32_t channels ) {
+    const struct anim_track *track = layer->track;
+    uint32_t key = layer->key;
+    int32_t time = layer->time;     // into key, negative while going back
+    uint16_t rgb[3];
+    uint16_t *out = &frame[layer->first];
+
+    for( uint32_t g = 0; g < layer->groups; g++, out += layer->width, time -= layer->lag ) {
+        if( layer->first + (g + 1) * layer->width > channels ) break;
+        while( time < 0 ) { // group is in an earlier key
+            if( key == 0 ) {
+                if( !track->loop || layer->length == 0 ) { // before the start: groups show the first key
+                    time = 0;
+                    break;
+                }
+                key = track->count;
+            }
+            key--;
+            time += track->keys[key].time;
+        }
+        if( g == 0 || layer->lag ) eval(track, key, time, rgb);
+        for( uint32_t c = 0; c < layer->width; c++ ) {
+            out[c] = blend(layer->blend, out[c], rgb[c], layer->opacity);
+        }
+    }
+}
+
+// Advance all layers and compute a frame of channels, layer 0 at the bottom on black
+void anim_frame( struct anim_layer *layers, uint32_t count, uint32_t elapsed, uint16_t *frame, uint32_t channels ) {
+    for( uint32_t c = 0; c < channels; c++ ) {
+        frame[c] = 0;
+    }
+    for( uint32_t l = 0; l < count; l++ ) {
+        advance(&layers[l], elapsed);
+        render(&layers[l], frame, channels);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef ANIM_H
+#define ANIM_H
+
+#include <stdint.h>
+
+/*
+Keyframe animation of channel groups, e.g. rgb leds, computed a whole frame at a time.
+A track is a list of keys: a color, the time to the next key and the easing curve towards it.
+A layer plays a track on groups of 1 (brightness) or 3 (rgb) consecutive channels of a frame,
+each group optionally lagging behind the one before, and blends onto the layers below it.
+All values are 16 bit fixed point: colors and opacity 0..65535, progress in a segment 0..65535.
+Time is in any unit the caller likes, e.g. ms or frames, as long as keys use the same.
+The per frame path has no division and no floating point: keys carry the reciprocal
+of their duration, computed by the compiler in ANIM_KEY().
+*/
+
+enum Anim_Spaces { AnimRgb, AnimHsv };  // how key colors are interpolated, hsv takes the shorter way around the hue circle
+enum Anim_Eases { AnimLinear, AnimEaseIn, AnimEaseOut, AnimEaseInOut, AnimStep };
+enum Anim_Blends {
+    AnimReplace,   // mix layer over below by opacity
+    AnimAdd,       // add layer times opacity, saturating
+    AnimMultiply,  // scale below by layer, mixed by opacity
+    AnimMax        // brighter of below and layer times opacity
+};
+
+struct anim_key {
+    uint16_t color[3];   // r g b or h s v
+    uint8_t  ease;       // curve towards the next key
+    uint32_t time;       // until the next key, 0: jump
+    uint32_t inv;        // 2^32 / time
+};
+
+#define ANIM_KEY(time, c0, c1, c2, ease) { { (c0), (c1), (c2) }, (ease), (time), (time) ? 0xffffffffU / (time) : 0 }
+
+struct anim_track {
+    const struct anim_key *keys;
+    uint16_t count;
+    uint8_t  space;      // enum Anim_Spaces
+    uint8_t  loop;       // last key goes on to the first, else the last key holds
+};
+
+struct anim_layer {
+    const struct anim_track *track;
+    uint16_t first;      // first channel in the frame
+    uint16_t groups;     // groups of width channels, following each other
+    uint8_t  width;      // 3: r g b, 1: first (red) component only
+    uint8_t  blend;      // enum Anim_Blends
+    uint16_t opacity;
+    uint32_t lag;        // time each group is behind the one before, 0: all groups alike
+    // playhead, set by anim_start()
+    uint32_t time;       // since the start of key
+    uint16_t key;
+    uint32_t length;     // sum of key times
+};
+
+void anim_start( struct anim_layer *layer );
+void anim_frame( struct anim_layer *layers, uint32_t count, uint32_t elapsed, uint16_t *frame, uint32_t channels );
+uint16_t anim_ease( uint8_t ease, uint16_t progress );
+void anim_hsv_rgb( const uint16_t hsv[3], uint16_t rgb[3] );
+
+#endif
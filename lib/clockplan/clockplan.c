@@ -0,0 +1,68 @@
+#include <clockplan.h>
+
+
+static const uint16_t _ahb_divs[] = { 512, 256, 128, 64, 16, 8, 4, 2, 1 }; // slowest first
+static const uint8_t _apb_divs[] = { 16, 8, 4, 2, 1 };
+
+// Error of a baud rate in ppm, the usart divides its clock by a 12.4 fixed point value of at least 16
+uint32_t clockplan_baud_ppm( uint32_t clock_hz, uint32_t baud ) {
+    if( baud == 0 ) return 0;
+    uint32_t div = (clock_hz + baud / 2) / baud; // like usart_baudrate_set()
+    if( div < 16 || div > 0xffff ) return UINT32_MAX;
+    uint64_t actual = (uint64_t)div * baud;      // compare clock * div scaled, no rounding of the rate
+    uint64_t diff = (actual > clock_hz) ? actual - clock_hz : clock_hz - actual;
+    return (diff * 1000000 + actual / 2) / actual;
+}
+
+// Timers run at their APB clock, doubled if that is divided from AHB
+static uint32_t timer_div( uint32_t apb_div ) {
+    return (apb_div == 1) ? 1 : apb_div / 2;
+}
+
+// Fill plan for the given dividers and return 1 if they meet all needs
+int clockplan_check( const struct clockplan_needs *n, uint32_t ahb_div, uint32_t apb1_div, uint32_t apb2_div, struct clockplan *plan ) {
+    uint32_t tdiv = timer_div(apb1_div);
+    if( tdiv != timer_div(apb2_div) ) return 0; // Timer0 and the others must tick alike
+    if( (uint64_t)n->sys_hz > (uint64_t)CLOCKPLAN_MAX_APB1_HZ * ahb_div * apb1_div ) return 0;
+    if( n->timer_hz == 0 || n->prescale == 0 ) return 0;
+
+    // new prescaler = prescale * new timer clock / timer_hz, only exact ones keep the pwm rate
+    uint64_t num = (uint64_t)n->prescale * n->sys_hz;
+    uint64_t den = (uint64_t)ahb_div * tdiv * n->timer_hz;
+    if( num % den ) return 0;
+    uint64_t prescale = num / den;
+    if( prescale == 0 || prescale > 0xffff || (n->even && (prescale & 1)) ) return 0;
+
+    uint64_t tick_cycles = prescale * tdiv; // core clock is timer clock * tdiv
+    uint32_t tick_need = n->tick_cycles;
+    if( tick_need ) {
+        tick_need += n->tick_apb1 * CLOCKPLAN_APB_CYCLES(apb1_div) + n->tick_apb2 * CLOCKPLAN_APB_CYCLES(apb2_div);
+    }
+    if( tick_cycles < tick_need || tick_cycles * n->ticks < n->interval_cycles ) return 0;
+
+    plan->ahb_div = ahb_div;
+    plan->apb1_div = apb1_div;
+    plan->apb2_div = apb2_div;
+    plan->core_hz = n->sys_hz / ahb_div;
+    plan->apb1_hz = plan->core_hz / apb1_div;
+    plan->apb2_hz = plan->core_hz / apb2_div;
+    plan->timer_hz = plan->core_hz / tdiv;
+    plan->prescale = prescale;
+    plan->baud_ppm = clockplan_baud_ppm(plan->apb2_hz, n->baud);
+    if( plan->timer_hz < n->min_timer_hz ) return 0;
+    if( n->baud && plan->baud_ppm > n->baud_ppm ) return 0;
+    return 1;
+}
+
+// Slowest core clock that meets the needs, then the slowest bus clocks for it.
+// Returns 0 if not even the undivided system clock does
+int clockplan_select( const struct clockplan_needs *n, struct clockplan *plan ) {
+    for( int a = 0; a < sizeof(_ahb_divs) / sizeof(_ahb_divs[0]); a++ ) {
+        for( int b1 = 0; b1 < sizeof(_apb_divs); b1++ ) {
+            for( int b2 = 0; b2 < sizeof(_apb_divs); b2++ ) {
+                if( clockplan_check(n, _ahb_divs[a], _apb_divs[b1], _apb_divs[b2], plan) ) return 1;
+            }
+        }
+    }
+    return 0;
+}
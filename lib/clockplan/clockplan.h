@@ -0,0 +1,54 @@
+#ifndef CLOCKPLAN_H
+#define CLOCKPLAN_H
+
+#include <stdint.h>
+
+/*
+Pick the slowest bus clocks that still keep the pwm, the serial port and the interrupt handlers going.
+The system clock (PLL) stays, the plan divides it with the AHB and APB prescalers:
+changing those is safe at any time, the PLL would need a detour over IRC8M.
+Pwm ticks keep their exact rate, so the timer clock must divide into the prescaler
+the pwm was configured with. Timer0 (APB2) and TIMER1..6 (APB1) get the same clock,
+both double their APB clock if it is divided from AHB.
+The core must have enough cycles per tick for Interrupt pins and per interval for update handlers.
+Handlers mostly access timer and gpio registers, those stall the core until the APB bridge
+has synced to the slower APB clock, so the cycles per tick grow with the APB dividers.
+USART0 (APB2) needs a divider of at least 16 with a baud rate error within baud_ppm.
+No hardware access in here, the caller maps dividers to register values and applies them.
+*/
+
+#define CLOCKPLAN_MAX_APB1_HZ 54000000 // data sheet limit of APB1, AHB and APB2 may run at the system clock
+#define CLOCKPLAN_APB_CYCLES(div) (2 + 2 * (div)) // core cycles of an APB access: two APB clocks and the bridge
+
+struct clockplan_needs {
+    uint32_t sys_hz;          // system clock, AHB divides it
+    uint32_t timer_hz;        // timer clock the pwm prescaler below is meant for
+    uint32_t prescale;        // timer clocks per pwm tick at timer_hz
+    uint32_t ticks;           // pwm ticks per interval
+    uint8_t  even;            // prescaler must stay even, e.g. center aligned counters
+    uint32_t tick_cycles;     // core cycles per tick without APB accesses, 0 without Interrupt pins
+    uint8_t  tick_apb1;       // APB1 and APB2 register accesses per tick on top of them
+    uint8_t  tick_apb2;
+    uint32_t interval_cycles; // core cycles per interval for update and dma handlers
+    uint32_t min_timer_hz;    // e.g. for led strip bit timing, 0 for none
+    uint32_t baud;            // USART0 baud rate, 0 without serial
+    uint32_t baud_ppm;        // tolerated baud rate error
+};
+
+struct clockplan {
+    uint16_t ahb_div;         // 1, 2, 4, 8, 16, 64, 128, 256 or 512
+    uint8_t  apb1_div;        // 1, 2, 4, 8 or 16
+    uint8_t  apb2_div;
+    uint32_t core_hz;         // AHB clock, also core and mtime * 4
+    uint32_t apb1_hz;
+    uint32_t apb2_hz;
+    uint32_t timer_hz;        // clock of all timers
+    uint32_t prescale;        // pwm prescaler for the same tick rate
+    uint32_t baud_ppm;        // baud rate error
+};
+
+uint32_t clockplan_baud_ppm( uint32_t clock_hz, uint32_t baud );
+int clockplan_check( const struct clockplan_needs *n, uint32_t ahb_div, uint32_t apb1_div, uint32_t apb2_div, struct clockplan *plan );
+int clockplan_select( const struct clockplan_needs *n, struct clockplan *plan );
+
+#endif
@@ -0,0 +1,66 @@
+#include <cmdline.h>
+
+/*
+Minimal command line parser.
+Words are separated by blanks and tokenized in place: separators are
+overwritten with '\0' and argv[] points into the line, so nothing is copied.
+*/
+
+
+static int is_blank( char ch ) {
+    return ch == ' ' || ch == '\t';
+}
+
+
+static int is_same( const char *a, const char *b ) {
+    while( *a && *a == *b ) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+
+// Split line into at most max words, return number of words
+int cmdline_split( char *line, char *argv[], int max ) {
+    int argc = 0;
+    while( *line ) {
+        while( is_blank(*line) ) *line++ = '\0';
+        if( !*line ) break;
+        if( argc == max ) return max + 1; // too many words
+        argv[argc++] = line;
+        while( *line && !is_blank(*line) ) line++;
+    }
+    return argc;
+}
+
+
+// Tokenize line and call the matching command
+enum cmdline_result cmdline_run( char *line, const struct cmdline_commands *cmds, int count ) {
+    char *argv[CMDLINE_MAX_ARGS];
+    int argc = cmdline_split(line, argv, CMDLINE_MAX_ARGS);
+    if( argc == 0 ) return CMDLINE_EMPTY;
+
+    for( int c = 0; c < count; c++ ) {
+        if( is_same(cmds[c].name, argv[0]) ) {
+            if( argc != cmds[c].args + 1 ) return CMDLINE_USAGE;
+            return cmds[c].run(argc, argv) ? CMDLINE_USAGE : CMDLINE_OK;
+        }
+    }
+    return CMDLINE_UNKNOWN;
+}
+
+
+// Parse decimal number, return 0 if s is not a valid number
+int cmdline_uint( const char *s, uint32_t *value ) {
+    uint32_t v = 0;
+    if( !*s ) return 0;
+    while( *s ) {
+        if( *s < '0' || *s > '9' ) return 0;
+        uint32_t digit = *s++ - '0';
+        if( v > (UINT32_MAX - digit) / 10 ) return 0; // overflow
+        v = v * 10 + digit;
+    }
+    *value = v;
+    return 1;
+}
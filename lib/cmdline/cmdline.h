@@ -0,0 +1,29 @@
+#ifndef CMDLINE_H
+#define CMDLINE_H
+
+#include <stdint.h>
+
+// Max words in a command line, including the command itself
+#ifndef CMDLINE_MAX_ARGS
+#define CMDLINE_MAX_ARGS 8
+#endif
+
+// Return values of cmdline_run()
+enum cmdline_result {
+    CMDLINE_OK,
+    CMDLINE_EMPTY,    // nothing but blanks
+    CMDLINE_UNKNOWN,  // no command with that name
+    CMDLINE_USAGE     // wrong number of arguments or command failed
+};
+
+struct cmdline_commands {
+    const char *name;
+    int args;  // number of arguments after the name
+    int (*run)( int argc, char *argv[] );  // return 0 if ok
+};
+
+int cmdline_split( char *line, char *argv[], int max );
+enum cmdline_result cmdline_run( char *line, const struct cmdline_commands *cmds, int count );
+int cmdline_uint( const char *s, uint32_t *value );
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef CRITICAL_H
+#define CRITICAL_H
+
+#include <stdint.h>
+#include <riscv_encoding.h>
+
+/*
+Short sections that must not be interrupted, e.g. ring buffer bookkeeping
+shared between main code and interrupt handlers.
+Nests fine since the previous interrupt state is restored on exit.
+*/
+
+// Mask interrupts, return previous state for critical_exit()
+static inline uint32_t critical_enter() {
+    return clear_csr(mstatus, MSTATUS_MIE) & MSTATUS_MIE;
+}
+
+// Restore interrupt state as it was before critical_enter()
+static inline void critical_exit( uint32_t state ) {
+    if( state ) set_csr(mstatus, MSTATUS_MIE);
+}
+
+// Let mcycle count: the core may come out of reset with it inhibited.
+// 0x320 is mcountinhibit, older toolchains don't know the name
+static inline void mcycle_enable() {
+    clear_csr(0x320, 1);
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef FASTREG_H
+#define FASTREG_H
+
+#include <stdint.h>
+#include <gd32vf103_timer.h>
+#include <gd32vf103_gpio.h>
+#include <gd32vf103_dma.h>
+#include <gd32vf103_usart.h>
+
+/*
+Register level timer, gpio, dma and usart accessors for hot paths like interrupt handlers.
+The sdk functions are compiled separately, so each flag check or register write there
+is a call with parameter checks. These inline to a load or store.
+No checks at all: callers pass valid peripherals and channels.
+With -DWITH_SDK_REGS the accessors make the sdk calls the hot paths made before,
+to compare builds (see test/test_fastreg). Registers the old code wrote directly stay direct.
+*/
+
+#ifdef WITH_SDK_REGS
+#define FASTREG_SDK(call, reg) call
+#else
+#define FASTREG_SDK(call, reg) reg
+#endif
+
+// Every register access of the program is a reg_load() or reg_store(). The native env has
+// no registers at the chip addresses, its register mock does the access (see test/mock)
+#ifdef MOCK_REGS
+static inline uint32_t reg_load( volatile uint32_t *reg ) {
+    return mock_load(reg);
+}
+
+static inline void reg_store( volatile uint32_t *reg, uint32_t value ) {
+    mock_store(reg, value);
+}
+#else
+static inline uint32_t reg_load( volatile uint32_t *reg ) {
+    return *reg;
+}
+
+static inline void reg_store( volatile uint32_t *reg, uint32_t value ) {
+    *reg = value;
+}
+#endif
+
+// Compare value register of a timer channel (TIMER_CH_0..3)
+static inline volatile uint32_t *reg_timer_cv( uint32_t timer, uint16_t channel ) {
+    return &TIMER_CH0CV(timer) + channel;
+}
+
+static inline void reg_timer_cv_set( uint32_t timer, uint16_t channel, uint16_t value ) {
+    FASTREG_SDK(timer_channel_output_pulse_value_config(timer, channel, value), reg_store(reg_timer_cv(timer, channel), value));
+}
+
+static inline uint16_t reg_timer_cv_get( uint32_t timer, uint16_t channel ) {
+    return reg_load(reg_timer_cv(timer, channel));
+}
+
+// Interrupt flags of a timer, clears the ones returned. Flags are cleared by writing 0
+static inline uint32_t reg_timer_flags_take( uint32_t timer ) {
+    uint32_t flags = reg_load(&TIMER_INTF(timer));
+    reg_store(&TIMER_INTF(timer), ~flags);
+    return flags;
+}
+
+static inline uint32_t reg_timer_count( uint32_t timer ) {
+    return reg_load(&TIMER_CNT(timer));
+}
+
+// Center aligned counters: counting down from the auto reload value
+static inline uint32_t reg_timer_counting_down( uint32_t timer ) {
+    return reg_load(&TIMER_CTL0(timer)) & TIMER_CTL0_DIR;
+}
+
+// No shadow register updates while changing several compare values
+static inline void reg_timer_update_disable( uint32_t timer ) {
+    FASTREG_SDK(timer_update_event_disable(timer), reg_store(&TIMER_CTL0(timer), reg_load(&TIMER_CTL0(timer)) | TIMER_CTL0_UPDIS));
+}
+
+static inline void reg_timer_update_enable( uint32_t timer ) {
+    FASTREG_SDK(timer_update_event_enable(timer), reg_store(&TIMER_CTL0(timer), reg_load(&TIMER_CTL0(timer)) & ~TIMER_CTL0_UPDIS));
+}
+
+// Set and reset pins of a gpio port with one write, set wins
+static inline void reg_gpio_bop( uint32_t gpio, uint16_t set, uint16_t reset ) {
+    reg_store(&GPIO_BOP(gpio), set | ((uint32_t)reset << 16));
+}
+
+// Dma channel flag (DMA_FLAG_G, FTF, HTF or ERR)
+static inline uint32_t reg_dma_flag( uint32_t dma, uint32_t channel, uint32_t flag ) {
+    return FASTREG_SDK(dma_flag_get(dma, channel, flag), reg_load(&DMA_INTF(dma)) & DMA_FLAG_ADD(flag, channel));
+}
+
+static inline void reg_dma_flag_clear( uint32_t dma, uint32_t channel, uint32_t flag ) {
+    FASTREG_SDK(dma_flag_clear(dma, channel, flag), reg_store(&DMA_INTC(dma), DMA_FLAG_ADD(flag, channel)));
+}
+
+static inline void reg_dma_disable( uint32_t dma, uint32_t channel ) {
+    FASTREG_SDK(dma_channel_disable(dma, channel), reg_store(&DMA_CHCTL(dma, channel), reg_load(&DMA_CHCTL(dma, channel)) & ~DMA_CHXCTL_CHEN));
+}
+
+// Start a transfer of count items from memory of a configured, disabled channel
+static inline void reg_dma_start( uint32_t dma, uint32_t channel, const void *memory, uint32_t count ) {
+#ifdef WITH_SDK_REGS
+    dma_memory_address_config(dma, channel, (uint32_t)(uintptr_t)memory);
+    dma_transfer_number_config(dma, channel, count);
+    dma_channel_enable(dma, channel);
+#else
+    reg_store(&DMA_CHMADDR(dma, channel), (uint32_t)(uintptr_t)memory);
+    reg_store(&DMA_CHCNT(dma, channel), count);
+    reg_store(&DMA_CHCTL(dma, channel), reg_load(&DMA_CHCTL(dma, channel)) | DMA_CHXCTL_CHEN);
+#endif
+}
+
+// Items the channel has yet to transfer
+static inline uint32_t reg_dma_remaining( uint32_t dma, uint32_t channel ) {
+    return FASTREG_SDK(dma_transfer_number_get(dma, channel), reg_load(&DMA_CHCNT(dma, channel)) & 0xffff);
+}
+
+// Transmit data register empty: usart takes another byte
+static inline uint32_t reg_usart_tbe( uint32_t usart ) {
+    return FASTREG_SDK(usart_flag_get(usart, USART_FLAG_TBE), reg_load(&USART_STAT(usart)) & USART_STAT_TBE);
+}
+
+// Transmission complete: last byte left the shift register
+static inline uint32_t reg_usart_tc( uint32_t usart ) {
+    return FASTREG_SDK(usart_flag_get(usart, USART_FLAG_TC), reg_load(&USART_STAT(usart)) & USART_STAT_TC);
+}
+
+static inline void reg_usart_write( uint32_t usart, uint8_t data ) {
+    FASTREG_SDK(usart_data_transmit(usart, data), reg_store(&USART_DATA(usart), data));
+}
+
+#endif
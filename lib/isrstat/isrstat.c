@@ -0,0 +1,109 @@
+#include <isrstat.h>
+
+#ifdef WITH_ISR_STATS
+
+#include <critical.h>
+
+/*
+Snapshots are sent as binary frames, decoded by tools/isrstat_decode.py:
+0xA5 0x5A, id, payload length, payload (struct isrstat fields in order,
+little endian, no padding), crc8 (poly 0x07) of id, length and payload.
+*/
+
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define PAYLOAD_SIZE (6 * 4 + 8 + ISRSTAT_BUCKETS * 2)
+
+static struct isrstat _stats[ISRSTAT_COUNT];
+
+
+static void reset( struct isrstat *s ) {
+    *s = (struct isrstat){ .min = UINT32_MAX, .latency_min = UINT32_MAX };
+}
+
+
+void isrstat_init() {
+    mcycle_enable();
+    for( int id = 0; id < ISRSTAT_COUNT; id++ ) {
+        reset(&_stats[id]);
+    }
+}
+
+
+// Called at the end of a handler with mcycle value of its start
+void isrstat_exit( uint32_t id, uint32_t start ) {
+    uint32_t cycles = (uint32_t)read_csr(mcycle) - start;
+    struct isrstat *s = &_stats[id];
+
+    s->count++;
+    s->sum += cycles;
+    if( cycles < s->min ) s->min = cycles;
+    if( cycles > s->max ) s->max = cycles;
+
+    uint32_t b = 0;
+    for( uint32_t c = cycles >> 5; c && b < ISRSTAT_BUCKETS - 1; c >>= 1 ) b++;
+    if( s->hist[b] != UINT16_MAX ) s->hist[b]++;
+}
+
+
+// Cycles between the event and the handler noticing it
+void isrstat_latency( uint32_t id, uint32_t cycles ) {
+    struct isrstat *s = &_stats[id];
+    if( cycles < s->latency_min ) s->latency_min = cycles;
+    if( cycles > s->latency_max ) s->latency_max = cycles;
+}
+
+
+void isrstat_missed( uint32_t id ) {
+    _stats[id].missed++;
+}
+
+
+// Consistent copy of the stats of a handler, optionally start over
+void isrstat_snapshot( uint32_t id, struct isrstat *copy, int reset_stats ) {
+    uint32_t irq = critical_enter();
+    *copy = _stats[id];
+    if( reset_stats ) reset(&_stats[id]);
+    critical_exit(irq);
+}
+
+
+static uint8_t crc8( uint8_t crc, uint8_t data ) {
+    crc ^= data;
+    for( int i = 0; i < 8; i++ ) {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+
+// Send a snapshot as binary frame, put is called for each byte
+void isrstat_send( uint32_t id, void (*put)( uint8_t ch ), int reset_stats ) {
+    struct isrstat s;
+    isrstat_snapshot(id, &s, reset_stats);
+
+    uint8_t payload[PAYLOAD_SIZE];
+    uint8_t *p = payload;
+    uint32_t words[] = { s.count, s.min, s.max, (uint32_t)s.sum, (uint32_t)(s.sum >> 32),
+                         s.latency_min, s.latency_max, s.missed };
+    for( int w = 0; w < sizeof(words) / sizeof(*words); w++ ) {
+        for( int i = 0; i < 4; i++ ) *p++ = words[w] >> (8 * i);
+    }
+    for( int b = 0; b < ISRSTAT_BUCKETS; b++ ) {
+        *p++ = s.hist[b];
+        *p++ = s.hist[b] >> 8;
+    }
+
+    uint8_t crc = crc8(crc8(0, id), PAYLOAD_SIZE);
+    put(FRAME_SYNC0);
+    put(FRAME_SYNC1);
+    put(id);
+    put(PAYLOAD_SIZE);
+    for( int i = 0; i < PAYLOAD_SIZE; i++ ) {
+        put(payload[i]);
+        crc = crc8(crc, payload[i]);
+    }
+    put(crc);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef ISRSTAT_H
+#define ISRSTAT_H
+
+#include <stdint.h>
+
+/*
+Interrupt handler instrumentation based on the mcycle counter.
+Per handler id: call count, duration min/max/sum and histogram,
+entry latency relative to the triggering event and missed events.
+Without WITH_ISR_STATS all ISRSTAT_* macros compile to nothing.
+*/
+
+#ifndef ISRSTAT_COUNT
+#define ISRSTAT_COUNT 16   // number of handler ids
+#endif
+
+#define ISRSTAT_BUCKETS 16 // bucket 0: < 32 cycles, bucket b: < 2^(b+5) cycles, last: the rest
+
+struct isrstat {
+    uint32_t count;        // handler calls
+    uint32_t min;          // handler duration in cycles
+    uint32_t max;
+    uint64_t sum;
+    uint32_t latency_min;  // cycles from event to handler, 0xffffffff if never measured
+    uint32_t latency_max;
+    uint32_t missed;       // events the handler could not serve in time
+    uint16_t hist[ISRSTAT_BUCKETS]; // duration histogram, saturates
+};
+
+#ifdef WITH_ISR_STATS
+
+#include <riscv_encoding.h>
+
+void isrstat_init();
+void isrstat_exit( uint32_t id, uint32_t start );
+void isrstat_latency( uint32_t id, uint32_t cycles );
+void isrstat_missed( uint32_t id );
+void isrstat_snapshot( uint32_t id, struct isrstat *copy, int reset );
+void isrstat_send( uint32_t id, void (*put)( uint8_t ch ), int reset );
+
+#define ISRSTAT_INIT()              isrstat_init()
+#define ISRSTAT_ENTER()             uint32_t _isrstat_start = read_csr(mcycle)
+#define ISRSTAT_EXIT(id)            isrstat_exit((id), _isrstat_start)
+#define ISRSTAT_LATENCY(id, cycles) isrstat_latency((id), (cycles))
+#define ISRSTAT_MISSED(id)          isrstat_missed((id))
+#define ISRSTAT_SEND(id, put)       isrstat_send((id), (put), 1)
+
+#else
+
+#define ISRSTAT_INIT()
+#define ISRSTAT_ENTER()
+#define ISRSTAT_EXIT(id)
+#define ISRSTAT_LATENCY(id, cycles)
+#define ISRSTAT_MISSED(id)
+#define ISRSTAT_SEND(id, put)
+
+#endif
+
+#endif
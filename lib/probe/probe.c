@@ -0,0 +1,105 @@
+#include <probe.h>
+
+
+// Results start over, timing continues
+static void clear( struct probe *p ) {
+    p->high = p->low = p->periods = p->max = p->edges = p->odd = p->resyncs = 0;
+    p->min = UINT32_MAX;
+}
+
+// Level of the pin when capturing starts, counter value at that time and expected period
+void probe_start( struct probe *p, uint8_t level, uint16_t now, uint32_t expect ) {
+    p->level = level ? 1 : 0;
+    p->expect = expect;
+    p->now = now;
+    p->idle = 0;
+    p->timed = 0;
+    p->mismatches = 0;
+    p->part_high = p->part_low = 0;
+    clear(p);
+}
+
+// One edge at timestamp stamp, it toggles the level
+static void edge( struct probe *p, uint16_t stamp ) {
+    p->edges++;
+    if( p->timed ) {
+        uint16_t span = stamp - p->last;
+        if( p->level ) p->part_high += span;
+        else p->part_low += span;
+    }
+    p->last = stamp;
+    p->level ^= 1;
+    if( !p->level ) return;
+
+    // rising edge: a period is complete if timing started with the one before
+    if( p->timed ) {
+        uint32_t period = p->part_high + p->part_low;
+        p->high += p->part_high;
+        p->low += p->part_low;
+        p->periods++;
+        if( period < p->min ) p->min = period;
+        if( period > p->max ) p->max = period;
+        if( p->expect && (period > p->expect + p->expect / 8 || period < p->expect - p->expect / 8) ) p->odd++;
+    }
+    p->part_high = p->part_low = 0;
+    p->timed = 1;
+}
+
+// Timing starts over with the next edge
+static void untime( struct probe *p ) {
+    p->timed = 0;
+    p->part_high = p->part_low = 0;
+}
+
+// Take new timestamps ring[from..to) of a circular buffer of size stamps (from == to: none),
+// now is the counter after the last of them was captured and level the pin sampled then.
+// Stamps are placed in time by their distance to the counter at the previous poll
+void probe_poll( struct probe *p, const uint16_t *ring, uint32_t size, uint32_t from, uint32_t to, uint16_t now, uint8_t level ) {
+    if( from != to ) {
+        uint16_t gap = ring[from] - p->now;
+        if( gap >= PROBE_LATE ) gap = 0; // captured before the last poll, written by the dma after it
+        if( p->idle + gap >= 0x10000 ) untime(p); // counter wrapped since the last edge
+    }
+    if( from == to ) {
+        p->idle += (uint16_t)(now - p->now);
+        if( p->idle >= 0x10000 ) p->idle = 0x10000; // no overflow while a pin sticks
+    }
+    else {
+        for( uint32_t i = from; i != to; i = (i + 1 == size) ? 0 : i + 1 ) {
+            edge(p, ring[i]);
+        }
+        p->idle = (uint16_t)(now - p->last);
+    }
+    p->now = now;
+
+    if( level == PROBE_LEVEL_UNKNOWN || level == p->level ) {
+        p->mismatches = 0;
+    }
+    else if( ++p->mismatches >= PROBE_MISMATCHES ) {
+        p->level = level;
+        p->mismatches = 0;
+        p->resyncs++;
+        untime(p);
+    }
+}
+
+// Copy the results and start collecting new ones
+void probe_take( struct probe *p, struct probe_stats *s ) {
+    s->periods = p->periods;
+    s->high = p->high;
+    s->low = p->low;
+    s->min = p->periods ? p->min : 0;
+    s->max = p->max;
+    s->edges = p->edges;
+    s->odd = p->odd;
+    s->resyncs = p->resyncs;
+    s->level = p->level;
+    clear(p);
+}
+
+// Share of the time at level, 0..65536. Without periods the current level had all of it
+uint32_t probe_share( const struct probe_stats *s, uint8_t level ) {
+    uint64_t total = s->high + s->low;
+    if( s->periods == 0 || total == 0 ) return (s->level == level) ? 0x10000 : 0;
+    return ((level ? s->high : s->low) << 16) / total;
+}
@@ -0,0 +1,63 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+
+#define PROBE_MISMATCHES 3     // sampling races with the capture, a real mismatch persists
+#define PROBE_LEVEL_UNKNOWN 2  // no pin sample for this poll
+#define PROBE_LATE 0xff00      // stamps up to 0x100 counts before the poll counter are late, not wrapped
+
+/*
+Pwm measurement from edge timestamps of a free running 16 bit capture counter
+that captures both edges of a pin, e.g. via dma into a circular buffer.
+Timestamps alternate between the two edges, so the level after the first one
+has to be known: the caller samples the pin before starting the capture.
+Durations are differences of timestamps, valid as long as no level lasts a whole
+counter wrap. probe_poll() needs the counter value too and must be called several times
+per counter wrap, so stale timestamps are detected.
+Periods go from rising edge to rising edge, those off the expected one by more than 1/8
+are counted, e.g. missed edges. A missed edge inverts the level, so each poll compares it
+with a sample of the pin: mismatches in PROBE_MISMATCHES polls in a row resync it.
+Results collect until probe_take().
+No hardware access in here.
+*/
+
+struct probe {
+    uint16_t last;        // timestamp of the last edge
+    uint16_t now;         // counter at the last poll
+    uint32_t idle;        // counts since the last edge
+    uint8_t  level;       // pin level after the last edge
+    uint8_t  timed;       // timing since a rising edge, last is a valid time base
+    uint8_t  mismatches;  // polls in a row the pin sample disagreed with level
+    uint32_t expect;      // period to compare with, 0: none
+    // results since probe_take()
+    uint64_t high;        // counts spent high and low in complete periods, 64 bit:
+    uint64_t low;         // a report period of an hour has up to 2^39 counts
+    uint32_t periods;
+    uint32_t min;         // shortest and longest period
+    uint32_t max;
+    uint32_t edges;
+    uint32_t odd;         // periods off expect
+    uint32_t resyncs;     // level corrections
+    uint32_t part_high;   // high and low of the current period
+    uint32_t part_low;
+};
+
+struct probe_stats {
+    uint32_t periods;     // complete periods measured
+    uint64_t high;        // counts high and low in them
+    uint64_t low;
+    uint32_t min;         // shortest and longest period, 0 without periods
+    uint32_t max;
+    uint32_t edges;
+    uint32_t odd;         // periods off the expected one
+    uint32_t resyncs;     // missed edges found by pin samples
+    uint8_t  level;       // current level, tells which one a pin without edges sticks to
+};
+
+void probe_start( struct probe *p, uint8_t level, uint16_t now, uint32_t expect );
+void probe_poll( struct probe *p, const uint16_t *ring, uint32_t size, uint32_t from, uint32_t to, uint16_t now, uint8_t level );
+void probe_take( struct probe *p, struct probe_stats *s );
+uint32_t probe_share( const struct probe_stats *s, uint8_t level );
+
+#endif
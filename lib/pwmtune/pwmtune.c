@@ -0,0 +1,48 @@
+#include <pwmtune.h>
+#include <riscv_encoding.h>
+#include <critical.h>
+
+
+// Busy wait about cycles core clocks and collect the interrupts that happen meanwhile
+void pwmtune_measure( struct pwmtune_sample *s, uint32_t cycles ) {
+    mcycle_enable();
+    s->stolen = s->max = s->gaps = 0;
+    uint32_t start = read_csr(mcycle);
+    uint32_t last = start;
+    uint32_t now;
+    do {
+        now = read_csr(mcycle);
+        uint32_t gap = now - last;
+        if( gap > PWMTUNE_GAP ) {
+            s->stolen += gap;
+            s->gaps++;
+            if( gap > s->max ) s->max = gap;
+        }
+        last = now;
+    } while( now - start < cycles );
+    s->cycles = now - start;
+}
+
+
+// Per mille of the cpu the interrupts of a sample would take with another prescaler
+uint32_t pwmtune_load( const struct pwmtune_sample *s, uint32_t sample_prescale, uint32_t prescale ) {
+    if( s->cycles == 0 || prescale == 0 ) return 0;
+    return ((uint64_t)s->stolen * sample_prescale * 1000 + (uint64_t)s->cycles * prescale - 1) / ((uint64_t)s->cycles * prescale);
+}
+
+
+// Smallest prescaler (highest pwm frequency) that keeps the load within budget
+// and lets the longest interrupt finish within a pwm tick, so edges keep their order.
+// Returns 0 if none up to max_prescale does
+uint32_t pwmtune_select( const struct pwmtune_sample *s, const struct pwmtune_limits *l ) {
+    if( s->cycles == 0 || l->budget == 0 || l->core_hz == 0 ) return 0;
+    uint64_t load = ((uint64_t)s->stolen * l->prescale * 1000 + (uint64_t)s->cycles * l->budget - 1)
+        / ((uint64_t)s->cycles * l->budget);
+    uint64_t tick = ((uint64_t)s->max * l->timer_hz + l->core_hz - 1) / l->core_hz;
+
+    uint64_t prescale = l->min_prescale ? l->min_prescale : 1;
+    if( load > prescale ) prescale = load;
+    if( tick > prescale ) prescale = tick;
+    if( l->even && (prescale & 1) ) prescale++;
+    return (prescale <= l->max_prescale) ? prescale : 0;
+}
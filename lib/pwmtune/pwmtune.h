@@ -0,0 +1,41 @@
+#ifndef PWMTUNE_H
+#define PWMTUNE_H
+
+#include <stdint.h>
+
+/*
+Pick the pwm prescaler from the measured interrupt load.
+pwmtune_measure() busy waits and adds up the cycles interrupts take away from it:
+gaps between two reads of mcycle that are longer than PWMTUNE_GAP.
+Handler calls per pwm interval only depend on pins and duties, so the load scales
+with the interval rate and one sample predicts it for other prescalers.
+Other interrupts in the sample are counted as if they were pwm ones, which errs on the safe side.
+pwmtune_select() does no hardware access.
+*/
+
+#ifndef PWMTUNE_GAP
+#define PWMTUNE_GAP 24 // a loop turn without interrupt takes less cycles
+#endif
+
+struct pwmtune_sample {
+    uint32_t cycles;   // duration of the sample
+    uint32_t stolen;   // cycles spent in interrupts
+    uint32_t max;      // longest interrupt including entry and exit
+    uint32_t gaps;     // interrupts seen
+};
+
+struct pwmtune_limits {
+    uint32_t prescale;      // prescaler while sampling
+    uint32_t core_hz;       // core clock
+    uint32_t timer_hz;      // clock of the pwm timers
+    uint32_t min_prescale;
+    uint32_t max_prescale;
+    uint8_t  even;          // prescaler must be even, e.g. center aligned counters
+    uint16_t budget;        // per mille of the cpu the interrupts may use
+};
+
+void pwmtune_measure( struct pwmtune_sample *s, uint32_t cycles );
+uint32_t pwmtune_load( const struct pwmtune_sample *s, uint32_t sample_prescale, uint32_t prescale );
+uint32_t pwmtune_select( const struct pwmtune_sample *s, const struct pwmtune_limits *l );
+
+#endif
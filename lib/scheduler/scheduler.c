@@ -0,0 +1,126 @@
+#include <scheduler.h>
+#include <critical.h>
+#include <systick.h>
+#include <gd32vf103.h>
+#include <fastreg.h>
+
+// How the core sleeps, the native env replaces it (see test/mock)
+#ifndef SCHED_SLEEP
+#define SCHED_SLEEP() __asm__ volatile( "wfi" )
+#endif
+
+/*
+Cooperative scheduler driven by the machine timer compare interrupt.
+Tasks are stepped from sched_run() in the main loop. In between the core
+sleeps with wfi until the next task is due or any other interrupt arrives.
+Periodic tasks are scheduled relative to their last due time, so they don't drift.
+There are a handful of tasks with exact mtime due times, so they are a plain list.
+*/
+
+#define MTIMECMP ((volatile uint32_t *)(TIMER_CTRL_ADDR + TIMER_MTIMECMP))
+
+static struct sched_task *_tasks;
+static uint32_t _max_late;  // worst step delay in mtime ticks
+static uint32_t _overruns;  // periodic steps skipped because they were too late
+
+
+// Set 64 bit compare register without a spurious match on the way
+static void set_compare( uint64_t when ) {
+    reg_store(&MTIMECMP[1], UINT32_MAX);
+    reg_store(&MTIMECMP[0], (uint32_t)when);
+    reg_store(&MTIMECMP[1], (uint32_t)(when >> 32));
+}
+
+
+// Only wakes the core, work is done in sched_run()
+void eclic_mtip_handler() {
+    set_compare(UINT64_MAX);
+}
+
+
+void sched_init() {
+    _tasks = 0;
+    systick_init(); // time conversion factors for current core clock
+    _max_late = _overruns = 0;
+    set_compare(UINT64_MAX);
+    eclic_irq_enable(CLIC_INT_TMR, 1, 0);
+}
+
+
+// Convert microseconds to mtime ticks
+uint32_t sched_ticks( uint32_t us ) {
+    return systick_us_to_ticks(us);
+}
+
+
+// Run task first after delay_us, then every period_us (if not 0)
+void sched_add( struct sched_task *task, uint32_t delay_us, uint32_t period_us ) {
+    sched_remove(task);
+    task->due = get_timer_value() + sched_ticks(delay_us);
+    task->period = sched_ticks(period_us);
+    task->next = _tasks;
+    _tasks = task;
+}
+
+
+void sched_remove( struct sched_task *task ) {
+    struct sched_task **curr = &_tasks;
+    while( *curr ) {
+        if( *curr == task ) {
+            *curr = task->next;
+            return;
+        }
+        curr = &(*curr)->next;
+    }
+}
+
+
+// Step all due tasks, then sleep until the next one is due or an interrupt happens
+void sched_run() {
+    uint64_t now = get_timer_value();
+    struct sched_task *task = _tasks;
+    while( task ) {
+        struct sched_task *next = task->next; // step may remove or re-add task
+        if( (int64_t)(now - task->due) >= 0 ) {
+            uint32_t late = now - task->due;
+            if( late > _max_late ) _max_late = late;
+            if( task->period ) {
+                task->due += task->period;
+                if( (int64_t)(now - task->due) >= 0 ) { // more than a period late: don't try to catch up
+                    task->due = now + task->period;
+                    _overruns++;
+                }
+            }
+            else {
+                sched_remove(task);
+            }
+            task->step(task);
+        }
+        task = next;
+    }
+
+    if( !_tasks ) return;
+    uint64_t due = _tasks->due;
+    for( task = _tasks->next; task; task = task->next ) {
+        if( (int64_t)(task->due - due) < 0 ) due = task->due;
+    }
+
+    // wfi also returns on interrupts pending while masked, so nothing is missed
+    uint32_t irq = critical_enter();
+    set_compare(due);
+    if( (int64_t)(get_timer_value() - due) < 0 ) {
+        SCHED_SLEEP();
+    }
+    critical_exit(irq);
+}
+
+
+// Worst delay of a step after its due time in mtime ticks
+uint32_t sched_max_late() {
+    return _max_late;
+}
+
+
+uint32_t sched_overruns() {
+    return _overruns;
+}
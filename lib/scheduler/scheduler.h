@@ -0,0 +1,25 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+struct sched_task;
+typedef void (*sched_step)( struct sched_task *task );
+
+struct sched_task {
+    sched_step step;          // called from sched_run() when due
+    uint32_t period;          // mtime ticks between steps, 0 for one shot
+    uint64_t due;             // mtime of next step
+    struct sched_task *next;  // no need to init this
+};
+
+void sched_init();
+void sched_add( struct sched_task *task, uint32_t delay_us, uint32_t period_us );
+void sched_remove( struct sched_task *task );
+uint32_t sched_ticks( uint32_t us );
+void sched_run();
+
+uint32_t sched_max_late();
+uint32_t sched_overruns();
+
+#endif
@@ -0,0 +1,91 @@
+#include <stream.h>
+
+enum stream_states { SYNC0, SYNC1, LENGTH, PAYLOAD, CRC0, CRC1 };
+
+
+void stream_init( struct stream *s, void (*text)( char ch ) ) {
+    *s = (struct stream){ .text = text, .state = SYNC0, .idle = STREAM_ACTIVE };
+}
+
+
+uint16_t stream_crc16( uint16_t crc, uint8_t byte ) {
+    crc ^= (uint16_t)byte << 8;
+    for( int b = 0; b < 8; b++ ) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+
+// Parse received bytes, never blocks
+void stream_feed( struct stream *s, const uint8_t *data, uint32_t count ) {
+    for( uint32_t i = 0; i < count; i++ ) {
+        uint8_t byte = data[i];
+        switch( s->state ) {
+            case SYNC0:
+                if( byte == STREAM_SYNC0 ) {
+                    s->state = SYNC1;
+                }
+                else if( s->text ) {
+                    s->text((char)byte);
+                }
+                break;
+            case SYNC1:
+                if( byte == STREAM_SYNC1 ) {
+                    s->state = LENGTH;
+                }
+                else if( byte != STREAM_SYNC0 ) { // 0xAA 0xAA 0x55 still syncs
+                    s->state = SYNC0;
+                }
+                break;
+            case LENGTH:
+                if( byte == 0 || byte > STREAM_MAX_PAYLOAD ) {
+                    s->length_errors++;
+                    s->state = SYNC0;
+                    break;
+                }
+                s->length = byte;
+                s->pos = 0;
+                s->crc = stream_crc16(0xffff, byte);
+                s->state = PAYLOAD;
+                break;
+            case PAYLOAD:
+                s->payload[s->back][s->pos++] = byte;
+                s->crc = stream_crc16(s->crc, byte);
+                if( s->pos == s->length ) s->state = CRC0;
+                break;
+            case CRC0:
+                s->received_crc = byte;
+                s->state = CRC1;
+                break;
+            case CRC1:
+                s->received_crc |= (uint16_t)byte << 8;
+                s->state = SYNC0;
+                if( s->received_crc != s->crc ) {
+                    s->crc_errors++;
+                    break;
+                }
+                s->frames++;
+                if( s->ready ) s->dropped++;
+                s->lengths[s->back] = s->length;
+                s->back ^= 1;
+                s->ready = 1;
+                break;
+        }
+    }
+}
+
+
+// Newest complete frame not taken yet or 0. Call at the rate frames are expected
+// The payload stays valid until the next frame is complete
+const uint8_t *stream_frame( struct stream *s, uint32_t *length ) {
+    if( !s->ready ) {
+        if( s->idle < STREAM_ACTIVE ) s->idle++;
+        return 0;
+    }
+    if( s->idle < STREAM_ACTIVE ) s->underruns += s->idle; // gaps, but not the pause before a new stream
+    s->ready = 0;
+    s->idle = 0;
+    *length = s->lengths[s->back ^ 1];
+    return s->payload[s->back ^ 1];
+}
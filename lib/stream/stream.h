@@ -0,0 +1,47 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+
+/*
+Binary frames in a byte stream, e.g. live duties from a host via serial:
+  0xAA 0x55 length payload[length] crc16 (little endian)
+crc16 is CCITT (poly 0x1021, init 0xffff) over length and payload.
+Bytes outside of frames go to a text function, so commands still work.
+Frames are decoded into one buffer while the last complete one waits in the other.
+*/
+
+#ifndef STREAM_MAX_PAYLOAD
+#define STREAM_MAX_PAYLOAD 64
+#endif
+
+#define STREAM_SYNC0 0xAA
+#define STREAM_SYNC1 0x55
+
+#define STREAM_ACTIVE 10 // stream_frame() calls without frame until the stream counts as stopped
+
+struct stream {
+    void (*text)( char ch );  // gets bytes outside of frames, may be 0
+    uint8_t  state;
+    uint8_t  length;
+    uint8_t  pos;
+    uint16_t crc;
+    uint16_t received_crc;
+    uint8_t  payload[2][STREAM_MAX_PAYLOAD];
+    uint8_t  lengths[2];
+    uint8_t  back;            // buffer being decoded into
+    uint8_t  ready;           // other buffer has a frame not yet taken
+    uint32_t idle;            // stream_frame() calls since the last frame
+    uint32_t frames;          // valid frames received
+    uint32_t crc_errors;
+    uint32_t length_errors;
+    uint32_t dropped;         // valid frames replaced before stream_frame() took them
+    uint32_t underruns;       // stream_frame() calls without new frame between frames of a stream
+};
+
+void stream_init( struct stream *s, void (*text)( char ch ) );
+void stream_feed( struct stream *s, const uint8_t *data, uint32_t count );
+const uint8_t *stream_frame( struct stream *s, uint32_t *length );
+uint16_t stream_crc16( uint16_t crc, uint8_t byte );
+
+#endif
@@ -35,6 +35,76 @@ OF SUCH DAMAGE.
 #include "gd32vf103.h"
 #include "systick.h"
 
+/* mtime runs at core clock / 4, factors are precomputed by systick_init() */
+static uint32_t us_per_tick_q32;    /* microseconds per mtime tick, 0.32 fixed point */
+static uint32_t ms_per_tick_q32;    /* milliseconds per mtime tick, 0.32 fixed point */
+static uint32_t ticks_per_us_q16;   /* mtime ticks per microsecond, 16.16 fixed point */
+
+/*!
+    \brief      precompute time conversion factors, again after core clock changes
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void systick_init(void)
+{
+    uint64_t mtime_hz = SystemCoreClock / 4;
+
+    us_per_tick_q32 = ((1000000ULL << 32) + mtime_hz / 2) / mtime_hz;
+    ms_per_tick_q32 = ((1000ULL << 32) + mtime_hz / 2) / mtime_hz;
+    ticks_per_us_q16 = ((mtime_hz << 16) + 500000) / 1000000;
+}
+
+/*!
+    \brief      convert microseconds to mtime ticks
+    \param[in]  us: time in microseconds
+    \param[out] none
+    \retval     time in mtime ticks
+*/
+uint64_t systick_us_to_ticks(uint32_t us)
+{
+    if (0 == ticks_per_us_q16) {
+        systick_init();
+    }
+    return ((uint64_t)us * ticks_per_us_q16) >> 16;
+}
+
+/* scale 64 bit mtime with 0.32 fixed point factor without 64 bit overflow */
+static uint64_t scale_ticks(uint64_t ticks, uint32_t factor_q32)
+{
+    uint32_t hi = (uint32_t)(ticks >> 32);
+    uint32_t lo = (uint32_t)ticks;
+    return (uint64_t)hi * factor_q32 + (((uint64_t)lo * factor_q32) >> 32);
+}
+
+/*!
+    \brief      monotonic time since reset in microseconds
+    \param[in]  none
+    \param[out] none
+    \retval     microseconds
+*/
+uint64_t micros(void)
+{
+    if (0 == us_per_tick_q32) {
+        systick_init();
+    }
+    return scale_ticks(get_timer_value(), us_per_tick_q32);
+}
+
+/*!
+    \brief      monotonic time since reset in milliseconds
+    \param[in]  none
+    \param[out] none
+    \retval     milliseconds
+*/
+uint64_t millis(void)
+{
+    if (0 == ms_per_tick_q32) {
+        systick_init();
+    }
+    return scale_ticks(get_timer_value(), ms_per_tick_q32);
+}
+
 /*!
     \brief      delay a time in milliseconds
     \param[in]  count: count in milliseconds
@@ -43,17 +113,10 @@ OF SUCH DAMAGE.
 */
 void delay_1ms(uint32_t count)
 {
-	uint64_t start_mtime, delta_mtime;
+    uint64_t end = get_timer_value() + 1000 * systick_us_to_ticks(count);
 
-	// Don't start measuring until we see an mtime tick
-	uint64_t tmp = get_timer_value();
-	do {
-	    start_mtime = get_timer_value();
-	} while( start_mtime == tmp );
-
-	do {
-	    delta_mtime = get_timer_value() - start_mtime;
-	}while( delta_mtime < ((uint64_t)SystemCoreClock * count) / 4000 );
+    while (get_timer_value() < end) {
+    }
 }
 
 /*!
@@ -62,16 +125,30 @@ void delay_1ms(uint32_t count)
     \param[out] none
     \retval     none
 */
-void delay_1us(uint32_t count) {
-    uint64_t start_mtime, delta_mtime;
-
-    // Don't start measuring until we see an mtime tick
-    uint64_t tmp = get_timer_value();
-    do {
-        start_mtime = get_timer_value();
-    } while( start_mtime == tmp );
-
-    do {
-        delta_mtime = get_timer_value() - start_mtime;
-    } while( delta_mtime < ((uint64_t)SystemCoreClock * count) / 4000000 );
+void delay_1us(uint32_t count)
+{
+    uint64_t end = get_timer_value() + systick_us_to_ticks(count);
+
+    while (get_timer_value() < end) {
+    }
+}
+
+/*!
+    \brief      wait for the next deadline of a periodic activity
+                 deadlines advance by period_us from the previous one, so time spent
+                 between calls does not add up to a drift
+    \param[in]  deadline: last deadline in mtime ticks, 0 to start from now
+    \param[in]  period_us: time from last deadline in microseconds
+    \param[out] deadline: the deadline waited for
+    \retval     none
+*/
+void delay_until(uint64_t *deadline, uint32_t period_us)
+{
+    if (0 == *deadline) {
+        *deadline = get_timer_value();
+    }
+    *deadline += systick_us_to_ticks(period_us);
+
+    while (get_timer_value() < *deadline) {
+    }
 }
@@ -37,7 +37,13 @@ OF SUCH DAMAGE.
 
 #include <stdint.h>
 
+void systick_init(void);
+uint64_t systick_us_to_ticks(uint32_t us);
+uint64_t micros(void);
+uint64_t millis(void);
+
 void delay_1ms(uint32_t count);
 void delay_1us(uint32_t count);
+void delay_until(uint64_t *deadline, uint32_t period_us);
 
 #endif /* SYS_TICK_H */
@@ -0,0 +1,98 @@
+#include <tlog.h>
+
+#ifdef WITH_TLOG
+
+/*
+Records are sent as binary frames, decoded by tools/tlog_decode.py:
+0xA5 0x4C, id (16 bit), number of arguments, arguments (32 bit),
+crc8 (poly 0x07) of id, number and arguments. All little endian.
+
+Writers reserve words by moving the head with compare and swap, so handlers
+of any priority can interrupt each other in the middle of a write.
+The header is written last: the reader stops at a reserved but unwritten
+record (header still 0) and picks it up on the next flush.
+*/
+
+#define MASK (TLOG_WORDS - 1)
+
+static uint32_t _buf[TLOG_WORDS];
+static uint32_t _head;     // next word to reserve
+static uint32_t _tail;     // oldest word not yet sent
+static uint32_t _dropped;  // records that did not fit
+static uint32_t _reported; // dropped records already sent
+
+
+// Queue a record: header and arguments. Returns 0 if the buffer is full
+int tlog_write( const uint32_t *record, uint32_t words ) {
+    uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+    do {
+        if( head + words - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE) > TLOG_WORDS ) {
+            __atomic_fetch_add(&_dropped, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    } while( !__atomic_compare_exchange_n(&_head, &head, head + words, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) );
+
+    for( uint32_t i = 1; i < words; i++ ) {
+        _buf[(head + i) & MASK] = record[i];
+    }
+    __atomic_store_n(&_buf[head & MASK], record[0], __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+static uint8_t crc8( uint8_t crc, uint8_t data ) {
+    crc ^= data;
+    for( int i = 0; i < 8; i++ ) {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+
+static void send( void (*put)( uint8_t ch ), uint16_t id, uint32_t count, const uint32_t *args, uint32_t pos ) {
+    uint8_t crc = crc8(crc8(crc8(0, id), id >> 8), count);
+    put(TLOG_SYNC0);
+    put(TLOG_SYNC1);
+    put(id);
+    put(id >> 8);
+    put(count);
+    for( uint32_t a = 0; a < count; a++ ) {
+        uint32_t arg = args[(pos + a) & MASK];
+        for( int i = 0; i < 4; i++ ) {
+            put(arg >> (8 * i));
+            crc = crc8(crc, arg >> (8 * i));
+        }
+    }
+    put(crc);
+}
+
+
+// Send committed records, put is called for each byte. Call from one place only, e.g. the main loop
+void tlog_flush( void (*put)( uint8_t ch ) ) {
+    uint32_t tail = _tail;
+    while( tail != __atomic_load_n(&_head, __ATOMIC_RELAXED) ) {
+        uint32_t header = __atomic_load_n(&_buf[tail & MASK], __ATOMIC_ACQUIRE);
+        if( !header ) break; // writer not done yet
+        uint32_t count = (header >> 8) & 0xff;
+        send(put, header >> 16, count, _buf, tail + 1);
+        for( uint32_t i = 0; i <= count; i++ ) {
+            _buf[(tail + i) & MASK] = 0;
+        }
+        tail += 1 + count;
+        __atomic_store_n(&_tail, tail, __ATOMIC_RELEASE);
+    }
+
+    uint32_t dropped = _dropped;
+    if( dropped != _reported ) {
+        uint32_t lost = dropped - _reported;
+        send(put, TLOG_DROPPED, 1, &lost, 0);
+        _reported = dropped;
+    }
+}
+
+
+uint32_t tlog_dropped() {
+    return _dropped;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TLOG_H
+#define TLOG_H
+
+#include <stdint.h>
+
+/*
+Tokenized logging: printf style calls without formatting on the device.
+The format string goes into the non-loaded section .tlog (no flash, no ram),
+its offset there is the log id. A call only queues id and raw 32 bit arguments
+into a lock-free ring buffer, so it is safe and cheap in interrupt handlers.
+tlog_flush() sends queued records as binary frames from the main loop,
+tools/tlog_decode.py formats them on the host with the strings from the elf file.
+%s arguments must point to constant strings in flash, the decoder reads them from the elf.
+Up to TLOG_MAX_ARGS integer or pointer arguments, no 64 bit or floating point values.
+Without WITH_TLOG, TLOG() compiles to nothing.
+*/
+
+// Ring buffer size in 32 bit words, power of 2. A record takes 1 + number of arguments words
+#ifndef TLOG_WORDS
+#define TLOG_WORDS 256
+#endif
+
+#define TLOG_MAX_ARGS 6
+
+#define TLOG_SYNC0 0xA5
+#define TLOG_SYNC1 0x4C
+
+#define TLOG_DROPPED 0xffff // id of the record telling how many records did not fit
+
+#ifdef WITH_TLOG
+
+// Not allocated: the trailing # comments out the section flags the compiler appends
+#define TLOG_SECTION ".tlog,\"\",@progbits #"
+
+// Record header: id, argument count and a marker so a committed header is never 0
+#define TLOG_HEADER(id, n) (((uint32_t)(uintptr_t)(id) << 16) | ((n) << 8) | 0x5a)
+
+#define TLOG_ARG(a) ((uint32_t)(uintptr_t)(a))
+#define TLOG_ARGS_0()
+#define TLOG_ARGS_1(a)                , TLOG_ARG(a)
+#define TLOG_ARGS_2(a, b)             , TLOG_ARG(a), TLOG_ARG(b)
+#define TLOG_ARGS_3(a, b, c)          , TLOG_ARG(a), TLOG_ARG(b), TLOG_ARG(c)
+#define TLOG_ARGS_4(a, b, c, d)       , TLOG_ARG(a), TLOG_ARG(b), TLOG_ARG(c), TLOG_ARG(d)
+#define TLOG_ARGS_5(a, b, c, d, e)    , TLOG_ARG(a), TLOG_ARG(b), TLOG_ARG(c), TLOG_ARG(d), TLOG_ARG(e)
+#define TLOG_ARGS_6(a, b, c, d, e, f) , TLOG_ARG(a), TLOG_ARG(b), TLOG_ARG(c), TLOG_ARG(d), TLOG_ARG(e), TLOG_ARG(f)
+
+#define TLOG_NARGS(...) TLOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define TLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define TLOG_CAT(a, b) TLOG_CAT_(a, b)
+#define TLOG_CAT_(a, b) a ## b
+
+#define TLOG(fmt, ...) do { \
+    static const char _tlog_fmt[] __attribute__((section(TLOG_SECTION), used)) = fmt; \
+    tlog_write((const uint32_t[]){ TLOG_HEADER(_tlog_fmt, TLOG_NARGS(__VA_ARGS__)) \
+        TLOG_CAT(TLOG_ARGS_, TLOG_NARGS(__VA_ARGS__))(__VA_ARGS__) }, 1 + TLOG_NARGS(__VA_ARGS__)); \
+} while( 0 )
+
+int tlog_write( const uint32_t *record, uint32_t words );
+void tlog_flush( void (*put)( uint8_t ch ) );
+uint32_t tlog_dropped();
+
+#else
+
+#define TLOG(fmt, ...)
+
+#endif
+
+#endif
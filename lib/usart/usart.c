@@ -1,6 +1,9 @@
 #include <usart.h>
 #include <gd32vf103_rcu.h>
 #include <gd32vf103_gpio.h>
+#include <gd32vf103_dma.h>
+#include <critical.h>
+#include <fastreg.h>
 
 void usart_init( uint32_t usart, uint32_t baud )
 {
@@ -43,8 +46,306 @@ void usart_init( uint32_t usart, uint32_t baud )
 }
 
 
+// Fastest baud rate the usart can do: its bus clock / 16 (oversampling)
+uint32_t usart_max_baud( uint32_t usart ) {
+    return rcu_clock_freq_get(usart == USART0 ? CK_APB2 : CK_APB1) / 16;
+}
+
+
+// Change baud rate after sending what is queued. Return 0 if the usart can't do it
+int usart_baud( uint32_t usart, uint32_t baud ) {
+    if( baud == 0 || baud > usart_max_baud(usart) ) return 0;
+    usart_tx_flush(usart);
+    usart_disable(usart);
+    usart_baudrate_set(usart, baud);
+    usart_enable(usart);
+    return 1;
+}
+
+
+/*
+Buffered transmit: usart_put_char() only queues the byte in a ring buffer
+and dma drains it to the usart in the background.
+The dma is fed with the longest contiguous chunk available and the next chunk
+is started from the transfer complete interrupt (or from the next put/flush
+if interrupts are not enabled yet).
+*/
+
+#if USART_TX_BUFFER_SIZE & (USART_TX_BUFFER_SIZE - 1)
+#error "USART_TX_BUFFER_SIZE must be a power of 2"
+#endif
+
+#define TX_MASK (USART_TX_BUFFER_SIZE - 1)
+
+static uint8_t _tx_buf[USART_TX_BUFFER_SIZE];
+static volatile uint16_t _tx_head;  // next free slot
+static volatile uint16_t _tx_tail;  // oldest byte not yet sent
+static volatile uint16_t _tx_len;   // bytes from tail handed to dma
+static volatile uint16_t _tx_send;  // oldest byte not yet handed to dma
+static volatile uint32_t _tx_dropped;
+static uint32_t _tx_usart;          // usart using the buffer, 0 if none
+static enum usart_tx_policy _tx_policy;
+
+
+// Retire a finished dma chunk and start the next one
+static void tx_kick() {
+    uint32_t irq = critical_enter();
+    if( _tx_len && reg_dma_flag(DMA0, DMA_CH3, DMA_FLAG_FTF) ) {
+        reg_dma_flag_clear(DMA0, DMA_CH3, DMA_FLAG_G);
+        reg_dma_disable(DMA0, DMA_CH3);
+        _tx_tail += _tx_len;
+        _tx_len = 0;
+    }
+    if( !_tx_len && _tx_head != _tx_tail ) {
+        uint16_t start = _tx_tail & TX_MASK;
+        uint16_t len = _tx_head - _tx_tail;
+        if( start + len > USART_TX_BUFFER_SIZE ) len = USART_TX_BUFFER_SIZE - start; // wrapped part goes next time
+        _tx_len = len;
+        _tx_send = _tx_tail + len;
+        reg_dma_start(DMA0, DMA_CH3, &_tx_buf[start], len);
+    }
+    critical_exit(irq);
+}
+
+
+// Queue a byte, return 0 if the policy says it can't be queued right now
+static int tx_queue( uint8_t ch ) {
+    int queued = 1;
+    uint32_t irq = critical_enter();
+    if( (uint16_t)(_tx_head - _tx_tail) >= USART_TX_BUFFER_SIZE ) {
+        if( _tx_policy == USART_TX_OVERWRITE && _tx_head != _tx_send ) {
+            // The newest byte dma doesn't have yet gives its slot to this one, nothing moves
+            _tx_buf[(uint16_t)(_tx_head - 1) & TX_MASK] = ch;
+            _tx_dropped++;
+            critical_exit(irq);
+            return 1;
+        }
+        else if( _tx_policy == USART_TX_BLOCK ) {
+            queued = 0;
+        }
+        else {
+            _tx_dropped++;
+            critical_exit(irq);
+            return 1; // nothing to retry
+        }
+    }
+    if( queued ) {
+        _tx_buf[_tx_head & TX_MASK] = ch;
+        _tx_head++;
+    }
+    critical_exit(irq);
+    return queued;
+}
+
+
+// Use buffered dma transmit for usart. Only USART0 (DMA0 channel 3) supported for now
+int usart_tx_dma_init( uint32_t usart, enum usart_tx_policy policy ) {
+    if( usart != USART0 ) return 0;
+
+    rcu_periph_clock_enable(RCU_DMA0);
+    dma_deinit(DMA0, DMA_CH3);
+
+    dma_parameter_struct dp = {
+        .periph_addr  = (uint32_t)&USART_DATA(usart),
+        .periph_width = DMA_PERIPHERAL_WIDTH_8BIT,
+        .memory_addr  = (uint32_t)_tx_buf,
+        .memory_width = DMA_MEMORY_WIDTH_8BIT,
+        .number       = 0,                // set per chunk
+        .priority     = DMA_PRIORITY_LOW,
+        .periph_inc   = DMA_PERIPH_INCREASE_DISABLE,
+        .memory_inc   = DMA_MEMORY_INCREASE_ENABLE,
+        .direction    = DMA_MEMORY_TO_PERIPHERAL};
+    dma_init(DMA0, DMA_CH3, &dp);
+    dma_circulation_disable(DMA0, DMA_CH3);
+    dma_memory_to_memory_disable(DMA0, DMA_CH3);
+    dma_interrupt_enable(DMA0, DMA_CH3, DMA_INT_FTF);
+    eclic_irq_enable(DMA0_Channel3_IRQn, 1, 0);
+
+    _tx_head = _tx_tail = _tx_len = _tx_send = 0;
+    _tx_dropped = 0;
+    _tx_policy = policy;
+    _tx_usart = usart;
+
+    usart_dma_transmit_config(usart, USART_DENT_ENABLE);
+    return 1;
+}
+
+
+// Wait until everything queued has been sent
+void usart_tx_flush( uint32_t usart ) {
+    if( usart == _tx_usart ) {
+        while( _tx_head != _tx_tail ) tx_kick();
+    }
+    while( usart_flag_get(usart, USART_FLAG_TC) == RESET );
+}
+
+
+// Bytes lost due to USART_TX_DROP or USART_TX_OVERWRITE policy
+uint32_t usart_tx_dropped() {
+    return _tx_dropped;
+}
+
+
 int usart_put_char( uint32_t usart, int ch ) {
-    usart_data_transmit(usart, (uint8_t)ch);
-    while( usart_flag_get(usart, USART_FLAG_TBE) == RESET );
+    if( usart == _tx_usart ) {
+        while( !tx_queue((uint8_t)ch) ) tx_kick(); // only USART_TX_BLOCK loops
+        tx_kick();
+        return ch;
+    }
+    reg_usart_write(usart, (uint8_t)ch);
+    while( !reg_usart_tbe(usart) );
     return ch;
 }
+
+
+/*
+Interrupt driven receive: the handler collects bytes directly into a ring of
+line buffers. A line is complete at CR or LF and handed out as is, so a parser
+can tokenize it in place. The slot is reused after usart_rx_line_done().
+*/
+
+#if USART_RX_LINES & (USART_RX_LINES - 1)
+#error "USART_RX_LINES must be a power of 2"
+#endif
+
+#define RX_MASK (USART_RX_LINES - 1)
+
+static char _rx_lines[USART_RX_LINES][USART_RX_LINE_SIZE];
+static volatile uint8_t _rx_head;  // line currently filled by the interrupt
+static volatile uint8_t _rx_tail;  // oldest complete line
+static uint16_t _rx_pos;           // next char in line _rx_head
+static volatile uint32_t _rx_overruns;
+
+
+// Add received byte to current line, called from interrupt or usart_rx_add()
+static void rx_byte( char ch ) {
+    if( (uint8_t)(_rx_head - _rx_tail) >= USART_RX_LINES ) {
+        _rx_overruns++; // all lines complete but not yet processed
+        return;
+    }
+    char *line = _rx_lines[_rx_head & RX_MASK];
+    if( ch == '\r' || ch == '\n' ) {
+        if( _rx_pos ) { // ignore empty lines, e.g. from CR LF
+            line[_rx_pos] = '\0';
+            _rx_pos = 0;
+            _rx_head++;
+        }
+    }
+    else if( _rx_pos < USART_RX_LINE_SIZE - 1 ) {
+        line[_rx_pos++] = ch;
+    }
+    else {
+        _rx_overruns++; // line too long, rest is cut off
+    }
+}
+
+
+// Receive lines via interrupt. Only USART0 supported for now
+int usart_rx_init( uint32_t usart ) {
+    if( usart != USART0 ) return 0;
+
+    _rx_head = _rx_tail = 0;
+    _rx_pos = 0;
+    _rx_overruns = 0;
+
+    usart_interrupt_enable(usart, USART_INT_RBNE); // usart_init() did that already, paranoia
+    eclic_irq_enable(USART0_IRQn, 1, 0);
+    return 1;
+}
+
+
+// Oldest complete line or 0 if there is none. Never blocks
+char *usart_rx_line() {
+    if( _rx_head == _rx_tail ) return 0;
+    return _rx_lines[_rx_tail & RX_MASK];
+}
+
+
+// Done with line from usart_rx_line(), its buffer can be reused
+void usart_rx_line_done() {
+    if( _rx_head != _rx_tail ) _rx_tail++;
+}
+
+
+// Received bytes lost because lines were too long or not processed in time
+uint32_t usart_rx_overruns() {
+    return _rx_overruns;
+}
+
+
+// Add a byte to the receive lines as if it came from the interrupt,
+// e.g. text between binary frames received via dma
+void usart_rx_add( char ch ) {
+    rx_byte(ch);
+}
+
+
+/*
+Dma driven receive: the dma writes all received bytes into a circular buffer,
+the cpu only looks at them when it has time. No interrupts involved, so the
+buffer must be read before it laps, e.g. 1024 bytes at 2 MBaud every 5ms.
+Lost bytes are not detected here, the protocol on top should check.
+*/
+
+#if USART_RX_DMA_SIZE & (USART_RX_DMA_SIZE - 1)
+#error "USART_RX_DMA_SIZE must be a power of 2"
+#endif
+
+static uint8_t _rx_dma_buf[USART_RX_DMA_SIZE];
+static uint32_t _rx_dma_tail;  // next byte to read
+
+
+// Receive via circular dma instead of the line interrupt. Only USART0 (DMA0 channel 4) supported for now
+int usart_rx_dma_init( uint32_t usart ) {
+    if( usart != USART0 ) return 0;
+
+    usart_interrupt_disable(usart, USART_INT_RBNE);
+    rcu_periph_clock_enable(RCU_DMA0);
+    dma_deinit(DMA0, DMA_CH4);
+
+    dma_parameter_struct dp = {
+        .periph_addr  = (uint32_t)&USART_DATA(usart),
+        .periph_width = DMA_PERIPHERAL_WIDTH_8BIT,
+        .memory_addr  = (uint32_t)_rx_dma_buf,
+        .memory_width = DMA_MEMORY_WIDTH_8BIT,
+        .number       = USART_RX_DMA_SIZE,
+        .priority     = DMA_PRIORITY_HIGH,
+        .periph_inc   = DMA_PERIPH_INCREASE_DISABLE,
+        .memory_inc   = DMA_MEMORY_INCREASE_ENABLE,
+        .direction    = DMA_PERIPHERAL_TO_MEMORY};
+    dma_init(DMA0, DMA_CH4, &dp);
+    dma_circulation_enable(DMA0, DMA_CH4);
+    dma_memory_to_memory_disable(DMA0, DMA_CH4);
+    dma_channel_enable(DMA0, DMA_CH4);
+
+    _rx_dma_tail = 0;
+    usart_dma_receive_config(usart, USART_DENR_ENABLE);
+    return 1;
+}
+
+
+// Oldest received bytes not yet consumed: returns how many are contiguous at *data. Never blocks
+uint32_t usart_rx_dma_peek( const uint8_t **data ) {
+    uint32_t head = USART_RX_DMA_SIZE - reg_dma_remaining(DMA0, DMA_CH4); // next byte dma writes
+    if( head == USART_RX_DMA_SIZE ) head = 0;
+    *data = &_rx_dma_buf[_rx_dma_tail];
+    return (head >= _rx_dma_tail) ? head - _rx_dma_tail : USART_RX_DMA_SIZE - _rx_dma_tail;
+}
+
+
+// Done with count bytes from usart_rx_dma_peek()
+void usart_rx_dma_consume( uint32_t count ) {
+    _rx_dma_tail = (_rx_dma_tail + count) & (USART_RX_DMA_SIZE - 1);
+}
+
+
+void DMA0_Channel3_IRQHandler() {
+    tx_kick();
+}
+
+
+void USART0_IRQHandler() {
+    if( usart_interrupt_flag_get(USART0, USART_INT_FLAG_RBNE) != RESET ) {
+        rx_byte((char)usart_data_receive(USART0)); // reading data clears the flag
+    }
+}
@@ -4,7 +4,48 @@
 #include <stdint.h>
 #include <gd32vf103_usart.h>
 
+// Size of the transmit ring buffer used after usart_tx_dma_init(), power of 2
+#ifndef USART_TX_BUFFER_SIZE
+#define USART_TX_BUFFER_SIZE 256
+#endif
+
+// What usart_put_char() does if the transmit ring buffer is full
+enum usart_tx_policy {
+    USART_TX_DROP,      // discard the new byte
+    USART_TX_BLOCK,     // wait until dma made room
+    USART_TX_OVERWRITE  // discard the newest queued byte not yet handed to dma, keep the new one
+};
+
+// Receive line buffers used after usart_rx_init(), number of lines is a power of 2
+#ifndef USART_RX_LINE_SIZE
+#define USART_RX_LINE_SIZE 64
+#endif
+#ifndef USART_RX_LINES
+#define USART_RX_LINES 4
+#endif
+
+// Size of the circular receive buffer used after usart_rx_dma_init(), power of 2
+#ifndef USART_RX_DMA_SIZE
+#define USART_RX_DMA_SIZE 1024
+#endif
+
 void usart_init( uint32_t usart, uint32_t baud );
+uint32_t usart_max_baud( uint32_t usart );
+int usart_baud( uint32_t usart, uint32_t baud );
 int usart_put_char( uint32_t usart, int ch );
 
+int usart_tx_dma_init( uint32_t usart, enum usart_tx_policy policy );
+void usart_tx_flush( uint32_t usart );
+uint32_t usart_tx_dropped();
+
+int usart_rx_init( uint32_t usart );
+char *usart_rx_line();
+void usart_rx_line_done();
+uint32_t usart_rx_overruns();
+void usart_rx_add( char ch );
+
+int usart_rx_dma_init( uint32_t usart );
+uint32_t usart_rx_dma_peek( const uint8_t **data );
+void usart_rx_dma_consume( uint32_t count );
+
 #endif
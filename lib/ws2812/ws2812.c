@@ -0,0 +1,144 @@
+#include <ws2812.h>
+#include <fastreg.h>
+#include <gd32vf103_timer.h>
+#include <gd32vf103_rcu.h>
+
+#define HALF_BITS (WS2812_HALF_BYTES * 8) // compare values per half of the dma buffer
+#define RESET_BYTES ((WS2812_RESET_US * (WS2812_HZ / 1000) / 1000 + 7) / 8)
+
+
+// Compare values for count bytes of data, msb first. Without data the line stays low (reset)
+void ws2812_encode( uint16_t *cv, const uint8_t *data, uint32_t count, uint16_t t0h, uint16_t t1h ) {
+    for( uint32_t i = 0; i < count; i++ ) {
+        uint8_t byte = data ? data[i] : 0;
+        for( uint8_t mask = 0x80; mask; mask >>= 1 ) {
+            *cv++ = data ? ((byte & mask) ? t1h : t0h) : 0;
+        }
+    }
+}
+
+
+// Encode the next bytes of the frame into one half of the dma buffer
+static void refill( struct ws2812 *s, uint16_t *cv ) {
+    uint32_t left = WS2812_HALF_BYTES;
+    if( s->pos < s->bytes ) {
+        uint32_t count = s->bytes - s->pos;
+        if( count > left ) count = left;
+        ws2812_encode(cv, &s->front[s->pos], count, s->t0h, s->t1h);
+        s->pos += count;
+        cv += 8 * count;
+        left -= count;
+    }
+    if( left ) {
+        if( s->pos >= s->end ) s->stopping = 1; // reset time is already playing
+        ws2812_encode(cv, 0, left, 0, 0);
+        s->pos += left;
+    }
+}
+
+
+// Setup timer, channel and dma. Pin and clocks of the timer are up to the caller
+void ws2812_init( struct ws2812 *s, uint32_t timer_clock, uint8_t *front, uint8_t *back, uint32_t bytes ) {
+    uint32_t period = timer_clock / WS2812_HZ;
+    s->t0h = (uint64_t)timer_clock * WS2812_T0H_NS / 1000000000;
+    s->t1h = (uint64_t)timer_clock * WS2812_T1H_NS / 1000000000;
+    s->front = front;
+    s->back = back;
+    s->bytes = bytes;
+    s->busy = 0;
+    s->frames = 0;
+
+    timer_deinit(s->timer);
+    timer_parameter_struct tp = {
+        .prescaler = 0,
+        .alignedmode = TIMER_COUNTER_EDGE,
+        .counterdirection = TIMER_COUNTER_UP,
+        .period = period - 1,
+        .clockdivision = TIMER_CKDIV_DIV1,
+        .repetitioncounter = 0};
+    timer_init(s->timer, &tp);
+
+    timer_oc_parameter_struct cp = {
+        .outputstate  = TIMER_CCX_ENABLE,
+        .outputnstate = TIMER_CCXN_DISABLE,
+        .ocpolarity   = TIMER_OC_POLARITY_HIGH,
+        .ocnpolarity  = TIMER_OCN_POLARITY_HIGH,
+        .ocidlestate  = TIMER_OC_IDLE_STATE_LOW,
+        .ocnidlestate = TIMER_OCN_IDLE_STATE_LOW};
+    timer_channel_output_config(s->timer, s->channel, &cp);
+    timer_channel_output_pulse_value_config(s->timer, s->channel, 0); // low
+    timer_channel_output_mode_config(s->timer, s->channel, TIMER_OC_MODE_PWM0);
+    timer_channel_output_shadow_config(s->timer, s->channel, TIMER_OC_SHADOW_ENABLE);
+    timer_primary_output_config(s->timer, ENABLE);
+    timer_auto_reload_shadow_enable(s->timer);
+
+    rcu_periph_clock_enable(s->dma == DMA0 ? RCU_DMA0 : RCU_DMA1);
+    dma_deinit(s->dma, s->dma_channel);
+    dma_parameter_struct dp = {
+        .periph_addr  = (uint32_t)reg_timer_cv(s->timer, s->channel),
+        .periph_width = DMA_PERIPHERAL_WIDTH_16BIT,
+        .memory_addr  = (uint32_t)s->cv,
+        .memory_width = DMA_MEMORY_WIDTH_16BIT,
+        .number       = 2 * HALF_BITS,
+        .priority     = DMA_PRIORITY_HIGH,
+        .periph_inc   = DMA_PERIPH_INCREASE_DISABLE,
+        .memory_inc   = DMA_MEMORY_INCREASE_ENABLE,
+        .direction    = DMA_MEMORY_TO_PERIPHERAL};
+    dma_init(s->dma, s->dma_channel, &dp);
+    dma_circulation_enable(s->dma, s->dma_channel);
+    dma_memory_to_memory_disable(s->dma, s->dma_channel);
+    dma_interrupt_enable(s->dma, s->dma_channel, DMA_INT_HTF | DMA_INT_FTF);
+
+    timer_enable(s->timer);
+}
+
+
+// Pixel buffer to draw the next frame into
+uint8_t *ws2812_back( struct ws2812 *s ) {
+    return s->back;
+}
+
+
+// Send the back buffer, it becomes the front buffer. Returns 0 if still sending the last frame
+int ws2812_show( struct ws2812 *s ) {
+    if( s->busy ) return 0;
+    uint8_t *front = s->back;
+    s->back = s->front;
+    s->front = front;
+    s->pos = 0;
+    s->end = s->bytes + RESET_BYTES;
+    s->stopping = 0;
+    s->busy = 1;
+
+    refill(s, s->cv);
+    refill(s, &s->cv[HALF_BITS]);
+    reg_store(&DMA_CHCNT(s->dma, s->dma_channel), 2 * HALF_BITS);
+    dma_channel_enable(s->dma, s->dma_channel);
+    timer_dma_enable(s->timer, TIMER_DMA_UPD);
+    return 1;
+}
+
+
+// Dma half/full transfer interrupt: refill the half that played or stop after the reset time
+void ws2812_interrupt( struct ws2812 *s ) {
+    uint16_t *half = 0;
+    if( reg_dma_flag(s->dma, s->dma_channel, DMA_FLAG_HTF) ) {
+        reg_dma_flag_clear(s->dma, s->dma_channel, DMA_FLAG_HTF);
+        half = s->cv;
+    }
+    if( reg_dma_flag(s->dma, s->dma_channel, DMA_FLAG_FTF) ) {
+        reg_dma_flag_clear(s->dma, s->dma_channel, DMA_FLAG_FTF);
+        half = &s->cv[HALF_BITS];
+    }
+    if( !half || !s->busy ) return;
+
+    if( s->stopping ) {
+        timer_dma_disable(s->timer, TIMER_DMA_UPD);
+        reg_dma_disable(s->dma, s->dma_channel);
+        s->frames++;
+        s->busy = 0;
+    }
+    else {
+        refill(s, half);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef WS2812_H
+#define WS2812_H
+
+#include <stdint.h>
+#include <gd32vf103_dma.h>
+
+/*
+WS2812/SK6812 addressable leds on a timer channel pin.
+Each bit is one pwm period of 1.25us, high for WS2812_T0H_NS or WS2812_T1H_NS.
+The update dma of the timer writes one compare value per bit to the channel (shadowed,
+so it applies from the next period). Instead of 16 bit per led bit for the whole strip,
+the dma plays a small circular buffer of 2 * WS2812_HALF_BYTES bytes worth of compare
+values. Its half/full transfer interrupts encode the next bytes into the half that
+just played. After the pixels the line stays low for WS2812_RESET_US, then dma stops.
+Pixels are double buffered: draw into ws2812_back() while the other buffer is sent,
+ws2812_show() swaps them and starts sending.
+Bytes are in wire order: G R B for WS2812, G R B W for SK6812 RGBW.
+*/
+
+#define WS2812_HZ      800000
+#define WS2812_T0H_NS  350    // fits WS2812B (250..550ns) and SK6812 (150..450ns)
+#define WS2812_T1H_NS  700    // fits WS2812B (650..950ns) and SK6812 (450..750ns)
+#define WS2812_RESET_US 280   // latch time of newer WS2812B, older ones and SK6812 need less
+
+// Bytes encoded per dma interrupt: 8 bytes = 64 bits = 80us between interrupts
+#ifndef WS2812_HALF_BYTES
+#define WS2812_HALF_BYTES 8
+#endif
+
+struct ws2812 {
+    uint32_t timer;           // timer peripheral, e.g. TIMER4
+    uint16_t channel;         // TIMER_CH_0..3, its pin must be in alternate function mode
+    uint32_t dma;             // dma serving the update event of the timer
+    dma_channel_enum dma_channel;
+    uint16_t t0h;             // compare values for 0 and 1 bits
+    uint16_t t1h;
+    uint8_t *front;           // pixels being sent
+    uint8_t *back;            // pixels to draw into
+    uint32_t bytes;           // size of each pixel buffer
+    uint32_t pos;             // next byte of front to encode, past bytes: reset time
+    uint32_t end;             // pos where the reset time is encoded
+    volatile uint8_t busy;    // sending front
+    uint8_t stopping;         // the half playing now is the last one
+    uint32_t frames;          // frames sent
+    uint16_t cv[2 * WS2812_HALF_BYTES * 8];
+};
+
+void ws2812_encode( uint16_t *cv, const uint8_t *data, uint32_t count, uint16_t t0h, uint16_t t1h );
+void ws2812_init( struct ws2812 *s, uint32_t timer_clock, uint8_t *front, uint8_t *back, uint32_t bytes );
+uint8_t *ws2812_back( struct ws2812 *s );
+int ws2812_show( struct ws2812 *s );
+void ws2812_interrupt( struct ws2812 *s );
+
+#endif
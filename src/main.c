@@ -1,115 +1,315 @@
 /*
 Example program to setup pwm on a Longan Nano board with a Risc V processor GD32VF103
 to produce a rainbow color cycle with the on board rgb led.
-It uses purely hardware driven alternate function pins and an interrupt driven approach.
+It uses purely hardware driven alternate function pins, an interrupt driven and a dma driven approach.
 Hardware driven approach is faster and uses no CPU cycles but only works on selected pins.
 Interrupt driven approach can be used on any pin but is limited to at least 10 times lower frequencies.
+Dma driven approach can be used on any pin of one gpio bank, needs RAM but almost no CPU cycles.
+Bit angle modulation approach can be used on any pin and needs only a few interrupts per interval for all pins.
 */
 
 #ifdef WITH_SERIAL
 #include <usart.h>
+#include <cmdline.h>
+#include <stream.h>
 #include <stdio.h>
 #endif
 
-#include <systick.h>
+#include <string.h>
+#include <scheduler.h>
+#include <critical.h>
+#include <isrstat.h>
+#include <tlog.h>
+#include <fastreg.h>
+#include <ws2812.h>
+#include <anim.h>
+#include <pwmtune.h>
+#include <probe.h>
+#include <clockplan.h>
 
 #include <gd32vf103_timer.h>
 #include <gd32vf103_gpio.h>
 #include <gd32vf103_rcu.h>
+#include <gd32vf103_dma.h>
 
 
 /*
 Parameter driven pwm setup to make the code easier to reuse
-Look at _cfg_*[] and resize _irq_*[] as needed
+Look at _cfg_*[] and CFG_PINS
 */
 
-struct timers {
+const struct timers {
     uint32_t port;
     uint32_t rcu;
     uint32_t eclic_interrupt;
-    struct irq_channels *channels; // no need to init this
+    uint32_t dma;                  // dma channel serving the update event of the timer
+    dma_channel_enum dma_channel;
+    uint32_t dma_interrupt;
+    uint8_t phase;                 // percent of the interval the counter starts ahead, spreads edges of timers
 } _cfg_timers[] = {
-    { TIMER1, RCU_TIMER1, TIMER1_IRQn }
+    { TIMER0, RCU_TIMER0, TIMER0_UP_IRQn, DMA0, DMA_CH4, DMA0_Channel4_IRQn,  0 }, // channels have their own interrupt: no Interrupt pins
+    { TIMER1, RCU_TIMER1, TIMER1_IRQn, DMA0, DMA_CH1, DMA0_Channel1_IRQn, 10 },
+    { TIMER2, RCU_TIMER2, TIMER2_IRQn, DMA0, DMA_CH2, DMA0_Channel2_IRQn, 20 },
+    { TIMER3, RCU_TIMER3, TIMER3_IRQn, DMA0, DMA_CH6, DMA0_Channel6_IRQn, 30 },
+    { TIMER4, RCU_TIMER4, TIMER4_IRQn, DMA1, DMA_CH1, DMA1_Channel1_IRQn, 40 }
 };
 
-enum Timers { Timer1 };  // Index into _cfg_timers array above
+enum Timers { Timer0, Timer1, Timer2, Timer3, Timer4, AnyTimer };  // Index into _cfg_timers array above, AnyTimer for Auto pins
 
+#define DMA_PWM_TIMER Timer2  // Timer driving pins in Dma mode
+#define BAM_PWM_TIMER Timer3  // Timer driving pins in Bam mode, can't be used by other modes
 
-struct timer_channels {
+// WS2812/SK6812 led strip on a channel of a timer that no pin uses, 0 pixels for no strip
+#ifndef LED_STRIP_PIXELS
+#define LED_STRIP_PIXELS 0
+#endif
+#define LED_STRIP_TIMER   Timer4
+#define LED_STRIP_CHANNEL Channel0 // PA0
+#define LED_STRIP_COLORS  3        // bytes per pixel: 3 for GRB, 4 for GRBW
+
+// Self test with -DWITH_PROBE: channels of a timer no pin uses capture the edges of pins.
+// The channel pin is the pin itself if the pad has both functions, else a wire connects them.
+// Capture dma channels are the ones serving the channel requests of PROBE_TIMER
+#define PROBE_TIMER Timer4
+#define CFG_PROBES(PROBE, x) \
+    PROBE( x, PinA1,  Channel1, DMA1, DMA_CH3 ) /* same pad */ \
+    PROBE( x, PinA2,  Channel2, DMA1, DMA_CH1 ) /* same pad */ \
+    PROBE( x, PinC13, Channel3, DMA1, DMA_CH0 ) /* wire C13 to A3 */
+
+#ifdef WITH_PROBE
+#define PROBE_ON 1
+#else
+#define PROBE_ON 0
+#endif
+
+
+enum Pwm_Phases {
+    Leading,  // on phase starts with the interval (edge aligned) or is centered on its start (center aligned)
+    Trailing  // on phase ends with the interval (edge aligned) or is centered on its middle (center aligned)
+};
+
+const struct timer_channels {
     uint16_t channel;           // channel of the timer to use
     uint32_t interrupt_channel; // only needed if gpio_mode is not alternate function
     uint32_t interrupt_flag;
+    enum Pwm_Phases phase;      // alternate, so not all pins of a timer switch on together
 } _cfg_channels[] = {
-    { TIMER_CH_1, TIMER_INT_CH1, TIMER_INT_FLAG_CH1 },
-    { TIMER_CH_2, TIMER_INT_CH2, TIMER_INT_FLAG_CH2 },
-    { TIMER_CH_3, TIMER_INT_CH3, TIMER_INT_FLAG_CH3 }
+    { TIMER_CH_0, TIMER_INT_CH0, TIMER_INT_FLAG_CH0, Leading },
+    { TIMER_CH_1, TIMER_INT_CH1, TIMER_INT_FLAG_CH1, Trailing },
+    { TIMER_CH_2, TIMER_INT_CH2, TIMER_INT_FLAG_CH2, Leading },
+    { TIMER_CH_3, TIMER_INT_CH3, TIMER_INT_FLAG_CH3, Trailing }
 };
 
-enum Timer_Channels { Channel1, Channel2, Channel3 };  // Index into _cfg_channels array above
+enum Timer_Channels { Channel0, Channel1, Channel2, Channel3, AnyChannel };  // Index into _cfg_channels array above, AnyChannel for Auto pins
 
 
-struct gpio_banks {
+const struct gpio_banks {
     uint32_t port;
     uint32_t rcu;
 } _cfg_gpio_banks[] = {
     { GPIOA, RCU_GPIOA },
+    { GPIOB, RCU_GPIOB },
     { GPIOC, RCU_GPIOC },
 };
 
-enum Gpio_Banks { BankA, BankC };  // Index into _cfg_gpio_banks array above
+enum Gpio_Banks { BankA, BankB, BankC };  // Index into _cfg_gpio_banks array above
 
 
 enum Pwm_Modes { 
-    Timer     = GPIO_MODE_AF_PP, 
-    Interrupt = GPIO_MODE_OUT_PP
+    Timer,     // timer channel drives the pin via alternate function
+    Interrupt, // timer channel interrupts switch the pin
+    Dma,       // DMA_PWM_TIMER ticks make dma write precomputed pin states (channel unused)
+    Bam,       // BAM_PWM_TIMER interrupts switch pins per duty bit (channel unused)
+    Auto       // allocate_pwm() picks a Timer channel wired to the pin, else an Interrupt channel
+};
+
+
+// Timer channels that can drive a pin via alternate function and the remap they need.
+// Covers the pins of the 48 pin GD32VF103CBT6 of the Longan Nano (no TIMER2 full remap).
+// Remaps apply to all channels of a timer, so the allocator picks one remap per timer.
+// Careful: PA15, PB3 and PB4 are jtag pins and PA9, PA10 are used by serial
+#define CFG_TIMER_PINS(TIMER_PIN, x) \
+    TIMER_PIN( x, Timer0, Channel0, BankA, 0,                          GPIO_PIN_8  ) \
+    TIMER_PIN( x, Timer0, Channel1, BankA, 0,                          GPIO_PIN_9  ) \
+    TIMER_PIN( x, Timer0, Channel2, BankA, 0,                          GPIO_PIN_10 ) \
+    TIMER_PIN( x, Timer0, Channel3, BankA, 0,                          GPIO_PIN_11 ) \
+    TIMER_PIN( x, Timer1, Channel0, BankA, 0,                          GPIO_PIN_0  ) \
+    TIMER_PIN( x, Timer1, Channel1, BankA, 0,                          GPIO_PIN_1  ) \
+    TIMER_PIN( x, Timer1, Channel2, BankA, 0,                          GPIO_PIN_2  ) \
+    TIMER_PIN( x, Timer1, Channel3, BankA, 0,                          GPIO_PIN_3  ) \
+    TIMER_PIN( x, Timer1, Channel0, BankA, GPIO_TIMER1_PARTIAL_REMAP0, GPIO_PIN_15 ) \
+    TIMER_PIN( x, Timer1, Channel1, BankB, GPIO_TIMER1_PARTIAL_REMAP0, GPIO_PIN_3  ) \
+    TIMER_PIN( x, Timer1, Channel2, BankA, GPIO_TIMER1_PARTIAL_REMAP0, GPIO_PIN_2  ) \
+    TIMER_PIN( x, Timer1, Channel3, BankA, GPIO_TIMER1_PARTIAL_REMAP0, GPIO_PIN_3  ) \
+    TIMER_PIN( x, Timer1, Channel0, BankA, GPIO_TIMER1_PARTIAL_REMAP1, GPIO_PIN_0  ) \
+    TIMER_PIN( x, Timer1, Channel1, BankA, GPIO_TIMER1_PARTIAL_REMAP1, GPIO_PIN_1  ) \
+    TIMER_PIN( x, Timer1, Channel2, BankB, GPIO_TIMER1_PARTIAL_REMAP1, GPIO_PIN_10 ) \
+    TIMER_PIN( x, Timer1, Channel3, BankB, GPIO_TIMER1_PARTIAL_REMAP1, GPIO_PIN_11 ) \
+    TIMER_PIN( x, Timer1, Channel0, BankA, GPIO_TIMER1_FULL_REMAP,     GPIO_PIN_15 ) \
+    TIMER_PIN( x, Timer1, Channel1, BankB, GPIO_TIMER1_FULL_REMAP,     GPIO_PIN_3  ) \
+    TIMER_PIN( x, Timer1, Channel2, BankB, GPIO_TIMER1_FULL_REMAP,     GPIO_PIN_10 ) \
+    TIMER_PIN( x, Timer1, Channel3, BankB, GPIO_TIMER1_FULL_REMAP,     GPIO_PIN_11 ) \
+    TIMER_PIN( x, Timer2, Channel0, BankA, 0,                          GPIO_PIN_6  ) \
+    TIMER_PIN( x, Timer2, Channel1, BankA, 0,                          GPIO_PIN_7  ) \
+    TIMER_PIN( x, Timer2, Channel2, BankB, 0,                          GPIO_PIN_0  ) \
+    TIMER_PIN( x, Timer2, Channel3, BankB, 0,                          GPIO_PIN_1  ) \
+    TIMER_PIN( x, Timer2, Channel0, BankB, GPIO_TIMER2_PARTIAL_REMAP,  GPIO_PIN_4  ) \
+    TIMER_PIN( x, Timer2, Channel1, BankB, GPIO_TIMER2_PARTIAL_REMAP,  GPIO_PIN_5  ) \
+    TIMER_PIN( x, Timer2, Channel2, BankB, GPIO_TIMER2_PARTIAL_REMAP,  GPIO_PIN_0  ) \
+    TIMER_PIN( x, Timer2, Channel3, BankB, GPIO_TIMER2_PARTIAL_REMAP,  GPIO_PIN_1  ) \
+    TIMER_PIN( x, Timer3, Channel0, BankB, 0,                          GPIO_PIN_6  ) \
+    TIMER_PIN( x, Timer3, Channel1, BankB, 0,                          GPIO_PIN_7  ) \
+    TIMER_PIN( x, Timer3, Channel2, BankB, 0,                          GPIO_PIN_8  ) \
+    TIMER_PIN( x, Timer3, Channel3, BankB, 0,                          GPIO_PIN_9  ) \
+    TIMER_PIN( x, Timer4, Channel0, BankA, 0,                          GPIO_PIN_0  ) \
+    TIMER_PIN( x, Timer4, Channel1, BankA, 0,                          GPIO_PIN_1  ) \
+    TIMER_PIN( x, Timer4, Channel2, BankA, 0,                          GPIO_PIN_2  ) \
+    TIMER_PIN( x, Timer4, Channel3, BankA, 0,                          GPIO_PIN_3  )
+
+#define TIMER_PIN_CONFIG(x, timer, channel, bank, remap, pin) { timer, channel, bank, remap, pin },
+
+const struct timer_pins {
+    enum Timers         timer;
+    enum Timer_Channels channel;
+    enum Gpio_Banks     bank;
+    uint32_t            remap;     // gpio_pin_remap_config() value, 0 for default mapping
+    uint32_t            pin;
+} _cfg_timer_pins[] = {
+    CFG_TIMER_PINS(TIMER_PIN_CONFIG, 0)
 };
 
-struct pins {
-    enum Timers         timer;     // timer to use for that pin
-    enum Timer_Channels channel;   // channel of the timer to use
+// One line per pin: name (index into _cfg_pins), timer, timer channel, gpio bank, mode, gpio pin,
+// gamma and gain (percent) of the brightness curve set_pwm_duty() uses, see _pin_levels
+// Pins are a macro list so configuration errors are found at compile time
+// Auto pins leave timer and channel to allocate_pwm(), other modes use what is given here
+// Gains balance the led colors to a white: a starting point, tune them by eye for your leds
+// Tests of the native env define their own pin list before including this file
+#ifndef CFG_PINS
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinA1,  AnyTimer, AnyChannel, BankA, Auto, GPIO_PIN_1,  CIE, 60  ) /* green led has advanced timer function */ \
+    PIN( x, PinA2,  AnyTimer, AnyChannel, BankA, Auto, GPIO_PIN_2,  CIE, 100 ) /* blue led has advanced timer function */  \
+    PIN( x, PinC13, AnyTimer, AnyChannel, BankC, Auto, GPIO_PIN_13, CIE, 100 ) /* red led has no advanced timer function, */ \
+                                                                                /* or use Timer2, Channel3, BankC, Dma */
+#endif
+
+#define CIE 0.0 // gamma of the CIE 1931 lightness curve, other values are exponents like 2.2
+
+#define PIN_NAME(x, name, timer, channel, bank, mode, pin, gamma, gain) name,
+#define PIN_CONFIG(x, name, timer, channel, bank, mode, pin, gamma, gain) { timer, channel, bank, mode, pin },
+
+const struct pins {
+    enum Timers         timer;     // timer to use for that pin, AnyTimer for Auto
+    enum Timer_Channels channel;   // channel of the timer to use, AnyChannel for Auto
     enum Gpio_Banks     bank;      // gpio bank this pin is part of
     enum Pwm_Modes      mode;
     uint32_t            pin;
 } _cfg_pins[] = {
-    { Timer1, Channel1, BankA, Timer,     GPIO_PIN_1  }, // green led has advanced timer function
-    { Timer1, Channel2, BankA, Timer,     GPIO_PIN_2  }, // blue led has advanced timer function
-    { Timer1, Channel3, BankC, Interrupt, GPIO_PIN_13 }  // red led has no advanced timer function
+    CFG_PINS(PIN_CONFIG, 0)
 };
 
-enum Pins { PinA1, PinA2, PinC13 };  // Index into _cfg_pins array above
+enum Pins { CFG_PINS(PIN_NAME, 0) };  // Index into _cfg_pins array above
 
 
 /*
-Datastructures to make interrupt handling with many pins faster.
-Lists built at startup from _cfg_* configuration.
-If you don't provide enough room in _irq_channels[] or _irq_pins[] then interrupt driven pins wont work!
+Tables to make interrupt handling with many pins fast, filled by allocate_pwm().
+For each timer, gpio bank and timer channel the mask of all interrupt pins,
+so the handler can switch all pins of a bank with one register write.
+Dimensions cover all timers with channels (TIMER0-4), all gpio banks (A-E) and channels.
+Only Auto pins need the table, without them irq_mask() takes IRQ_MASK() from CFG_PINS.
 */
 
-struct irq_pins {
-    uint32_t pin;
-    uint32_t port;
-    uint32_t equalizer;
-    struct irq_pins *next;
-};
+#define IRQ_TIMERS   5
+#define IRQ_BANKS    5
+#define IRQ_CHANNELS 4
 
-struct irq_channels {
-    uint32_t channel;
-    uint32_t interrupt_flag;
-    struct irq_pins *pins;
-    struct irq_channels *next;
-};
+uint16_t _irq_masks[IRQ_TIMERS][IRQ_BANKS][IRQ_CHANNELS];
+uint32_t _irq_timers;    // bit per timer with Interrupt pins
+uint32_t _dither_timers; // bit per timer with dithered Timer pins, see set_pwm_duty16()
+
+// Compare values of timers with Interrupt or dithered pins. Frames are committed to _irq_next
+// and the handler latches them at the update event. From duty and fraction it then
+// writes the registers and _irq_cv once per interval
+uint16_t _irq_cv[IRQ_TIMERS][IRQ_CHANNELS];
+uint16_t _irq_duty[IRQ_TIMERS][IRQ_CHANNELS];
+uint16_t _irq_frac[IRQ_TIMERS][IRQ_CHANNELS];      // 1/65536 ticks on top of _irq_duty
+uint16_t _irq_acc[IRQ_TIMERS][IRQ_CHANNELS];       // dither error accumulator
+uint16_t _irq_next[IRQ_TIMERS][IRQ_CHANNELS];
+uint16_t _irq_next_frac[IRQ_TIMERS][IRQ_CHANNELS];
+volatile uint8_t _irq_pending[IRQ_TIMERS];
+uint32_t _wave_timers; // bit per timer playing a waveform: dma writes the compare values
+
+
+/*
+Pins in Dma mode, also from CFG_PINS at compile time.
+They all must be in one gpio bank and use DMA_PWM_TIMER.
+*/
+
+#define PIN_DMA_MASK(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) == Dma ? (pin) : 0)
+#define PIN_DMA_BANKS(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) == Dma ? 1U << (bank) : 0)
+#define PIN_DMA_TIMERS(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) == Dma ? 1U << (timer) : 0)
+
+#define DMA_MASK   (0 CFG_PINS(PIN_DMA_MASK, 0))
+#define DMA_BANKS  (0 CFG_PINS(PIN_DMA_BANKS, 0))
+#define DMA_TIMERS (0 CFG_PINS(PIN_DMA_TIMERS, 0))
+#define DMA_BANK   (DMA_BANKS == 1 ? 0 : DMA_BANKS == 2 ? 1 : DMA_BANKS == 4 ? 2 : DMA_BANKS == 8 ? 3 : 4)
+
+_Static_assert((DMA_BANKS & (DMA_BANKS - 1)) == 0, "Dma pins must be in one gpio bank");
+_Static_assert(DMA_TIMERS == 0 || DMA_TIMERS == 1U << DMA_PWM_TIMER, "Dma pins must use DMA_PWM_TIMER");
+
+
+/*
+Pins in Bam mode per gpio bank, also from CFG_PINS at compile time.
+BAM_BITS duty bits are needed to cover MAX_DUTY.
+*/
+
+#define PIN_BAM_MASK(b, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) == Bam && (bank) == (b) ? (pin) : 0)
+#define PIN_BAM_TIMERS(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) == Bam ? 1U << (timer) : 0)
+#define PIN_BAM_SHARED(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) != Bam && (timer) == BAM_PWM_TIMER)
 
-struct irq_channels _irq_channels[1]; // provide space for all channels of all timers used for interrupt pins
-struct irq_pins _irq_pins[1];         // provide space for all interrupt pins
+#define BAM_MASK(b)  (0 CFG_PINS(PIN_BAM_MASK, b))
+#define BAM_TIMERS   (0 CFG_PINS(PIN_BAM_TIMERS, 0))
+#define BAM_SHARED   (0 CFG_PINS(PIN_BAM_SHARED, 0))
+#define BAM_BITS     (MAX_DUTY < 256 ? 8 : MAX_DUTY < 512 ? 9 : MAX_DUTY < 1024 ? 10 : MAX_DUTY < 2048 ? 11 : \
+                      MAX_DUTY < 4096 ? 12 : MAX_DUTY < 8192 ? 13 : MAX_DUTY < 16384 ? 14 : MAX_DUTY < 32768 ? 15 : 16)
+#define BAM_MAX      ((1U << BAM_BITS) - 1)
+
+_Static_assert(BAM_TIMERS == 0 || BAM_TIMERS == 1U << BAM_PWM_TIMER, "Bam pins must use BAM_PWM_TIMER");
+_Static_assert(BAM_TIMERS == 0 || !BAM_SHARED, "BAM_PWM_TIMER can't drive pins of other modes");
+
+
+/*
+Pins in Interrupt mode per timer, gpio bank and channel, also from CFG_PINS at compile time.
+Auto pins only get their timer and channel from allocate_pwm(), then the masks are in _irq_masks.
+*/
+
+#define IRQ_TBC(t, b, c) ((t) << 8 | (b) << 4 | (c))
+#define PIN_IRQ_MASK(tbc, name, timer, channel, bank, mode, pin, gamma, gain) \
+    | ((mode) == Interrupt && IRQ_TBC(timer, bank, channel) == (tbc) ? (pin) : 0)
+#define PIN_AUTO(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) == Auto)
+
+#define IRQ_MASK(t, b, c) (0 CFG_PINS(PIN_IRQ_MASK, IRQ_TBC(t, b, c)))
+#define AUTO_PINS         (0 CFG_PINS(PIN_AUTO, 0))
 
 
 // PWM timimg stuff
-const uint16_t PRESCALE = 200;  // Min 200 for interrupt pins -> ~500kHz ticks.
-const uint16_t MAX_DUTY = 1000; // 100kHz ticks/MAX_DUTY: 100Hz pwm interval
+#ifndef PRESCALE
+#define PRESCALE  200  // Min 200 for interrupt pins -> ~500kHz ticks. Command tune finds the limit at runtime
+#endif
+#ifndef MAX_DUTY
+#define MAX_DUTY 1000  // 100kHz ticks/MAX_DUTY: 100Hz pwm interval, also size of Dma mode tables
+#endif
+
+// Counter mode of timers with Timer or Interrupt pins, same interval and duty resolution in both:
+// TIMER_COUNTER_EDGE: counters run up, edges of Leading and Trailing pins meet at the update event
+// TIMER_COUNTER_CENTER_BOTH: counters run up and down at twice the rate, on phases are centered,
+// so edges spread with the duties and none is at the update events. Needs an even prescale
+#ifndef PWM_ALIGN
+#define PWM_ALIGN TIMER_COUNTER_EDGE
+#endif
 
 
 // Application timing stuff
-const uint32_t DUTY_US = 5000; // 5ms same duty: duty*MAX_DUTY = 5s per fade
+const uint32_t DUTY_US = 5000; // 5ms same duty: duty*MAX_DUTY = 5s per fade (default)
 
 // Pins the application uses for the led colors
 enum Color {
@@ -129,6 +329,129 @@ No timer, led or other pwm configuration should be necessary below
 #define ARRAY_SIZE(a) (sizeof(a)/sizeof(*(a)))
 #endif
 
+_Static_assert(ARRAY_SIZE(_cfg_timers) <= IRQ_TIMERS, "too many timers for _irq_masks");
+_Static_assert(ARRAY_SIZE(_cfg_gpio_banks) <= IRQ_BANKS, "too many gpio banks for _irq_masks");
+_Static_assert(ARRAY_SIZE(_cfg_channels) <= IRQ_CHANNELS, "too many channels for _irq_masks");
+
+
+/*
+Compile time checks of CFG_PINS. Auto pins are placed by allocate_pwm() at init,
+these reject configurations that can't work whatever it decides.
+A configuration that passes them leaves no Auto pin without a channel (_pwm_unplaced).
+*/
+
+// Each pin is listed once: sum and or of its bank's pin bits are equal
+#define PIN_BANK_SUM(b, name, timer, channel, bank, mode, pin, gamma, gain) + ((bank) == (b) ? (pin) : 0)
+#define PIN_BANK_OR(b, name, timer, channel, bank, mode, pin, gamma, gain)  | ((bank) == (b) ? (pin) : 0)
+#define PINS_UNIQUE(b) ((0 CFG_PINS(PIN_BANK_SUM, b)) == (0 CFG_PINS(PIN_BANK_OR, b)))
+
+_Static_assert(PINS_UNIQUE(BankA) && PINS_UNIQUE(BankB) && PINS_UNIQUE(BankC), "pin listed more than once");
+
+// Each timer channel is given to one Timer or Interrupt pin
+#define PIN_CHANNEL_BIT(timer, channel, mode) (((mode) == Timer || (mode) == Interrupt) ? 1ULL << ((timer) * IRQ_CHANNELS + (channel)) : 0)
+#define PIN_CHANNEL_SUM(x, name, timer, channel, bank, mode, pin, gamma, gain) + PIN_CHANNEL_BIT(timer, channel, mode)
+#define PIN_CHANNEL_OR(x, name, timer, channel, bank, mode, pin, gamma, gain)  | PIN_CHANNEL_BIT(timer, channel, mode)
+
+_Static_assert((0 CFG_PINS(PIN_CHANNEL_SUM, 0)) == (0 CFG_PINS(PIN_CHANNEL_OR, 0)), "timer channel used by more than one pin");
+
+// Timer pins are wired to their timer channel (with some remap)
+#define PIN_KEY(timer, channel, bank, pin) (((timer) << 24) | ((channel) << 20) | ((bank) << 16) | (pin))
+#define TIMER_PIN_MATCH(key, timer, channel, bank, remap, pin) || PIN_KEY(timer, channel, bank, pin) == (key)
+#define PIN_WIRED(x, name, timer, channel, bank, mode, pin, gamma, gain) \
+    && ((mode) != Timer || (0 CFG_TIMER_PINS(TIMER_PIN_MATCH, PIN_KEY(timer, channel, bank, pin))))
+
+_Static_assert(1 CFG_PINS(PIN_WIRED, 0), "Timer pin is not wired to its timer channel");
+
+// TIMER0 update and channel events have separate interrupts, the pwm handler needs both
+#define PIN_TIMER0_IRQ(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((mode) == Interrupt && (timer) == Timer0)
+
+_Static_assert(!(0 CFG_PINS(PIN_TIMER0_IRQ, 0)), "Timer0 can't drive Interrupt pins");
+
+// Enough channels for all pins that need one. TIMER0 channels only serve their own pins,
+// Auto pins wired to TIMER0 get one of them unless TIMER0 is reserved.
+// Timers driving Dma or Bam pins, the led strip or the probe have no channels to offer
+#define RESERVED_TIMERS ((DMA_TIMERS ? 1U << DMA_PWM_TIMER : 0) | (BAM_TIMERS ? 1U << BAM_PWM_TIMER : 0) \
+    | (LED_STRIP_PIXELS ? 1U << LED_STRIP_TIMER : 0) | (PROBE_ON ? 1U << PROBE_TIMER : 0))
+#define TIMER_PIN_MASK(key, timer, channel, bank, remap, pin) | ((((timer) << 8) | (bank)) == (key) ? (pin) : 0)
+#define TIMER_PINS(timer, bank) (0 CFG_TIMER_PINS(TIMER_PIN_MASK, ((timer) << 8) | (bank)))
+#define TIMER0_FREE (!(RESERVED_TIMERS & (1U << Timer0)))
+#define PIN_CHANNELS(x, name, timer, channel, bank, mode, pin, gamma, gain) + ((mode) == Timer || (mode) == Interrupt || (mode) == Auto)
+#define PIN_NOT_TIMER0(timer0_free, name, timer, channel, bank, mode, pin, gamma, gain) \
+    + ((mode) == Interrupt || ((mode) == Timer && (timer) != Timer0) \
+       || ((mode) == Auto && !((timer0_free) && ((pin) & TIMER_PINS(Timer0, bank)))))
+#define PWM_CHANNELS (ARRAY_SIZE(_cfg_channels) * (ARRAY_SIZE(_cfg_timers) - __builtin_popcount(RESERVED_TIMERS)))
+#define IRQ_PWM_CHANNELS (ARRAY_SIZE(_cfg_channels) * (ARRAY_SIZE(_cfg_timers) - 1 - __builtin_popcount(RESERVED_TIMERS & ~(1U << Timer0))))
+
+_Static_assert((0 CFG_PINS(PIN_CHANNELS, 0)) <= PWM_CHANNELS, "more Timer, Interrupt and Auto pins than timer channels");
+_Static_assert((0 CFG_PINS(PIN_NOT_TIMER0, TIMER0_FREE)) <= IRQ_PWM_CHANNELS, "more pins than channels without TIMER0");
+
+_Static_assert(PWM_ALIGN == TIMER_COUNTER_EDGE || PRESCALE % 2 == 0, "center aligned counters need an even PRESCALE");
+_Static_assert(!BAM_TIMERS || PRESCALE % 2 == 0, "Bam pins need an even PRESCALE");
+
+// The led strip has its timer for itself
+#define PIN_STRIP_TIMER(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((timer) == LED_STRIP_TIMER)
+
+_Static_assert(!LED_STRIP_PIXELS || !(0 CFG_PINS(PIN_STRIP_TIMER, 0)), "LED_STRIP_TIMER can't drive pins");
+_Static_assert(!LED_STRIP_PIXELS || ((LED_STRIP_TIMER != DMA_PWM_TIMER || !DMA_TIMERS)
+    && (LED_STRIP_TIMER != BAM_PWM_TIMER || !BAM_TIMERS)), "LED_STRIP_TIMER is busy with Dma or Bam pins");
+
+// The probe timer only captures
+#define PIN_PROBE_TIMER(x, name, timer, channel, bank, mode, pin, gamma, gain) | ((timer) == PROBE_TIMER)
+
+_Static_assert(!PROBE_ON || !(0 CFG_PINS(PIN_PROBE_TIMER, 0)), "PROBE_TIMER can't drive pins");
+_Static_assert(!PROBE_ON || !LED_STRIP_PIXELS || PROBE_TIMER != LED_STRIP_TIMER, "PROBE_TIMER drives the led strip");
+_Static_assert(!PROBE_ON || ((PROBE_TIMER != DMA_PWM_TIMER || !DMA_TIMERS)
+    && (PROBE_TIMER != BAM_PWM_TIMER || !BAM_TIMERS)), "PROBE_TIMER is busy with Dma or Bam pins");
+
+
+/*
+Brightness curves: level (16 bit, see set_pwm_duty16()) for each perceived brightness 0..MAX_DUTY of a pin.
+The compiler computes the tables from gamma and gain in CFG_PINS, so they follow MAX_DUTY
+and there is no floating point at runtime. Levels are a power of the brightness or for CIE
+the CIE 1931 lightness L* = 100 * brightness converted to luminance Y = ((L* + 16) / 116)^3
+(L* / 903.3 below L* 8), times gain. Rows have a power of 2 size >= MAX_DUTY + 1, levels
+above MAX_DUTY stay at full brightness. The dark end needs the sub tick levels of dithering.
+*/
+
+#define LEVEL_X(i)     ((i) >= MAX_DUTY ? 1.0 : (double)(i) / MAX_DUTY)
+#define LEVEL_CIE(l)   ((l) <= 8.0 ? (l) / 903.3 : __builtin_pow(((l) + 16.0) / 116.0, 3.0))
+#define LEVEL_Y(x, gamma) ((gamma) > 0.0 ? __builtin_pow((x), (gamma)) : LEVEL_CIE(100.0 * (x)))
+#define LEVEL(gamma, gain, i) (uint16_t)(65535.0 * (gain) / 100.0 * LEVEL_Y(LEVEL_X(i), (gamma)) + 0.5),
+
+#define LEVEL_REP4(M, g, k, i)    M(g, k, (i)) M(g, k, (i) + 1) M(g, k, (i) + 2) M(g, k, (i) + 3)
+#define LEVEL_REP16(M, g, k, i)   LEVEL_REP4(M, g, k, i) LEVEL_REP4(M, g, k, (i) + 4) \
+                                  LEVEL_REP4(M, g, k, (i) + 8) LEVEL_REP4(M, g, k, (i) + 12)
+#define LEVEL_REP64(M, g, k, i)   LEVEL_REP16(M, g, k, i) LEVEL_REP16(M, g, k, (i) + 16) \
+                                  LEVEL_REP16(M, g, k, (i) + 32) LEVEL_REP16(M, g, k, (i) + 48)
+#define LEVEL_REP256(M, g, k, i)  LEVEL_REP64(M, g, k, i) LEVEL_REP64(M, g, k, (i) + 64) \
+                                  LEVEL_REP64(M, g, k, (i) + 128) LEVEL_REP64(M, g, k, (i) + 192)
+#define LEVEL_REP1024(M, g, k, i) LEVEL_REP256(M, g, k, i) LEVEL_REP256(M, g, k, (i) + 256) \
+                                  LEVEL_REP256(M, g, k, (i) + 512) LEVEL_REP256(M, g, k, (i) + 768)
+#define LEVEL_REP4096(M, g, k, i) LEVEL_REP1024(M, g, k, i) LEVEL_REP1024(M, g, k, (i) + 1024) \
+                                  LEVEL_REP1024(M, g, k, (i) + 2048) LEVEL_REP1024(M, g, k, (i) + 3072)
+
+#if MAX_DUTY < 256
+#define LEVEL_STEPS 256
+#define LEVEL_ROW(g, k) LEVEL_REP256(LEVEL, g, k, 0)
+#elif MAX_DUTY < 1024
+#define LEVEL_STEPS 1024
+#define LEVEL_ROW(g, k) LEVEL_REP1024(LEVEL, g, k, 0)
+#elif MAX_DUTY < 4096
+#define LEVEL_STEPS 4096
+#define LEVEL_ROW(g, k) LEVEL_REP4096(LEVEL, g, k, 0)
+#else
+#error "no brightness tables for MAX_DUTY >= 4096"
+#endif
+
+#define PIN_LEVELS(x, name, timer, channel, bank, mode, pin, gamma, gain) { LEVEL_ROW(gamma, gain) },
+#define PIN_GAIN_OK(x, name, timer, channel, bank, mode, pin, gamma, gain) && (gain) > 0 && (gain) <= 100 && (gamma) >= 0
+
+_Static_assert(1 CFG_PINS(PIN_GAIN_OK, 0), "gain must be 1..100 percent and gamma CIE or positive");
+
+const uint16_t _pin_levels[ARRAY_SIZE(_cfg_pins)][LEVEL_STEPS] = {
+    CFG_PINS(PIN_LEVELS, 0)
+};
+
 
 #ifdef WITH_SERIAL
 
@@ -137,10 +460,27 @@ Init serial and reroute c standard output there.
 Convenience stuff, not related to pwm at all.
 */
 
+#ifndef SERIAL_BAUD
+#define SERIAL_BAUD 115200 // up to usart_max_baud(), can be changed via serial
+#endif
+
+// With WITH_TLOG debug output is tokenized (lib/tlog): no formatting and no printf() on
+// the device, tools/tlog_decode.py formats it on the host. Otherwise it is printf().
+#ifdef WITH_TLOG
+#define DEBUG_OUT(...) TLOG(__VA_ARGS__)
+#else
+#define DEBUG_OUT(...) printf(__VA_ARGS__)
+#endif
+
 // Init serial output and announce ourselves there
+// Output is queued and sent via dma, so printf() does not wait for the wire
+// Input is received via circular dma, see poll_serial()
 void init_usart0() {
-    usart_init(USART0, 115200);
-    printf("Rainbow V4 10/2020\n\r");
+    usart_init(USART0, SERIAL_BAUD);
+    usart_tx_dma_init(USART0, USART_TX_BLOCK); // block only if buffer is full, e.g. init chatter
+    usart_rx_dma_init(USART0);
+    eclic_global_interrupt_enable(); // for dma and receive interrupts
+    DEBUG_OUT("Rainbow V4 10/2020\n\r");
 }
 
 // Reroute c standard output to serial
@@ -148,12 +488,17 @@ int _put_char( int ch ) {
     return usart_put_char(USART0, ch);
 }
 
-#define DEBUG_OUT(...) printf(__VA_ARGS__)
-
 #else
 #define DEBUG_OUT(...)
 #endif
 
+// Only tokenized output is fast enough for interrupt handlers
+#if defined(WITH_SERIAL) && defined(WITH_TLOG)
+#define ISR_OUT(...) TLOG(__VA_ARGS__)
+#else
+#define ISR_OUT(...)
+#endif
+
 
 /* 
 Setup hardware supported pwm using a timer.
@@ -163,66 +508,338 @@ Interrupt based pwm maxes out at least 10 times earlier and uses cpu cycles.
 So try to avoid, e.g. connect the red led pin PC13 to adjacent pin PA0 would be an option.
 */
 
+/*
+Interrupt levels: timer handlers switching pins preempt everything else, so serial,
+scheduler and dma refills (level 1 and 2) don't delay edges.
+With WITH_RAM_ISR the timer handlers run from sram without flash wait states and
+the eclic jumps straight into them (vectored), they save only the registers they use.
+Their data (_irq_*) is in sram anyway, the const _cfg_* tables fold into the code.
+*/
+
+#define PWM_IRQ_LEVEL     3 // timer interrupts of Interrupt, Bam and dithered pins
+#define PWM_DMA_IRQ_LEVEL 2 // refills of Dma pin tables and waves
+
+#ifdef WITH_RAM_ISR
+#ifndef RAM_ISR // the native env has its own (see test/mock)
+#define RAM_ISR __attribute__((interrupt, section(".data.ramfunc")))
+#endif
+#define PWM_ISR RAM_ISR
+#else
+#define PWM_ISR
+#endif
+
+void enable_pwm_irq( uint32_t irq ) {
+    eclic_irq_enable(irq, PWM_IRQ_LEVEL, 1);
+    #ifdef WITH_RAM_ISR
+    eclic_set_vmode(irq);
+    #endif
+}
+
+uint16_t _pwm_ticks;    // ticks per pwm interval
+uint16_t _pwm_prescale; // timer clocks per tick
+
+// Compare value for a duty and back: Trailing channels use pwm mode 1, on from the compare value on
+// Full duty is beyond the auto reload value, since center aligned counters reach it
+static inline uint16_t pwm_cv( enum Timer_Channels channel, uint16_t duty ) {
+    if( duty >= _pwm_ticks ) return (_cfg_channels[channel].phase == Leading) ? UINT16_MAX : 0;
+    return (_cfg_channels[channel].phase == Leading) ? duty : _pwm_ticks - duty;
+}
+
 // Make a timer channel use pwm pattern defined by given structure
-void init_pwm_channel( uint32_t timer, uint16_t channel, timer_oc_parameter_struct *ocp ) {
-    timer_channel_output_config(timer, channel, ocp);
-    timer_channel_output_pulse_value_config(timer, channel, 0); // duty off
-    timer_channel_output_mode_config(timer, channel, TIMER_OC_MODE_PWM0);
-    timer_channel_output_shadow_config(timer, channel, TIMER_OC_SHADOW_DISABLE);
+// With shadow enabled new duties wait for the update event, see pwm_frame_commit()
+void init_pwm_channel( uint32_t timer, enum Timer_Channels channel, timer_oc_parameter_struct *ocp, uint16_t shadow ) {
+    uint16_t ch = _cfg_channels[channel].channel;
+    timer_channel_output_config(timer, ch, ocp);
+    timer_channel_output_pulse_value_config(timer, ch, pwm_cv(channel, 0)); // duty off
+    timer_channel_output_mode_config(timer, ch, (_cfg_channels[channel].phase == Leading) ? TIMER_OC_MODE_PWM0 : TIMER_OC_MODE_PWM1);
+    timer_channel_output_shadow_config(timer, ch, shadow);
+}
+
+
+/*
+Dma driven pwm for any pins of one gpio bank.
+DMA_PWM_TIMER updates once per pwm tick and each update makes the dma write
+the next slot of a table to GPIO_BOP of the bank. A slot holds the state of all
+Dma pins for that tick, so the pins follow the pwm pattern without the cpu.
+The table holds two pwm intervals. Duty changes are applied to the half that
+just finished playing (half/full transfer interrupt, once per interval),
+so an interval never plays a partly updated table.
+*/
+
+uint32_t _dma_slots[2 * MAX_DUTY];                 // GPIO_BOP values for two pwm intervals
+uint16_t _dma_ticks;                               // slots used per interval
+volatile uint16_t _dma_duty[ARRAY_SIZE(_cfg_pins)]; // requested duty of Dma pins
+uint16_t _dma_half_duty[2][ARRAY_SIZE(_cfg_pins)];  // duty each half of _dma_slots currently has
+
+
+// Make dma write the table to the gpio bank on each update of the timer
+void init_pwm_dma( enum Timers timer, uint16_t ticks ) {
+    if( ticks > MAX_DUTY ) {
+        DEBUG_OUT("ERROR: dma pwm limited to MAX_DUTY ticks!\n\r");
+        ticks = MAX_DUTY;
+    }
+    _dma_ticks = ticks;
+    for( int s = 0; s < 2 * ticks; s++ ) {
+        _dma_slots[s] = DMA_MASK; // inverted leds off
+    }
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        _dma_duty[p] = _dma_half_duty[0][p] = _dma_half_duty[1][p] = 0;
+    }
+
+    const struct timers *t = &_cfg_timers[timer];
+    rcu_periph_clock_enable(t->dma == DMA0 ? RCU_DMA0 : RCU_DMA1);
+    dma_deinit(t->dma, t->dma_channel);
+
+    dma_parameter_struct dp = {
+        .periph_addr  = (uint32_t)&GPIO_BOP(_cfg_gpio_banks[DMA_BANK].port),
+        .periph_width = DMA_PERIPHERAL_WIDTH_32BIT,
+        .memory_addr  = (uint32_t)_dma_slots,
+        .memory_width = DMA_MEMORY_WIDTH_32BIT,
+        .number       = 2 * ticks,
+        .priority     = DMA_PRIORITY_HIGH,
+        .periph_inc   = DMA_PERIPH_INCREASE_DISABLE,
+        .memory_inc   = DMA_MEMORY_INCREASE_ENABLE,
+        .direction    = DMA_MEMORY_TO_PERIPHERAL};
+    dma_init(t->dma, t->dma_channel, &dp);
+    dma_circulation_enable(t->dma, t->dma_channel);
+    dma_memory_to_memory_disable(t->dma, t->dma_channel);
+    dma_interrupt_enable(t->dma, t->dma_channel, DMA_INT_HTF | DMA_INT_FTF);
+    eclic_irq_enable(t->dma_interrupt, PWM_DMA_IRQ_LEVEL, 1);
+    dma_channel_enable(t->dma, t->dma_channel);
+
+    timer_dma_enable(t->port, TIMER_DMA_UPD);
 }
 
 
-struct irq_channels *find_or_add_channel( struct irq_channels **head, struct irq_channels **pool, enum Timer_Channels c ) {
-    struct irq_channels *curr = *head;
-    while( curr ) {
-        if( curr->channel == c ) return curr; // ok, channel already available (driving multiple gpios)
-        curr = curr->next;
+/*
+Bit angle modulation for any pins, a few interrupts per interval no matter how many pins.
+An interval has BAM_BITS slots, slot k lasts 2^k ticks and a pin is on during
+slot k if bit k of its duty is set. The update interrupt of BAM_PWM_TIMER
+writes the precomputed pin states of the next slot to all banks at once and
+reprograms the auto reload (shadowed) for the slot after that.
+Timer units are half ticks, since an auto reload value of 0 would stop the counter.
+set_pwm_duty() changes _bam_next, which is taken over before an interval starts.
+*/
+
+uint32_t _bam_now[BAM_BITS][IRQ_BANKS];   // GPIO_BOP values per slot and bank in use
+uint32_t _bam_next[BAM_BITS][IRQ_BANKS];  // same with latest duty changes
+volatile int _bam_dirty;                  // _bam_next differs from _bam_now
+volatile uint32_t _bam_slot;              // slot that starts with the next update
+
+
+// Init slot tables to off and start the timer interrupt
+void init_pwm_bam( enum Timers timer ) {
+    for( int k = 0; k < BAM_BITS; k++ ) {
+        for( int b = 0; b < ARRAY_SIZE(_cfg_gpio_banks); b++ ) {
+            _bam_now[k][b] = _bam_next[k][b] = BAM_MASK(b); // inverted leds off
+        }
+    }
+    _bam_dirty = 0;
+
+    // timer is in slot 0 (auto reload 1) after init, preload slot 1
+    _bam_slot = 1;
+    timer_auto_reload_shadow_enable(_cfg_timers[timer].port);
+    timer_autoreload_value_config(_cfg_timers[timer].port, (2U << 1) - 1);
+    timer_interrupt_flag_clear(_cfg_timers[timer].port, TIMER_INT_FLAG_UP);
+    timer_interrupt_enable(_cfg_timers[timer].port, TIMER_INT_UP);
+    enable_pwm_irq(_cfg_timers[timer].eclic_interrupt);
+}
+
+
+// Ids of instrumented handlers for isrstat: timer interrupts, then dma interrupts of the timers
+#define ISR_TIMER(t) (t)
+#define ISR_DMA(t)   (ARRAY_SIZE(_cfg_timers) + (t))
+_Static_assert(ISR_DMA(ARRAY_SIZE(_cfg_timers)) <= ISRSTAT_COUNT, "more handlers than ISRSTAT_COUNT");
+
+uint32_t _cycles_per_tick[ARRAY_SIZE(_cfg_timers)]; // core clock cycles per counter tick, for latencies
+uint32_t _pwm_interval_us;                          // duration of a pwm interval
+uint32_t _pwm_update_us;                            // time between update events, half the interval if center aligned
+
+// Clock of TIMER1..6: CK_APB1, doubled if APB1 is divided from AHB
+uint32_t pwm_timer_clock() {
+    uint32_t apb1 = rcu_clock_freq_get(CK_APB1);
+    return (apb1 == rcu_clock_freq_get(CK_AHB)) ? apb1 : 2 * apb1;
+}
+
+
+/*
+Pwm allocation: which timer channel and mode each pin of CFG_PINS ends up with.
+Pins with a fixed mode keep what is configured. Auto pins get a timer channel wired
+to them if one is left. All remap combinations of the timers are tried to find the one
+with the most hardware driven pins. Remaining Auto pins become Interrupt pins
+on free channels, preferring timers that already have Interrupt pins.
+*/
+
+#define MAX_REMAPS 4 // remap options per timer, including none
+
+struct pwm_pins {
+    enum Timers         timer;
+    enum Timer_Channels channel;
+    enum Pwm_Modes      mode;    // Auto if no channel was left for the pin
+} _pwm_pins[ARRAY_SIZE(_cfg_pins)];
+
+uint32_t _pwm_remaps[ARRAY_SIZE(_cfg_timers)]; // gpio_pin_remap_config() value per timer, 0 for none
+uint32_t _pwm_unplaced;                        // Auto pins without channel
+
+// Timers driving Dma or Bam pins, the led strip or the probe have no channels to offer
+int timer_reserved( enum Timers timer ) {
+    return (RESERVED_TIMERS >> timer) & 1;
+}
+
+// Collect the distinct remaps of a timer, none first. Returns how many
+int timer_remaps( enum Timers timer, uint32_t remaps[MAX_REMAPS] ) {
+    int count = 0;
+    remaps[count++] = 0;
+    for( int h = 0; h < ARRAY_SIZE(_cfg_timer_pins); h++ ) {
+        if( _cfg_timer_pins[h].timer != timer ) continue;
+        int known = 0;
+        for( int r = 0; r < count; r++ ) {
+            if( remaps[r] == _cfg_timer_pins[h].remap ) known = 1;
+        }
+        if( !known && count < MAX_REMAPS ) remaps[count++] = _cfg_timer_pins[h].remap;
     }
+    return count;
+}
 
-    // Allocate new channel element from pool 
-    if( *pool == 0 ) return 0; // no more elements. Increase pool.
-    curr = (*pool)++;
+// Place pins on timer channels wired to them with the given remaps
+// Returns number of Auto pins placed or -1 if a Timer pin is not wired with these remaps
+int allocate_timer_pins( const uint32_t *remaps, struct pwm_pins *pins ) {
+    uint32_t used[ARRAY_SIZE(_cfg_timers)] = { 0 }; // channel bits
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        pins[p].timer = _cfg_pins[p].timer;
+        pins[p].channel = _cfg_pins[p].channel;
+        pins[p].mode = _cfg_pins[p].mode;
+        if( pins[p].mode == Timer || pins[p].mode == Interrupt ) used[pins[p].timer] |= 1U << pins[p].channel;
+    }
 
-    // Init new element with data
-    curr->channel = _cfg_channels[c].channel;
-    curr->interrupt_flag = _cfg_channels[c].interrupt_flag;
-    curr->pins = 0;
+    int placed = 0;
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        if( pins[p].mode != Timer && pins[p].mode != Auto ) continue;
+        int wired = 0;
+        for( int h = 0; h < ARRAY_SIZE(_cfg_timer_pins) && !wired; h++ ) {
+            const struct timer_pins *hw = &_cfg_timer_pins[h];
+            if( hw->bank != _cfg_pins[p].bank || hw->pin != _cfg_pins[p].pin || hw->remap != remaps[hw->timer] ) continue;
+            if( pins[p].mode == Timer ) {
+                wired = hw->timer == pins[p].timer && hw->channel == pins[p].channel;
+            }
+            else if( !timer_reserved(hw->timer) && !(used[hw->timer] & (1U << hw->channel)) ) {
+                used[hw->timer] |= 1U << hw->channel;
+                pins[p].timer = hw->timer;
+                pins[p].channel = hw->channel;
+                pins[p].mode = Timer;
+                placed++;
+            }
+        }
+        if( _cfg_pins[p].mode == Timer && !wired ) return -1;
+    }
+    return placed;
+}
 
-    // link new element into list at head
-    curr->next = *head;
-    *head = curr;
+// Put Auto pins that have no wired channel on free channels of interrupt capable timers
+void allocate_interrupt_pins() {
+    _pwm_unplaced = 0;
+    uint32_t used[ARRAY_SIZE(_cfg_timers)] = { 0 }; // channel bits
+    int irq[ARRAY_SIZE(_cfg_timers)] = { 0 };       // timer has Interrupt pins
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode == Timer || _pwm_pins[p].mode == Interrupt ) used[_pwm_pins[p].timer] |= 1U << _pwm_pins[p].channel;
+        if( _pwm_pins[p].mode == Interrupt ) irq[_pwm_pins[p].timer] = 1;
+    }
 
-    return curr;
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        for( int pass = 0; pass < 2 && _pwm_pins[p].mode == Auto; pass++ ) {
+            for( int t = 0; t < ARRAY_SIZE(_cfg_timers) && _pwm_pins[p].mode == Auto; t++ ) {
+                if( t == Timer0 || timer_reserved(t) || (pass == 0 && !irq[t]) ) continue;
+                for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) {
+                    if( used[t] & (1U << c) ) continue;
+                    used[t] |= 1U << c;
+                    irq[t] = 1;
+                    _pwm_pins[p].timer = t;
+                    _pwm_pins[p].channel = c;
+                    _pwm_pins[p].mode = Interrupt;
+                    break;
+                }
+            }
+        }
+        if( _pwm_pins[p].mode == Auto ) _pwm_unplaced++;
+    }
 }
 
+// Decide timer, channel and mode of all pins and build the interrupt pin masks
+void allocate_pwm() {
+    uint32_t options[ARRAY_SIZE(_cfg_timers)][MAX_REMAPS];
+    uint32_t counts[ARRAY_SIZE(_cfg_timers)];
+    uint32_t combinations = 1;
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        counts[t] = timer_remaps(t, options[t]);
+        combinations *= counts[t];
+    }
+
+    // First combination is no remaps at all, later ones only win with more Timer pins
+    int best = -1;
+    for( uint32_t combination = 0; combination < combinations; combination++ ) {
+        uint32_t remaps[ARRAY_SIZE(_cfg_timers)];
+        uint32_t rest = combination;
+        for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+            remaps[t] = options[t][rest % counts[t]];
+            rest /= counts[t];
+        }
+        struct pwm_pins pins[ARRAY_SIZE(_cfg_pins)];
+        int placed = allocate_timer_pins(remaps, pins);
+        if( placed > best ) {
+            best = placed;
+            for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) _pwm_pins[p] = pins[p];
+            for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) _pwm_remaps[t] = remaps[t];
+        }
+    }
 
-struct irq_pins *find_or_add_pin( struct irq_pins **head, struct irq_pins **pool, enum Pins p ) {
-    struct irq_pins *curr = *head;
-    while( curr ) {
-        if( curr->pin == p ) return curr;
-        curr = curr->next;
+    if( best < 0 ) { // Timer pins need conflicting remaps: drive none of them
+        for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+            _pwm_pins[p].timer = _cfg_pins[p].timer;
+            _pwm_pins[p].channel = _cfg_pins[p].channel;
+            _pwm_pins[p].mode = (_cfg_pins[p].mode == Timer) ? Auto : _cfg_pins[p].mode;
+        }
     }
 
-    if( *pool == 0 ) return 0;
-    curr = (*pool)++;
+    allocate_interrupt_pins();
+
+    memset(_irq_masks, 0, sizeof(_irq_masks));
+    _irq_timers = 0;
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode == Interrupt ) {
+            _irq_masks[_pwm_pins[p].timer][_cfg_pins[p].bank][_pwm_pins[p].channel] |= _cfg_pins[p].pin;
+            _irq_timers |= 1U << _pwm_pins[p].timer;
+        }
+    }
+}
 
-    curr->pin = _cfg_pins[p].pin;
-    curr->port = _cfg_gpio_banks[_cfg_pins[p].bank].port;
-    curr->equalizer = 0;
 
-    curr->next = *head;
-    *head = curr;
+// Is the timer used by any pin?
+int timer_used( enum Timers timer ) {
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode != Auto && _pwm_pins[p].timer == timer ) return 1;
+    }
+    return 0;
+}
 
-    return curr;
+// Does the timer drive pins via alternate function?
+int timer_wired( enum Timers timer ) {
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode == Timer && _pwm_pins[p].timer == timer ) return 1;
+    }
+    return 0;
 }
 
 
 // Reset eclic config and provide clock/reset used gpio banks
 // Do this before other components want to use gpio or interrupts
 void preinit_pwm() {
-    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
-        if( _cfg_pins[p].mode == Interrupt ) {
-            eclic_init(_cfg_timers[_cfg_pins[p].timer].eclic_interrupt);
+    allocate_pwm();
+
+    eclic_priority_group_set(ECLIC_PRIGROUP_LEVEL3_PRIO1); // 8 levels, so PWM_IRQ_LEVEL preempts
+
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode != Timer && _pwm_pins[p].mode != Auto ) {
+            eclic_init(_cfg_timers[_pwm_pins[p].timer].eclic_interrupt);
         }
     }
 
@@ -237,40 +854,29 @@ void preinit_pwm() {
 // use channels to define the pwm pattern, 
 // and make gpio pin state follow that pattern
 void init_pwm( uint16_t prescale, uint16_t ticks ) {
-    // prepare structure for fast interrupt handling
-    struct irq_channels *c_pool = _irq_channels;
-    struct irq_pins *p_pool = _irq_pins;
-    // clear channel lists
-    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
-        _cfg_timers[t].channels = 0;
+    if( _pwm_unplaced ) { // the compile time checks should have caught that
+        DEBUG_OUT("%lu pins without timer channel, pwm not started\n\r", _pwm_unplaced);
+        return;
     }
-    // create channel lists with pins using interrupts instead of alternate timer function
-    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
-        if( _cfg_pins[p].mode == Interrupt ) {
-            struct irq_channels *pc = find_or_add_channel(&_cfg_timers[_cfg_pins[p].timer].channels, &c_pool, _cfg_pins[p].channel);
-            if( !pc ) {
-                DEBUG_OUT("ERROR: increase channel pool or some irq pins wont work!\n\r");
-                break; // Error! Provide more space in _irq_channels
-            }
-            if( c_pool && c_pool >= &_irq_channels[ARRAY_SIZE(_irq_channels)] ) c_pool = 0; // last slot in _irq_channels used up
-            if( !find_or_add_pin(&pc->pins, &p_pool, p) ) {
-                DEBUG_OUT("ERROR: increase pin pool or some irq pins wont work!\n\r");
-                break; // Error! Provide more space in _irq_pins
-            }
-            if( p_pool && p_pool >= &_irq_pins[ARRAY_SIZE(_irq_pins)] ) p_pool = 0; // last slot in _irq_pins used up
-        }
-    }
-    DEBUG_OUT("irq lists done\n\r");
 
     // Init used gpio pins
     for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
-        gpio_init(_cfg_gpio_banks[_cfg_pins[p].bank].port, _cfg_pins[p].mode, GPIO_OSPEED_10MHZ, _cfg_pins[p].pin);
+        uint32_t gpio_mode = (_pwm_pins[p].mode == Timer) ? GPIO_MODE_AF_PP : GPIO_MODE_OUT_PP;
+        gpio_init(_cfg_gpio_banks[_cfg_pins[p].bank].port, gpio_mode, GPIO_OSPEED_10MHZ, _cfg_pins[p].pin);
         gpio_bit_set(_cfg_gpio_banks[_cfg_pins[p].bank].port, _cfg_pins[p].pin); // switch off inverted led
     }
 
+    rcu_periph_clock_enable(RCU_AF);
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( _pwm_remaps[t] && timer_wired(t) ) gpio_pin_remap_config(_pwm_remaps[t], ENABLE);
+    }
+
     DEBUG_OUT("gpio done\n\r");
 
+    _pwm_ticks = ticks;
+    _pwm_prescale = prescale;
     for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( !timer_used(t) ) continue;
         rcu_periph_clock_enable(_cfg_timers[t].rcu); // clock for used timers
         timer_deinit(_cfg_timers[t].port);           // unset old stuff paranoia
 
@@ -281,8 +887,26 @@ void init_pwm( uint16_t prescale, uint16_t ticks ) {
             .period = ticks - 1,             // 1000 ticks for full cycle -> 100Hz pwm interval
             .clockdivision = TIMER_CKDIV_DIV1,
             .repetitioncounter = 0};
+        if( PWM_ALIGN != TIMER_COUNTER_EDGE ) { // half ticks up to ticks and back down
+            tp.alignedmode = PWM_ALIGN;
+            tp.prescaler = prescale / 2 - 1;
+            tp.period = ticks;
+        }
+        if( t == DMA_PWM_TIMER && DMA_TIMERS ) { // update on every tick, the table has the pwm interval
+            tp.alignedmode = TIMER_COUNTER_EDGE;
+            tp.prescaler = 0;
+            tp.period = prescale - 1;
+        }
+        if( t == BAM_PWM_TIMER && BAM_TIMERS ) { // half ticks, start with slot 0
+            tp.alignedmode = TIMER_COUNTER_EDGE;
+            tp.prescaler = prescale / 2 - 1;
+            tp.period = 1;
+        }
         timer_init(_cfg_timers[t].port, &tp);
+        _cycles_per_tick[t] = SystemCoreClock / pwm_timer_clock() * (tp.prescaler + 1);
     }
+    _pwm_interval_us = (uint64_t)prescale * ticks * 1000000 / pwm_timer_clock();
+    _pwm_update_us = (PWM_ALIGN == TIMER_COUNTER_EDGE) ? _pwm_interval_us : _pwm_interval_us / 2;
 
     DEBUG_OUT("timer init done. %lu ns = %lu kHz ticks and %lu us = %lu Hz intervals if CK_TIMER = CK_ABP1 = %lu MHz\n\r",
         500000000UL / (rcu_clock_freq_get(CK_APB1) / prescale), 2UL * rcu_clock_freq_get(CK_APB1) / (prescale * 1000UL),
@@ -297,25 +921,63 @@ void init_pwm( uint16_t prescale, uint16_t ticks ) {
         .ocidlestate  = TIMER_OC_IDLE_STATE_HIGH,
         .ocnidlestate = TIMER_OCN_IDLE_STATE_HIGH};
     int use_mode_interrupt = 0;
-    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
-        init_pwm_channel(_cfg_timers[_cfg_pins[p].timer].port, _cfg_channels[_cfg_pins[p].channel].channel, &cp);
-        if( _cfg_pins[p].mode == Interrupt ) {
-            timer_interrupt_enable(_cfg_timers[_cfg_pins[p].timer].port, _cfg_channels[_cfg_pins[p].channel].interrupt_channel);
-            timer_interrupt_enable(_cfg_timers[_cfg_pins[p].timer].port, TIMER_INT_UP);
-            eclic_irq_enable(_cfg_timers[_cfg_pins[p].timer].eclic_interrupt, 1, 1); // level and prio up to you...
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode != Timer && _pwm_pins[p].mode != Interrupt ) continue;
+        // Interrupt timers write their compare values in the handler at the update event already
+        uint16_t shadow = (_irq_timers & (1U << _pwm_pins[p].timer)) ? TIMER_OC_SHADOW_DISABLE : TIMER_OC_SHADOW_ENABLE;
+        // Interrupt pins only need the compare flag. An enabled output would drive the channel's
+        // alternate function pin too, e.g. PA0 of TIMER1 ch0 that the led strip of TIMER4 uses
+        cp.outputstate = (_pwm_pins[p].mode == Timer) ? TIMER_CCX_ENABLE : TIMER_CCX_DISABLE;
+        init_pwm_channel(_cfg_timers[_pwm_pins[p].timer].port, _pwm_pins[p].channel, &cp, shadow);
+        _irq_cv[_pwm_pins[p].timer][_pwm_pins[p].channel] = pwm_cv(_pwm_pins[p].channel, 0);
+        if( _pwm_pins[p].mode == Interrupt ) {
+            timer_interrupt_enable(_cfg_timers[_pwm_pins[p].timer].port, _cfg_channels[_pwm_pins[p].channel].interrupt_channel);
+            timer_interrupt_enable(_cfg_timers[_pwm_pins[p].timer].port, TIMER_INT_UP);
+            enable_pwm_irq(_cfg_timers[_pwm_pins[p].timer].eclic_interrupt);
             use_mode_interrupt = 1;
         }
     }
 
     DEBUG_OUT("channel init done\n\r");
 
+    #ifdef WITH_SERIAL
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        static const char *modes[] = { "timer", "interrupt", "dma", "bam", "unplaced" };
+        DEBUG_OUT("pin %d: %s on timer%d ch%d\n\r", p, modes[_pwm_pins[p].mode], _pwm_pins[p].timer, _pwm_pins[p].channel);
+    }
+    #endif
+
+    if( DMA_MASK ) {
+        init_pwm_dma(DMA_PWM_TIMER, ticks);
+        use_mode_interrupt = 1;
+        DEBUG_OUT("dma init done\n\r");
+    }
+
+    if( BAM_TIMERS ) {
+        init_pwm_bam(BAM_PWM_TIMER);
+        use_mode_interrupt = 1;
+        DEBUG_OUT("bam init done\n\r");
+    }
+
     if( use_mode_interrupt ) {
         eclic_global_interrupt_enable(); // make the interrupt controller do its work
     }
 
     DEBUG_OUT("eclic enabled\n\r");
 
+    // Start counters apart, so the timers don't switch their pins at the same time.
+    // Center aligned counters start counting up, so at most half an interval apart
     for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( !timer_used(t) ) continue;
+        if( !timer_reserved(t) ) {
+            uint32_t phase = _cfg_timers[t].phase % 100;
+            if( PWM_ALIGN == TIMER_COUNTER_EDGE ) {
+                timer_counter_value_config(_cfg_timers[t].port, phase * ticks / 100);
+            }
+            else { // half ticks
+                timer_counter_value_config(_cfg_timers[t].port, 2 * (phase > 50 ? 50 : phase) * ticks / 100);
+            }
+        }
         timer_primary_output_config(_cfg_timers[t].port, ENABLE);
         timer_auto_reload_shadow_enable(_cfg_timers[t].port);
         timer_enable(_cfg_timers[t].port);
@@ -330,104 +992,1419 @@ volatile uint32_t _u = 0;
 volatile uint32_t _c = 0;
 volatile uint32_t _g = 0;
 
+// Interrupt pins of a timer channel in a gpio bank
+// A constant without Auto pins, else a load from the table allocate_pwm() filled
+static inline uint32_t irq_mask( enum Timers timer, enum Gpio_Banks bank, enum Timer_Channels channel ) {
+    return AUTO_PINS ? _irq_masks[timer][bank][channel] : IRQ_MASK(timer, bank, channel);
+}
+
 // Timer event routine called on rising and falling edges of the pwm signal
-// Tested to work up until around 200kHz tick speed (makes 200Hz intervals with 1000 steps)
-void handle_pwm_interrupt( enum Timers timer ) {
+// Stateless: each event sets all interrupt pins of a timer to the level
+// the pwm pattern has at the current counter value, one gpio write per bank.
+// Always inlined, so timer is a constant in each handler and loops have compile time bounds.
+// Without Auto pins the masks are constants too and the compiler unrolls it into
+// a flat handler per timer that only touches channels and banks with pins.
+// Auto pins cost a table load per channel and bank.
+// Handler cycles and tick rates for 1-16 pins: test/test_irq_rate
+static inline __attribute__((always_inline)) void handle_pwm_interrupt( enum Timers timer ) {
+    uint32_t port = _cfg_timers[timer].port;
+
+    uint32_t flags = reg_timer_flags_take(port); // only clears what we have seen
+
     _h++;
-    if (_cfg_timers[timer].channels)
-    {
-        // Interrupts not only used for signal going up or down,
-        // so filter depending on current output state and timer value
-        uint32_t count = timer_counter_read(_cfg_timers[timer].port);
-
-        struct irq_channels *ch = _cfg_timers[timer].channels;
-        while( ch ) {
-            if( SET == timer_interrupt_flag_get(_cfg_timers[timer].port, ch->interrupt_flag) ) {
+    if( flags & TIMER_INTF_UPIF ) _u++;
+
+    // Center aligned counters update at the top too, an interval starts when counting up from 0
+    uint32_t down = (PWM_ALIGN != TIMER_COUNTER_EDGE) && reg_timer_counting_down(port);
+    uint32_t start = (flags & TIMER_INTF_UPIF) && !down;
+
+    // New interval: take over a committed frame, all channels of the timer at once.
+    // Then dither: the accumulator carries the fraction into one more tick when it overflows,
+    // so over 65536 intervals the average duty is duty + frac/65536 ticks
+    if( (flags & TIMER_INTF_UPIF) && (_wave_timers & (1U << timer)) ) { // dma just wrote the next step
+        for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) {
+            _irq_cv[timer][c] = reg_timer_cv_get(port, _cfg_channels[c].channel);
+        }
+    }
+    else if( start ) {
+        int pending = _irq_pending[timer];
+        _irq_pending[timer] = 0;
+        for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) {
+            if( pending ) {
+                _irq_duty[timer][c] = _irq_next[timer][c];
+                _irq_frac[timer][c] = _irq_next_frac[timer][c];
+            }
+            uint32_t cv = _irq_duty[timer][c];
+            if( _irq_frac[timer][c] ) {
+                uint32_t acc = (uint32_t)_irq_acc[timer][c] + _irq_frac[timer][c];
+                _irq_acc[timer][c] = acc;
+                cv += acc >> 16;
+            }
+            cv = pwm_cv(c, cv);
+            if( _irq_cv[timer][c] != cv ) {
+                _irq_cv[timer][c] = cv;
+                reg_timer_cv_set(port, _cfg_channels[c].channel, cv);
+            }
+        }
+    }
+
+    uint32_t count = reg_timer_count(port);
+    uint32_t latency = down ? reg_load(&TIMER_CAR(port)) - count : count; // ticks since the earliest event we serve
+
+    // Pin levels from latched compare values, registers are not read back
+    uint32_t on[IRQ_CHANNELS];
+    for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) {
+        uint32_t pins = 0;
+        for( int b = 0; b < ARRAY_SIZE(_cfg_gpio_banks); b++ ) {
+            pins |= irq_mask(timer, b, c);
+        }
+        on[c] = 0;
+        if( pins ) {
+            uint32_t cv = _irq_cv[timer][c];
+            if( flags & _cfg_channels[c].interrupt_flag ) {
                 _c++;
-                timer_interrupt_flag_clear(_cfg_timers[timer].port, ch->interrupt_flag);
-                struct irq_pins *pn = ch->pins;
-                while( pn ) {
-                    if( pn->equalizer && count >= timer_channel_capture_value_register_read(_cfg_timers[timer].port, ch->channel) ) {
-                        gpio_bit_set(pn->port, pn->pin); // inverted led off
-                        pn->equalizer = 0;
-                    }
-                    pn = pn->next;
-                }
+                uint32_t since = down ? cv - count : count - cv;
+                if( (down ? count <= cv : count >= cv) && since < latency ) latency = since;
             }
-            ch = ch->next;
-        }
-
-        if( SET == timer_interrupt_flag_get(_cfg_timers[timer].port, TIMER_INT_FLAG_UP) ) {
-            _u++;
-            timer_interrupt_flag_clear(_cfg_timers[timer].port, TIMER_INT_FLAG_UP);
-            struct irq_channels *ch = _cfg_timers[timer].channels;
-            while( ch ) {
-                struct irq_pins *pn = ch->pins;
-                while( pn ) {
-                    if( (!pn->equalizer) && count < timer_channel_capture_value_register_read(_cfg_timers[timer].port, ch->channel) ) {
-                        gpio_bit_reset(pn->port, pn->pin); // inverted led on
-                        pn->equalizer = 1;
-                    }
-                    pn = pn->next;
-                }
-                ch = ch->next;
+            if( _cfg_channels[c].phase == Leading && start && cv > 0 && cv <= count ) { // on phase over before we got here
+                if( (_g++ & 0xff) == 0 ) ISR_OUT("timer%d ch%d missed on phase: count %lu cv %lu\n\r", timer, c, count, cv); // first and every 256th
+                ISRSTAT_MISSED(ISR_TIMER(timer));
             }
+            // PWM0 reference: counting up it's active below cv, counting down it stays active down from cv
+            uint32_t ref = down ? count <= cv : count < cv;
+            on[c] = (_cfg_channels[c].phase == Leading) ? ref : !ref;
+        }
+    }
+    ISRSTAT_LATENCY(ISR_TIMER(timer), latency * _cycles_per_tick[timer]);
+
+    for( int b = 0; b < ARRAY_SIZE(_cfg_gpio_banks); b++ ) {
+        uint32_t pins = 0;
+        uint32_t pins_on = 0;
+        for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) {
+            pins |= irq_mask(timer, b, c);
+            if( on[c] ) pins_on |= irq_mask(timer, b, c);
+        }
+        if( pins ) {
+            reg_gpio_bop(_cfg_gpio_banks[b].port, pins & ~pins_on, pins_on); // inverted leds: set is off
         }
     }
 }
 
 // Timer interrupt handler needs to have this name to be used by the system
-// Define one for each timer that uses interrups according to _cfg_pins[]
-void TIMER1_IRQHandler() {
+// One for each timer that allocate_pwm() may give Interrupt pins (all but TIMER0)
+// TIMER0 only has update interrupts for dithering
+PWM_ISR void TIMER0_UP_IRQHandler() {
+    ISRSTAT_ENTER();
+    handle_pwm_interrupt(Timer0);
+    ISRSTAT_EXIT(ISR_TIMER(Timer0));
+}
+
+PWM_ISR void TIMER1_IRQHandler() {
+    ISRSTAT_ENTER();
     // This resets flags for UP and CHx
     handle_pwm_interrupt(Timer1);
+    ISRSTAT_EXIT(ISR_TIMER(Timer1));
 }
 
+PWM_ISR void TIMER2_IRQHandler() {
+    ISRSTAT_ENTER();
+    handle_pwm_interrupt(Timer2);
+    ISRSTAT_EXIT(ISR_TIMER(Timer2));
+}
 
-// From the constant pwm interval duration of MAX_DUTY ticks,
-// how many of them is the signal of a pin up?
-void set_pwm_duty( enum Pins pin, uint16_t duty ) {
-    // duty >= MAX_DUTY: always on
-    // duty == 0: always off
-    timer_channel_output_pulse_value_config(_cfg_timers[_cfg_pins[pin].timer].port, _cfg_channels[_cfg_pins[pin].channel].channel, duty);
+PWM_ISR void TIMER4_IRQHandler() {
+    ISRSTAT_ENTER();
+    handle_pwm_interrupt(Timer4);
+    ISRSTAT_EXIT(ISR_TIMER(Timer4));
 }
 
 
-/* 
-Application side using the pwm to fade LEDs
-No pin, timer or pwm configuration below
+// Move the edge of each Dma pin in one half of the table to its requested duty
+// Only touches slots between old and new duty, so small steps are cheap
+void update_dma_half( uint32_t *slots, uint16_t *half_duty ) {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        if( _cfg_pins[p].mode != Dma ) continue;
+        uint32_t pin = _cfg_pins[p].pin;
+        uint32_t from = half_duty[p];
+        uint32_t to = _dma_duty[p];
+        if( to > _dma_ticks ) to = _dma_ticks;
+        for( ; from < to; from++ ) {
+            slots[from] = (slots[from] & ~pin) | (pin << 16); // inverted led on
+        }
+        while( from > to ) {
+            from--;
+            slots[from] = (slots[from] & ~(pin << 16)) | pin; // inverted led off
+        }
+        half_duty[p] = to;
+    }
+}
+
+// Dma event routine called once per pwm interval when dma is done with one half of the table
+void handle_pwm_dma_interrupt( enum Timers timer ) {
+    uint32_t dma = _cfg_timers[timer].dma;
+    dma_channel_enum ch = _cfg_timers[timer].dma_channel;
+    if( reg_dma_flag(dma, ch, DMA_FLAG_HTF) ) {
+        reg_dma_flag_clear(dma, ch, DMA_FLAG_HTF);
+        update_dma_half(_dma_slots, _dma_half_duty[0]);
+    }
+    if( reg_dma_flag(dma, ch, DMA_FLAG_FTF) ) {
+        reg_dma_flag_clear(dma, ch, DMA_FLAG_FTF);
+        update_dma_half(&_dma_slots[_dma_ticks], _dma_half_duty[1]);
+    }
+}
+
+
+// Bam event routine called at the start of each slot
+void handle_pwm_bam_interrupt( enum Timers timer ) {
+    uint32_t port = _cfg_timers[timer].port;
+    reg_store(&TIMER_INTF(port), ~TIMER_INTF_UPIF);
+    ISRSTAT_LATENCY(ISR_TIMER(timer), reg_timer_count(port) * _cycles_per_tick[timer]);
+
+    uint32_t k = _bam_slot;
+    for( int b = 0; b < ARRAY_SIZE(_cfg_gpio_banks); b++ ) {
+        if( BAM_MASK(b) ) reg_store(&GPIO_BOP(_cfg_gpio_banks[b].port), _bam_now[k][b]);
+    }
+
+    uint32_t next = (k + 1 < BAM_BITS) ? k + 1 : 0;
+    reg_store(&TIMER_CAR(port), (2U << next) - 1); // shadowed: used when this slot ends
+    _bam_slot = next;
+
+    if( next == 0 && _bam_dirty ) { // longest slot is running, take over duty changes for next interval
+        for( int s = 0; s < BAM_BITS; s++ ) {
+            for( int b = 0; b < ARRAY_SIZE(_cfg_gpio_banks); b++ ) {
+                if( BAM_MASK(b) ) _bam_now[s][b] = _bam_next[s][b];
+            }
+        }
+        _bam_dirty = 0;
+    }
+}
+
+// Timer interrupt handler for BAM_PWM_TIMER, see _cfg_timers[]
+// Without Bam pins the timer is free for Interrupt pins
+PWM_ISR void TIMER3_IRQHandler() {
+    ISRSTAT_ENTER();
+    if( BAM_TIMERS ) {
+        handle_pwm_bam_interrupt(BAM_PWM_TIMER);
+    }
+    else {
+        handle_pwm_interrupt(Timer3);
+    }
+    ISRSTAT_EXIT(ISR_TIMER(Timer3));
+}
+
+// Set the duty bits of a Bam pin in all slots
+void set_pwm_bam_duty( enum Pins pin, uint16_t duty ) {
+    uint32_t value = (duty >= MAX_DUTY) ? BAM_MAX : (uint32_t)duty * BAM_MAX / MAX_DUTY;
+    uint32_t mask = _cfg_pins[pin].pin;
+    enum Gpio_Banks bank = _cfg_pins[pin].bank;
+
+    uint32_t irq = critical_enter(); // interval must not take over half of the bits
+    for( int k = 0; k < BAM_BITS; k++ ) {
+        uint32_t bop = _bam_next[k][bank] & ~(mask | (mask << 16));
+        _bam_next[k][bank] = bop | (((value >> k) & 1) ? mask << 16 : mask); // inverted led on: reset
+    }
+    _bam_dirty = 1;
+    critical_exit(irq);
+}
+
+
+/*
+Frames: duties of many pins staged and applied together at the next update event.
+Between pwm_frame_begin() and pwm_frame_commit() set_pwm_duty() only stages,
+outside of a frame each call is a frame of its own. Only changed duties are written.
+Timer pins use the shadow registers of their timer, held back from the update event
+while they are written. Timers with Interrupt or dithered pins latch the frame in their handler.
+Dma and Bam tables pick up the frame at the start of their next interval.
 */
 
+uint16_t _frame_duty[ARRAY_SIZE(_cfg_pins)]; // staged duties
+uint16_t _frame_frac[ARRAY_SIZE(_cfg_pins)]; // staged fractions, see set_pwm_duty16()
+uint16_t _pwm_duty[ARRAY_SIZE(_cfg_pins)];   // committed duties
+uint16_t _pwm_frac[ARRAY_SIZE(_cfg_pins)];
+int _frame_open = 0;
+
+// Start staging duties
+void pwm_frame_begin() {
+    _frame_open = 1;
+}
 
-// Gradualy adjust pwm duty to make LED darker or brighter 
-void fade( enum Color from, enum Color to, uint32_t duty_us ) {
-    for( uint32_t i = 0; i <= MAX_DUTY; i++ ) { // 5s per cycle
-        set_pwm_duty(from, MAX_DUTY - i);
-        set_pwm_duty(to, i);
-        delay_1us(duty_us);
+// Let the update interrupt handler of a timer write its compare values from now on
+// Needed to dither Timer pins, it stays that way
+void start_dither( enum Timers timer ) {
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode == Timer && _pwm_pins[p].timer == timer ) {
+            _irq_cv[timer][_pwm_pins[p].channel] = pwm_cv(_pwm_pins[p].channel, _pwm_duty[p]);
+            _irq_duty[timer][_pwm_pins[p].channel] = _pwm_duty[p];
+            _irq_next[timer][_pwm_pins[p].channel] = _pwm_duty[p];
+        }
     }
+    _dither_timers |= 1U << timer;
+    timer_interrupt_flag_clear(_cfg_timers[timer].port, TIMER_INT_FLAG_UP);
+    timer_interrupt_enable(_cfg_timers[timer].port, TIMER_INT_UP);
+    enable_pwm_irq(_cfg_timers[timer].eclic_interrupt);
 }
 
+// Apply all staged duties at the next update event of their timers
+void pwm_frame_commit() {
+    uint32_t irq = critical_enter();
 
-// Putting it all together: 
-// * Start program saying hello on serial
-// * Setup the pwm signal
-// * Start fading between colors to cycle through the rainbow
-int main() {
-    preinit_pwm(); // reset interrupt and gpio state paranoia
-    #ifdef WITH_SERIAL
-    init_usart0();
+    uint32_t shadowed = 0; // timers with compare values written here
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( timer_wired(t) && !((_irq_timers | _dither_timers) & (1U << t)) ) {
+            shadowed |= 1U << t;
+            reg_timer_update_disable(_cfg_timers[t].port);
+        }
+    }
+
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        uint16_t duty = _frame_duty[p];
+        uint16_t frac = _frame_frac[p];
+        if( duty == _pwm_duty[p] && frac == _pwm_frac[p] ) continue;
+        enum Timers t = _pwm_pins[p].timer;
+        switch( _pwm_pins[p].mode ) {
+            case Dma: // no dithering, round
+                _dma_duty[p] = duty + (frac >> 15); // table is updated in the dma interrupt
+                break;
+            case Bam:
+                set_pwm_bam_duty(p, duty + (frac >> 15));
+                break;
+            case Timer:
+            case Interrupt:
+                if( frac && !((_irq_timers | _dither_timers) & (1U << t)) ) start_dither(t);
+                if( (_irq_timers | _dither_timers) & (1U << t) ) {
+                    _irq_next[t][_pwm_pins[p].channel] = duty;
+                    _irq_next_frac[t][_pwm_pins[p].channel] = frac;
+                    _irq_pending[t] = 1;
+                }
+                else {
+                    reg_timer_cv_set(_cfg_timers[t].port, _cfg_channels[_pwm_pins[p].channel].channel, pwm_cv(_pwm_pins[p].channel, duty));
+                }
+                break;
+            default: // no channel left for this pin
+                break;
+        }
+        _pwm_duty[p] = duty;
+        _pwm_frac[p] = frac;
+    }
+
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( shadowed & (1U << t) ) reg_timer_update_enable(_cfg_timers[t].port);
+    }
+
+    _frame_open = 0;
+    critical_exit(irq);
+}
+
+// Level 0 is off, 65535 is all ticks of the pwm interval the signal of a pin is up
+// Timer and Interrupt pins alternate between adjacent duties to reach the level on average
+void set_pwm_duty16( enum Pins pin, uint16_t level ) {
+    uint32_t ticks = (uint32_t)level * _pwm_ticks;
+    _frame_duty[pin] = ticks / 65535;
+    _frame_frac[pin] = ((ticks % 65535) << 16) / 65535;
+    if( !_frame_open ) pwm_frame_commit();
+}
+
+// Perceived brightness 0..MAX_DUTY of a pin, mapped by its curve in _pin_levels
+// duty >= MAX_DUTY: on as far as the gain of the pin allows
+// duty == 0: always off
+void set_pwm_duty( enum Pins pin, uint16_t duty ) {
+    set_pwm_duty16(pin, _pin_levels[pin][duty < MAX_DUTY ? duty : MAX_DUTY]);
+}
+
+// Whole ticks of a brightness, for tables of compare values
+uint16_t pwm_brightness_ticks( enum Pins pin, uint16_t duty ) {
+    uint32_t level = _pin_levels[pin][duty < MAX_DUTY ? duty : MAX_DUTY];
+    return (level * _pwm_ticks + 32767) / 65535;
+}
+
+
+/*
+Retiming: other tick length and ticks per interval while the pwm runs.
+Prescaler, auto reload and compare values are all loaded at the next update event,
+so the current interval ends as it started and the next one has the new timing.
+Duties and fractions are rescaled to keep their share of the interval.
+Dma and Bam pins and waveforms have tables made for the timing, they can't follow.
+*/
+
+// Switch all timers to prescale timer clocks per tick and ticks per interval.
+// Returns 0 if the pins or the values don't allow it
+int pwm_retime( uint16_t prescale, uint16_t ticks ) {
+    if( DMA_TIMERS || BAM_TIMERS || _wave_timers ) return 0;
+    if( ticks < 2 || prescale == 0 || (PWM_ALIGN != TIMER_COUNTER_EDGE && (prescale & 1)) ) return 0;
+
+    uint32_t irq = critical_enter();
+    uint32_t old = _pwm_ticks;
+    _pwm_ticks = ticks;
+    _pwm_prescale = prescale;
+
+    // Rescale duties first, so the registers of each timer are written in one short burst below
+    uint16_t cvs[ARRAY_SIZE(_cfg_timers)][IRQ_CHANNELS];
+    uint32_t cv_channels[ARRAY_SIZE(_cfg_timers)] = { 0 }; // bit per channel to write
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode != Timer && _pwm_pins[p].mode != Interrupt ) continue;
+        enum Timers t = _pwm_pins[p].timer;
+        enum Timer_Channels c = _pwm_pins[p].channel;
+        uint64_t share = ((uint64_t)_pwm_duty[p] << 16 | _pwm_frac[p]) * ticks / old;
+        if( share > (uint64_t)ticks << 16 ) share = (uint64_t)ticks << 16;
+        if( (_irq_timers | _dither_timers) & (1U << t) ) { // the update handler takes it over
+            _pwm_duty[p] = share >> 16;
+            _pwm_frac[p] = share & 0xffff;
+            _irq_next[t][c] = _pwm_duty[p];
+            _irq_next_frac[t][c] = _pwm_frac[p];
+            _irq_pending[t] = 1;
+        }
+        else { // no dithering, round
+            _pwm_duty[p] = (share + 0x8000) >> 16;
+            _pwm_frac[p] = 0;
+            cvs[t][c] = pwm_cv(c, _pwm_duty[p]);
+            cv_channels[t] |= 1U << c;
+        }
+        _frame_duty[p] = _pwm_duty[p];
+        _frame_frac[p] = _pwm_frac[p];
+    }
+
+    // UPDIS keeps an update event from loading some of the new values without the others.
+    // It also swallows an update that falls into the window: the counter wraps without one.
+    // Then a software update (counter restarts at 0) loads them and lets the handler start the interval
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( !timer_used(t) ) continue;
+        uint32_t port = _cfg_timers[t].port;
+        uint32_t count = reg_timer_count(port);
+        uint32_t down = reg_timer_counting_down(port);
+        reg_timer_update_disable(port);
+        if( PWM_ALIGN == TIMER_COUNTER_EDGE ) {
+            reg_store(&TIMER_PSC(port), prescale - 1);
+            reg_store(&TIMER_CAR(port), ticks - 1);
+        }
+        else { // half ticks up to ticks and back down
+            reg_store(&TIMER_PSC(port), prescale / 2 - 1);
+            reg_store(&TIMER_CAR(port), ticks);
+        }
+        for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) {
+            if( cv_channels[t] & (1U << c) ) reg_timer_cv_set(port, _cfg_channels[c].channel, cvs[t][c]);
+        }
+        reg_timer_update_enable(port);
+        // counter passed an end since, but without an update flag: it was in the window
+        uint32_t passed = (PWM_ALIGN == TIMER_COUNTER_EDGE) ? reg_timer_count(port) < count
+            : reg_timer_counting_down(port) != down;
+        if( passed && !(reg_load(&TIMER_INTF(port)) & TIMER_INTF_UPIF) ) reg_store(&TIMER_SWEVG(port), TIMER_SWEVG_UPG);
+        _cycles_per_tick[t] = SystemCoreClock / pwm_timer_clock() * (reg_load(&TIMER_PSC(port)) + 1);
+    }
+
+    _pwm_interval_us = (uint64_t)prescale * ticks * 1000000 / pwm_timer_clock();
+    _pwm_update_us = (PWM_ALIGN == TIMER_COUNTER_EDGE) ? _pwm_interval_us : _pwm_interval_us / 2;
+    critical_exit(irq);
+    return 1;
+}
+
+
+// Most edges of Timer and Interrupt pins at the same time with the current duties,
+// e.g. led current steps adding up or pins one interrupt has to switch.
+// Edges are placed in half ticks of an interval, timers shifted by their counter start
+uint32_t pwm_edge_peak() {
+    uint32_t period = 2 * _pwm_ticks;
+    uint32_t edges[2 * ARRAY_SIZE(_pwm_pins)]; // half ticks, up to 2 * 65535
+    uint32_t count = 0;
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode != Timer && _pwm_pins[p].mode != Interrupt ) continue;
+        uint32_t duty = 2 * _pwm_duty[p];
+        if( duty == 0 || duty >= period ) continue; // no edges
+        uint32_t phase = _cfg_timers[_pwm_pins[p].timer].phase % 100;
+        if( PWM_ALIGN != TIMER_COUNTER_EDGE && phase > 50 ) phase = 50;
+        uint32_t shift = period - phase * period / 100;
+        uint32_t on, off;
+        if( PWM_ALIGN == TIMER_COUNTER_EDGE ) {
+            on = (_cfg_channels[_pwm_pins[p].channel].phase == Leading) ? 0 : period - duty;
+            off = on + duty;
+        }
+        else {
+            on = (_cfg_channels[_pwm_pins[p].channel].phase == Leading) ? period - duty / 2 : (period - duty) / 2;
+            off = on + duty;
+        }
+        edges[count++] = (on + shift) % period;
+        edges[count++] = (off + shift) % period;
+    }
+    uint32_t peak = 0;
+    for( uint32_t e = 0; e < count; e++ ) {
+        uint32_t same = 0;
+        for( uint32_t o = 0; o < count; o++ ) {
+            if( edges[o] == edges[e] ) same++;
+        }
+        if( same > peak ) peak = same;
+    }
+    return peak;
+}
+
+
+/*
+Waveform player: each update event of a timer makes the dma write the next step
+of a table to its compare registers, using the dma burst register DMATB.
+A step holds the compare values (see pwm_cv()) of consecutive channels, so all of them change together.
+Center aligned counters update twice per interval, so they also play two steps per interval.
+Without refill function the table plays endlessly. With one it plays ping-pong:
+the refill function computes the half of the table that just finished playing,
+called from the half/full transfer interrupt.
+Interrupt pins of the timer take their compare values from the registers while playing.
+*/
+
+typedef void (*wave_refill)( enum Timers timer, uint16_t *steps, uint32_t count );
+
+struct waves {
+    uint16_t   *table;    // steps * channels compare values
+    enum Timer_Channels first;
+    uint32_t    steps;
+    uint32_t    channels;
+    wave_refill refill;   // 0: no refill, play table endlessly
+} _waves[ARRAY_SIZE(_cfg_timers)];
+
+// Play steps of compare values of channels first.. of a timer, one step per update event
+// Returns 0 if the timer can't play: not used, driving Dma or Bam pins or already playing
+int wave_start( enum Timers timer, enum Timer_Channels first, uint32_t channels, uint16_t *table, uint32_t steps, wave_refill refill ) {
+    if( !timer_used(timer) || timer_reserved(timer) || (_wave_timers & (1U << timer)) ) return 0;
+    if( reg_load(&DMA_CHCTL(_cfg_timers[timer].dma, _cfg_timers[timer].dma_channel)) & DMA_CHXCTL_CHEN ) return 0; // dma channel busy, e.g. serial
+    if( channels == 0 || first + channels > ARRAY_SIZE(_cfg_channels) || steps < 2 ) return 0;
+
+    struct waves *w = &_waves[timer];
+    w->table = table;
+    w->first = first;
+    w->steps = steps;
+    w->channels = channels;
+    w->refill = refill;
+    if( refill ) refill(timer, table, steps);
+
+    const struct timers *t = &_cfg_timers[timer];
+    rcu_periph_clock_enable(t->dma == DMA0 ? RCU_DMA0 : RCU_DMA1);
+    dma_deinit(t->dma, t->dma_channel);
+
+    dma_parameter_struct dp = {
+        .periph_addr  = (uint32_t)&TIMER_DMATB(t->port),
+        .periph_width = DMA_PERIPHERAL_WIDTH_16BIT,
+        .memory_addr  = (uint32_t)table,
+        .memory_width = DMA_MEMORY_WIDTH_16BIT,
+        .number       = steps * channels,
+        .priority     = DMA_PRIORITY_HIGH,
+        .periph_inc   = DMA_PERIPH_INCREASE_DISABLE,
+        .memory_inc   = DMA_MEMORY_INCREASE_ENABLE,
+        .direction    = DMA_MEMORY_TO_PERIPHERAL};
+    dma_init(t->dma, t->dma_channel, &dp);
+    dma_circulation_enable(t->dma, t->dma_channel);
+    dma_memory_to_memory_disable(t->dma, t->dma_channel);
+    if( refill ) {
+        dma_interrupt_enable(t->dma, t->dma_channel, DMA_INT_HTF | DMA_INT_FTF);
+        eclic_irq_enable(t->dma_interrupt, PWM_DMA_IRQ_LEVEL, 1);
+    }
+    dma_channel_enable(t->dma, t->dma_channel);
+
+    // Burst of one write per channel to the compare registers, starting at the first one
+    timer_dma_transfer_config(t->port, TIMER_DMACFG_DMATA_CH0CV + _cfg_channels[first].channel,
+        (channels - 1) * TIMER_DMACFG_DMATC_2TRANSFER);
+    uint32_t irq = critical_enter();
+    _wave_timers |= 1U << timer;
+    timer_dma_enable(t->port, TIMER_DMA_UPD);
+    critical_exit(irq);
+    return 1;
+}
+
+// Stop playing, channels keep the duties of the last step
+void wave_stop( enum Timers timer ) {
+    if( !(_wave_timers & (1U << timer)) ) return;
+    const struct timers *t = &_cfg_timers[timer];
+
+    uint32_t irq = critical_enter();
+    timer_dma_disable(t->port, TIMER_DMA_UPD);
+    dma_channel_disable(t->dma, t->dma_channel);
+    dma_interrupt_disable(t->dma, t->dma_channel, DMA_INT_HTF | DMA_INT_FTF);
+    _wave_timers &= ~(1U << timer);
+    for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) { // the update handler continues from here
+        _irq_cv[timer][c] = reg_timer_cv_get(t->port, _cfg_channels[c].channel);
+        _irq_duty[timer][c] = _irq_next[timer][c] = pwm_cv(c, _irq_cv[timer][c]);
+        _irq_frac[timer][c] = _irq_next_frac[timer][c] = 0;
+    }
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( (_pwm_pins[p].mode == Timer || _pwm_pins[p].mode == Interrupt) && _pwm_pins[p].timer == timer ) {
+            _frame_duty[p] = _pwm_duty[p] = _irq_duty[timer][_pwm_pins[p].channel];
+            _frame_frac[p] = _pwm_frac[p] = 0;
+        }
+    }
+    critical_exit(irq);
+}
+
+// Dma event routine of a playing timer: refill the half of the table that was played
+void handle_wave_interrupt( enum Timers timer ) {
+    uint32_t dma = _cfg_timers[timer].dma;
+    dma_channel_enum ch = _cfg_timers[timer].dma_channel;
+    struct waves *w = &_waves[timer];
+    uint32_t half = w->steps / 2;
+    if( reg_dma_flag(dma, ch, DMA_FLAG_HTF) ) {
+        reg_dma_flag_clear(dma, ch, DMA_FLAG_HTF);
+        w->refill(timer, w->table, half);
+    }
+    if( reg_dma_flag(dma, ch, DMA_FLAG_FTF) ) {
+        reg_dma_flag_clear(dma, ch, DMA_FLAG_FTF);
+        w->refill(timer, &w->table[half * w->channels], w->steps - half);
+    }
+}
+
+// Timer and channel of a pin, if its duty is a compare value a waveform can play
+int wave_pin( enum Pins pin, enum Timers *timer, enum Timer_Channels *channel ) {
+    if( _pwm_pins[pin].mode != Timer && _pwm_pins[pin].mode != Interrupt ) return 0;
+    *timer = _pwm_pins[pin].timer;
+    *channel = _pwm_pins[pin].channel;
+    return 1;
+}
+
+
+/*
+Led strip: WS2812/SK6812 pixels sent by the update dma of LED_STRIP_TIMER, see ws2812.h.
+The dma interrupt encodes a few bytes at a time, so long strips need no bit buffer.
+*/
+
+#if LED_STRIP_PIXELS
+uint8_t _strip_pixels[2][LED_STRIP_PIXELS * LED_STRIP_COLORS]; // front and back buffer, wire order
+struct ws2812 _strip;
+
+// Setup pin, timer and dma of the strip and switch all pixels off
+void init_strip() {
+    const struct timers *t = &_cfg_timers[LED_STRIP_TIMER];
+    for( int h = 0; h < ARRAY_SIZE(_cfg_timer_pins); h++ ) {
+        const struct timer_pins *hw = &_cfg_timer_pins[h];
+        if( hw->timer == LED_STRIP_TIMER && hw->channel == LED_STRIP_CHANNEL && hw->remap == 0 ) {
+            gpio_init(_cfg_gpio_banks[hw->bank].port, GPIO_MODE_AF_PP, GPIO_OSPEED_50MHZ, hw->pin);
+            break;
+        }
+    }
+
+    rcu_periph_clock_enable(t->rcu);
+    _strip.timer = t->port;
+    _strip.channel = _cfg_channels[LED_STRIP_CHANNEL].channel;
+    _strip.dma = t->dma;
+    _strip.dma_channel = t->dma_channel;
+    ws2812_init(&_strip, pwm_timer_clock(), _strip_pixels[0], _strip_pixels[1], sizeof(_strip_pixels[0]));
+    eclic_irq_enable(t->dma_interrupt, PWM_DMA_IRQ_LEVEL, 1);
+    ws2812_show(&_strip);
+}
+#else
+#define init_strip()
+#endif
+
+
+/*
+Self test: PROBE_TIMER counts free running and its channels capture both edges of the pins in CFG_PROBES.
+Dma writes the timestamps into a circular buffer per pin, a scheduler task hands new ones to lib/probe.
+No interrupts and no load on the pwm. The counter wraps after several polls and pwm intervals,
+so a level of up to an interval is measured without ambiguity.
+*/
+
+#ifdef WITH_PROBE
+#define PROBE_STAMPS  256  // edges per pin and poll, at most
+#define PROBE_POLL_US 1000 // a counter wrap lasts at least PROBE_WRAPS polls
+#define PROBE_WRAPS   4
+
+#define PROBE_CONFIG(x, pin, channel, dma, dma_channel) { pin, channel, dma, dma_channel },
+
+const struct probes {
+    enum Pins           pin;         // pin to measure
+    enum Timer_Channels channel;     // capture channel of PROBE_TIMER
+    uint32_t            dma;         // dma channel serving the capture requests of the channel
+    dma_channel_enum    dma_channel;
+} _cfg_probes[] = {
+    CFG_PROBES(PROBE_CONFIG, 0)
+};
+
+const uint16_t _probe_requests[] = { TIMER_DMA_CH0D, TIMER_DMA_CH1D, TIMER_DMA_CH2D, TIMER_DMA_CH3D };
+
+uint16_t _probe_stamps[ARRAY_SIZE(_cfg_probes)][PROBE_STAMPS];
+uint32_t _probe_read[ARRAY_SIZE(_cfg_probes)]; // next stamp to hand over
+struct probe _probes[ARRAY_SIZE(_cfg_probes)];
+uint32_t _probe_prescale;                      // timer clocks per count
+
+// Input level of a pin, outputs included
+static inline uint8_t pin_level( enum Pins pin ) {
+    return (reg_load(&GPIO_ISTAT(_cfg_gpio_banks[_cfg_pins[pin].bank].port)) & _cfg_pins[pin].pin) != 0;
+}
+
+// Stamps the dma has written to a circular buffer, minus full rounds
+static inline uint32_t probe_written( int p ) {
+    uint32_t written = PROBE_STAMPS - reg_dma_remaining(_cfg_probes[p].dma, _cfg_probes[p].dma_channel);
+    return (written == PROBE_STAMPS) ? 0 : written;
+}
+
+// (Re)start capturing for the current pwm timing
+void init_probe() {
+    const struct timers *t = &_cfg_timers[PROBE_TIMER];
+    rcu_periph_clock_enable(t->rcu);
+    timer_deinit(t->port);
+
+    uint32_t wrap = (uint64_t)pwm_timer_clock() * PROBE_POLL_US * PROBE_WRAPS / 1000000;
+    if( wrap < 2 * (uint32_t)_pwm_prescale * _pwm_ticks ) wrap = 2 * (uint32_t)_pwm_prescale * _pwm_ticks;
+    _probe_prescale = (wrap + 0xffff) >> 16;
+    if( _probe_prescale == 0 ) _probe_prescale = 1;
+
+    timer_parameter_struct tp = {
+        .prescaler         = _probe_prescale - 1,
+        .alignedmode       = TIMER_COUNTER_EDGE,
+        .counterdirection  = TIMER_COUNTER_UP,
+        .period            = 0xffff,
+        .clockdivision     = TIMER_CKDIV_DIV1,
+        .repetitioncounter = 0};
+    timer_init(t->port, &tp);
+
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        const struct probes *cfg = &_cfg_probes[p];
+        for( int h = 0; h < ARRAY_SIZE(_cfg_timer_pins); h++ ) { // a capture pin wired to the pin is an input
+            const struct timer_pins *hw = &_cfg_timer_pins[h];
+            if( hw->timer == PROBE_TIMER && hw->channel == cfg->channel && hw->remap == 0 ) {
+                if( hw->bank != _cfg_pins[cfg->pin].bank || hw->pin != _cfg_pins[cfg->pin].pin ) {
+                    gpio_init(_cfg_gpio_banks[hw->bank].port, GPIO_MODE_IN_FLOATING, GPIO_OSPEED_50MHZ, hw->pin);
+                }
+                break;
+            }
+        }
+
+        rcu_periph_clock_enable(cfg->dma == DMA0 ? RCU_DMA0 : RCU_DMA1);
+        dma_deinit(cfg->dma, cfg->dma_channel);
+        dma_parameter_struct dp = {
+            .periph_addr  = (uint32_t)reg_timer_cv(t->port, _cfg_channels[cfg->channel].channel),
+            .periph_width = DMA_PERIPHERAL_WIDTH_16BIT,
+            .memory_addr  = (uint32_t)_probe_stamps[p],
+            .memory_width = DMA_MEMORY_WIDTH_16BIT,
+            .number       = PROBE_STAMPS,
+            .priority     = DMA_PRIORITY_MEDIUM,
+            .periph_inc   = DMA_PERIPH_INCREASE_DISABLE,
+            .memory_inc   = DMA_MEMORY_INCREASE_ENABLE,
+            .direction    = DMA_PERIPHERAL_TO_MEMORY};
+        dma_init(cfg->dma, cfg->dma_channel, &dp);
+        dma_circulation_enable(cfg->dma, cfg->dma_channel);
+        dma_memory_to_memory_disable(cfg->dma, cfg->dma_channel);
+        dma_channel_enable(cfg->dma, cfg->dma_channel);
+
+        timer_ic_parameter_struct ic = {
+            .icpolarity  = TIMER_IC_POLARITY_BOTH_EDGE,
+            .icselection = TIMER_IC_SELECTION_DIRECTTI,
+            .icprescaler = TIMER_IC_PSC_DIV1,
+            .icfilter    = 0};
+        timer_input_capture_config(t->port, _cfg_channels[cfg->channel].channel, &ic);
+        timer_dma_enable(t->port, _probe_requests[cfg->channel]);
+    }
+    timer_enable(t->port);
+
+    // Timestamps alternate between the edges: start with the level after the last stamp written.
+    // An edge between sampling the level and counting the stamps makes that pin try again
+    uint32_t expect = (uint32_t)_pwm_prescale * _pwm_ticks / _probe_prescale;
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        uint32_t written;
+        uint8_t level;
+        uint16_t now;
+        uint32_t irq;
+        do {
+            irq = critical_enter();
+            written = probe_written(p);
+            level = pin_level(_cfg_probes[p].pin);
+            now = reg_timer_count(t->port);
+            critical_exit(irq);
+        } while( written != probe_written(p) );
+        _probe_read[p] = written;
+        probe_start(&_probes[p], level, now, expect);
+    }
+}
+
+// Hand new timestamps over with the counter and pin levels sampled after them
+// A pin sample only counts if it held and no stamp arrived in the meantime, e.g. one the dma had yet to write
+// Scheduler task: every PROBE_POLL_US
+void poll_probe( struct sched_task *task ) {
+    uint32_t written[ARRAY_SIZE(_cfg_probes)];
+    uint8_t level[ARRAY_SIZE(_cfg_probes)];
+    uint32_t irq = critical_enter();
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        level[p] = pin_level(_cfg_probes[p].pin);
+    }
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        written[p] = probe_written(p);
+    }
+    uint16_t now = reg_timer_count(_cfg_timers[PROBE_TIMER].port);
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        if( pin_level(_cfg_probes[p].pin) != level[p] ) level[p] = PROBE_LEVEL_UNKNOWN;
+    }
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        if( probe_written(p) != written[p] ) level[p] = PROBE_LEVEL_UNKNOWN;
+    }
+    critical_exit(irq);
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        probe_poll(&_probes[p], _probe_stamps[p], PROBE_STAMPS, _probe_read[p], written[p], now, level[p]);
+        _probe_read[p] = written[p];
+    }
+}
+
+struct sched_task _probe_task = { poll_probe };
+
+#ifdef WITH_SERIAL
+#ifndef PROBE_REPORT_MS
+#define PROBE_REPORT_MS 1000 // 0: no reports until the probe command asks for them
+#endif
+
+uint32_t _probe_report_ms = PROBE_REPORT_MS;
+
+// Print what each pin did since the last report next to the duty it should have:
+// time on (low, inverted leds) in 1/10000, frequency and period jitter
+// Scheduler task: every _probe_report_ms
+void report_probe( struct sched_task *task ) {
+    uint32_t clock = pwm_timer_clock();
+    for( int p = 0; p < ARRAY_SIZE(_cfg_probes); p++ ) {
+        enum Pins pin = _cfg_probes[p].pin;
+        struct probe_stats s;
+        probe_take(&_probes[p], &s);
+        uint64_t set = ((uint64_t)_pwm_duty[pin] << 16 | _pwm_frac[pin]) / _pwm_ticks;
+        if( set > 0x10000 ) set = 0x10000;
+        uint64_t counts = s.high + s.low;
+        uint32_t hz = counts ? (uint64_t)s.periods * clock / _probe_prescale / counts : 0;
+        uint32_t jitter_ns = (uint64_t)(s.max - s.min) * _probe_prescale * 1000000000 / clock;
+        DEBUG_OUT("probe pin %d: on %lu set %lu of 10000, %lu Hz, ", pin,
+            (probe_share(&s, 0) * 10000 + 0x8000) >> 16, (uint32_t)((set * 10000 + 0x8000) >> 16), hz);
+        DEBUG_OUT("jitter %lu ns, %lu periods, %lu odd, %lu resyncs\n\r", jitter_ns, s.periods, s.odd, s.resyncs);
+    }
+}
+
+struct sched_task _probe_report_task = { report_probe };
+#endif
+
+// Start measuring and reporting
+void start_probe() {
+    init_probe();
+    sched_add(&_probe_task, 0, PROBE_POLL_US);
+    #ifdef WITH_SERIAL
+    if( _probe_report_ms ) sched_add(&_probe_report_task, _probe_report_ms * 1000, _probe_report_ms * 1000);
+    #endif
+}
+#else
+#define init_probe()
+#define start_probe()
+#endif
+
+// Dma event routine of a timer: encode the led strip or refill a playing wave
+void handle_timer_dma_interrupt( enum Timers timer ) {
+    #if LED_STRIP_PIXELS
+    if( timer == LED_STRIP_TIMER ) {
+        ws2812_interrupt(&_strip);
+        return;
+    }
+    #endif
+    handle_wave_interrupt(timer);
+}
+
+// Dma interrupt handlers for the update events of the timers, see _cfg_timers[]
+void DMA0_Channel4_IRQHandler() {
+    ISRSTAT_ENTER();
+    handle_timer_dma_interrupt(Timer0);
+    ISRSTAT_EXIT(ISR_DMA(Timer0));
+}
+
+void DMA0_Channel1_IRQHandler() {
+    ISRSTAT_ENTER();
+    handle_timer_dma_interrupt(Timer1);
+    ISRSTAT_EXIT(ISR_DMA(Timer1));
+}
+
+// DMA_PWM_TIMER plays Dma pins if there are any
+void DMA0_Channel2_IRQHandler() {
+    ISRSTAT_ENTER();
+    if( DMA_TIMERS ) {
+        handle_pwm_dma_interrupt(DMA_PWM_TIMER);
+    }
+    else {
+        handle_timer_dma_interrupt(Timer2);
+    }
+    ISRSTAT_EXIT(ISR_DMA(Timer2));
+}
+
+void DMA0_Channel6_IRQHandler() {
+    ISRSTAT_ENTER();
+    handle_timer_dma_interrupt(Timer3);
+    ISRSTAT_EXIT(ISR_DMA(Timer3));
+}
+
+void DMA1_Channel1_IRQHandler() {
+    ISRSTAT_ENTER();
+    handle_timer_dma_interrupt(Timer4);
+    ISRSTAT_EXIT(ISR_DMA(Timer4));
+}
+
+
+/* 
+Application side using the pwm to fade LEDs
+No pin, timer or pwm configuration below
+*/
+
+
+uint32_t _duty_us = DUTY_US; // fade speed, can be changed via serial
+int _paused = 0;             // stop fading while duties are set via serial
+
+
+// Fades making up the rainbow, one after the other
+const struct fades {
+    enum Color from;
+    enum Color to;
+    const char *name;
+} _fades[] = {
+    { Red,   Blue,  "r->b" },
+    { Blue,  Green, "b->g" },
+    { Green, Red,   "g->r" }
+};
+
+// Same fades as keyframe track, time unit is one fade step
+const struct anim_key _fade_keys[] = {
+    ANIM_KEY(MAX_DUTY + 1, 65535, 0, 0, AnimLinear), // r->b
+    ANIM_KEY(MAX_DUTY + 1, 0, 0, 65535, AnimLinear), // b->g
+    ANIM_KEY(MAX_DUTY + 1, 0, 65535, 0, AnimLinear)  // g->r
+};
+_Static_assert(ARRAY_SIZE(_fade_keys) == ARRAY_SIZE(_fades), "one key per fade");
+
+const struct anim_track _fade_track = { _fade_keys, ARRAY_SIZE(_fade_keys), AnimRgb, 1 };
+struct anim_layer _fade_layer = { &_fade_track, 0, 1, 3, AnimReplace, 65535 }; // levels of red, green, blue
+
+
+/*
+Rainbow as waveform if the colors are on adjacent channels of one timer:
+dma sets the duties every pwm interval and the cpu computes the next steps
+every RAINBOW_STEPS/2 intervals. Otherwise the fade task below steps the duties.
+*/
+
+#define RAINBOW_STEPS 32 // steps in the ping-pong table
+
+uint16_t _rainbow_table[RAINBOW_STEPS * 3];
+uint32_t _rainbow_pos = 0;             // fade steps since start of the rainbow, 16.16 fixed point
+enum Timers _rainbow_timer = AnyTimer; // timer playing the rainbow
+uint8_t _rainbow_slot[ARRAY_SIZE(_cfg_pins)]; // index of a color's duty in a step
+
+// Compute the next steps of the rainbow, same speed as the fade task
+void rainbow_refill( enum Timers timer, uint16_t *steps, uint32_t count ) {
+    uint32_t inc = ((uint64_t)_pwm_update_us << 16) / _duty_us; // fade steps per wave step
+    uint32_t end = ARRAY_SIZE(_fades) * (MAX_DUTY + 1) << 16;
+    for( uint32_t s = 0; s < count; s++ ) {
+        uint32_t step = _rainbow_pos >> 16;
+        const struct fades *f = &_fades[step / (MAX_DUTY + 1)];
+        uint16_t duty[3] = { 0, 0, 0 };
+        duty[_rainbow_slot[f->from]] = pwm_brightness_ticks(f->from, MAX_DUTY - step % (MAX_DUTY + 1));
+        duty[_rainbow_slot[f->to]] = pwm_brightness_ticks(f->to, step % (MAX_DUTY + 1));
+        for( int c = 0; c < 3; c++ ) {
+            steps[s * 3 + c] = pwm_cv(_waves[timer].first + c, duty[c]);
+        }
+        _rainbow_pos += inc;
+        if( _rainbow_pos >= end ) _rainbow_pos -= end;
+    }
+}
+
+// Start playing the rainbow from where it was, returns 0 if the colors don't allow it
+int rainbow_wave_start() {
+    const enum Color colors[] = { Red, Green, Blue };
+    enum Timers timer[ARRAY_SIZE(colors)];
+    enum Timer_Channels channel[ARRAY_SIZE(colors)];
+    uint32_t first = AnyChannel, last = 0;
+    for( int c = 0; c < ARRAY_SIZE(colors); c++ ) {
+        if( !wave_pin(colors[c], &timer[c], &channel[c]) || timer[c] != timer[0] ) return 0;
+        if( channel[c] < first ) first = channel[c];
+        if( channel[c] > last ) last = channel[c];
+    }
+    if( last - first != 2 ) return 0;
+
+    for( int c = 0; c < ARRAY_SIZE(colors); c++ ) {
+        _rainbow_slot[colors[c]] = channel[c] - first;
+    }
+    if( !wave_start(timer[0], first, 3, _rainbow_table, RAINBOW_STEPS, rainbow_refill) ) return 0;
+    _rainbow_timer = timer[0];
+    return 1;
+}
+
+// Hold the rainbow while duties are set via serial
+void pause_rainbow() {
+    _paused = 1;
+    if( _rainbow_timer != AnyTimer ) wave_stop(_rainbow_timer);
+}
+
+void resume_rainbow() {
+    _paused = 0;
+    if( _rainbow_timer != AnyTimer ) rainbow_wave_start();
+}
+
+
+/*
+Power: the work is a few register writes per event and sched_run() sleeps in between,
+so mostly the core clock decides the current. With -DWITH_LOW_POWER the bus clocks are divided
+as far as the pwm tick rate, Interrupt and Bam pin handlers, the led strip and the serial baud rate allow,
+see lib/clockplan. That happens before serial and timers take their settings from the clocks.
+Once everything runs, gpio banks without pins and the flash clock during sleep are switched off.
+*/
+
+#ifndef LOW_POWER_TICK_CYCLES
+#define LOW_POWER_TICK_CYCLES     172      // core cycles per tick for Interrupt and Bam pins without register
+#endif                                     // accesses, with them 200 at the default clocks, see PRESCALE
+#define LOW_POWER_TICK_APB1       4        // timer register accesses per tick: flags, clear, counter, direction
+#define LOW_POWER_INTERVAL_CYCLES 2000     // core cycles per interval for update handlers, refills and tasks
+#define LOW_POWER_STRIP_HZ        24000000 // timer clock for led strip bit timing, also keeps the encoder ahead
+#define LOW_POWER_BAUD_PPM        20000    // 2% baud rate error, the receiver samples mid bit
+
+#ifdef WITH_LOW_POWER
+const struct dividers {
+    uint32_t div;
+    uint32_t ahb;   // rcu config values, APB ones go up to 16
+    uint32_t apb1;
+    uint32_t apb2;
+} _cfg_dividers[] = {
+    { 1,   RCU_AHB_CKSYS_DIV1,   RCU_APB1_CKAHB_DIV1,  RCU_APB2_CKAHB_DIV1 },
+    { 2,   RCU_AHB_CKSYS_DIV2,   RCU_APB1_CKAHB_DIV2,  RCU_APB2_CKAHB_DIV2 },
+    { 4,   RCU_AHB_CKSYS_DIV4,   RCU_APB1_CKAHB_DIV4,  RCU_APB2_CKAHB_DIV4 },
+    { 8,   RCU_AHB_CKSYS_DIV8,   RCU_APB1_CKAHB_DIV8,  RCU_APB2_CKAHB_DIV8 },
+    { 16,  RCU_AHB_CKSYS_DIV16,  RCU_APB1_CKAHB_DIV16, RCU_APB2_CKAHB_DIV16 },
+    { 64,  RCU_AHB_CKSYS_DIV64,  0, 0 },
+    { 128, RCU_AHB_CKSYS_DIV128, 0, 0 },
+    { 256, RCU_AHB_CKSYS_DIV256, 0, 0 },
+    { 512, RCU_AHB_CKSYS_DIV512, 0, 0 },
+};
+
+struct clockplan _clock_plan; // ahb_div 0: clocks as SystemInit() left them
+
+const struct dividers *divider( uint32_t div ) {
+    for( int d = 0; d < ARRAY_SIZE(_cfg_dividers); d++ ) {
+        if( _cfg_dividers[d].div == div ) return &_cfg_dividers[d];
+    }
+    return &_cfg_dividers[0];
+}
+
+// Divide the bus clocks as far as the pwm allows and return the prescaler for the same tick rate
+// Needs the pin modes from allocate_pwm()
+uint16_t plan_clocks( uint16_t prescale, uint16_t ticks ) {
+    int interrupts = 0;
+    uint32_t banks = 0; // one gpio write per bank and tick
+    for( int p = 0; p < ARRAY_SIZE(_pwm_pins); p++ ) {
+        if( _pwm_pins[p].mode == Interrupt || _pwm_pins[p].mode == Bam ) {
+            interrupts = 1;
+            banks |= 1U << _cfg_pins[p].bank;
+        }
+    }
+    struct clockplan_needs n = {
+        .sys_hz          = rcu_clock_freq_get(CK_SYS),
+        .timer_hz        = pwm_timer_clock(),
+        .prescale        = prescale,
+        .ticks           = ticks,
+        .even            = (PWM_ALIGN != TIMER_COUNTER_EDGE) || BAM_TIMERS, // both count half ticks
+        .tick_cycles     = interrupts ? LOW_POWER_TICK_CYCLES : 0,
+        .tick_apb1       = interrupts ? LOW_POWER_TICK_APB1 : 0,
+        .tick_apb2       = __builtin_popcount(banks),
+        .interval_cycles = LOW_POWER_INTERVAL_CYCLES,
+        .min_timer_hz    = LED_STRIP_PIXELS ? LOW_POWER_STRIP_HZ : 0,
+        #ifdef WITH_SERIAL
+        .baud            = SERIAL_BAUD,
+        #endif
+        .baud_ppm        = LOW_POWER_BAUD_PPM };
+    if( !clockplan_select(&n, &_clock_plan) ) {
+        _clock_plan.ahb_div = 0;
+        return prescale;
+    }
+
+    // Slowing down only: with AHB divided first no APB clock exceeds its limit on the way
+    rcu_ahb_clock_config(divider(_clock_plan.ahb_div)->ahb);
+    rcu_apb1_clock_config(divider(_clock_plan.apb1_div)->apb1);
+    rcu_apb2_clock_config(divider(_clock_plan.apb2_div)->apb2);
+    SystemCoreClockUpdate();
+    return _clock_plan.prescale;
+}
+
+// Switch off clocks nothing needs: gpio banks without pins, serial, led strip or probe pins,
+// and the flash while the core sleeps, since dma only moves data from and to sram
+void gate_clocks() {
+    uint32_t banks = 0;
+    #ifdef WITH_SERIAL
+    banks |= 1U << BankA; // USART0 on A9, A10
+    #endif
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        banks |= 1U << _cfg_pins[p].bank;
+    }
+    for( int h = 0; h < ARRAY_SIZE(_cfg_timer_pins); h++ ) {
+        const struct timer_pins *hw = &_cfg_timer_pins[h];
+        if( hw->remap != 0 ) continue;
+        if( (LED_STRIP_PIXELS && hw->timer == LED_STRIP_TIMER && hw->channel == LED_STRIP_CHANNEL)
+            || (PROBE_ON && hw->timer == PROBE_TIMER) ) banks |= 1U << hw->bank;
+    }
+    for( int b = 0; b < ARRAY_SIZE(_cfg_gpio_banks); b++ ) {
+        if( !(banks & (1U << b)) ) rcu_periph_clock_disable(_cfg_gpio_banks[b].rcu);
+    }
+    rcu_periph_clock_sleep_disable(RCU_FMC_SLP);
+}
+#else
+#define plan_clocks(prescale, ticks) (prescale)
+#define gate_clocks()
+#endif
+
+uint64_t _active_mtime; // mtime and mcycle at the last active_permille()
+uint64_t _active_cycles;
+
+static inline uint64_t read_mcycle64() {
+    uint32_t hi, lo;
+    do {
+        hi = read_csr(mcycleh);
+        lo = read_csr(mcycle);
+    } while( hi != read_csr(mcycleh) );
+    return (uint64_t)hi << 32 | lo;
+}
+
+// Estimated share of core cycles not spent sleeping since the last call, per mille:
+// mcycle stops while wfi gates the core clock, mtime counts core clock / 4 all the time
+uint32_t active_permille() {
+    mcycle_enable();
+    uint64_t mtime = get_timer_value();
+    uint64_t cycles = read_mcycle64();
+    uint64_t total = (mtime - _active_mtime) * 4;
+    uint64_t active = cycles - _active_cycles;
+    _active_mtime = mtime;
+    _active_cycles = cycles;
+    if( total == 0 ) return 0;
+    return (active >= total) ? 1000 : active * 1000 / total;
+}
+
+
+#ifdef WITH_SERIAL
+
+/*
+Serial commands to play with the pwm while the rainbow is running.
+Complete lines are polled from the main loop, nothing here waits for input.
+*/
+
+// Byte output for binary frames
+void put_serial( uint8_t ch ) {
+    usart_put_char(USART0, ch);
+}
+
+// Binary isrstat frames of used handlers, decode with tools/isrstat_decode.py
+void send_isr_stats() {
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( !timer_used(t) ) continue;
+        ISRSTAT_SEND(ISR_TIMER(t), put_serial);
+        if( (t == DMA_PWM_TIMER && DMA_TIMERS) || (_wave_timers & (1U << t)) ) ISRSTAT_SEND(ISR_DMA(t), put_serial);
+    }
+}
+
+/*
+Live duties streamed from a host (tools/stream_send.py), see lib/stream for the framing.
+Payload: sequence number, first pin, then 16 bit levels (little endian) for pins from there.
+poll_serial() drains the receive dma often enough for SERIAL_BAUD and feeds the parser,
+text between frames goes to the command lines. take_stream_frame() applies the newest
+frame at the frame rate, so frames appear at pwm update boundaries as one pwm frame.
+*/
+
+#define SERIAL_POLL_US 1000 // 1024 bytes receive buffer last 5ms at 2 MBaud
+#define STREAM_FPS       60 // default frame rate, can be changed via serial
+
+struct stream _stream;
+uint32_t _stream_fps = STREAM_FPS;
+
+// Pass text between frames to the command lines
+void stream_text( char ch ) {
+    usart_rx_add(ch);
+}
+
+// Scheduler task: parse what the dma received
+void poll_serial( struct sched_task *task ) {
+    const uint8_t *data;
+    uint32_t count;
+    while( (count = usart_rx_dma_peek(&data)) ) {
+        stream_feed(&_stream, data, count);
+        usart_rx_dma_consume(count);
+    }
+}
+
+// Scheduler task: apply newest frame, once per frame period
+void take_stream_frame( struct sched_task *task ) {
+    task->period = sched_ticks(1000000 / _stream_fps); // rate may have changed
+    uint32_t length;
+    const uint8_t *frame = stream_frame(&_stream, &length);
+    if( !frame || length < 2 ) return;
+
+    if( !_paused ) pause_rainbow();
+    uint32_t pin = frame[1];
+    pwm_frame_begin();
+    for( uint32_t i = 2; i + 1 < length && pin < ARRAY_SIZE(_cfg_pins); i += 2, pin++ ) {
+        set_pwm_duty16(pin, frame[i] | (frame[i + 1] << 8));
+    }
+    pwm_frame_commit();
+}
+
+struct sched_task _serial_task = { poll_serial };
+struct sched_task _stream_task = { take_stream_frame };
+
+// Start receiving commands and frames
+void init_stream() {
+    stream_init(&_stream, stream_text);
+    sched_add(&_serial_task, 0, SERIAL_POLL_US);
+    sched_add(&_stream_task, 0, 1000000 / _stream_fps);
+}
+
+// duty <pin> <duty>: set duty of a pin (index into _cfg_pins[]) and pause fading
+int cmd_duty( int argc, char *argv[] ) {
+    uint32_t pin, duty;
+    if( !cmdline_uint(argv[1], &pin) || pin >= ARRAY_SIZE(_cfg_pins) ) return 1;
+    if( !cmdline_uint(argv[2], &duty) || duty > MAX_DUTY ) return 1;
+    pause_rainbow();
+    set_pwm_duty(pin, duty);
+    return 0;
+}
+
+// level <pin> <level>: set 16 bit duty of a pin (0..65535) and pause fading
+int cmd_level( int argc, char *argv[] ) {
+    uint32_t pin, level;
+    if( !cmdline_uint(argv[1], &pin) || pin >= ARRAY_SIZE(_cfg_pins) ) return 1;
+    if( !cmdline_uint(argv[2], &level) || level > 65535 ) return 1;
+    pause_rainbow();
+    set_pwm_duty16(pin, level);
+    return 0;
+}
+
+// speed <us>: time per fade step, also resumes fading
+int cmd_speed( int argc, char *argv[] ) {
+    uint32_t us;
+    if( !cmdline_uint(argv[1], &us) || us == 0 ) return 1;
+    _duty_us = us;
+    resume_rainbow();
+    return 0;
+}
+
+// fps <rate>: frames per second taken from the stream
+int cmd_fps( int argc, char *argv[] ) {
+    uint32_t fps;
+    if( !cmdline_uint(argv[1], &fps) || fps == 0 || fps > 1000 ) return 1;
+    _stream_fps = fps;
+    return 0;
+}
+
+// baud <rate>: serial baud rate, the reply already uses the new rate
+int cmd_baud( int argc, char *argv[] ) {
+    uint32_t baud;
+    if( !cmdline_uint(argv[1], &baud) ) return 1;
+    if( !usart_baud(USART0, baud) ) {
+        DEBUG_OUT("max %lu baud\n\r", usart_max_baud(USART0));
+        return 1;
+    }
+    DEBUG_OUT("%lu baud\n\r", baud);
+    return 0;
+}
+
+// Retime the pwm, a playing rainbow restarts with compare values for the new timing
+int retime( uint16_t prescale, uint16_t ticks ) {
+    int playing = (_rainbow_timer != AnyTimer && !_paused);
+    if( playing ) wave_stop(_rainbow_timer);
+    int ok = pwm_retime(prescale, ticks);
+    if( playing ) rainbow_wave_start();
+    if( ok ) init_probe(); // capture counter fits the new interval
+    if( ok ) DEBUG_OUT("pwm interval %lu us, %lu ticks of %lu timer clocks\n\r", _pwm_interval_us, (uint32_t)_pwm_ticks, (uint32_t)_pwm_prescale);
+    return ok;
+}
+
+// retime <prescale> <ticks>: timer clocks per pwm tick and ticks per interval
+int cmd_retime( int argc, char *argv[] ) {
+    uint32_t prescale, ticks;
+    if( !cmdline_uint(argv[1], &prescale) || prescale > 65535 ) return 1;
+    if( !cmdline_uint(argv[2], &ticks) || ticks > 65535 ) return 1;
+    return !retime(prescale, ticks);
+}
+
+// tune <per mille>: measure the interrupt load for 100ms and switch to the
+// highest pwm frequency that keeps it within the budget, same ticks per interval
+int cmd_tune( int argc, char *argv[] ) {
+    uint32_t budget;
+    if( !cmdline_uint(argv[1], &budget) || budget == 0 || budget > 1000 ) return 1;
+
+    struct pwmtune_sample sample;
+    uint32_t calls = _h;
+    pwmtune_measure(&sample, SystemCoreClock / 10);
+    calls = _h - calls;
+
+    struct pwmtune_limits limits = {
+        .prescale = _pwm_prescale,
+        .core_hz = SystemCoreClock,
+        .timer_hz = pwm_timer_clock(),
+        .min_prescale = 2,
+        .max_prescale = 65535,
+        .even = (PWM_ALIGN != TIMER_COUNTER_EDGE),
+        .budget = budget };
+    uint32_t prescale = pwmtune_select(&sample, &limits);
+    DEBUG_OUT("prescale %lu: load %lu permille, %lu interrupts (%lu pwm), longest %lu cycles\n\r",
+        (uint32_t)_pwm_prescale, pwmtune_load(&sample, _pwm_prescale, _pwm_prescale), sample.gaps, calls, sample.max);
+    if( prescale == 0 ) {
+        DEBUG_OUT("no prescale fits %lu permille\n\r", budget);
+        return 1;
+    }
+    DEBUG_OUT("prescale %lu: load %lu permille expected\n\r", prescale, pwmtune_load(&sample, _pwm_prescale, prescale));
+
+    return !retime(prescale, _pwm_ticks);
+}
+
+#ifdef WITH_PROBE
+// probe <ms>: report the measured pin outputs every ms, 0 stops reporting
+int cmd_probe( int argc, char *argv[] ) {
+    uint32_t ms;
+    if( !cmdline_uint(argv[1], &ms) || ms > 3600000 ) return 1;
+    _probe_report_ms = ms;
+    if( ms ) sched_add(&_probe_report_task, ms * 1000, ms * 1000);
+    else sched_remove(&_probe_report_task);
+    return 0;
+}
+#endif
+
+// stats: dump interrupt and serial counters
+int cmd_stats( int argc, char *argv[] ) {
+    mcycle_enable();
+    uint32_t start = read_csr(mcycle);
+    DEBUG_OUT("handler/update/channel/missed: %lu/%lu/%lu/%lu\n\r", _h, _u, _c, _g);
+    uint32_t cycles = read_csr(mcycle) - start; // cost of a debug output call, printf() or tokenized
+    send_isr_stats();
+    DEBUG_OUT("serial tx dropped/rx overruns: %lu/%lu\n\r", usart_tx_dropped(), usart_rx_overruns());
+    DEBUG_OUT("stream frames/crc/length/dropped/underruns: %lu/%lu/%lu/%lu/%lu\n\r", _stream.frames,
+        _stream.crc_errors, _stream.length_errors, _stream.dropped, _stream.underruns);
+    DEBUG_OUT("fade step %lu us%s, max late %lu ticks, overruns %lu\n\r",
+        _duty_us, _paused ? ", paused" : "", sched_max_late(), sched_overruns());
+    DEBUG_OUT("debug output call %lu cycles, max simultaneous pwm edges %lu\n\r", cycles, pwm_edge_peak());
+    DEBUG_OUT("core %lu Hz, active %lu permille since last stats (estimated)\n\r", SystemCoreClock, active_permille());
+    #if LED_STRIP_PIXELS
+    DEBUG_OUT("led strip frames %lu\n\r", _strip.frames);
     #endif
-    init_pwm(PRESCALE, MAX_DUTY);
+    return 0;
+}
+
+const struct cmdline_commands _commands[] = {
+    { "duty",  2, cmd_duty },
+    { "level", 2, cmd_level },
+    { "speed", 1, cmd_speed },
+    { "fps",   1, cmd_fps },
+    { "baud",  1, cmd_baud },
+    { "retime", 2, cmd_retime },
+    { "tune",  1, cmd_tune },
+#ifdef WITH_PROBE
+    { "probe", 1, cmd_probe },
+#endif
+    { "stats", 0, cmd_stats }
+};
+
+// Execute a received command line if there is one
+void poll_commands() {
+    char *line = usart_rx_line();
+    if( line ) {
+        enum cmdline_result rc = cmdline_run(line, _commands, ARRAY_SIZE(_commands));
+        usart_rx_line_done();
+        if( rc == CMDLINE_UNKNOWN ) DEBUG_OUT("commands: duty <pin> <duty>, level <pin> <level>, speed <us>, fps <rate>, baud <rate>, retime <prescale> <ticks>, tune <permille>, %sstats\n\r", PROBE_ON ? "probe <ms>, " : "");
+        if( rc == CMDLINE_USAGE ) DEBUG_OUT("invalid arguments\n\r");
+    }
+}
+
+// Send queued tokenized debug output, decode with tools/tlog_decode.py
+#ifdef WITH_TLOG
+void poll_log() {
+    tlog_flush(put_serial);
+}
+#else
+#define poll_log()
+#endif
+
+#else
+#define poll_commands()
+#define poll_log()
+#define send_isr_stats()
+#define init_stream()
+#endif
+
+
+
+// Gradualy adjust pwm duty to make LED darker or brighter
+// Scheduler task: one step of the fade animation per call, every _duty_us
+void fade( struct sched_task *task ) {
+    task->period = sched_ticks(_duty_us); // speed may have changed
+    if( _paused ) return;
+
+    uint16_t rgb[3];
+    uint32_t key = _fade_layer.key;
+    anim_frame(&_fade_layer, 1, 1, rgb, ARRAY_SIZE(rgb));
+    pwm_frame_begin(); // all colors change in the same pwm interval
+    set_pwm_duty(Red, ((uint32_t)rgb[0] * MAX_DUTY + 32768) >> 16); // perceived brightness
+    set_pwm_duty(Green, ((uint32_t)rgb[1] * MAX_DUTY + 32768) >> 16);
+    set_pwm_duty(Blue, ((uint32_t)rgb[2] * MAX_DUTY + 32768) >> 16);
+    pwm_frame_commit();
+
+    if( _fade_layer.key != key ) { // 5s per fade
+        DEBUG_OUT("fade %s\n\r", _fades[_fade_layer.key].name);
+        if( _fade_layer.key == 0 ) {
+            DEBUG_OUT("handler/update/channel/missed: %lu/%lu/%lu/%lu\n\r", _h, _u, _c, _g);
+            send_isr_stats();
+        }
+    }
+}
+
+struct sched_task _fade_task = { fade };
+
+
+#if LED_STRIP_PIXELS
+#define STRIP_FPS 30
+
+uint32_t _strip_hue = 0; // hue of the first pixel, 0..767
+
+// Draw a rainbow moving along the strip into the back buffer and show it
+// Scheduler task: if the last frame is still being sent, try again next time
+void strip_chase( struct sched_task *task ) {
+    uint8_t *pixel = ws2812_back(&_strip);
+    for( uint32_t i = 0; i < LED_STRIP_PIXELS; i++, pixel += LED_STRIP_COLORS ) {
+        uint32_t hue = (_strip_hue + i * 768 / LED_STRIP_PIXELS) % 768;
+        uint32_t rise = hue % 256;
+        uint8_t rgb[3] = { 0, 0, 0 };
+        rgb[hue / 256] = 255 - rise;           // red -> green -> blue -> red
+        rgb[(hue / 256 + 1) % 3] = rise;
+        pixel[0] = rgb[1] / 8;                 // wire order g r b, dimmed for usb power
+        pixel[1] = rgb[0] / 8;
+        pixel[2] = rgb[2] / 8;
+        if( LED_STRIP_COLORS > 3 ) pixel[3] = 0;
+    }
+    if( ws2812_show(&_strip) ) _strip_hue = (_strip_hue + 4) % 768;
+}
+
+struct sched_task _strip_task = { strip_chase };
+#endif
+
+
+// Putting it all together: 
+// * Start program saying hello on serial
+// * Setup the pwm signal
+// * Start playing or fading between colors to cycle through the rainbow
+// * Sleep between fade steps and serial commands
+int main() {
+    preinit_pwm(); // reset interrupt and gpio state paranoia
+    ISRSTAT_INIT();
+    uint16_t prescale = plan_clocks(PRESCALE, MAX_DUTY); // before serial and timers derive their settings
+    #ifdef WITH_SERIAL
+    init_usart0();
+    #endif
+    #ifdef WITH_LOW_POWER
+    DEBUG_OUT("core %lu Hz, apb1 %lu Hz, apb2 %lu Hz, baud error %lu ppm\n\r", SystemCoreClock,
+        rcu_clock_freq_get(CK_APB1), rcu_clock_freq_get(CK_APB2), _clock_plan.ahb_div ? _clock_plan.baud_ppm : 0);
+    #endif
+    init_pwm(prescale, MAX_DUTY);
     DEBUG_OUT("init done\n\r");
 
+    sched_init();
+    eclic_global_interrupt_enable(); // timer compare interrupt wakes us up
+    init_stream();
+    init_strip();
+    start_probe();
+    gate_clocks();
+    #if LED_STRIP_PIXELS
+    sched_add(&_strip_task, 0, 1000000 / STRIP_FPS);
+    #endif
+    if( rainbow_wave_start() ) {
+        DEBUG_OUT("rainbow played by dma on timer%d\n\r", _rainbow_timer);
+    }
+    else {
+        anim_start(&_fade_layer);
+        DEBUG_OUT("fade %s\n\r", _fades[0].name);
+        sched_add(&_fade_task, 0, _duty_us);
+    }
+
     while( 1 ) {
-        DEBUG_OUT("fade r->b\n\r");
-        fade(Red, Blue, DUTY_US);
-        DEBUG_OUT("fade b->g\n\r");
-        fade(Blue, Green, DUTY_US);
-        DEBUG_OUT("fade g->r\n\r");
-        fade(Green, Red, DUTY_US);
-        DEBUG_OUT("handler/update/channel/overflow: %lu/%lu/%lu/%lu\n\r", _h, _u, _c, _g);
+        poll_commands();
+        poll_log();
+        sched_run(); // returns after due steps are done and something woke us up
     }
 }
@@ -0,0 +1,96 @@
+#ifndef GD32VF103_H
+#define GD32VF103_H
+
+#include <stdint.h>
+
+/*
+Host stand-in for the gd32vf103 sdk headers, used by the native env (see test/mock/mock.c).
+Register addresses, offsets and bits are the ones of the chip. Nothing is mapped there:
+the program accesses registers with reg_load() and reg_store() of lib/fastreg, which call
+the mock here, and sdk functions, which the mock implements.
+Only what this project uses is declared.
+*/
+
+typedef enum { RESET = 0, SET = !RESET } FlagStatus;
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } ControlStatus;
+typedef enum { ERROR = 0, SUCCESS = !ERROR } ErrStatus;
+typedef FlagStatus bit_status;
+
+// Register macros only give addresses to reg_load() and reg_store(), a direct access crashes
+#define REG32(addr) (*(volatile uint32_t *)(uintptr_t)(addr))
+#define REG16(addr) (*(volatile uint16_t *)(uintptr_t)(addr))
+#define REG8(addr)  (*(volatile uint8_t *)(uintptr_t)(addr))
+#define BIT(x)      ((uint32_t)((uint32_t)0x01U << (x)))
+#define BITS(start, end) ((0xFFFFFFFFUL << (start)) & (0xFFFFFFFFUL >> (31U - (uint32_t)(end))))
+#define GET_BITS(regval, start, end) (((regval) & BITS((start), (end))) >> (start))
+
+#define APB1_BUS_BASE ((uint32_t)0x40000000U)
+#define APB2_BUS_BASE ((uint32_t)0x40010000U)
+#define AHB1_BUS_BASE ((uint32_t)0x40018000U)
+
+#define TIMER_BASE (APB1_BUS_BASE + 0x00000000U)
+#define USART_BASE (APB1_BUS_BASE + 0x00004400U)
+#define AFIO_BASE  (APB2_BUS_BASE + 0x00000000U)
+#define GPIO_BASE  (APB2_BUS_BASE + 0x00000800U)
+#define DMA_BASE   (AHB1_BUS_BASE + 0x00008000U)
+#define RCU_BASE   (AHB1_BUS_BASE + 0x00009000U)
+
+typedef enum IRQn {
+    CLIC_INT_RESERVED      = 0,
+    CLIC_INT_SFT           = 3,
+    CLIC_INT_TMR           = 7,
+    CLIC_INT_BWEI          = 17,
+    CLIC_INT_PMOVI         = 18,
+    WWDGT_IRQn             = 19,
+    DMA0_Channel0_IRQn     = 30,
+    DMA0_Channel1_IRQn     = 31,
+    DMA0_Channel2_IRQn     = 32,
+    DMA0_Channel3_IRQn     = 33,
+    DMA0_Channel4_IRQn     = 34,
+    DMA0_Channel5_IRQn     = 35,
+    DMA0_Channel6_IRQn     = 36,
+    TIMER0_BRK_IRQn        = 43,
+    TIMER0_UP_IRQn         = 44,
+    TIMER0_TRG_CMT_IRQn    = 45,
+    TIMER0_Channel_IRQn    = 46,
+    TIMER1_IRQn            = 47,
+    TIMER2_IRQn            = 48,
+    TIMER3_IRQn            = 49,
+    USART0_IRQn            = 56,
+    USART1_IRQn            = 57,
+    USART2_IRQn            = 58,
+    TIMER4_IRQn            = 69,
+    DMA1_Channel0_IRQn     = 75,
+    DMA1_Channel1_IRQn     = 76,
+    DMA1_Channel2_IRQn     = 77,
+    DMA1_Channel3_IRQn     = 78,
+    DMA1_Channel4_IRQn     = 79,
+    ECLIC_NUM_INTERRUPTS
+} IRQn_Type;
+
+extern uint32_t SystemCoreClock;
+void SystemCoreClockUpdate(void);
+
+// Register accesses of lib/fastreg
+#define MOCK_REGS
+uint32_t mock_load(volatile uint32_t *reg);
+void mock_store(volatile uint32_t *reg, uint32_t value);
+
+// wfi of lib/scheduler, the mock sleeps until an interrupt is pending
+void mock_wfi(void);
+#define SCHED_SLEEP() mock_wfi()
+
+// Handlers of src/main.c with WITH_RAM_ISR: the host has no riscv interrupt attribute and no sram
+// to copy code to. Their own section stands for sram, instructions there pay no flash wait states,
+// and vectored entry is charged less (see mock.h)
+#define RAM_ISR __attribute__((section("mock_sram")))
+
+#include "n200_func.h"
+#include "riscv_encoding.h"
+#include "gd32vf103_rcu.h"
+#include "gd32vf103_gpio.h"
+#include "gd32vf103_timer.h"
+#include "gd32vf103_dma.h"
+#include "gd32vf103_usart.h"
+
+#endif
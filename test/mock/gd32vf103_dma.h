@@ -0,0 +1,96 @@
+#ifndef GD32VF103_DMA_H
+#define GD32VF103_DMA_H
+
+#include "gd32vf103.h"
+
+#define DMA0 (DMA_BASE)
+#define DMA1 (DMA_BASE + 0x0400U)
+
+#define DMA_INTF(dmax)          REG32((dmax) + 0x00U)
+#define DMA_INTC(dmax)          REG32((dmax) + 0x04U)
+#define DMA_CHCTL(dmax, chx)    REG32((dmax) + 0x08U + 0x14U * (uint32_t)(chx))
+#define DMA_CHCNT(dmax, chx)    REG32((dmax) + 0x0CU + 0x14U * (uint32_t)(chx))
+#define DMA_CHPADDR(dmax, chx)  REG32((dmax) + 0x10U + 0x14U * (uint32_t)(chx))
+#define DMA_CHMADDR(dmax, chx)  REG32((dmax) + 0x14U + 0x14U * (uint32_t)(chx))
+
+#define DMA_CHXCTL_CHEN   BIT(0)
+#define DMA_CHXCTL_FTFIE  BIT(1)
+#define DMA_CHXCTL_HTFIE  BIT(2)
+#define DMA_CHXCTL_ERRIE  BIT(3)
+#define DMA_CHXCTL_DIR    BIT(4)
+#define DMA_CHXCTL_CMEN   BIT(5)
+#define DMA_CHXCTL_PNAGA  BIT(6)
+#define DMA_CHXCTL_MNAGA  BIT(7)
+#define DMA_CHXCTL_PWIDTH BITS(8, 9)
+#define DMA_CHXCTL_MWIDTH BITS(10, 11)
+#define DMA_CHXCTL_PRIO   BITS(12, 13)
+#define DMA_CHXCTL_M2M    BIT(14)
+
+typedef enum { DMA_CH0 = 0, DMA_CH1, DMA_CH2, DMA_CH3, DMA_CH4, DMA_CH5, DMA_CH6 } dma_channel_enum;
+
+typedef struct {
+    uint32_t periph_addr;
+    uint32_t periph_width;
+    uint32_t memory_addr;
+    uint32_t memory_width;
+    uint32_t number;
+    uint32_t priority;
+    uint8_t  periph_inc;
+    uint8_t  memory_inc;
+    uint8_t  direction;
+} dma_parameter_struct;
+
+// Flags of a channel in INTF/INTC, 4 bits per channel
+#define DMA_FLAG_ADD(flag, shift) ((flag) << ((shift) * 4U))
+#define DMA_FLAG_G   BIT(0)
+#define DMA_FLAG_FTF BIT(1)
+#define DMA_FLAG_HTF BIT(2)
+#define DMA_FLAG_ERR BIT(3)
+#define DMA_INT_FLAG_G   DMA_FLAG_G
+#define DMA_INT_FLAG_FTF DMA_FLAG_FTF
+#define DMA_INT_FLAG_HTF DMA_FLAG_HTF
+#define DMA_INT_FLAG_ERR DMA_FLAG_ERR
+
+#define DMA_INT_FTF DMA_CHXCTL_FTFIE
+#define DMA_INT_HTF DMA_CHXCTL_HTFIE
+#define DMA_INT_ERR DMA_CHXCTL_ERRIE
+
+#define DMA_PERIPHERAL_WIDTH_8BIT  (0U << 8)
+#define DMA_PERIPHERAL_WIDTH_16BIT (1U << 8)
+#define DMA_PERIPHERAL_WIDTH_32BIT (2U << 8)
+#define DMA_MEMORY_WIDTH_8BIT      (0U << 10)
+#define DMA_MEMORY_WIDTH_16BIT     (1U << 10)
+#define DMA_MEMORY_WIDTH_32BIT     (2U << 10)
+#define DMA_PRIORITY_LOW           (0U << 12)
+#define DMA_PRIORITY_MEDIUM        (1U << 12)
+#define DMA_PRIORITY_HIGH          (2U << 12)
+#define DMA_PRIORITY_ULTRA_HIGH    (3U << 12)
+
+// Like the sdk: 0 enables address increase
+#define DMA_PERIPH_INCREASE_ENABLE  ((uint8_t)0x00U)
+#define DMA_PERIPH_INCREASE_DISABLE ((uint8_t)0x01U)
+#define DMA_MEMORY_INCREASE_ENABLE  ((uint8_t)0x00U)
+#define DMA_MEMORY_INCREASE_DISABLE ((uint8_t)0x01U)
+#define DMA_PERIPHERAL_TO_MEMORY    ((uint8_t)0x00U)
+#define DMA_MEMORY_TO_PERIPHERAL    ((uint8_t)0x01U)
+
+void dma_deinit(uint32_t dma_periph, dma_channel_enum channelx);
+void dma_struct_para_init(dma_parameter_struct *init_struct);
+void dma_init(uint32_t dma_periph, dma_channel_enum channelx, dma_parameter_struct *init_struct);
+void dma_circulation_enable(uint32_t dma_periph, dma_channel_enum channelx);
+void dma_circulation_disable(uint32_t dma_periph, dma_channel_enum channelx);
+void dma_memory_to_memory_disable(uint32_t dma_periph, dma_channel_enum channelx);
+void dma_channel_enable(uint32_t dma_periph, dma_channel_enum channelx);
+void dma_channel_disable(uint32_t dma_periph, dma_channel_enum channelx);
+void dma_periph_address_config(uint32_t dma_periph, dma_channel_enum channelx, uint32_t address);
+void dma_memory_address_config(uint32_t dma_periph, dma_channel_enum channelx, uint32_t address);
+void dma_transfer_number_config(uint32_t dma_periph, dma_channel_enum channelx, uint32_t number);
+uint32_t dma_transfer_number_get(uint32_t dma_periph, dma_channel_enum channelx);
+FlagStatus dma_flag_get(uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag);
+void dma_flag_clear(uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag);
+FlagStatus dma_interrupt_flag_get(uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag);
+void dma_interrupt_flag_clear(uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag);
+void dma_interrupt_enable(uint32_t dma_periph, dma_channel_enum channelx, uint32_t source);
+void dma_interrupt_disable(uint32_t dma_periph, dma_channel_enum channelx, uint32_t source);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef GD32VF103_GPIO_H
+#define GD32VF103_GPIO_H
+
+#include "gd32vf103.h"
+
+#define GPIOA (GPIO_BASE + 0x00000000U)
+#define GPIOB (GPIO_BASE + 0x00000400U)
+#define GPIOC (GPIO_BASE + 0x00000800U)
+#define GPIOD (GPIO_BASE + 0x00000C00U)
+#define GPIOE (GPIO_BASE + 0x00001000U)
+#define AFIO  AFIO_BASE
+
+#define GPIO_CTL0(gpiox)  REG32((gpiox) + 0x00U)
+#define GPIO_CTL1(gpiox)  REG32((gpiox) + 0x04U)
+#define GPIO_ISTAT(gpiox) REG32((gpiox) + 0x08U)
+#define GPIO_OCTL(gpiox)  REG32((gpiox) + 0x0CU)
+#define GPIO_BOP(gpiox)   REG32((gpiox) + 0x10U)
+#define GPIO_BC(gpiox)    REG32((gpiox) + 0x14U)
+#define GPIO_LOCK(gpiox)  REG32((gpiox) + 0x18U)
+
+#define AFIO_EC   REG32(AFIO + 0x00U)
+#define AFIO_PCF0 REG32(AFIO + 0x04U)
+
+#define GPIO_PIN_0   BIT(0)
+#define GPIO_PIN_1   BIT(1)
+#define GPIO_PIN_2   BIT(2)
+#define GPIO_PIN_3   BIT(3)
+#define GPIO_PIN_4   BIT(4)
+#define GPIO_PIN_5   BIT(5)
+#define GPIO_PIN_6   BIT(6)
+#define GPIO_PIN_7   BIT(7)
+#define GPIO_PIN_8   BIT(8)
+#define GPIO_PIN_9   BIT(9)
+#define GPIO_PIN_10  BIT(10)
+#define GPIO_PIN_11  BIT(11)
+#define GPIO_PIN_12  BIT(12)
+#define GPIO_PIN_13  BIT(13)
+#define GPIO_PIN_14  BIT(14)
+#define GPIO_PIN_15  BIT(15)
+#define GPIO_PIN_ALL BITS(0, 15)
+
+// Mode nibble of a pin in CTL0/CTL1 is mode & 0xf, with the speed for outputs
+#define GPIO_MODE_AIN         ((uint8_t)0x00U)
+#define GPIO_MODE_IN_FLOATING ((uint8_t)0x04U)
+#define GPIO_MODE_IPD         ((uint8_t)0x28U)
+#define GPIO_MODE_IPU         ((uint8_t)0x48U)
+#define GPIO_MODE_OUT_OD      ((uint8_t)0x14U)
+#define GPIO_MODE_OUT_PP      ((uint8_t)0x10U)
+#define GPIO_MODE_AF_OD       ((uint8_t)0x1CU)
+#define GPIO_MODE_AF_PP       ((uint8_t)0x18U)
+
+#define GPIO_OSPEED_10MHZ ((uint8_t)0x01U)
+#define GPIO_OSPEED_2MHZ  ((uint8_t)0x02U)
+#define GPIO_OSPEED_50MHZ ((uint8_t)0x03U)
+
+// Remaps: bits 0-15 value in AFIO_PCF0, bit 20 set for a 2 bit field at the position in bits 16-19
+#define GPIO_USART0_REMAP          ((uint32_t)0x00000004U)
+#define GPIO_TIMER0_PARTIAL_REMAP  ((uint32_t)0x00160040U)
+#define GPIO_TIMER0_FULL_REMAP     ((uint32_t)0x001600C0U)
+#define GPIO_TIMER1_PARTIAL_REMAP0 ((uint32_t)0x00180100U)
+#define GPIO_TIMER1_PARTIAL_REMAP1 ((uint32_t)0x00180200U)
+#define GPIO_TIMER1_FULL_REMAP     ((uint32_t)0x00180300U)
+#define GPIO_TIMER2_PARTIAL_REMAP  ((uint32_t)0x001A0800U)
+#define GPIO_TIMER2_FULL_REMAP     ((uint32_t)0x001A0C00U)
+#define GPIO_TIMER3_REMAP          ((uint32_t)0x00001000U)
+#define GPIO_SWJ_NONJTRST_REMAP    ((uint32_t)0x00300100U)
+#define GPIO_SWJ_SWDPENABLE_REMAP  ((uint32_t)0x00300200U)
+#define GPIO_SWJ_DISABLE_REMAP     ((uint32_t)0x00300400U)
+
+void gpio_deinit(uint32_t gpio_periph);
+void gpio_init(uint32_t gpio_periph, uint32_t mode, uint32_t speed, uint32_t pin);
+void gpio_bit_set(uint32_t gpio_periph, uint32_t pin);
+void gpio_bit_reset(uint32_t gpio_periph, uint32_t pin);
+FlagStatus gpio_input_bit_get(uint32_t gpio_periph, uint32_t pin);
+FlagStatus gpio_output_bit_get(uint32_t gpio_periph, uint32_t pin);
+void gpio_pin_remap_config(uint32_t remap, ControlStatus newvalue);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef GD32VF103_RCU_H
+#define GD32VF103_RCU_H
+
+#include "gd32vf103.h"
+
+#define RCU RCU_BASE
+
+#define RCU_CTL    REG32(RCU + 0x00U)
+#define RCU_CFG0   REG32(RCU + 0x04U)
+#define RCU_INT    REG32(RCU + 0x08U)
+#define RCU_APB2RST REG32(RCU + 0x0CU)
+#define RCU_APB1RST REG32(RCU + 0x10U)
+#define RCU_AHBEN  REG32(RCU + 0x14U)
+#define RCU_APB2EN REG32(RCU + 0x18U)
+#define RCU_APB1EN REG32(RCU + 0x1CU)
+
+#define RCU_CFG0_AHBPSC  BITS(4, 7)
+#define RCU_CFG0_APB1PSC BITS(8, 10)
+#define RCU_CFG0_APB2PSC BITS(11, 13)
+
+// Peripheral enable bits: register offset and bit, like the sdk
+#define RCU_REGIDX_BIT(regidx, bitpos) (((uint32_t)(regidx) << 6) | (uint32_t)(bitpos))
+#define RCU_REG_VAL(periph)            (REG32(RCU + ((uint32_t)(periph) >> 6)))
+#define RCU_BIT_POS(val)               ((uint32_t)(val) & 0x1FU)
+
+#define AHBEN_REG_OFFSET  0x14U
+#define APB2EN_REG_OFFSET 0x18U
+#define APB1EN_REG_OFFSET 0x1CU
+
+typedef enum {
+    RCU_DMA0   = RCU_REGIDX_BIT(AHBEN_REG_OFFSET, 0U),
+    RCU_DMA1   = RCU_REGIDX_BIT(AHBEN_REG_OFFSET, 1U),
+    RCU_CRC    = RCU_REGIDX_BIT(AHBEN_REG_OFFSET, 6U),
+    RCU_EXMC   = RCU_REGIDX_BIT(AHBEN_REG_OFFSET, 8U),
+    RCU_USBFS  = RCU_REGIDX_BIT(AHBEN_REG_OFFSET, 12U),
+    RCU_TIMER1 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 0U),
+    RCU_TIMER2 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 1U),
+    RCU_TIMER3 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 2U),
+    RCU_TIMER4 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 3U),
+    RCU_TIMER5 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 4U),
+    RCU_TIMER6 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 5U),
+    RCU_USART1 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 17U),
+    RCU_USART2 = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 18U),
+    RCU_PMU    = RCU_REGIDX_BIT(APB1EN_REG_OFFSET, 28U),
+    RCU_AF     = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 0U),
+    RCU_GPIOA  = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 2U),
+    RCU_GPIOB  = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 3U),
+    RCU_GPIOC  = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 4U),
+    RCU_GPIOD  = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 5U),
+    RCU_GPIOE  = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 6U),
+    RCU_TIMER0 = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 11U),
+    RCU_USART0 = RCU_REGIDX_BIT(APB2EN_REG_OFFSET, 14U)
+} rcu_periph_enum;
+
+typedef enum {
+    RCU_SRAM_SLP = RCU_REGIDX_BIT(AHBEN_REG_OFFSET, 2U),
+    RCU_FMC_SLP  = RCU_REGIDX_BIT(AHBEN_REG_OFFSET, 4U)
+} rcu_periph_sleep_enum;
+
+typedef enum { CK_SYS, CK_AHB, CK_APB1, CK_APB2 } rcu_clock_freq_enum;
+
+#define CFG0_AHBPSC(regval) (BITS(4, 7) & ((uint32_t)(regval) << 4))
+#define RCU_AHB_CKSYS_DIV1   CFG0_AHBPSC(0)
+#define RCU_AHB_CKSYS_DIV2   CFG0_AHBPSC(8)
+#define RCU_AHB_CKSYS_DIV4   CFG0_AHBPSC(9)
+#define RCU_AHB_CKSYS_DIV8   CFG0_AHBPSC(10)
+#define RCU_AHB_CKSYS_DIV16  CFG0_AHBPSC(11)
+#define RCU_AHB_CKSYS_DIV64  CFG0_AHBPSC(12)
+#define RCU_AHB_CKSYS_DIV128 CFG0_AHBPSC(13)
+#define RCU_AHB_CKSYS_DIV256 CFG0_AHBPSC(14)
+#define RCU_AHB_CKSYS_DIV512 CFG0_AHBPSC(15)
+
+#define CFG0_APB1PSC(regval) (BITS(8, 10) & ((uint32_t)(regval) << 8))
+#define RCU_APB1_CKAHB_DIV1  CFG0_APB1PSC(0)
+#define RCU_APB1_CKAHB_DIV2  CFG0_APB1PSC(4)
+#define RCU_APB1_CKAHB_DIV4  CFG0_APB1PSC(5)
+#define RCU_APB1_CKAHB_DIV8  CFG0_APB1PSC(6)
+#define RCU_APB1_CKAHB_DIV16 CFG0_APB1PSC(7)
+
+#define CFG0_APB2PSC(regval) (BITS(11, 13) & ((uint32_t)(regval) << 11))
+#define RCU_APB2_CKAHB_DIV1  CFG0_APB2PSC(0)
+#define RCU_APB2_CKAHB_DIV2  CFG0_APB2PSC(4)
+#define RCU_APB2_CKAHB_DIV4  CFG0_APB2PSC(5)
+#define RCU_APB2_CKAHB_DIV8  CFG0_APB2PSC(6)
+#define RCU_APB2_CKAHB_DIV16 CFG0_APB2PSC(7)
+
+void rcu_periph_clock_enable(rcu_periph_enum periph);
+void rcu_periph_clock_disable(rcu_periph_enum periph);
+void rcu_periph_clock_sleep_enable(rcu_periph_sleep_enum periph);
+void rcu_periph_clock_sleep_disable(rcu_periph_sleep_enum periph);
+void rcu_ahb_clock_config(uint32_t ck_ahb);
+void rcu_apb1_clock_config(uint32_t ck_apb1);
+void rcu_apb2_clock_config(uint32_t ck_apb2);
+uint32_t rcu_clock_freq_get(rcu_clock_freq_enum clock);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef GD32VF103_TIMER_H
+#define GD32VF103_TIMER_H
+
+#include "gd32vf103.h"
+
+#define TIMER0 (TIMER_BASE + 0x00012C00U)
+#define TIMER1 (TIMER_BASE + 0x00000000U)
+#define TIMER2 (TIMER_BASE + 0x00000400U)
+#define TIMER3 (TIMER_BASE + 0x00000800U)
+#define TIMER4 (TIMER_BASE + 0x00000C00U)
+#define TIMER5 (TIMER_BASE + 0x00001000U)
+#define TIMER6 (TIMER_BASE + 0x00001400U)
+
+#define TIMER_CTL0(timerx)     REG32((timerx) + 0x00U)
+#define TIMER_CTL1(timerx)     REG32((timerx) + 0x04U)
+#define TIMER_SMCFG(timerx)    REG32((timerx) + 0x08U)
+#define TIMER_DMAINTEN(timerx) REG32((timerx) + 0x0CU)
+#define TIMER_INTF(timerx)     REG32((timerx) + 0x10U)
+#define TIMER_SWEVG(timerx)    REG32((timerx) + 0x14U)
+#define TIMER_CHCTL0(timerx)   REG32((timerx) + 0x18U)
+#define TIMER_CHCTL1(timerx)   REG32((timerx) + 0x1CU)
+#define TIMER_CHCTL2(timerx)   REG32((timerx) + 0x20U)
+#define TIMER_CNT(timerx)      REG32((timerx) + 0x24U)
+#define TIMER_PSC(timerx)      REG32((timerx) + 0x28U)
+#define TIMER_CAR(timerx)      REG32((timerx) + 0x2CU)
+#define TIMER_CREP(timerx)     REG32((timerx) + 0x30U)
+#define TIMER_CH0CV(timerx)    REG32((timerx) + 0x34U)
+#define TIMER_CH1CV(timerx)    REG32((timerx) + 0x38U)
+#define TIMER_CH2CV(timerx)    REG32((timerx) + 0x3CU)
+#define TIMER_CH3CV(timerx)    REG32((timerx) + 0x40U)
+#define TIMER_CCHP(timerx)     REG32((timerx) + 0x44U)
+#define TIMER_DMACFG(timerx)   REG32((timerx) + 0x48U)
+#define TIMER_DMATB(timerx)    REG32((timerx) + 0x4CU)
+
+#define TIMER_CTL0_CEN   BIT(0)
+#define TIMER_CTL0_UPDIS BIT(1)
+#define TIMER_CTL0_UPS   BIT(2)
+#define TIMER_CTL0_SPM   BIT(3)
+#define TIMER_CTL0_DIR   BIT(4)
+#define TIMER_CTL0_CAM   BITS(5, 6)
+#define TIMER_CTL0_ARSE  BIT(7)
+#define TIMER_CTL0_CKDIV BITS(8, 9)
+
+#define TIMER_DMAINTEN_UPIE  BIT(0)
+#define TIMER_DMAINTEN_CH0IE BIT(1)
+#define TIMER_DMAINTEN_CH1IE BIT(2)
+#define TIMER_DMAINTEN_CH2IE BIT(3)
+#define TIMER_DMAINTEN_CH3IE BIT(4)
+#define TIMER_DMAINTEN_UPDEN BIT(8)
+#define TIMER_DMAINTEN_CH0DEN BIT(9)
+#define TIMER_DMAINTEN_CH1DEN BIT(10)
+#define TIMER_DMAINTEN_CH2DEN BIT(11)
+#define TIMER_DMAINTEN_CH3DEN BIT(12)
+
+#define TIMER_INTF_UPIF  BIT(0)
+#define TIMER_INTF_CH0IF BIT(1)
+#define TIMER_INTF_CH1IF BIT(2)
+#define TIMER_INTF_CH2IF BIT(3)
+#define TIMER_INTF_CH3IF BIT(4)
+#define TIMER_INTF_CH0OF BIT(9)
+#define TIMER_INTF_CH1OF BIT(10)
+#define TIMER_INTF_CH2OF BIT(11)
+#define TIMER_INTF_CH3OF BIT(12)
+
+#define TIMER_SWEVG_UPG BIT(0)
+
+#define TIMER_CHCTL2_CH0EN BIT(0)
+#define TIMER_CHCTL2_CH0P  BIT(1)
+#define TIMER_CCHP_POEN    BIT(15)
+
+#define TIMER_CH_0 ((uint16_t)0x0000U)
+#define TIMER_CH_1 ((uint16_t)0x0001U)
+#define TIMER_CH_2 ((uint16_t)0x0002U)
+#define TIMER_CH_3 ((uint16_t)0x0003U)
+
+#define TIMER_INT_UP  TIMER_DMAINTEN_UPIE
+#define TIMER_INT_CH0 TIMER_DMAINTEN_CH0IE
+#define TIMER_INT_CH1 TIMER_DMAINTEN_CH1IE
+#define TIMER_INT_CH2 TIMER_DMAINTEN_CH2IE
+#define TIMER_INT_CH3 TIMER_DMAINTEN_CH3IE
+
+#define TIMER_INT_FLAG_UP  TIMER_INTF_UPIF
+#define TIMER_INT_FLAG_CH0 TIMER_INTF_CH0IF
+#define TIMER_INT_FLAG_CH1 TIMER_INTF_CH1IF
+#define TIMER_INT_FLAG_CH2 TIMER_INTF_CH2IF
+#define TIMER_INT_FLAG_CH3 TIMER_INTF_CH3IF
+
+#define TIMER_FLAG_UP  TIMER_INTF_UPIF
+#define TIMER_FLAG_CH0 TIMER_INTF_CH0IF
+#define TIMER_FLAG_CH1 TIMER_INTF_CH1IF
+#define TIMER_FLAG_CH2 TIMER_INTF_CH2IF
+#define TIMER_FLAG_CH3 TIMER_INTF_CH3IF
+
+#define TIMER_DMA_UPD  ((uint16_t)TIMER_DMAINTEN_UPDEN)
+#define TIMER_DMA_CH0D ((uint16_t)TIMER_DMAINTEN_CH0DEN)
+#define TIMER_DMA_CH1D ((uint16_t)TIMER_DMAINTEN_CH1DEN)
+#define TIMER_DMA_CH2D ((uint16_t)TIMER_DMAINTEN_CH2DEN)
+#define TIMER_DMA_CH3D ((uint16_t)TIMER_DMAINTEN_CH3DEN)
+
+// Dma burst: first register (in words from CTL0) and number of transfers per request
+#define DMACFG_DMATA(regval) (BITS(0, 4) & ((uint32_t)(regval) << 0))
+#define DMACFG_DMATC(regval) (BITS(8, 12) & ((uint32_t)(regval) << 8))
+#define TIMER_DMACFG_DMATA_CH0CV    DMACFG_DMATA(13)
+#define TIMER_DMACFG_DMATC_1TRANSFER DMACFG_DMATC(0)
+#define TIMER_DMACFG_DMATC_2TRANSFER DMACFG_DMATC(1)
+#define TIMER_DMACFG_DMATC_3TRANSFER DMACFG_DMATC(2)
+#define TIMER_DMACFG_DMATC_4TRANSFER DMACFG_DMATC(3)
+
+#define CTL0_CAM(regval) ((uint16_t)(BITS(5, 6) & ((uint32_t)(regval) << 5)))
+#define TIMER_COUNTER_EDGE        CTL0_CAM(0)
+#define TIMER_COUNTER_CENTER_DOWN CTL0_CAM(1)
+#define TIMER_COUNTER_CENTER_UP   CTL0_CAM(2)
+#define TIMER_COUNTER_CENTER_BOTH CTL0_CAM(3)
+#define TIMER_COUNTER_UP   ((uint16_t)0x0000U)
+#define TIMER_COUNTER_DOWN ((uint16_t)TIMER_CTL0_DIR)
+#define TIMER_CKDIV_DIV1   ((uint16_t)0x0000U)
+
+#define TIMER_CCX_ENABLE        ((uint16_t)0x0001U)
+#define TIMER_CCX_DISABLE       ((uint16_t)0x0000U)
+#define TIMER_CCXN_ENABLE       ((uint16_t)0x0004U)
+#define TIMER_CCXN_DISABLE      ((uint16_t)0x0000U)
+#define TIMER_OC_POLARITY_HIGH  ((uint16_t)0x0000U)
+#define TIMER_OC_POLARITY_LOW   ((uint16_t)0x0002U)
+#define TIMER_OCN_POLARITY_HIGH ((uint16_t)0x0000U)
+#define TIMER_OCN_POLARITY_LOW  ((uint16_t)0x0008U)
+#define TIMER_OC_IDLE_STATE_LOW   ((uint16_t)0x0000U)
+#define TIMER_OC_IDLE_STATE_HIGH  ((uint16_t)0x0100U)
+#define TIMER_OCN_IDLE_STATE_LOW  ((uint16_t)0x0000U)
+#define TIMER_OCN_IDLE_STATE_HIGH ((uint16_t)0x0200U)
+
+#define TIMER_OC_MODE_TIMING   ((uint16_t)0x0000U)
+#define TIMER_OC_MODE_ACTIVE   ((uint16_t)0x0010U)
+#define TIMER_OC_MODE_INACTIVE ((uint16_t)0x0020U)
+#define TIMER_OC_MODE_TOGGLE   ((uint16_t)0x0030U)
+#define TIMER_OC_MODE_LOW      ((uint16_t)0x0040U)
+#define TIMER_OC_MODE_HIGH     ((uint16_t)0x0050U)
+#define TIMER_OC_MODE_PWM0     ((uint16_t)0x0060U)
+#define TIMER_OC_MODE_PWM1     ((uint16_t)0x0070U)
+#define TIMER_OC_SHADOW_ENABLE  ((uint16_t)0x0008U)
+#define TIMER_OC_SHADOW_DISABLE ((uint16_t)0x0000U)
+
+#define TIMER_IC_POLARITY_RISING    ((uint16_t)0x0000U)
+#define TIMER_IC_POLARITY_FALLING   ((uint16_t)0x0002U)
+#define TIMER_IC_POLARITY_BOTH_EDGE ((uint16_t)0x000AU)
+#define TIMER_IC_SELECTION_DIRECTTI ((uint16_t)0x0001U)
+#define TIMER_IC_PSC_DIV1           ((uint16_t)0x0000U)
+
+#define TIMER_EVENT_SRC_UPG ((uint16_t)0x0001U)
+
+typedef struct {
+    uint16_t prescaler;
+    uint16_t alignedmode;
+    uint16_t counterdirection;
+    uint32_t period;
+    uint16_t clockdivision;
+    uint8_t  repetitioncounter;
+} timer_parameter_struct;
+
+typedef struct {
+    uint16_t outputstate;
+    uint16_t outputnstate;
+    uint16_t ocpolarity;
+    uint16_t ocnpolarity;
+    uint16_t ocidlestate;
+    uint16_t ocnidlestate;
+} timer_oc_parameter_struct;
+
+typedef struct {
+    uint16_t icpolarity;
+    uint16_t icselection;
+    uint16_t icprescaler;
+    uint16_t icfilter;
+} timer_ic_parameter_struct;
+
+void timer_deinit(uint32_t timer_periph);
+void timer_init(uint32_t timer_periph, timer_parameter_struct *initpara);
+void timer_enable(uint32_t timer_periph);
+void timer_disable(uint32_t timer_periph);
+void timer_auto_reload_shadow_enable(uint32_t timer_periph);
+void timer_auto_reload_shadow_disable(uint32_t timer_periph);
+void timer_autoreload_value_config(uint32_t timer_periph, uint16_t autoreload);
+void timer_counter_value_config(uint32_t timer_periph, uint16_t counter);
+uint32_t timer_counter_read(uint32_t timer_periph);
+void timer_event_software_generate(uint32_t timer_periph, uint16_t event);
+void timer_primary_output_config(uint32_t timer_periph, ControlStatus newvalue);
+void timer_channel_output_config(uint32_t timer_periph, uint16_t channel, timer_oc_parameter_struct *ocpara);
+void timer_channel_output_mode_config(uint32_t timer_periph, uint16_t channel, uint16_t ocmode);
+void timer_channel_output_pulse_value_config(uint32_t timer_periph, uint16_t channel, uint32_t pulse);
+void timer_channel_output_shadow_config(uint32_t timer_periph, uint16_t channel, uint16_t ocshadow);
+void timer_input_capture_config(uint32_t timer_periph, uint16_t channel, timer_ic_parameter_struct *icpara);
+void timer_interrupt_enable(uint32_t timer_periph, uint32_t interrupt);
+void timer_interrupt_disable(uint32_t timer_periph, uint32_t interrupt);
+void timer_interrupt_flag_clear(uint32_t timer_periph, uint32_t interrupt);
+FlagStatus timer_interrupt_flag_get(uint32_t timer_periph, uint32_t interrupt);
+void timer_dma_enable(uint32_t timer_periph, uint16_t dma);
+void timer_dma_disable(uint32_t timer_periph, uint16_t dma);
+void timer_dma_transfer_config(uint32_t timer_periph, uint32_t dma_baseaddr, uint32_t dma_lenth);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef GD32VF103_USART_H
+#define GD32VF103_USART_H
+
+#include "gd32vf103.h"
+
+#define USART1 USART_BASE
+#define USART2 (USART_BASE + 0x00000400U)
+#define USART0 (USART_BASE + 0x0000F400U)
+
+#define USART_STAT(usartx) REG32((usartx) + 0x00U)
+#define USART_DATA(usartx) REG32((usartx) + 0x04U)
+#define USART_BAUD(usartx) REG32((usartx) + 0x08U)
+#define USART_CTL0(usartx) REG32((usartx) + 0x0CU)
+#define USART_CTL1(usartx) REG32((usartx) + 0x10U)
+#define USART_CTL2(usartx) REG32((usartx) + 0x14U)
+#define USART_GP(usartx)   REG32((usartx) + 0x18U)
+
+#define USART_STAT_PERR  BIT(0)
+#define USART_STAT_FERR  BIT(1)
+#define USART_STAT_NERR  BIT(2)
+#define USART_STAT_ORERR BIT(3)
+#define USART_STAT_IDLEF BIT(4)
+#define USART_STAT_RBNE  BIT(5)
+#define USART_STAT_TC    BIT(6)
+#define USART_STAT_TBE   BIT(7)
+
+#define USART_CTL0_REN    BIT(2)
+#define USART_CTL0_TEN    BIT(3)
+#define USART_CTL0_IDLEIE BIT(4)
+#define USART_CTL0_RBNEIE BIT(5)
+#define USART_CTL0_TCIE   BIT(6)
+#define USART_CTL0_TBEIE  BIT(7)
+#define USART_CTL0_UEN    BIT(13)
+#define USART_CTL2_DENR   BIT(6)
+#define USART_CTL2_DENT   BIT(7)
+
+// Flags and interrupts: register offset and bit, like the sdk
+#define USART_REGIDX_BIT(regidx, bitpos) (((uint32_t)(regidx) << 6) | (uint32_t)(bitpos))
+#define USART_REGIDX_BIT2(regidx, bitpos, regidx2, bitpos2) \
+    (((uint32_t)(regidx2) << 22) | (uint32_t)((bitpos2) << 16) | (((uint32_t)(regidx) << 6) | (uint32_t)(bitpos)))
+#define USART_REG_VAL(usartx, offset)  (REG32((usartx) + (((uint32_t)(offset) & 0x0000FFFFU) >> 6)))
+#define USART_BIT_POS(val)             ((uint32_t)(val) & 0x1FU)
+#define USART_REG_VAL2(usartx, offset) (REG32((usartx) + ((uint32_t)(offset) >> 22)))
+#define USART_BIT_POS2(val)            (((uint32_t)(val) & 0x1F0000U) >> 16)
+
+#define STAT_REG_OFFSET 0x00U
+#define CTL0_REG_OFFSET 0x0CU
+#define CTL2_REG_OFFSET 0x14U
+
+typedef enum {
+    USART_FLAG_ORERR = USART_REGIDX_BIT(STAT_REG_OFFSET, 3U),
+    USART_FLAG_IDLEF = USART_REGIDX_BIT(STAT_REG_OFFSET, 4U),
+    USART_FLAG_RBNE  = USART_REGIDX_BIT(STAT_REG_OFFSET, 5U),
+    USART_FLAG_TC    = USART_REGIDX_BIT(STAT_REG_OFFSET, 6U),
+    USART_FLAG_TBE   = USART_REGIDX_BIT(STAT_REG_OFFSET, 7U)
+} usart_flag_enum;
+
+typedef enum {
+    USART_INT_FLAG_IDLE       = USART_REGIDX_BIT2(CTL0_REG_OFFSET, 4U, STAT_REG_OFFSET, 4U),
+    USART_INT_FLAG_RBNE       = USART_REGIDX_BIT2(CTL0_REG_OFFSET, 5U, STAT_REG_OFFSET, 5U),
+    USART_INT_FLAG_TC         = USART_REGIDX_BIT2(CTL0_REG_OFFSET, 6U, STAT_REG_OFFSET, 6U),
+    USART_INT_FLAG_TBE        = USART_REGIDX_BIT2(CTL0_REG_OFFSET, 7U, STAT_REG_OFFSET, 7U),
+    USART_INT_FLAG_RBNE_ORERR = USART_REGIDX_BIT2(CTL0_REG_OFFSET, 5U, STAT_REG_OFFSET, 3U)
+} usart_interrupt_flag_enum;
+
+typedef enum {
+    USART_INT_IDLE = USART_REGIDX_BIT(CTL0_REG_OFFSET, 4U),
+    USART_INT_RBNE = USART_REGIDX_BIT(CTL0_REG_OFFSET, 5U),
+    USART_INT_TC   = USART_REGIDX_BIT(CTL0_REG_OFFSET, 6U),
+    USART_INT_TBE  = USART_REGIDX_BIT(CTL0_REG_OFFSET, 7U)
+} usart_interrupt_enum;
+
+#define USART_WL_8BIT        0U
+#define USART_WL_9BIT        BIT(12)
+#define USART_STB_1BIT       0U
+#define USART_PM_NONE        0U
+#define USART_RTS_DISABLE    0U
+#define USART_CTS_DISABLE    0U
+#define USART_RECEIVE_ENABLE  USART_CTL0_REN
+#define USART_RECEIVE_DISABLE 0U
+#define USART_TRANSMIT_ENABLE  USART_CTL0_TEN
+#define USART_TRANSMIT_DISABLE 0U
+#define USART_DENR_ENABLE  USART_CTL2_DENR
+#define USART_DENR_DISABLE 0U
+#define USART_DENT_ENABLE  USART_CTL2_DENT
+#define USART_DENT_DISABLE 0U
+
+void usart_deinit(uint32_t usart_periph);
+void usart_baudrate_set(uint32_t usart_periph, uint32_t baudval);
+void usart_word_length_set(uint32_t usart_periph, uint32_t wlen);
+void usart_stop_bit_set(uint32_t usart_periph, uint32_t stblen);
+void usart_parity_config(uint32_t usart_periph, uint32_t paritycfg);
+void usart_hardware_flow_rts_config(uint32_t usart_periph, uint32_t rtsconfig);
+void usart_hardware_flow_cts_config(uint32_t usart_periph, uint32_t ctsconfig);
+void usart_receive_config(uint32_t usart_periph, uint32_t rxconfig);
+void usart_transmit_config(uint32_t usart_periph, uint32_t txconfig);
+void usart_enable(uint32_t usart_periph);
+void usart_disable(uint32_t usart_periph);
+void usart_interrupt_enable(uint32_t usart_periph, usart_interrupt_enum interrupt);
+void usart_interrupt_disable(uint32_t usart_periph, usart_interrupt_enum interrupt);
+FlagStatus usart_interrupt_flag_get(uint32_t usart_periph, usart_interrupt_flag_enum int_flag);
+void usart_interrupt_flag_clear(uint32_t usart_periph, usart_interrupt_flag_enum int_flag);
+void usart_data_transmit(uint32_t usart_periph, uint32_t data);
+uint16_t usart_data_receive(uint32_t usart_periph);
+FlagStatus usart_flag_get(uint32_t usart_periph, usart_flag_enum flag);
+void usart_dma_transmit_config(uint32_t usart_periph, uint32_t dmacmd);
+void usart_dma_receive_config(uint32_t usart_periph, uint32_t dmacmd);
+
+#endif
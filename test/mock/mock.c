@@ -0,0 +1,2060 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // needs to be set for all headers, the native env has it in its build_flags
+#endif
+#include "mock.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+/*
+Implementation of the register mock, see mock.h.
+Included once by each test program, so it needs no build setup of its own.
+
+Registers: plain memory indexed by chip address. The program reaches them through
+mock_load() and mock_store(), the reg_load() and reg_store() of lib/fastreg, and through
+the sdk functions below. Each access is charged, updates the simulation to the current time
+and refreshes live registers (counters, mtime, received data) first. Writes are passed
+to reg_written(), which applies what they mean to the hardware.
+
+Simulation: timers step from one interesting counter value (compare value, wrap) to the next,
+everything else reacts immediately to register writes, dma requests and pin changes.
+*/
+
+#if !defined(__linux__) || !defined(__x86_64__)
+#error "the register mock needs x86-64 Linux (instructions are counted by single stepping)"
+#endif
+
+#define PERIPH_BASE 0x40000000U
+#define PERIPH_SIZE 0x30000U
+#define CORE_BASE   TIMER_CTRL_ADDR
+#define CORE_SIZE   0x1000U
+
+#define NEVER UINT64_MAX
+
+#define MOCK_TRACE_SIZE (1U << 20)
+#define MOCK_USART_SIZE (1U << 16)
+#define MOCK_SOURCES    ECLIC_NUM_INTERRUPTS
+
+uint32_t SystemCoreClock = MOCK_SYS_HZ;
+
+
+/*
+State
+*/
+
+static uint32_t _periph[PERIPH_SIZE / 4]; // peripheral registers
+static uint32_t _core[CORE_SIZE / 4];     // machine timer registers
+static uintptr_t _ram_high;  // upper half of host addresses of statics, dma has 32 bit addresses
+
+static uint64_t _now;        // CK_SYS cycles, time of the cpu
+static uint64_t _ev;         // time of what the simulation does right now (event or cpu access)
+
+static uint64_t _mtime;      // machine timer: core clock / 4
+static uint64_t _mtime_at;   // time _mtime was last brought up to date
+static uint64_t _mcycle;     // core cycles while awake
+static uint64_t _mcycle_at;
+static int _sleeping;
+static uint32_t _mcountinhibit;
+static uint32_t _mstatus;
+
+struct mock_timer {
+    uint32_t base;
+    int apb2;          // TIMER0 is on APB2, the others on APB1
+    uint16_t cnt;
+    uint8_t down;      // center aligned counting down
+    uint32_t psc;      // active values, PSC always and CAR and CHxCV if shadowed are loaded by update events
+    uint32_t car;
+    uint32_t cv[4];
+    uint64_t next;     // time of the next counter step while running
+    uint32_t burst;    // dma burst index while serving an update request
+    int burst_hit;     // dma accessed DMATB
+    uint8_t ref[4];    // output reference of channels in frozen modes
+};
+
+static struct mock_timer _timers[5] = {
+    { .base = TIMER0, .apb2 = 1 }, { .base = TIMER1 }, { .base = TIMER2 }, { .base = TIMER3 }, { .base = TIMER4 }
+};
+
+// Dma channels serving timer requests: dma number * 8 + channel, -1 for none
+static const int8_t _update_dma[5] = { 4, 1, 2, 6, 8 + 1 };
+static const int8_t _channel_dma[5][4] = {
+    { 1, 2, 5, 3 }, { 4, 6, 0, 6 }, { 5, -1, 1, 2 }, { 0, 3, 4, -1 }, { 8 + 4, 8 + 3, 8 + 1, 8 + 0 }
+};
+#define USART0_TX_DMA 3
+#define USART0_RX_DMA 4
+
+struct mock_dma_channel {
+    uint32_t total;   // items per round, latched when enabled
+    uint32_t index;   // items done in this round
+};
+static struct mock_dma_channel _dma[2][7];
+
+static struct {
+    int shifting;          // byte in the shift register
+    uint64_t shift_end;
+    uint8_t shift_byte;
+    int full;              // byte waiting in the data register
+    uint8_t data;
+    uint8_t received;      // what reading DATA returns
+    uint8_t rx[MOCK_USART_SIZE];
+    uint32_t rx_head, rx_tail;
+    uint64_t rx_next;      // time the next injected byte is complete
+    uint8_t tx[MOCK_USART_SIZE];
+    uint32_t tx_count, tx_taken;
+    uint32_t sent;
+    int discard;
+} _usart;
+
+static uint8_t _pad[5][16];    // pin levels
+static uint8_t _drive[5][16];  // levels of unconnected inputs
+static int8_t _wire[5][16];    // input wired to pin bank * 16 + pin, -1 for none
+
+static struct mock_edge _trace[MOCK_TRACE_SIZE];
+static uint32_t _trace_count;
+static int _trace_full;
+static uint64_t _trace_start;
+static uint8_t _trace_initial[5][16];
+
+static uint8_t _ie[MOCK_SOURCES];
+static uint8_t _level_of[MOCK_SOURCES];
+static uint8_t _vmode[MOCK_SOURCES];
+static uint8_t _pending[MOCK_SOURCES];
+static uint64_t _pending_at[MOCK_SOURCES];
+static struct mock_irq_stat _irq_stats[MOCK_SOURCES];
+static int _level;             // eclic level of the running handler, -1 in main code
+static int _depth;
+
+static int _in_mock;           // depth of mock code called by the program
+static int _counting;          // program instructions are single stepped and cost time
+static uint64_t _instructions;
+static uint64_t _preempt_at;   // mock_preempt(): instruction count to call the handler at
+static void (*_preempt)( void );
+
+static uint32_t _spin_addr;    // busy wait detection: same register read with the same value
+static uint32_t _spin_value;
+static uint32_t _spin_reads;
+static int _spin_skip;         // tests allow skipping busy waits with mock_skip_waits()
+
+
+/*
+Registers and clocks
+*/
+
+static inline uint32_t *reg_at( uint32_t addr ) {
+    if( addr >= CORE_BASE ) return &_core[(addr - CORE_BASE) / 4];
+    return &_periph[(addr - PERIPH_BASE) / 4];
+}
+
+#define R(addr) (*reg_at(addr))
+
+static uint32_t ahb_div( void ) {
+    static const uint8_t shift[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9 };
+    return 1U << shift[(R(RCU_BASE + 0x04) >> 4) & 0xf];
+}
+
+static uint32_t apb_div( int apb2 ) {
+    static const uint8_t shift[8] = { 0, 0, 0, 0, 1, 2, 3, 4 };
+    return 1U << shift[(R(RCU_BASE + 0x04) >> (apb2 ? 11 : 8)) & 7];
+}
+
+// CK_SYS cycles per timer clock: APB clock, doubled if APB is divided from AHB
+static uint64_t timer_clock( int apb2 ) {
+    uint32_t div = apb_div(apb2);
+    return (uint64_t)ahb_div() * div / (div > 1 ? 2 : 1);
+}
+
+// Core cycles of a register access
+static uint32_t access_cost( uint32_t addr ) {
+    if( addr >= CORE_BASE || addr >= AHB1_BUS_BASE ) return MOCK_AHB_ACCESS;
+    return MOCK_APB_ACCESS + 2 * apb_div(addr >= APB2_BUS_BASE);
+}
+
+static void spend( uint32_t core_cycles ) {
+    _now += (uint64_t)core_cycles * ahb_div();
+}
+
+
+/*
+Instruction counting: the trap flag single steps the program, the step handler charges each
+instruction. Mock code called by the program is not counted: MOCK_SCOPE() marks it,
+the first step inside clears the trap flag and leaving the outermost scope sets it again.
+A register access on the chip is a single load or store. mock_load() and mock_store() are
+in their own section, steps into it are not charged: an access costs its operands and
+the return, close to the load or store it stands for. Instructions outside the RAM_ISR
+section are fetched from flash and pay MOCK_FLASH_WAIT on top.
+*/
+
+#define MOCK_ACCESS __attribute__((section("mock_access"), noinline))
+extern const char __start_mock_access[], __stop_mock_access[];
+extern const char __start_mock_sram[] __attribute__((weak)), __stop_mock_sram[] __attribute__((weak)); // RAM_ISR
+
+// Set or clear the x86 trap flag. Skips the red zone, leaf functions may keep locals there
+static inline void trap_flag( int on ) {
+    if( on ) __asm__ volatile( "lea -128(%%rsp), %%rsp; pushfq; orq $0x100, (%%rsp); popfq; lea 128(%%rsp), %%rsp" ::: "memory" );
+    else __asm__ volatile( "lea -128(%%rsp), %%rsp; pushfq; andq $~0x100, (%%rsp); popfq; lea 128(%%rsp), %%rsp" ::: "memory" );
+}
+
+static void on_step( int sig, siginfo_t *info, void *context ) {
+    ucontext_t *uc = context;
+    if( _counting && !_in_mock ) {
+        const char *next = (const char *)uc->uc_mcontext.gregs[REG_RIP];
+        if( next < __start_mock_access || next >= __stop_mock_access ) {
+            int sram = next >= __start_mock_sram && next < __stop_mock_sram;
+            _instructions++;
+            spend(MOCK_INSTRUCTION + (sram ? 0 : MOCK_FLASH_WAIT));
+        }
+        if( _preempt && _instructions >= _preempt_at ) {
+            void (*handler)( void ) = _preempt;
+            _preempt = 0;
+            handler(); // the kernel cleared the trap flag for the signal handler
+        }
+    }
+    else {
+        uc->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+    }
+}
+
+static int mock_enter( void ) {
+    _in_mock++;
+    __asm__ volatile( "" ::: "memory" ); // mock code after this is not counted
+    return 0;
+}
+
+static void mock_leave( int *scope ) {
+    if( !--_in_mock && _counting ) trap_flag(1);
+}
+
+#define MOCK_SCOPE() int _mock_scope __attribute__((cleanup(mock_leave), unused)) = mock_enter()
+
+
+/*
+Machine timer and cycle counter
+*/
+
+static void sync_mtime( void ) {
+    uint64_t unit = 4ULL * ahb_div();
+    uint64_t ticks = (_ev - _mtime_at) / unit;
+    _mtime += ticks;
+    _mtime_at += ticks * unit;
+    uint64_t cycles = (_ev - _mcycle_at) / ahb_div();
+    if( !_sleeping && !(_mcountinhibit & 1) ) _mcycle += cycles;
+    _mcycle_at += cycles * ahb_div();
+}
+
+static uint64_t mtimecmp( void ) {
+    return (uint64_t)R(CORE_BASE + TIMER_MTIMECMP + 4) << 32 | R(CORE_BASE + TIMER_MTIMECMP);
+}
+
+// Time the machine timer reaches its compare value
+static uint64_t mtime_event( void ) {
+    uint64_t cmp = mtimecmp();
+    if( _mtime >= cmp ) return _mtime_at;
+    uint64_t ticks = cmp - _mtime;
+    if( ticks > (NEVER - _mtime_at) / (4ULL * ahb_div()) ) return NEVER;
+    return _mtime_at + ticks * 4 * ahb_div();
+}
+
+
+/*
+Timers
+*/
+
+static void dma_request( int channel );
+static void pads_of_timer( struct mock_timer *t );
+static void irq_scan( void );
+
+static inline uint32_t tim_reg( struct mock_timer *t, uint32_t offset ) {
+    return R(t->base + offset);
+}
+
+// Channel field of CHCTL0/1: mode select, compare shadow and compare mode
+static inline uint32_t tim_field( struct mock_timer *t, int c ) {
+    return (tim_reg(t, c < 2 ? 0x18 : 0x1C) >> ((c & 1) * 8)) & 0xff;
+}
+
+static inline int tim_compare( struct mock_timer *t, int c ) {
+    return (tim_field(t, c) & 3) == 0;
+}
+
+static inline int tim_enabled( struct mock_timer *t, int c ) {
+    return (tim_reg(t, 0x20) >> (4 * c)) & 1;
+}
+
+static inline uint32_t tim_cam( struct mock_timer *t ) {
+    return (tim_reg(t, 0x00) >> 5) & 3;
+}
+
+static inline uint64_t tim_tick( struct mock_timer *t ) {
+    return (t->psc + 1) * timer_clock(t->apb2);
+}
+
+static inline int tim_running( struct mock_timer *t ) {
+    return tim_reg(t, 0x00) & TIMER_CTL0_CEN;
+}
+
+// Counter steps until the next one with something to do: wrap, turn or compare match
+static uint32_t tim_steps( struct mock_timer *t ) {
+    uint32_t n;
+    if( tim_cam(t) == 0 ) n = (t->cnt <= t->car) ? t->car - t->cnt + 1 : 0x10000U - t->cnt;
+    else if( !t->down ) n = (t->cnt < t->car) ? t->car - t->cnt : 1;
+    else n = t->cnt ? t->cnt : 1;
+    for( int c = 0; c < 4; c++ ) {
+        if( !tim_compare(t, c) ) continue;
+        uint32_t cv = t->cv[c];
+        if( !t->down && cv > t->cnt && cv - t->cnt < n ) n = cv - t->cnt;
+        if( t->down && cv < t->cnt && t->cnt - cv < n ) n = t->cnt - cv;
+    }
+    return n;
+}
+
+static uint64_t tim_event( struct mock_timer *t ) {
+    if( !tim_running(t) ) return NEVER;
+    return t->next + (tim_steps(t) - 1) * tim_tick(t);
+}
+
+// Counter value at the current time, without passing an event
+static void tim_sync( struct mock_timer *t ) {
+    if( tim_running(t) && _ev >= t->next ) {
+        uint64_t tick = tim_tick(t);
+        uint64_t steps = (_ev - t->next) / tick + 1;
+        uint32_t limit = tim_steps(t) - 1;
+        if( steps > limit ) steps = limit;
+        t->cnt = t->down ? t->cnt - steps : t->cnt + steps;
+        t->next += steps * tick;
+    }
+    R(t->base + 0x24) = t->cnt;
+    if( tim_cam(t) ) {
+        R(t->base) = (R(t->base) & ~TIMER_CTL0_DIR) | (t->down ? TIMER_CTL0_DIR : 0);
+    }
+}
+
+static void tim_update( struct mock_timer *t, int software ) {
+    uint32_t ctl0 = tim_reg(t, 0x00);
+    if( ctl0 & TIMER_CTL0_UPDIS ) return;
+    t->psc = tim_reg(t, 0x28) & 0xffff;
+    t->car = tim_reg(t, 0x2C) & 0xffff;
+    for( int c = 0; c < 4; c++ ) {
+        if( tim_compare(t, c) && (tim_field(t, c) & 8) ) t->cv[c] = tim_reg(t, 0x34 + 4 * c) & 0xffff;
+    }
+    if( !(software && (ctl0 & TIMER_CTL0_UPS)) ) R(t->base + 0x10) |= TIMER_INTF_UPIF;
+    if( tim_reg(t, 0x0C) & TIMER_DMAINTEN_UPDEN ) {
+        // dma burst: the timer asks again as long as the dma writes DMATB
+        uint32_t transfers = ((tim_reg(t, 0x48) >> 8) & 0x1f) + 1;
+        for( t->burst = 0; t->burst < transfers; t->burst++ ) {
+            t->burst_hit = 0;
+            dma_request(_update_dma[t - _timers]);
+            if( !t->burst_hit ) break;
+        }
+        t->burst = 0;
+    }
+}
+
+// Compare match of a channel: flag and dma request
+static void tim_match( struct mock_timer *t, int c ) {
+    uint32_t cam = tim_cam(t);
+    if( cam == 1 && !t->down ) return;
+    if( cam == 2 && t->down ) return;
+    R(t->base + 0x10) |= TIMER_INTF_CH0IF << c;
+    if( (tim_reg(t, 0x0C) & (TIMER_DMAINTEN_CH0DEN << c)) && _channel_dma[t - _timers][c] >= 0 ) {
+        dma_request(_channel_dma[t - _timers][c]);
+    }
+}
+
+// Do the steps up to the next event, which happens now
+static void tim_step( struct mock_timer *t, uint32_t steps ) {
+    if( steps > 1 ) t->cnt = t->down ? t->cnt - (steps - 1) : t->cnt + (steps - 1);
+    int update = 0;
+    if( tim_cam(t) == 0 ) {
+        if( t->cnt == t->car || t->cnt == 0xffff ) {
+            t->cnt = 0;
+            update = 1;
+        }
+        else {
+            t->cnt++;
+        }
+    }
+    else if( !t->down ) {
+        t->cnt++;
+        if( t->cnt >= t->car ) {
+            t->down = 1;
+            update = 1;
+        }
+    }
+    else {
+        t->cnt--;
+        if( t->cnt == 0 ) {
+            t->down = 0;
+            update = 1;
+        }
+    }
+    R(t->base + 0x24) = t->cnt;
+    t->next = _ev + tim_tick(t); // dma writes sync the timer, it's at this step already
+    for( int c = 0; c < 4; c++ ) {
+        if( tim_compare(t, c) && t->cv[c] == t->cnt ) tim_match(t, c);
+    }
+    if( update ) tim_update(t, 0);
+    t->next = _ev + tim_tick(t);
+    pads_of_timer(t);
+}
+
+// Software update event: counter and prescaler restart
+static void tim_generate( struct mock_timer *t ) {
+    t->cnt = 0;
+    t->down = 0;
+    tim_update(t, 1);
+    t->next = _ev + tim_tick(t);
+    R(t->base + 0x24) = 0;
+    pads_of_timer(t);
+}
+
+// Output of a channel as the pin sees it
+static uint8_t tim_output( struct mock_timer *t, int c ) {
+    if( t == &_timers[0] && !(tim_reg(t, 0x44) & TIMER_CCHP_POEN) ) {
+        return (tim_reg(t, 0x04) >> (8 + 2 * c)) & 1; // idle state
+    }
+    uint32_t mode = (tim_field(t, c) >> 4) & 7;
+    uint8_t ref;
+    switch( mode ) {
+        case 4: ref = 0; break;
+        case 5: ref = 1; break;
+        case 6: ref = t->down ? t->cnt <= t->cv[c] : t->cnt < t->cv[c]; break;
+        case 7: ref = !(t->down ? t->cnt <= t->cv[c] : t->cnt < t->cv[c]); break;
+        default: ref = t->ref[c]; break;
+    }
+    t->ref[c] = ref;
+    return ref ^ ((tim_reg(t, 0x20) >> (4 * c + 1)) & 1);
+}
+
+static void tim_reset( struct mock_timer *t ) {
+    for( uint32_t offset = 0; offset <= 0x4C; offset += 4 ) R(t->base + offset) = 0;
+    R(t->base + 0x2C) = 0xffff;
+    t->cnt = 0;
+    t->down = 0;
+    t->psc = 0;
+    t->car = 0xffff;
+    memset(t->cv, 0, sizeof(t->cv));
+    memset(t->ref, 0, sizeof(t->ref));
+    t->next = NEVER;
+}
+
+static struct mock_timer *timer_of( uint32_t addr ) {
+    for( int i = 0; i < 5; i++ ) {
+        if( addr >= _timers[i].base && addr < _timers[i].base + 0x400 ) return &_timers[i];
+    }
+    return 0;
+}
+
+
+/*
+Pins
+*/
+
+// Pin (bank * 16 + pin) of a timer channel with the current remap, see the datasheet
+static int channel_pin( int timer, int c ) {
+    static const int8_t pins[5][4][4] = { // [timer][remap][channel]
+        { { 8, 9, 10, 11 }, { 8, 9, 10, 11 }, { -1, -1, -1, -1 }, { 64 + 9, 64 + 11, 64 + 13, 64 + 14 } },
+        { { 0, 1, 2, 3 }, { 15, 16 + 3, 2, 3 }, { 0, 1, 16 + 10, 16 + 11 }, { 15, 16 + 3, 16 + 10, 16 + 11 } },
+        { { 6, 7, 16, 17 }, { -1, -1, -1, -1 }, { 16 + 4, 16 + 5, 16, 17 }, { 32 + 6, 32 + 7, 32 + 8, 32 + 9 } },
+        { { 16 + 6, 16 + 7, 16 + 8, 16 + 9 }, { 48 + 12, 48 + 13, 48 + 14, 48 + 15 }, { -1 }, { -1 } },
+        { { 0, 1, 2, 3 }, { 0, 1, 2, 3 }, { 0, 1, 2, 3 }, { 0, 1, 2, 3 } }
+    };
+    static const uint8_t shift[5] = { 6, 8, 10, 12, 0 };
+    static const uint8_t bits[5] = { 3, 3, 3, 1, 0 };
+    uint32_t remap = (R(AFIO + 0x04) >> shift[timer]) & bits[timer];
+    return pins[timer][remap][c];
+}
+
+// Timer channel driving an alternate function output pin, -1 for none
+static int pin_driver( int pad ) {
+    for( int t = 0; t < 5; t++ ) {
+        for( int c = 0; c < 4; c++ ) {
+            if( channel_pin(t, c) == pad && tim_compare(&_timers[t], c) && tim_enabled(&_timers[t], c) ) return t * 4 + c;
+        }
+    }
+    return -1;
+}
+
+static uint8_t pad_level( int pad ) {
+    int b = pad / 16;
+    int p = pad % 16;
+    uint32_t port = GPIOA + 0x400 * b;
+    uint32_t mode = (R(port + (p < 8 ? 0 : 4)) >> ((p & 7) * 4)) & 0xf;
+    if( mode & 3 ) { // output
+        if( mode & 8 ) {
+            int driver = pin_driver(pad);
+            if( driver >= 0 ) return tim_output(&_timers[driver / 4], driver % 4);
+        }
+        return (R(port + 0x0C) >> p) & 1;
+    }
+    if( _wire[b][p] >= 0 ) return _pad[_wire[b][p] / 16][_wire[b][p] % 16];
+    return _drive[b][p];
+}
+
+// Input capture of channels reading a pin
+static void capture( int pad, uint8_t level ) {
+    for( int i = 0; i < 5; i++ ) {
+        struct mock_timer *t = &_timers[i];
+        for( int c = 0; c < 4; c++ ) {
+            if( channel_pin(i, c) != pad || (tim_field(t, c) & 3) != 1 || !tim_enabled(t, c) ) continue;
+            uint32_t polarity = (tim_reg(t, 0x20) >> (4 * c)) & 0xa; // CHxP, CHxNP
+            if( polarity == 0 && !level ) continue;
+            if( polarity == 2 && level ) continue;
+            tim_sync(t);
+            R(t->base + 0x34 + 4 * c) = t->cnt;
+            if( R(t->base + 0x10) & (TIMER_INTF_CH0IF << c) ) R(t->base + 0x10) |= TIMER_INTF_CH0OF << c;
+            R(t->base + 0x10) |= TIMER_INTF_CH0IF << c;
+            if( (tim_reg(t, 0x0C) & (TIMER_DMAINTEN_CH0DEN << c)) && _channel_dma[i][c] >= 0 ) {
+                dma_request(_channel_dma[i][c]);
+            }
+        }
+    }
+}
+
+static void pad_update( int pad ) {
+    if( pad < 0 ) return;
+    int b = pad / 16;
+    int p = pad % 16;
+    uint8_t level = pad_level(pad);
+    if( level == _pad[b][p] ) return;
+    _pad[b][p] = level;
+    uint32_t istat = GPIOA + 0x400 * b + 0x08;
+    R(istat) = (R(istat) & ~(1U << p)) | ((uint32_t)level << p);
+    if( _trace_count < MOCK_TRACE_SIZE ) {
+        _trace[_trace_count++] = (struct mock_edge){ _ev, b, p, level };
+    }
+    else {
+        _trace_full = 1;
+    }
+    capture(pad, level);
+    for( int i = 0; i < 5 * 16; i++ ) {
+        if( _wire[i / 16][i % 16] == pad ) pad_update(i);
+    }
+}
+
+static void pads_of_timer( struct mock_timer *t ) {
+    for( int c = 0; c < 4; c++ ) pad_update(channel_pin(t - _timers, c));
+}
+
+static void pads_of_bank( int b, uint32_t pins ) {
+    for( int p = 0; p < 16; p++ ) {
+        if( pins & (1U << p) ) pad_update(b * 16 + p);
+    }
+}
+
+static void pads_all( void ) {
+    for( int b = 0; b < 5; b++ ) pads_of_bank(b, 0xffff);
+}
+
+
+/*
+Usart0
+*/
+
+#define USART0_REG(offset) R(USART0 + (offset))
+
+static uint64_t usart_byte_time( void ) {
+    uint32_t div = USART0_REG(0x08) & 0xffff;
+    if( div < 16 ) div = 16;
+    return 10ULL * div * ahb_div() * apb_div(1);
+}
+
+static int usart_on( void ) {
+    return (USART0_REG(0x0C) & USART_CTL0_UEN) != 0;
+}
+
+static uint64_t usart_event( void ) {
+    uint64_t next = _usart.shifting ? _usart.shift_end : NEVER;
+    if( _usart.rx_head != _usart.rx_tail && _usart.rx_next < next ) next = _usart.rx_next;
+    return next;
+}
+
+static int dma_ready( int channel );
+
+// Dma requests are levels: transmit while the data register is empty, receive while data is there
+static void usart_service( void ) {
+    for( int i = 0; i < 2; i++ ) {
+        if( (USART0_REG(0x14) & USART_CTL2_DENT) && (USART0_REG(0x00) & USART_STAT_TBE) && dma_ready(USART0_TX_DMA) ) {
+            dma_request(USART0_TX_DMA);
+        }
+    }
+    if( (USART0_REG(0x14) & USART_CTL2_DENR) && (USART0_REG(0x00) & USART_STAT_RBNE) && dma_ready(USART0_RX_DMA) ) {
+        dma_request(USART0_RX_DMA);
+    }
+}
+
+static void usart_transmit( uint8_t byte ) {
+    if( !usart_on() || !(USART0_REG(0x0C) & USART_CTL0_TEN) ) return;
+    if( !_usart.shifting ) {
+        _usart.shifting = 1;
+        _usart.shift_byte = byte;
+        _usart.shift_end = _ev + usart_byte_time();
+        USART0_REG(0x00) &= ~USART_STAT_TC;
+    }
+    else {
+        _usart.full = 1; // a byte written while TBE is clear is lost, like on the chip
+        _usart.data = byte;
+        USART0_REG(0x00) &= ~USART_STAT_TBE;
+    }
+}
+
+static void usart_step( void ) {
+    if( _usart.shifting && _usart.shift_end == _ev ) {
+        _usart.sent++;
+        if( !_usart.discard && _usart.tx_count - _usart.tx_taken < MOCK_USART_SIZE ) {
+            _usart.tx[_usart.tx_count++ % MOCK_USART_SIZE] = _usart.shift_byte;
+        }
+        if( _usart.full ) {
+            _usart.full = 0;
+            _usart.shift_byte = _usart.data;
+            _usart.shift_end = _ev + usart_byte_time();
+            USART0_REG(0x00) |= USART_STAT_TBE;
+        }
+        else {
+            _usart.shifting = 0;
+            USART0_REG(0x00) |= USART_STAT_TC;
+        }
+    }
+    if( _usart.rx_head != _usart.rx_tail && _usart.rx_next == _ev ) {
+        uint8_t byte = _usart.rx[_usart.rx_tail++ % MOCK_USART_SIZE];
+        if( usart_on() && (USART0_REG(0x0C) & USART_CTL0_REN) ) {
+            if( USART0_REG(0x00) & USART_STAT_RBNE ) {
+                USART0_REG(0x00) |= USART_STAT_ORERR;
+            }
+            else {
+                _usart.received = byte;
+                USART0_REG(0x04) = byte;
+                USART0_REG(0x00) |= USART_STAT_RBNE;
+            }
+        }
+        _usart.rx_next = _ev + usart_byte_time();
+    }
+    usart_service();
+}
+
+static void usart_reset( void ) {
+    for( uint32_t offset = 0; offset <= 0x18; offset += 4 ) USART0_REG(offset) = 0;
+    USART0_REG(0x00) = USART_STAT_TBE | USART_STAT_TC;
+    _usart.shifting = _usart.full = 0;
+}
+
+
+/*
+Dma
+*/
+
+static void reg_written( uint32_t addr, uint32_t old, uint32_t value );
+static void reg_read( uint32_t addr );
+static void sync_register( uint32_t addr );
+
+static inline uint32_t dma_base( int channel ) {
+    return (channel & 8) ? DMA1 : DMA0;
+}
+
+static inline uint32_t dma_reg( int channel, uint32_t offset ) {
+    return dma_base(channel) + offset + 0x14 * (channel & 7);
+}
+
+static int dma_ready( int channel ) {
+    return (R(dma_reg(channel, 0x08)) & DMA_CHXCTL_CHEN) && (R(dma_reg(channel, 0x0C)) & 0xffff);
+}
+
+static int is_periph( uint32_t addr ) {
+    return addr >= PERIPH_BASE && addr < PERIPH_BASE + PERIPH_SIZE;
+}
+
+static void *host_address( uint32_t addr ) {
+    return (void *)(_ram_high | addr);
+}
+
+static uint32_t item_read( uint32_t addr, uint32_t width ) {
+    if( is_periph(addr) ) {
+        sync_register(addr);
+        uint32_t value = R(addr);
+        reg_read(addr);
+        return value;
+    }
+    void *p = host_address(addr);
+    return width == 1 ? *(uint8_t *)p : width == 2 ? *(uint16_t *)p : *(uint32_t *)p;
+}
+
+static void item_write( uint32_t addr, uint32_t width, uint32_t value ) {
+    if( width == 1 ) value &= 0xff;
+    if( width == 2 ) value &= 0xffff;
+    if( is_periph(addr) ) {
+        sync_register(addr);
+        uint32_t old = R(addr);
+        R(addr) = value;
+        reg_written(addr, old, value);
+        return;
+    }
+    void *p = host_address(addr);
+    if( width == 1 ) *(uint8_t *)p = value;
+    else if( width == 2 ) *(uint16_t *)p = value;
+    else *(uint32_t *)p = value;
+}
+
+// One transfer of a channel, if it is enabled and has items left
+static void dma_request( int channel ) {
+    if( channel < 0 || !dma_ready(channel) ) return;
+    struct mock_dma_channel *s = &_dma[channel >> 3][channel & 7];
+    uint32_t ctl = R(dma_reg(channel, 0x08));
+    uint32_t pwidth = 1U << ((ctl >> 8) & 3);
+    uint32_t mwidth = 1U << ((ctl >> 10) & 3);
+    uint32_t periph = R(dma_reg(channel, 0x10)) + ((ctl & DMA_CHXCTL_PNAGA) ? s->index * pwidth : 0);
+    uint32_t memory = R(dma_reg(channel, 0x14)) + ((ctl & DMA_CHXCTL_MNAGA) ? s->index * mwidth : 0);
+    uint32_t count = (R(dma_reg(channel, 0x0C)) & 0xffff) - 1;
+    s->index++;
+    R(dma_reg(channel, 0x0C)) = count;
+
+    uint32_t flags = DMA_FLAG_G;
+    if( s->total - count == s->total / 2 ) flags |= DMA_FLAG_HTF;
+    if( count == 0 ) {
+        flags |= DMA_FLAG_FTF;
+        if( ctl & DMA_CHXCTL_CMEN ) {
+            R(dma_reg(channel, 0x0C)) = s->total;
+            s->index = 0;
+        }
+    }
+    R(dma_base(channel)) |= flags << (4 * (channel & 7));
+
+    if( ctl & DMA_CHXCTL_DIR ) item_write(periph, pwidth, item_read(memory, mwidth));
+    else item_write(memory, mwidth, item_read(periph, pwidth));
+}
+
+
+/*
+Interrupts
+*/
+
+static void (*const _handlers[MOCK_SOURCES])( void );
+
+static int irq_pending( uint32_t irq ) {
+    if( irq == CLIC_INT_TMR ) return _mtime >= mtimecmp();
+    if( irq >= DMA0_Channel0_IRQn && irq <= DMA0_Channel6_IRQn ) {
+        int ch = irq - DMA0_Channel0_IRQn;
+        return (R(DMA0) >> (4 * ch)) & R(dma_reg(ch, 0x08)) & 0xe;
+    }
+    if( irq >= DMA1_Channel0_IRQn && irq <= DMA1_Channel4_IRQn ) {
+        int ch = 8 + irq - DMA1_Channel0_IRQn;
+        return (R(DMA1) >> (4 * (ch & 7))) & R(dma_reg(ch, 0x08)) & 0xe;
+    }
+    struct mock_timer *t = 0;
+    uint32_t mask = 0x1f;
+    switch( irq ) {
+        case TIMER0_UP_IRQn:      t = &_timers[0]; mask = TIMER_INTF_UPIF; break;
+        case TIMER0_Channel_IRQn: t = &_timers[0]; mask = 0x1e; break;
+        case TIMER1_IRQn:         t = &_timers[1]; break;
+        case TIMER2_IRQn:         t = &_timers[2]; break;
+        case TIMER3_IRQn:         t = &_timers[3]; break;
+        case TIMER4_IRQn:         t = &_timers[4]; break;
+        case USART0_IRQn: {
+            uint32_t stat = USART0_REG(0x00), ctl0 = USART0_REG(0x0C);
+            return ((ctl0 & USART_CTL0_RBNEIE) && (stat & (USART_STAT_RBNE | USART_STAT_ORERR)))
+                || ((ctl0 & USART_CTL0_TBEIE) && (stat & USART_STAT_TBE))
+                || ((ctl0 & USART_CTL0_TCIE) && (stat & USART_STAT_TC));
+        }
+        default: return 0;
+    }
+    return tim_reg(t, 0x10) & tim_reg(t, 0x0C) & mask;
+}
+
+// Note when enabled interrupts become pending, for latencies
+static void irq_scan( void ) {
+    for( uint32_t irq = 0; irq < MOCK_SOURCES; irq++ ) {
+        if( !_ie[irq] ) continue;
+        int pending = irq_pending(irq) != 0;
+        if( pending && !_pending[irq] ) _pending_at[irq] = _ev;
+        _pending[irq] = pending;
+    }
+}
+
+
+/*
+Simulation
+*/
+
+// Process everything that happens up to the cpu time
+static void advance( void ) {
+    for( ;; ) {
+        uint64_t when = usart_event();
+        struct mock_timer *next = 0;
+        for( int i = 0; i < 5; i++ ) {
+            uint64_t at = tim_event(&_timers[i]);
+            if( at < when ) {
+                when = at;
+                next = &_timers[i];
+            }
+        }
+        if( when > _now ) break;
+        _ev = when;
+        sync_mtime();
+        if( next ) tim_step(next, tim_steps(next));
+        else usart_step();
+        irq_scan();
+    }
+    _ev = _now;
+    sync_mtime();
+    irq_scan();
+}
+
+// Next time something could make an interrupt pending
+static uint64_t next_event( void ) {
+    uint64_t when = usart_event();
+    for( int i = 0; i < 5; i++ ) {
+        uint64_t at = tim_event(&_timers[i]);
+        if( at < when ) when = at;
+    }
+    if( _ie[CLIC_INT_TMR] ) {
+        uint64_t at = mtime_event();
+        if( at > _now && at < when ) when = at;
+    }
+    return when;
+}
+
+static void run_irq( uint32_t irq ) {
+    void (*handler)( void ) = _handlers[irq];
+    if( !handler ) {
+        fprintf(stderr, "mock: interrupt %u enabled and pending without handler\n", irq);
+        abort();
+    }
+    uint64_t pending_at = _pending_at[irq];
+    int level = _level;
+    uint32_t mstatus = _mstatus;
+    uint64_t start = _now;
+
+    spend(_vmode[irq] ? MOCK_IRQ_ENTRY_VECTORED : MOCK_IRQ_ENTRY);
+    advance();
+    _level = _level_of[irq];
+    if( _vmode[irq] ) _mstatus &= ~MSTATUS_MIE; // non-vectored entry enables nesting
+    _depth++;
+    int scope = _in_mock; // the handler is program code
+    _in_mock = 0;
+    if( _counting ) trap_flag(1);
+    handler();
+    _in_mock = scope;
+    _depth--;
+    spend(_vmode[irq] ? MOCK_IRQ_EXIT_VECTORED : MOCK_IRQ_EXIT);
+    advance();
+    _level = level;
+    _mstatus = mstatus;
+
+    struct mock_irq_stat *s = &_irq_stats[irq];
+    uint32_t cycles = (_now - start) / ahb_div();
+    uint32_t latency = (start - pending_at) / ahb_div();
+    s->count++;
+    s->cycles += cycles;
+    if( cycles > s->max_cycles ) s->max_cycles = cycles;
+    if( latency > s->max_latency ) s->max_latency = latency;
+    _pending[irq] = 0;
+    irq_scan();
+}
+
+// Serve pending interrupts above the current level, highest level first
+static void dispatch( void ) {
+    while( (_mstatus & MSTATUS_MIE) && _depth < 16 ) {
+        int best = -1;
+        int level = _level;
+        for( uint32_t irq = 0; irq < MOCK_SOURCES; irq++ ) {
+            if( _ie[irq] && _level_of[irq] > _level && _level_of[irq] >= level && irq_pending(irq) ) {
+                best = irq;
+                level = _level_of[irq];
+            }
+        }
+        if( best < 0 ) return;
+        run_irq(best);
+    }
+}
+
+// Cost of an sdk call and a chance for interrupts
+#define SDK_CALL() MOCK_SCOPE(); sdk_call()
+
+static void sdk_call( void ) {
+    spend(MOCK_CALL);
+    advance();
+    dispatch();
+}
+
+
+/*
+Register semantics
+*/
+
+// Live registers: counters, direction, received data and mtime
+static void sync_register( uint32_t addr ) {
+    if( addr >= CORE_BASE ) {
+        R(CORE_BASE + TIMER_MTIME) = (uint32_t)_mtime;
+        R(CORE_BASE + TIMER_MTIME + 4) = (uint32_t)(_mtime >> 32);
+        return;
+    }
+    struct mock_timer *t = timer_of(addr);
+    if( t ) tim_sync(t);
+    if( addr == USART0 + 0x04 ) R(addr) = _usart.received;
+}
+
+static void reg_read( uint32_t addr ) {
+    if( addr == USART0 + 0x04 ) { // reading data clears receive flags
+        USART0_REG(0x00) &= ~(USART_STAT_RBNE | USART_STAT_ORERR | USART_STAT_IDLEF);
+        irq_scan();
+    }
+}
+
+static void timer_written( struct mock_timer *t, uint32_t offset, uint32_t old, uint32_t value ) {
+    switch( offset ) {
+        case 0x00:
+            if( (value & ~old) & TIMER_CTL0_CEN ) t->next = _ev + tim_tick(t);
+            if( (value >> 5) & 3 ) { // direction is read only center aligned
+                R(t->base) = (value & ~TIMER_CTL0_DIR) | (t->down ? TIMER_CTL0_DIR : 0);
+            }
+            else {
+                t->down = 0;
+            }
+            pads_of_timer(t);
+            break;
+        case 0x10: // flags are cleared by writing 0
+            R(t->base + 0x10) = old & value;
+            break;
+        case 0x14:
+            R(t->base + 0x14) = 0;
+            R(t->base + 0x10) |= value & 0x1e;
+            if( value & TIMER_SWEVG_UPG ) tim_generate(t);
+            break;
+        case 0x18:
+        case 0x1C:
+        case 0x20:
+        case 0x44:
+            pads_of_timer(t);
+            break;
+        case 0x24:
+            t->cnt = value;
+            pads_of_timer(t);
+            break;
+        case 0x2C:
+            if( !(tim_reg(t, 0x00) & TIMER_CTL0_ARSE) ) t->car = value & 0xffff;
+            break;
+        case 0x34:
+        case 0x38:
+        case 0x3C:
+        case 0x40: {
+            int c = (offset - 0x34) / 4;
+            if( !tim_compare(t, c) || !(tim_field(t, c) & 8) ) t->cv[c] = value & 0xffff;
+            pads_of_timer(t);
+            break;
+        }
+        case 0x4C: { // dma burst register: the write goes to DMATA + transfer index
+            uint32_t target = t->base + 4 * ((tim_reg(t, 0x48) & 0x1f) + t->burst);
+            t->burst_hit = 1;
+            R(t->base + 0x4C) = 0;
+            uint32_t previous = R(target);
+            R(target) = value;
+            timer_written(t, target - t->base, previous, value);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void gpio_written( int bank, uint32_t offset, uint32_t old, uint32_t value ) {
+    uint32_t port = GPIOA + 0x400 * bank;
+    uint32_t octl = R(port + 0x0C);
+    switch( offset ) {
+        case 0x00:
+        case 0x04:
+            pads_of_bank(bank, 0xffff);
+            return;
+        case 0x08: // input status is read only
+            R(port + 0x08) = old;
+            return;
+        case 0x0C:
+            pads_of_bank(bank, (old ^ value) & 0xffff);
+            return;
+        case 0x10: // set wins over reset
+            R(port + 0x0C) = (octl & ~(value >> 16)) | (value & 0xffff);
+            R(port + 0x10) = 0;
+            break;
+        case 0x14:
+            R(port + 0x0C) = octl & ~(value & 0xffff);
+            R(port + 0x14) = 0;
+            break;
+        default:
+            return;
+    }
+    pads_of_bank(bank, (octl ^ R(port + 0x0C)) & 0xffff);
+}
+
+static void dma_written( uint32_t base, uint32_t offset, uint32_t old, uint32_t value ) {
+    int d = (base == DMA1) ? 8 : 0;
+    if( offset == 0x00 ) { // flags are read only
+        R(base) = old;
+        return;
+    }
+    if( offset == 0x04 ) {
+        uint32_t clear = value;
+        for( int ch = 0; ch < 7; ch++ ) {
+            if( value & (DMA_FLAG_G << (4 * ch)) ) clear |= 0xfU << (4 * ch);
+        }
+        R(base) &= ~clear;
+        R(base + 0x04) = 0;
+        return;
+    }
+    int ch = (offset - 0x08) / 0x14;
+    if( ch < 7 && (offset - 0x08) % 0x14 == 0 && ((value & ~old) & DMA_CHXCTL_CHEN) ) {
+        _dma[d ? 1 : 0][ch].total = R(dma_reg(d + ch, 0x0C)) & 0xffff;
+        _dma[d ? 1 : 0][ch].index = 0;
+        if( !d ) usart_service();
+    }
+}
+
+static void usart_written( uint32_t offset, uint32_t old, uint32_t value ) {
+    switch( offset ) {
+        case 0x00: // transmit complete and receive flags are cleared by writing 0
+            USART0_REG(0x00) = old & ~(~value & (USART_STAT_TC | USART_STAT_RBNE));
+            break;
+        case 0x04:
+            USART0_REG(0x04) = _usart.received;
+            usart_transmit(value);
+            usart_service();
+            break;
+        default:
+            usart_service();
+            break;
+    }
+}
+
+static void rcu_written( uint32_t offset, uint32_t old, uint32_t value ) {
+    if( offset != 0x04 ) return;
+    // clocks changed: running counters continue with the new timer clock
+    for( int i = 0; i < 5; i++ ) {
+        if( tim_running(&_timers[i]) ) _timers[i].next = _ev + tim_tick(&_timers[i]);
+    }
+    if( _usart.shifting ) _usart.shift_end = _ev + usart_byte_time();
+}
+
+static void reg_written( uint32_t addr, uint32_t old, uint32_t value ) {
+    struct mock_timer *t;
+    _spin_reads = 0;
+    if( addr >= CORE_BASE ) {
+        if( addr - CORE_BASE < 8 ) { // mtime
+            _mtime = (uint64_t)R(CORE_BASE + 4) << 32 | R(CORE_BASE);
+            _mtime_at = _ev;
+        }
+    }
+    else if( (t = timer_of(addr)) ) {
+        timer_written(t, addr - t->base, old, value);
+    }
+    else if( addr >= GPIOA && addr < GPIOA + 5 * 0x400 ) {
+        gpio_written((addr - GPIOA) / 0x400, addr % 0x400, old, value);
+    }
+    else if( addr == AFIO + 0x04 ) {
+        pads_all();
+    }
+    else if( addr >= DMA0 && addr < DMA0 + 0x800 ) {
+        dma_written(addr & ~0x3ffU, addr & 0x3ff, old, value);
+    }
+    else if( addr >= USART0 && addr < USART0 + 0x400 ) {
+        usart_written(addr - USART0, old, value);
+    }
+    else if( addr >= RCU_BASE && addr < RCU_BASE + 0x400 ) {
+        rcu_written(addr - RCU_BASE, old, value);
+    }
+    irq_scan();
+}
+
+// Register access of sdk functions
+static uint32_t rd( uint32_t addr ) {
+    spend(access_cost(addr));
+    advance();
+    sync_register(addr);
+    uint32_t value = R(addr);
+    reg_read(addr);
+    return value;
+}
+
+static void wr( uint32_t addr, uint32_t value ) {
+    spend(access_cost(addr));
+    advance();
+    sync_register(addr);
+    uint32_t old = R(addr);
+    R(addr) = value;
+    reg_written(addr, old, value);
+}
+
+#define SET(addr, bits)   wr((addr), rd(addr) | (bits))
+#define CLEAR(addr, bits) wr((addr), rd(addr) & ~(bits))
+
+
+/*
+Register access of the program
+*/
+
+// Busy wait: the program reads the same value from a register again and again.
+// Nothing it sees changes before the next event, so skip there
+static void spin_check( uint32_t addr ) {
+    uint32_t value = R(addr);
+    if( addr != _spin_addr || value != _spin_value ) {
+        _spin_addr = addr;
+        _spin_value = value;
+        _spin_reads = 0;
+    }
+    if( ++_spin_reads < MOCK_SPIN_READS || _counting || !_spin_skip ) return;
+    _spin_reads = 0;
+    uint64_t when = next_event();
+    if( when == NEVER || when <= _now ) return;
+    _now = when;
+    advance();
+    dispatch();
+    sync_register(addr);
+}
+
+static uint32_t reg_address( volatile uint32_t *r ) {
+    uintptr_t addr = (uintptr_t)r;
+    int periph = addr >= PERIPH_BASE && addr < PERIPH_BASE + PERIPH_SIZE;
+    int core = addr >= CORE_BASE && addr < CORE_BASE + CORE_SIZE;
+    if( (addr & 3) || !(periph || core) ) {
+        fprintf(stderr, "mock: no register at %p\n", (void *)r);
+        abort();
+    }
+    return addr;
+}
+
+MOCK_ACCESS uint32_t mock_load( volatile uint32_t *r ) {
+    MOCK_SCOPE();
+    uint32_t addr = reg_address(r);
+    spend(access_cost(addr));
+    advance();
+    dispatch(); // interrupts come before the access, their handlers access registers too
+    sync_register(addr);
+    spin_check(addr);
+    uint32_t value = R(addr);
+    reg_read(addr);
+    return value;
+}
+
+MOCK_ACCESS void mock_store( volatile uint32_t *r, uint32_t value ) {
+    MOCK_SCOPE();
+    uint32_t addr = reg_address(r);
+    spend(access_cost(addr));
+    advance();
+    dispatch();
+    sync_register(addr);
+    uint32_t old = R(addr);
+    R(addr) = value;
+    reg_written(addr, old, value);
+}
+
+
+/*
+Sdk: rcu
+*/
+
+void rcu_periph_clock_enable( rcu_periph_enum periph ) {
+    SDK_CALL();
+    SET(RCU_BASE + (periph >> 6), 1U << (periph & 0x1f));
+}
+
+void rcu_periph_clock_disable( rcu_periph_enum periph ) {
+    SDK_CALL();
+    CLEAR(RCU_BASE + (periph >> 6), 1U << (periph & 0x1f));
+}
+
+void rcu_periph_clock_sleep_enable( rcu_periph_sleep_enum periph ) {
+    SDK_CALL();
+    SET(RCU_BASE + (periph >> 6), 1U << (periph & 0x1f));
+}
+
+void rcu_periph_clock_sleep_disable( rcu_periph_sleep_enum periph ) {
+    SDK_CALL();
+    CLEAR(RCU_BASE + (periph >> 6), 1U << (periph & 0x1f));
+}
+
+void rcu_ahb_clock_config( uint32_t ck_ahb ) {
+    SDK_CALL();
+    wr(RCU_BASE + 0x04, (rd(RCU_BASE + 0x04) & ~RCU_CFG0_AHBPSC) | ck_ahb);
+}
+
+void rcu_apb1_clock_config( uint32_t ck_apb1 ) {
+    SDK_CALL();
+    wr(RCU_BASE + 0x04, (rd(RCU_BASE + 0x04) & ~RCU_CFG0_APB1PSC) | ck_apb1);
+}
+
+void rcu_apb2_clock_config( uint32_t ck_apb2 ) {
+    SDK_CALL();
+    wr(RCU_BASE + 0x04, (rd(RCU_BASE + 0x04) & ~RCU_CFG0_APB2PSC) | ck_apb2);
+}
+
+uint32_t rcu_clock_freq_get( rcu_clock_freq_enum clock ) {
+    SDK_CALL();
+    rd(RCU_BASE + 0x04);
+    uint32_t ahb = MOCK_SYS_HZ / ahb_div();
+    switch( clock ) {
+        case CK_SYS:  return MOCK_SYS_HZ;
+        case CK_AHB:  return ahb;
+        case CK_APB1: return ahb / apb_div(0);
+        case CK_APB2: return ahb / apb_div(1);
+    }
+    return 0;
+}
+
+void SystemCoreClockUpdate( void ) {
+    SDK_CALL();
+    SystemCoreClock = MOCK_SYS_HZ / ahb_div();
+}
+
+
+/*
+Sdk: gpio
+*/
+
+void gpio_deinit( uint32_t gpio_periph ) {
+    SDK_CALL();
+    wr(gpio_periph + 0x00, 0x44444444);
+    wr(gpio_periph + 0x04, 0x44444444);
+    wr(gpio_periph + 0x0C, 0);
+}
+
+void gpio_init( uint32_t gpio_periph, uint32_t mode, uint32_t speed, uint32_t pin ) {
+    SDK_CALL();
+    uint32_t nibble = mode & 0x0f;
+    if( mode & 0x10 ) nibble |= speed;
+    for( uint32_t i = 0; i < 16; i++ ) {
+        if( !(pin & (1U << i)) ) continue;
+        uint32_t ctl = gpio_periph + (i < 8 ? 0x00 : 0x04);
+        uint32_t shift = (i & 7) * 4;
+        uint32_t reg = rd(ctl) & ~(0xfU << shift);
+        if( mode == GPIO_MODE_IPD ) wr(gpio_periph + 0x14, 1U << i);
+        if( mode == GPIO_MODE_IPU ) wr(gpio_periph + 0x10, 1U << i);
+        wr(ctl, reg | nibble << shift);
+    }
+}
+
+void gpio_bit_set( uint32_t gpio_periph, uint32_t pin ) {
+    SDK_CALL();
+    wr(gpio_periph + 0x10, pin);
+}
+
+void gpio_bit_reset( uint32_t gpio_periph, uint32_t pin ) {
+    SDK_CALL();
+    wr(gpio_periph + 0x14, pin);
+}
+
+FlagStatus gpio_input_bit_get( uint32_t gpio_periph, uint32_t pin ) {
+    SDK_CALL();
+    return (rd(gpio_periph + 0x08) & pin) ? SET : RESET;
+}
+
+FlagStatus gpio_output_bit_get( uint32_t gpio_periph, uint32_t pin ) {
+    SDK_CALL();
+    return (rd(gpio_periph + 0x0C) & pin) ? SET : RESET;
+}
+
+void gpio_pin_remap_config( uint32_t remap, ControlStatus newvalue ) {
+    SDK_CALL();
+    uint32_t mask = remap & 0xffff;
+    if( remap & 0x00100000 ) mask = 3U << ((remap >> 16) & 0xf); // two bit field
+    if( remap & 0x00200000 ) return;                              // debug port remaps are not modeled
+    uint32_t pcf0 = rd(AFIO + 0x04) & ~mask;
+    if( newvalue == ENABLE ) pcf0 |= remap & 0xffff;
+    wr(AFIO + 0x04, pcf0);
+}
+
+
+/*
+Sdk: timer
+*/
+
+static uint32_t channel_ctl( uint32_t timer_periph, uint16_t channel ) {
+    return timer_periph + (channel < 2 ? 0x18 : 0x1C);
+}
+
+void timer_deinit( uint32_t timer_periph ) {
+    SDK_CALL();
+    spend(access_cost(timer_periph));
+    struct mock_timer *t = timer_of(timer_periph);
+    if( t ) tim_reset(t);
+    pads_all();
+    irq_scan();
+}
+
+void timer_init( uint32_t timer_periph, timer_parameter_struct *initpara ) {
+    SDK_CALL();
+    wr(timer_periph + 0x28, initpara->prescaler);
+    uint32_t ctl0 = rd(timer_periph) & ~(TIMER_CTL0_DIR | TIMER_CTL0_CAM);
+    wr(timer_periph, ctl0 | initpara->alignedmode | initpara->counterdirection);
+    wr(timer_periph + 0x2C, initpara->period);
+    wr(timer_periph, (rd(timer_periph) & ~TIMER_CTL0_CKDIV) | initpara->clockdivision);
+    if( timer_periph == TIMER0 ) wr(timer_periph + 0x30, initpara->repetitioncounter);
+    SET(timer_periph + 0x14, TIMER_SWEVG_UPG);
+}
+
+void timer_enable( uint32_t timer_periph ) {
+    SDK_CALL();
+    SET(timer_periph, TIMER_CTL0_CEN);
+}
+
+void timer_disable( uint32_t timer_periph ) {
+    SDK_CALL();
+    CLEAR(timer_periph, TIMER_CTL0_CEN);
+}
+
+void timer_update_event_enable( uint32_t timer_periph ) {
+    SDK_CALL();
+    CLEAR(timer_periph, TIMER_CTL0_UPDIS);
+}
+
+void timer_update_event_disable( uint32_t timer_periph ) {
+    SDK_CALL();
+    SET(timer_periph, TIMER_CTL0_UPDIS);
+}
+
+void timer_auto_reload_shadow_enable( uint32_t timer_periph ) {
+    SDK_CALL();
+    SET(timer_periph, TIMER_CTL0_ARSE);
+}
+
+void timer_auto_reload_shadow_disable( uint32_t timer_periph ) {
+    SDK_CALL();
+    CLEAR(timer_periph, TIMER_CTL0_ARSE);
+}
+
+void timer_autoreload_value_config( uint32_t timer_periph, uint16_t autoreload ) {
+    SDK_CALL();
+    wr(timer_periph + 0x2C, autoreload);
+}
+
+void timer_counter_value_config( uint32_t timer_periph, uint16_t counter ) {
+    SDK_CALL();
+    wr(timer_periph + 0x24, counter);
+}
+
+uint32_t timer_counter_read( uint32_t timer_periph ) {
+    SDK_CALL();
+    return rd(timer_periph + 0x24);
+}
+
+void timer_event_software_generate( uint32_t timer_periph, uint16_t event ) {
+    SDK_CALL();
+    SET(timer_periph + 0x14, event);
+}
+
+void timer_primary_output_config( uint32_t timer_periph, ControlStatus newvalue ) {
+    SDK_CALL();
+    if( newvalue == ENABLE ) SET(timer_periph + 0x44, TIMER_CCHP_POEN);
+    else CLEAR(timer_periph + 0x44, TIMER_CCHP_POEN);
+}
+
+void timer_channel_output_config( uint32_t timer_periph, uint16_t channel, timer_oc_parameter_struct *ocpara ) {
+    SDK_CALL();
+    uint32_t shift = 4 * channel;
+    uint32_t ctl2 = rd(timer_periph + 0x20) & ~(0xfU << shift);
+    wr(timer_periph + 0x20, ctl2 | (uint32_t)(ocpara->outputstate | ocpara->ocpolarity) << shift);
+    if( timer_periph == TIMER0 ) {
+        SET(timer_periph + 0x20, (uint32_t)(ocpara->outputnstate | ocpara->ocnpolarity) << shift);
+        uint32_t ctl1 = rd(timer_periph + 0x04) & ~(3U << (8 + 2 * channel));
+        wr(timer_periph + 0x04, ctl1 | (uint32_t)(ocpara->ocidlestate | ocpara->ocnidlestate) << (2 * channel));
+    }
+    CLEAR(channel_ctl(timer_periph, channel), 3U << ((channel & 1) * 8)); // output mode
+}
+
+void timer_channel_output_mode_config( uint32_t timer_periph, uint16_t channel, uint16_t ocmode ) {
+    SDK_CALL();
+    uint32_t shift = (channel & 1) * 8;
+    uint32_t ctl = rd(channel_ctl(timer_periph, channel)) & ~(0x70U << shift);
+    wr(channel_ctl(timer_periph, channel), ctl | (uint32_t)ocmode << shift);
+}
+
+void timer_channel_output_pulse_value_config( uint32_t timer_periph, uint16_t channel, uint32_t pulse ) {
+    SDK_CALL();
+    wr(timer_periph + 0x34 + 4 * channel, pulse);
+}
+
+void timer_channel_output_shadow_config( uint32_t timer_periph, uint16_t channel, uint16_t ocshadow ) {
+    SDK_CALL();
+    uint32_t shift = (channel & 1) * 8;
+    uint32_t ctl = rd(channel_ctl(timer_periph, channel)) & ~(0x08U << shift);
+    wr(channel_ctl(timer_periph, channel), ctl | (uint32_t)ocshadow << shift);
+}
+
+void timer_input_capture_config( uint32_t timer_periph, uint16_t channel, timer_ic_parameter_struct *icpara ) {
+    SDK_CALL();
+    uint32_t shift = 4 * channel;
+    CLEAR(timer_periph + 0x20, 0xfU << shift);
+    SET(timer_periph + 0x20, (uint32_t)icpara->icpolarity << shift);
+    uint32_t field = (channel & 1) * 8;
+    uint32_t ctl = rd(channel_ctl(timer_periph, channel)) & ~(0xffU << field);
+    wr(channel_ctl(timer_periph, channel), ctl | ((uint32_t)icpara->icselection | (uint32_t)icpara->icprescaler << 2 | (uint32_t)icpara->icfilter << 4) << field);
+    SET(timer_periph + 0x20, 1U << shift);
+}
+
+void timer_interrupt_enable( uint32_t timer_periph, uint32_t interrupt ) {
+    SDK_CALL();
+    SET(timer_periph + 0x0C, interrupt);
+}
+
+void timer_interrupt_disable( uint32_t timer_periph, uint32_t interrupt ) {
+    SDK_CALL();
+    CLEAR(timer_periph + 0x0C, interrupt);
+}
+
+void timer_interrupt_flag_clear( uint32_t timer_periph, uint32_t interrupt ) {
+    SDK_CALL();
+    wr(timer_periph + 0x10, ~interrupt);
+}
+
+FlagStatus timer_interrupt_flag_get( uint32_t timer_periph, uint32_t interrupt ) {
+    SDK_CALL();
+    uint32_t flags = rd(timer_periph + 0x10);
+    return (flags & interrupt) && (rd(timer_periph + 0x0C) & interrupt) ? SET : RESET;
+}
+
+void timer_dma_enable( uint32_t timer_periph, uint16_t dma ) {
+    SDK_CALL();
+    SET(timer_periph + 0x0C, dma);
+}
+
+void timer_dma_disable( uint32_t timer_periph, uint16_t dma ) {
+    SDK_CALL();
+    CLEAR(timer_periph + 0x0C, dma);
+}
+
+void timer_dma_transfer_config( uint32_t timer_periph, uint32_t dma_baseaddr, uint32_t dma_lenth ) {
+    SDK_CALL();
+    wr(timer_periph + 0x48, dma_baseaddr | dma_lenth);
+}
+
+
+/*
+Sdk: dma
+*/
+
+static uint32_t dma_channel_reg( uint32_t dma_periph, dma_channel_enum channelx, uint32_t offset ) {
+    return dma_periph + offset + 0x14 * channelx;
+}
+
+void dma_deinit( uint32_t dma_periph, dma_channel_enum channelx ) {
+    SDK_CALL();
+    CLEAR(dma_channel_reg(dma_periph, channelx, 0x08), DMA_CHXCTL_CHEN);
+    wr(dma_channel_reg(dma_periph, channelx, 0x08), 0);
+    wr(dma_channel_reg(dma_periph, channelx, 0x0C), 0);
+    wr(dma_channel_reg(dma_periph, channelx, 0x10), 0);
+    wr(dma_channel_reg(dma_periph, channelx, 0x14), 0);
+    wr(dma_periph + 0x04, 0xfU << (4 * channelx));
+}
+
+void dma_struct_para_init( dma_parameter_struct *init_struct ) {
+    MOCK_SCOPE();
+    memset(init_struct, 0, sizeof(*init_struct));
+}
+
+void dma_init( uint32_t dma_periph, dma_channel_enum channelx, dma_parameter_struct *init_struct ) {
+    SDK_CALL();
+    wr(dma_channel_reg(dma_periph, channelx, 0x10), init_struct->periph_addr);
+    wr(dma_channel_reg(dma_periph, channelx, 0x14), init_struct->memory_addr);
+    wr(dma_channel_reg(dma_periph, channelx, 0x0C), init_struct->number & 0xffff);
+    uint32_t ctl = rd(dma_channel_reg(dma_periph, channelx, 0x08));
+    ctl &= ~(DMA_CHXCTL_PWIDTH | DMA_CHXCTL_MWIDTH | DMA_CHXCTL_PRIO | DMA_CHXCTL_PNAGA | DMA_CHXCTL_MNAGA | DMA_CHXCTL_DIR);
+    ctl |= init_struct->periph_width | init_struct->memory_width | init_struct->priority;
+    if( init_struct->periph_inc == DMA_PERIPH_INCREASE_ENABLE ) ctl |= DMA_CHXCTL_PNAGA;
+    if( init_struct->memory_inc == DMA_MEMORY_INCREASE_ENABLE ) ctl |= DMA_CHXCTL_MNAGA;
+    if( init_struct->direction == DMA_MEMORY_TO_PERIPHERAL ) ctl |= DMA_CHXCTL_DIR;
+    wr(dma_channel_reg(dma_periph, channelx, 0x08), ctl);
+}
+
+void dma_circulation_enable( uint32_t dma_periph, dma_channel_enum channelx ) {
+    SDK_CALL();
+    SET(dma_channel_reg(dma_periph, channelx, 0x08), DMA_CHXCTL_CMEN);
+}
+
+void dma_circulation_disable( uint32_t dma_periph, dma_channel_enum channelx ) {
+    SDK_CALL();
+    CLEAR(dma_channel_reg(dma_periph, channelx, 0x08), DMA_CHXCTL_CMEN);
+}
+
+void dma_memory_to_memory_disable( uint32_t dma_periph, dma_channel_enum channelx ) {
+    SDK_CALL();
+    CLEAR(dma_channel_reg(dma_periph, channelx, 0x08), DMA_CHXCTL_M2M);
+}
+
+void dma_channel_enable( uint32_t dma_periph, dma_channel_enum channelx ) {
+    SDK_CALL();
+    SET(dma_channel_reg(dma_periph, channelx, 0x08), DMA_CHXCTL_CHEN);
+}
+
+void dma_channel_disable( uint32_t dma_periph, dma_channel_enum channelx ) {
+    SDK_CALL();
+    CLEAR(dma_channel_reg(dma_periph, channelx, 0x08), DMA_CHXCTL_CHEN);
+}
+
+void dma_periph_address_config( uint32_t dma_periph, dma_channel_enum channelx, uint32_t address ) {
+    SDK_CALL();
+    wr(dma_channel_reg(dma_periph, channelx, 0x10), address);
+}
+
+void dma_memory_address_config( uint32_t dma_periph, dma_channel_enum channelx, uint32_t address ) {
+    SDK_CALL();
+    wr(dma_channel_reg(dma_periph, channelx, 0x14), address);
+}
+
+void dma_transfer_number_config( uint32_t dma_periph, dma_channel_enum channelx, uint32_t number ) {
+    SDK_CALL();
+    wr(dma_channel_reg(dma_periph, channelx, 0x0C), number & 0xffff);
+}
+
+uint32_t dma_transfer_number_get( uint32_t dma_periph, dma_channel_enum channelx ) {
+    SDK_CALL();
+    return rd(dma_channel_reg(dma_periph, channelx, 0x0C));
+}
+
+FlagStatus dma_flag_get( uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag ) {
+    SDK_CALL();
+    return (rd(dma_periph) & DMA_FLAG_ADD(flag, channelx)) ? SET : RESET;
+}
+
+void dma_flag_clear( uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag ) {
+    SDK_CALL();
+    wr(dma_periph + 0x04, DMA_FLAG_ADD(flag, channelx));
+}
+
+FlagStatus dma_interrupt_flag_get( uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag ) {
+    SDK_CALL();
+    uint32_t enabled = rd(dma_channel_reg(dma_periph, channelx, 0x08)) & flag & 0xe;
+    return ((rd(dma_periph) & DMA_FLAG_ADD(flag, channelx)) && (enabled || flag == DMA_INT_FLAG_G)) ? SET : RESET;
+}
+
+void dma_interrupt_flag_clear( uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag ) {
+    SDK_CALL();
+    wr(dma_periph + 0x04, DMA_FLAG_ADD(flag, channelx));
+}
+
+void dma_interrupt_enable( uint32_t dma_periph, dma_channel_enum channelx, uint32_t source ) {
+    SDK_CALL();
+    SET(dma_channel_reg(dma_periph, channelx, 0x08), source);
+}
+
+void dma_interrupt_disable( uint32_t dma_periph, dma_channel_enum channelx, uint32_t source ) {
+    SDK_CALL();
+    CLEAR(dma_channel_reg(dma_periph, channelx, 0x08), source);
+}
+
+
+/*
+Sdk: usart, only USART0 is modeled
+*/
+
+void usart_deinit( uint32_t usart_periph ) {
+    SDK_CALL();
+    spend(access_cost(usart_periph));
+    if( usart_periph == USART0 ) usart_reset();
+    irq_scan();
+}
+
+void usart_baudrate_set( uint32_t usart_periph, uint32_t baudval ) {
+    SDK_CALL();
+    uint32_t clock = rcu_clock_freq_get(usart_periph == USART0 ? CK_APB2 : CK_APB1);
+    wr(usart_periph + 0x08, ((clock + baudval / 2) / baudval) & 0xffff);
+}
+
+void usart_word_length_set( uint32_t usart_periph, uint32_t wlen ) {
+    SDK_CALL();
+    wr(usart_periph + 0x0C, (rd(usart_periph + 0x0C) & ~USART_WL_9BIT) | wlen);
+}
+
+void usart_stop_bit_set( uint32_t usart_periph, uint32_t stblen ) {
+    SDK_CALL();
+    wr(usart_periph + 0x10, (rd(usart_periph + 0x10) & ~(3U << 12)) | stblen);
+}
+
+void usart_parity_config( uint32_t usart_periph, uint32_t paritycfg ) {
+    SDK_CALL();
+    wr(usart_periph + 0x0C, (rd(usart_periph + 0x0C) & ~(3U << 9)) | paritycfg);
+}
+
+void usart_hardware_flow_rts_config( uint32_t usart_periph, uint32_t rtsconfig ) {
+    SDK_CALL();
+    wr(usart_periph + 0x14, (rd(usart_periph + 0x14) & ~BIT(8)) | rtsconfig);
+}
+
+void usart_hardware_flow_cts_config( uint32_t usart_periph, uint32_t ctsconfig ) {
+    SDK_CALL();
+    wr(usart_periph + 0x14, (rd(usart_periph + 0x14) & ~BIT(9)) | ctsconfig);
+}
+
+void usart_receive_config( uint32_t usart_periph, uint32_t rxconfig ) {
+    SDK_CALL();
+    wr(usart_periph + 0x0C, (rd(usart_periph + 0x0C) & ~USART_CTL0_REN) | rxconfig);
+}
+
+void usart_transmit_config( uint32_t usart_periph, uint32_t txconfig ) {
+    SDK_CALL();
+    wr(usart_periph + 0x0C, (rd(usart_periph + 0x0C) & ~USART_CTL0_TEN) | txconfig);
+}
+
+void usart_enable( uint32_t usart_periph ) {
+    SDK_CALL();
+    SET(usart_periph + 0x0C, USART_CTL0_UEN);
+}
+
+void usart_disable( uint32_t usart_periph ) {
+    SDK_CALL();
+    CLEAR(usart_periph + 0x0C, USART_CTL0_UEN);
+}
+
+void usart_interrupt_enable( uint32_t usart_periph, usart_interrupt_enum interrupt ) {
+    SDK_CALL();
+    SET(usart_periph + ((interrupt & 0xffff) >> 6), 1U << (interrupt & 0x1f));
+}
+
+void usart_interrupt_disable( uint32_t usart_periph, usart_interrupt_enum interrupt ) {
+    SDK_CALL();
+    CLEAR(usart_periph + ((interrupt & 0xffff) >> 6), 1U << (interrupt & 0x1f));
+}
+
+FlagStatus usart_interrupt_flag_get( uint32_t usart_periph, usart_interrupt_flag_enum int_flag ) {
+    SDK_CALL();
+    uint32_t enabled = rd(usart_periph + ((int_flag & 0xffff) >> 6)) & (1U << (int_flag & 0x1f));
+    uint32_t flag = rd(usart_periph + (int_flag >> 22)) & (1U << ((int_flag >> 16) & 0x1f));
+    return (enabled && flag) ? SET : RESET;
+}
+
+void usart_interrupt_flag_clear( uint32_t usart_periph, usart_interrupt_flag_enum int_flag ) {
+    SDK_CALL();
+    wr(usart_periph + (int_flag >> 22), ~(1U << ((int_flag >> 16) & 0x1f)));
+}
+
+void usart_data_transmit( uint32_t usart_periph, uint32_t data ) {
+    SDK_CALL();
+    wr(usart_periph + 0x04, data & 0x1ff);
+}
+
+uint16_t usart_data_receive( uint32_t usart_periph ) {
+    SDK_CALL();
+    return rd(usart_periph + 0x04) & 0x1ff;
+}
+
+FlagStatus usart_flag_get( uint32_t usart_periph, usart_flag_enum flag ) {
+    SDK_CALL();
+    return (rd(usart_periph + (flag >> 6)) & (1U << (flag & 0x1f))) ? SET : RESET;
+}
+
+void usart_dma_transmit_config( uint32_t usart_periph, uint32_t dmacmd ) {
+    SDK_CALL();
+    wr(usart_periph + 0x14, (rd(usart_periph + 0x14) & ~USART_CTL2_DENT) | dmacmd);
+}
+
+void usart_dma_receive_config( uint32_t usart_periph, uint32_t dmacmd ) {
+    SDK_CALL();
+    wr(usart_periph + 0x14, (rd(usart_periph + 0x14) & ~USART_CTL2_DENR) | dmacmd);
+}
+
+
+/*
+Core: eclic, machine timer, csr
+*/
+
+void eclic_init( uint32_t num_irq ) {
+    SDK_CALL();
+    for( uint32_t irq = 0; irq < num_irq && irq < MOCK_SOURCES; irq++ ) {
+        _ie[irq] = _level_of[irq] = _vmode[irq] = 0;
+    }
+}
+
+void eclic_enable_interrupt( uint32_t source ) {
+    SDK_CALL();
+    _ie[source] = 1;
+    irq_scan();
+}
+
+void eclic_disable_interrupt( uint32_t source ) {
+    SDK_CALL();
+    _ie[source] = 0;
+}
+
+void eclic_set_pending( uint32_t source ) {
+    SDK_CALL();
+}
+
+void eclic_clear_pending( uint32_t source ) {
+    SDK_CALL();
+}
+
+void eclic_set_irq_lvl_abs( uint32_t source, uint8_t lvl_abs ) {
+    SDK_CALL();
+    _level_of[source] = lvl_abs;
+}
+
+void eclic_priority_group_set( uint32_t prigroup ) {
+    SDK_CALL();
+}
+
+void eclic_irq_enable( uint32_t source, uint8_t level, uint8_t priority ) {
+    SDK_CALL();
+    _level_of[source] = level;
+    _ie[source] = 1;
+    irq_scan();
+    dispatch();
+}
+
+void eclic_irq_disable( uint32_t source ) {
+    SDK_CALL();
+    _ie[source] = 0;
+}
+
+void eclic_set_vmode( uint32_t source ) {
+    SDK_CALL();
+    _vmode[source] = 1;
+}
+
+void eclic_set_nonvmode( uint32_t source ) {
+    SDK_CALL();
+    _vmode[source] = 0;
+}
+
+void eclic_global_interrupt_enable( void ) {
+    SDK_CALL();
+    _mstatus |= MSTATUS_MIE;
+    dispatch();
+}
+
+void eclic_global_interrupt_disable( void ) {
+    SDK_CALL();
+    _mstatus &= ~MSTATUS_MIE;
+}
+
+uint64_t get_timer_value( void ) {
+    SDK_CALL();
+    spend(2 * MOCK_AHB_ACCESS);
+    advance();
+    return _mtime;
+}
+
+uint32_t get_timer_freq( void ) {
+    MOCK_SCOPE();
+    return SystemCoreClock / 4;
+}
+
+unsigned long mock_csr( const char *reg, int op, unsigned long value ) {
+    MOCK_SCOPE();
+    spend(MOCK_CSR);
+    advance();
+    uint32_t *csr;
+    uint32_t counter;
+    if( !strcmp(reg, "mstatus") ) {
+        csr = &_mstatus;
+    }
+    else if( !strcmp(reg, "0x320") || !strcmp(reg, "mcountinhibit") ) {
+        csr = &_mcountinhibit;
+    }
+    else if( !strcmp(reg, "mcycle") || !strcmp(reg, "mcycleh") ) {
+        counter = (uint32_t)(reg[6] ? _mcycle >> 32 : _mcycle);
+        csr = &counter;
+    }
+    else {
+        fprintf(stderr, "mock: csr %s not modeled\n", reg);
+        abort();
+    }
+    if( op != 3 || csr != &_mstatus ) dispatch(); // interrupts come before the instruction
+    uint32_t old = *csr;
+    if( op == 1 ) *csr = value;
+    if( op == 2 ) *csr |= value;
+    if( op == 3 ) *csr &= ~value;
+    if( csr == &_mstatus && (op == 1 || op == 2) ) dispatch();
+    return old;
+}
+
+void mock_wfi( void ) {
+    MOCK_SCOPE();
+    spend(MOCK_CSR);
+    advance();
+    sync_mtime();
+    _sleeping = 1;
+    uint64_t limit = _now + MOCK_SYS_HZ; // spurious wake up after a second of nothing
+    for( ;; ) {
+        int pending = 0;
+        for( uint32_t irq = 0; irq < MOCK_SOURCES && !pending; irq++ ) {
+            pending = _ie[irq] && irq_pending(irq);
+        }
+        if( pending || _now >= limit ) break;
+        uint64_t when = next_event();
+        _now = (when < limit) ? when : limit;
+        advance();
+    }
+    _sleeping = 0;
+    dispatch();
+}
+
+
+/*
+Test interface
+*/
+
+void mock_init( void ) {
+    MOCK_SCOPE();
+    struct sigaction sa = { .sa_flags = SA_SIGINFO, .sa_sigaction = on_step };
+    sigaction(SIGTRAP, &sa, 0);
+    _ram_high = (uintptr_t)&_trace_count & ~(uintptr_t)0xffffffffU;
+    memset(_periph, 0, sizeof(_periph));
+    memset(_core, 0, sizeof(_core));
+    R(RCU_BASE + 0x04) = RCU_APB1_CKAHB_DIV2; // clocks as SystemInit() leaves them: 108MHz, APB1 54MHz
+    R(CORE_BASE + TIMER_MTIMECMP) = R(CORE_BASE + TIMER_MTIMECMP + 4) = UINT32_MAX;
+    _now = _ev = 0;
+    _mtime = _mtime_at = _mcycle = _mcycle_at = 0;
+    _sleeping = 0;
+    _counting = 0;
+    _preempt = 0;
+    _instructions = 0;
+    _spin_reads = 0;
+    _spin_skip = 0;
+    _mcountinhibit = 0;
+    _mstatus = 0;
+    SystemCoreClock = MOCK_SYS_HZ;
+
+    for( int i = 0; i < 5; i++ ) tim_reset(&_timers[i]);
+    memset(_dma, 0, sizeof(_dma));
+    memset(&_usart, 0, sizeof(_usart));
+    usart_reset();
+    for( int b = 0; b < 5; b++ ) {
+        R(GPIOA + 0x400 * b) = R(GPIOA + 0x400 * b + 0x04) = 0x44444444;
+        for( int p = 0; p < 16; p++ ) _wire[b][p] = -1;
+    }
+    memset(_pad, 0, sizeof(_pad));
+    memset(_drive, 0, sizeof(_drive));
+
+    memset(_ie, 0, sizeof(_ie));
+    memset(_level_of, 0, sizeof(_level_of));
+    memset(_vmode, 0, sizeof(_vmode));
+    memset(_pending, 0, sizeof(_pending));
+    _level = -1;
+    _depth = 0;
+    mock_irq_stat_reset();
+    mock_trace_reset();
+}
+
+void mock_run_until( uint64_t sys_cycles ) {
+    MOCK_SCOPE();
+    for( ;; ) {
+        advance();
+        dispatch();
+        if( _now >= sys_cycles ) break;
+        uint64_t when = next_event();
+        _now = (when < sys_cycles) ? when : sys_cycles;
+    }
+}
+
+void mock_run( uint64_t core_cycles ) {
+    MOCK_SCOPE();
+    mock_run_until(_now + core_cycles * ahb_div());
+}
+
+void mock_run_us( uint32_t us ) {
+    MOCK_SCOPE();
+    mock_run_until(_now + (uint64_t)us * (MOCK_SYS_HZ / 1000000));
+}
+
+void mock_count( int on ) {
+    MOCK_SCOPE(); // leaving it starts stepping
+    _counting = on;
+}
+
+void mock_skip_waits( int on ) {
+    MOCK_SCOPE();
+    _spin_skip = on;
+}
+
+uint64_t mock_instructions( void ) {
+    MOCK_SCOPE();
+    return _instructions;
+}
+
+void mock_preempt( uint64_t instructions, void (*handler)( void ) ) {
+    MOCK_SCOPE();
+    _preempt_at = _instructions + instructions;
+    _preempt = handler;
+}
+
+uint64_t mock_cycles( void ) {
+    MOCK_SCOPE();
+    return _now;
+}
+
+uint64_t mock_core_cycles( void ) {
+    MOCK_SCOPE();
+    return _now / ahb_div();
+}
+
+uint64_t mock_us( void ) {
+    MOCK_SCOPE();
+    return _now / (MOCK_SYS_HZ / 1000000);
+}
+
+uint32_t mock_reg( uint32_t addr ) {
+    MOCK_SCOPE();
+    _ev = _now;
+    sync_register(addr);
+    return R(addr);
+}
+
+void mock_trace_reset( void ) {
+    MOCK_SCOPE();
+    _trace_count = 0;
+    _trace_full = 0;
+    _trace_start = _now;
+    memcpy(_trace_initial, _pad, sizeof(_pad));
+}
+
+uint32_t mock_trace_count( void ) {
+    MOCK_SCOPE();
+    return _trace_count;
+}
+
+const struct mock_edge *mock_trace_get( uint32_t index ) {
+    MOCK_SCOPE();
+    return index < _trace_count ? &_trace[index] : 0;
+}
+
+int mock_trace_full( void ) {
+    MOCK_SCOPE();
+    return _trace_full;
+}
+
+uint8_t mock_pin( enum Mock_Banks bank, uint32_t pin ) {
+    MOCK_SCOPE();
+    return _pad[bank][pin];
+}
+
+uint32_t mock_pin_share( enum Mock_Banks bank, uint32_t pin, uint8_t level, uint64_t from, uint64_t to ) {
+    MOCK_SCOPE();
+    if( to <= from ) return 0;
+    uint8_t current = _trace_initial[bank][pin];
+    uint64_t since = _trace_start;
+    uint64_t time = 0;
+    for( uint32_t i = 0; i <= _trace_count; i++ ) {
+        uint64_t until = to;
+        if( i < _trace_count ) {
+            if( _trace[i].bank != bank || _trace[i].pin != pin ) continue;
+            until = _trace[i].time;
+        }
+        uint64_t a = since > from ? since : from;
+        uint64_t b = until < to ? until : to;
+        if( current == level && b > a ) time += b - a;
+        if( i < _trace_count ) {
+            current = _trace[i].level;
+            since = until;
+        }
+    }
+    return time * 1000000 / (to - from);
+}
+
+uint32_t mock_pin_edges( enum Mock_Banks bank, uint32_t pin, uint64_t from, uint64_t to ) {
+    MOCK_SCOPE();
+    uint32_t edges = 0;
+    for( uint32_t i = 0; i < _trace_count; i++ ) {
+        const struct mock_edge *e = &_trace[i];
+        if( e->bank == bank && e->pin == pin && e->time >= from && e->time < to ) edges++;
+    }
+    return edges;
+}
+
+void mock_drive( enum Mock_Banks bank, uint32_t pin, uint8_t level ) {
+    MOCK_SCOPE();
+    _ev = _now;
+    _drive[bank][pin] = level;
+    pad_update(bank * 16 + pin);
+    irq_scan();
+}
+
+void mock_wire( enum Mock_Banks bank, uint32_t pin, enum Mock_Banks from_bank, uint32_t from_pin ) {
+    MOCK_SCOPE();
+    _ev = _now;
+    _wire[bank][pin] = from_bank * 16 + from_pin;
+    pad_update(bank * 16 + pin);
+    irq_scan();
+}
+
+void mock_usart_inject( const uint8_t *data, uint32_t length ) {
+    MOCK_SCOPE();
+    if( _usart.rx_head == _usart.rx_tail ) _usart.rx_next = _now + usart_byte_time();
+    for( uint32_t i = 0; i < length && _usart.rx_head - _usart.rx_tail < MOCK_USART_SIZE; i++ ) {
+        _usart.rx[_usart.rx_head++ % MOCK_USART_SIZE] = data[i];
+    }
+}
+
+uint32_t mock_usart_sent( void ) {
+    MOCK_SCOPE();
+    return _usart.sent;
+}
+
+uint32_t mock_usart_take( uint8_t *data, uint32_t max ) {
+    MOCK_SCOPE();
+    uint32_t count = 0;
+    while( count < max && _usart.tx_taken != _usart.tx_count ) {
+        data[count++] = _usart.tx[_usart.tx_taken++ % MOCK_USART_SIZE];
+    }
+    return count;
+}
+
+void mock_usart_discard( int discard ) {
+    MOCK_SCOPE();
+    _usart.discard = discard;
+}
+
+const struct mock_irq_stat *mock_irq_stat( uint32_t irq ) {
+    MOCK_SCOPE();
+    return &_irq_stats[irq];
+}
+
+void mock_irq_stat_reset( void ) {
+    MOCK_SCOPE();
+    memset(_irq_stats, 0, sizeof(_irq_stats));
+}
+
+
+/*
+Interrupt handlers of the program, weak so a test links without the ones it doesn't use
+*/
+
+#define MOCK_HANDLER(name) void name( void ) __attribute__((weak));
+MOCK_HANDLER(eclic_mtip_handler)
+MOCK_HANDLER(DMA0_Channel0_IRQHandler)
+MOCK_HANDLER(DMA0_Channel1_IRQHandler)
+MOCK_HANDLER(DMA0_Channel2_IRQHandler)
+MOCK_HANDLER(DMA0_Channel3_IRQHandler)
+MOCK_HANDLER(DMA0_Channel4_IRQHandler)
+MOCK_HANDLER(DMA0_Channel5_IRQHandler)
+MOCK_HANDLER(DMA0_Channel6_IRQHandler)
+MOCK_HANDLER(TIMER0_UP_IRQHandler)
+MOCK_HANDLER(TIMER0_Channel_IRQHandler)
+MOCK_HANDLER(TIMER1_IRQHandler)
+MOCK_HANDLER(TIMER2_IRQHandler)
+MOCK_HANDLER(TIMER3_IRQHandler)
+MOCK_HANDLER(USART0_IRQHandler)
+MOCK_HANDLER(TIMER4_IRQHandler)
+MOCK_HANDLER(DMA1_Channel0_IRQHandler)
+MOCK_HANDLER(DMA1_Channel1_IRQHandler)
+MOCK_HANDLER(DMA1_Channel2_IRQHandler)
+MOCK_HANDLER(DMA1_Channel3_IRQHandler)
+MOCK_HANDLER(DMA1_Channel4_IRQHandler)
+
+static void (*const _handlers[MOCK_SOURCES])( void ) = {
+    [CLIC_INT_TMR]        = eclic_mtip_handler,
+    [DMA0_Channel0_IRQn]  = DMA0_Channel0_IRQHandler,
+    [DMA0_Channel1_IRQn]  = DMA0_Channel1_IRQHandler,
+    [DMA0_Channel2_IRQn]  = DMA0_Channel2_IRQHandler,
+    [DMA0_Channel3_IRQn]  = DMA0_Channel3_IRQHandler,
+    [DMA0_Channel4_IRQn]  = DMA0_Channel4_IRQHandler,
+    [DMA0_Channel5_IRQn]  = DMA0_Channel5_IRQHandler,
+    [DMA0_Channel6_IRQn]  = DMA0_Channel6_IRQHandler,
+    [TIMER0_UP_IRQn]      = TIMER0_UP_IRQHandler,
+    [TIMER0_Channel_IRQn] = TIMER0_Channel_IRQHandler,
+    [TIMER1_IRQn]         = TIMER1_IRQHandler,
+    [TIMER2_IRQn]         = TIMER2_IRQHandler,
+    [TIMER3_IRQn]         = TIMER3_IRQHandler,
+    [USART0_IRQn]         = USART0_IRQHandler,
+    [TIMER4_IRQn]         = TIMER4_IRQHandler,
+    [DMA1_Channel0_IRQn]  = DMA1_Channel0_IRQHandler,
+    [DMA1_Channel1_IRQn]  = DMA1_Channel1_IRQHandler,
+    [DMA1_Channel2_IRQn]  = DMA1_Channel2_IRQHandler,
+    [DMA1_Channel3_IRQn]  = DMA1_Channel3_IRQHandler,
+    [DMA1_Channel4_IRQn]  = DMA1_Channel4_IRQHandler,
+};
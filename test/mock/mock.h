@@ -0,0 +1,123 @@
+#ifndef MOCK_H
+#define MOCK_H
+
+#include <stdint.h>
+#include "gd32vf103.h"
+
+/*
+Register mock of the GD32VF103 for the native env: the project's code runs on a x86-64 Linux
+host. It accesses registers only through reg_load() and reg_store() of lib/fastreg and the
+sdk functions. Natively those are mock_load(), mock_store() and the mock's sdk: each access
+advances simulated time by its cost, brings timers, dma and usart up to date and then
+applies what a write means to the hardware (flag clearing, gpio set/reset, update events...).
+Pins are tracked as levels, every change is recorded in an edge trace.
+
+Time is counted in CK_SYS cycles (108MHz). The cost model is deliberately simple:
+C code between register accesses takes no time, an access to an AHB peripheral
+takes MOCK_AHB_ACCESS core cycles and an APB access MOCK_APB_ACCESS plus two APB clocks,
+sdk calls, csr accesses and interrupt entry/exit have fixed costs.
+So simulated cycle numbers compare variants, they are no substitute for isrstat on the chip.
+
+Interrupts are served before register accesses, sdk calls and csr accesses, in wfi and mock_run().
+Handlers of higher eclic levels preempt lower ones like the non-vectored eclic does,
+vectored ones run with interrupts disabled and enter and exit cheaper.
+After mock_skip_waits(1) a busy wait on a register skips to the next time something happens.
+
+To see what C code costs, mock_count() single steps the program and charges every
+instruction. Instructions of the x86 host build stand in for the RISC-V ones, so take the
+numbers as an estimate. A register access counts its operands and one instruction for the
+load or store, the registers the call clobbers add a few. Stepping is slow, use it around
+what a test measures. Flash wait states are a guess the mock can't check: MOCK_FLASH_WAIT is 0
+unless a test sets it, code in sram (RAM_ISR) never pays them.
+*/
+
+#define MOCK_SYS_HZ     108000000ULL
+#define MOCK_AHB_ACCESS 2   // core cycles of a load or store to an AHB peripheral (dma, rcu, mtime)
+#define MOCK_APB_ACCESS 2   // core cycles of an APB access on top of two APB clocks
+#define MOCK_CALL       30  // core cycles of an sdk function call on top of its register accesses
+#define MOCK_CSR        2   // core cycles of a csr access
+#define MOCK_IRQ_ENTRY  40  // core cycles to save context and enter a handler
+#define MOCK_IRQ_EXIT   40  // core cycles to restore context after a handler
+#define MOCK_IRQ_ENTRY_VECTORED 12 // vectored (eclic_set_vmode()): straight into the handler, it saves what it uses
+#define MOCK_IRQ_EXIT_VECTORED  12
+#define MOCK_INSTRUCTION 1  // core cycles of a program instruction while counting, see mock_count()
+#ifndef MOCK_FLASH_WAIT
+#define MOCK_FLASH_WAIT 0   // wait cycles on top for an instruction fetched from flash, not from a RAM_ISR handler
+#endif
+#define MOCK_SPIN_READS 8   // same value read this often from a register: skip to the next event
+
+enum Mock_Banks { MockA, MockB, MockC, MockD, MockE };
+
+// Recorded change of a pin level
+struct mock_edge {
+    uint64_t time;  // CK_SYS cycles since mock_init()
+    uint8_t  bank;  // MockA..MockE
+    uint8_t  pin;   // 0..15
+    uint8_t  level;
+};
+
+// Served interrupts per eclic source
+struct mock_irq_stat {
+    uint32_t count;
+    uint64_t cycles;      // core cycles in the handler including entry and exit
+    uint32_t max_cycles;
+    uint32_t max_latency; // core cycles from the interrupt becoming pending to handler entry
+};
+
+// Reset registers, time, trace and interrupt state. Call before each test
+void mock_init( void );
+
+// Let time pass while main code busy waits, serving interrupts as they come
+void mock_run( uint64_t core_cycles );
+void mock_run_us( uint32_t us );
+void mock_run_until( uint64_t sys_cycles );
+
+// Sleep until an interrupt is pending like wfi, lib/scheduler sleeps with it (see gd32vf103.h)
+void mock_wfi( void );
+
+// Charge each program instruction MOCK_INSTRUCTION core cycles from now on (1) or not (0)
+void mock_count( int on );
+uint64_t mock_instructions( void ); // counted since mock_init()
+
+// Call handler once after that many more counted instructions, like an interrupt would come in.
+// The mock serves its interrupt sources at register accesses only, this reaches code without any,
+// e.g. lock-free code between two of its instructions. The handler's instructions are not counted
+void mock_preempt( uint64_t instructions, void (*handler)( void ) );
+
+// Skip busy waits (1): MOCK_SPIN_READS reads of the same value from a register in a row
+// jump to the next event. Only for tests where the program polls a register while it waits,
+// a loop that does work between polls would lose time
+void mock_skip_waits( int on );
+
+uint64_t mock_cycles( void );   // CK_SYS cycles since mock_init()
+uint64_t mock_core_cycles( void ); // core cycles since mock_init(), sleeping or not
+uint64_t mock_us( void );
+
+// Register value without simulated cost or side effects, for checks in tests
+uint32_t mock_reg( uint32_t addr );
+
+// Edge trace
+void mock_trace_reset( void );
+uint32_t mock_trace_count( void );
+const struct mock_edge *mock_trace_get( uint32_t index );
+int mock_trace_full( void );
+uint8_t mock_pin( enum Mock_Banks bank, uint32_t pin );
+// Parts per million of the time between from and to (CK_SYS cycles) the pin had the level
+uint32_t mock_pin_share( enum Mock_Banks bank, uint32_t pin, uint8_t level, uint64_t from, uint64_t to );
+// Changes of a pin between from and to
+uint32_t mock_pin_edges( enum Mock_Banks bank, uint32_t pin, uint64_t from, uint64_t to );
+
+// Inputs: level of an unconnected input pin, or a wire from another pin
+void mock_drive( enum Mock_Banks bank, uint32_t pin, uint8_t level );
+void mock_wire( enum Mock_Banks bank, uint32_t pin, enum Mock_Banks from_bank, uint32_t from_pin );
+
+// USART0: bytes arrive back to back at the configured baud rate, sent bytes are collected
+void mock_usart_inject( const uint8_t *data, uint32_t length );
+uint32_t mock_usart_sent( void );
+uint32_t mock_usart_take( uint8_t *data, uint32_t max );
+void mock_usart_discard( int discard ); // count sent bytes without keeping them
+
+const struct mock_irq_stat *mock_irq_stat( uint32_t irq );
+void mock_irq_stat_reset( void );
+
+#endif
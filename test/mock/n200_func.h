@@ -0,0 +1,38 @@
+#ifndef N200_FUNC_H
+#define N200_FUNC_H
+
+#include <stdint.h>
+
+/*
+Host stand-in for the core functions of the sdk: machine timer and eclic, see test/mock/mock.c
+*/
+
+#define TIMER_CTRL_ADDR 0xd1000000
+#define TIMER_MSIP      0xFFC
+#define TIMER_MTIMECMP  0x8
+#define TIMER_MTIME     0x0
+
+#define ECLIC_PRIGROUP_LEVEL0_PRIO4 0
+#define ECLIC_PRIGROUP_LEVEL1_PRIO3 1
+#define ECLIC_PRIGROUP_LEVEL2_PRIO2 2
+#define ECLIC_PRIGROUP_LEVEL3_PRIO1 3
+#define ECLIC_PRIGROUP_LEVEL4_PRIO0 4
+
+uint64_t get_timer_value(void);
+uint32_t get_timer_freq(void);
+
+void eclic_init(uint32_t num_irq);
+void eclic_enable_interrupt(uint32_t source);
+void eclic_disable_interrupt(uint32_t source);
+void eclic_set_pending(uint32_t source);
+void eclic_clear_pending(uint32_t source);
+void eclic_set_irq_lvl_abs(uint32_t source, uint8_t lvl_abs);
+void eclic_priority_group_set(uint32_t prigroup);
+void eclic_irq_enable(uint32_t source, uint8_t level, uint8_t priority);
+void eclic_irq_disable(uint32_t source);
+void eclic_set_vmode(uint32_t source);
+void eclic_set_nonvmode(uint32_t source);
+void eclic_global_interrupt_enable(void);
+void eclic_global_interrupt_disable(void);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef RISCV_CSR_ENCODING_H
+#define RISCV_CSR_ENCODING_H
+
+#include <stdint.h>
+
+/*
+Host stand-in for the csr access macros of the sdk, see test/mock/mock.c.
+The csr is passed by name like in the asm the sdk macros generate:
+mstatus for the interrupt enable, mcycle and mcycleh from the simulated core clock
+and 0x320 (mcountinhibit).
+*/
+
+#define MSTATUS_MIE  0x00000008
+#define MSTATUS_MPIE 0x00000080
+
+unsigned long mock_csr( const char *reg, int op, unsigned long value );
+
+#define MOCK_CSR_NAME(reg) #reg
+
+#define read_csr(reg)       mock_csr(MOCK_CSR_NAME(reg), 0, 0)
+#define write_csr(reg, val) ((void)mock_csr(MOCK_CSR_NAME(reg), 1, (val)))
+#define set_csr(reg, bit)   mock_csr(MOCK_CSR_NAME(reg), 2, (bit))
+#define clear_csr(reg, bit) mock_csr(MOCK_CSR_NAME(reg), 3, (bit))
+
+#endif
@@ -0,0 +1,160 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Bam pins against Interrupt pins: BAM_PINS (3, 16 or 32) leds in Bam mode on BAM_PWM_TIMER,
+or with -DBAM_AS_INTERRUPT the same leds as Interrupt pins, a channel each on TIMER1-4
+(at most 16). All pins get different duties, so Interrupt pins rarely share an event.
+Handler instructions are counted (see mock_count()) over BAM_INTERVALS intervals:
+interrupts per second and the share of the core the handlers take, entry and exit included.
+Each pin has to show its duty within a tick.
+
+At PRESCALE 2000 (54 kHz ticks, MAX_DUTY 1000), counted x86 instructions for RISC-V ones:
+leds | mode      | interrupts/s | -O2 cpu | -O1 cpu
+   3 | Bam       |          527 |   0.07% |   0.07%
+   3 | Interrupt |          215 |   0.11% |   0.17%
+  16 | Bam       |          527 |   0.07% |   0.13%
+  16 | Interrupt |         1079 |   0.65% |   1.21%
+  32 | Bam       |          527 |   0.07% |   0.18%
+Bam takes BAM_BITS interrupts per interval (of BAM_MAX ticks) however many leds there are,
+each one writes the banks in use. Interrupt pins take one per timer for the update that
+turns its leds on and one per led to turn it off.
+The load scales with the tick rate: at the default PRESCALE 200 multiply by 10.
+The rows other than 32 Bam are test_bam_3, _16, _3_interrupt and _16_interrupt, they define
+BAM_PINS and BAM_AS_INTERRUPT and include this file.
+
+The Longan Nano has no 32 free pins. The 32 list is for the mock and takes pins the board
+uses otherwise: A9 is USART0 TX (no WITH_SERIAL), A15, B3 and B4 are JTAG (the firmware
+would have to remap GPIO_SWJ_DISABLE_REMAP first and loses the debugger), A11 and A12 are
+USB and B2 is BOOT1. The 3 and 16 lists leave those alone.
+*/
+
+#ifndef BAM_PINS
+#define BAM_PINS 32
+#endif
+
+#ifndef PRESCALE
+#define PRESCALE 2000
+#endif
+
+#ifdef BAM_AS_INTERRUPT
+#define MODE Interrupt
+#define ON(timer) timer // a channel per pin
+#else
+#define MODE Bam
+#define ON(timer) BAM_PWM_TIMER
+#endif
+
+// The board's color pins first (enum Color in main.c needs them)
+#define BAM_PINS_3(PIN, x) \
+    PIN( x, PinC13, ON(Timer1), Channel0, BankC, MODE, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinA1,  ON(Timer1), Channel1, BankA, MODE, GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  ON(Timer1), Channel2, BankA, MODE, GPIO_PIN_2,  CIE, 100 )
+#define BAM_PINS_16(PIN, x) BAM_PINS_3(PIN, x) \
+    PIN( x, PinA3,  ON(Timer1), Channel3, BankA, MODE, GPIO_PIN_3,  CIE, 100 ) \
+    PIN( x, PinA4,  ON(Timer2), Channel0, BankA, MODE, GPIO_PIN_4,  CIE, 100 ) \
+    PIN( x, PinA5,  ON(Timer2), Channel1, BankA, MODE, GPIO_PIN_5,  CIE, 100 ) \
+    PIN( x, PinA6,  ON(Timer2), Channel2, BankA, MODE, GPIO_PIN_6,  CIE, 100 ) \
+    PIN( x, PinA7,  ON(Timer2), Channel3, BankA, MODE, GPIO_PIN_7,  CIE, 100 ) \
+    PIN( x, PinB0,  ON(Timer3), Channel0, BankB, MODE, GPIO_PIN_0,  CIE, 100 ) \
+    PIN( x, PinB1,  ON(Timer3), Channel1, BankB, MODE, GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinB5,  ON(Timer3), Channel2, BankB, MODE, GPIO_PIN_5,  CIE, 100 ) \
+    PIN( x, PinB6,  ON(Timer3), Channel3, BankB, MODE, GPIO_PIN_6,  CIE, 100 ) \
+    PIN( x, PinB7,  ON(Timer4), Channel0, BankB, MODE, GPIO_PIN_7,  CIE, 100 ) \
+    PIN( x, PinB8,  ON(Timer4), Channel1, BankB, MODE, GPIO_PIN_8,  CIE, 100 ) \
+    PIN( x, PinC14, ON(Timer4), Channel2, BankC, MODE, GPIO_PIN_14, CIE, 100 ) \
+    PIN( x, PinC15, ON(Timer4), Channel3, BankC, MODE, GPIO_PIN_15, CIE, 100 )
+#define BAM_PINS_32(PIN, x) BAM_PINS_16(PIN, x) \
+    PIN( x, PinA0,  ON(Timer1), Channel0, BankA, MODE, GPIO_PIN_0,  CIE, 100 ) \
+    PIN( x, PinA8,  ON(Timer1), Channel0, BankA, MODE, GPIO_PIN_8,  CIE, 100 ) \
+    PIN( x, PinA11, ON(Timer1), Channel0, BankA, MODE, GPIO_PIN_11, CIE, 100 ) \
+    PIN( x, PinA12, ON(Timer1), Channel0, BankA, MODE, GPIO_PIN_12, CIE, 100 ) \
+    PIN( x, PinA15, ON(Timer1), Channel0, BankA, MODE, GPIO_PIN_15, CIE, 100 ) \
+    PIN( x, PinB2,  ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_2,  CIE, 100 ) \
+    PIN( x, PinB3,  ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_3,  CIE, 100 ) \
+    PIN( x, PinB4,  ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_4,  CIE, 100 ) \
+    PIN( x, PinB9,  ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_9,  CIE, 100 ) \
+    PIN( x, PinB10, ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_10, CIE, 100 ) \
+    PIN( x, PinB11, ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_11, CIE, 100 ) \
+    PIN( x, PinB12, ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_12, CIE, 100 ) \
+    PIN( x, PinB13, ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinB14, ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_14, CIE, 100 ) \
+    PIN( x, PinB15, ON(Timer1), Channel0, BankB, MODE, GPIO_PIN_15, CIE, 100 ) \
+    PIN( x, PinA9,  ON(Timer1), Channel0, BankA, MODE, GPIO_PIN_9,  CIE, 100 )
+
+#if BAM_PINS == 3
+#define CFG_PINS BAM_PINS_3
+#elif BAM_PINS == 16
+#define CFG_PINS BAM_PINS_16
+#elif BAM_PINS == 32 && !defined(BAM_AS_INTERRUPT)
+#define CFG_PINS BAM_PINS_32
+#else
+#error "BAM_PINS must be 3, 16 or 32, Interrupt pins have 16 channels at most"
+#endif
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define BAM_INTERVALS 8
+
+// CK_SYS cycles of a pwm interval, Bam slots add up to BAM_MAX ticks
+static uint64_t interval() {
+    uint32_t ticks = (MODE == Bam) ? BAM_MAX : _pwm_ticks;
+    return (uint64_t)_pwm_prescale * ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+// Ticks of a pin, all different
+static uint32_t duty_of( enum Pins pin ) {
+    return 100 + 27 * pin;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_interrupts_and_load() {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        TEST_ASSERT_EQUAL(MODE, _pwm_pins[p].mode);
+        set_pwm_duty16(p, (duty_of(p) * 65535 + MAX_DUTY - 1) / MAX_DUTY);
+    }
+    mock_run_until(mock_cycles() + 2 * interval());
+    mock_irq_stat_reset();
+    mock_trace_reset();
+    uint64_t from = mock_cycles();
+    uint64_t core = mock_core_cycles();
+    mock_count(1);
+    mock_run_until(from + BAM_INTERVALS * interval());
+    mock_count(0);
+    core = mock_core_cycles() - core;
+
+    uint32_t count = 0;
+    uint64_t cycles = 0;
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        const struct mock_irq_stat *s = mock_irq_stat(_cfg_timers[t].eclic_interrupt);
+        count += s->count;
+        cycles += s->cycles;
+    }
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        uint32_t share = mock_pin_share((enum Mock_Banks)_cfg_pins[p].bank, __builtin_ctz(_cfg_pins[p].pin), 0, from, mock_cycles());
+        char message[32];
+        snprintf(message, sizeof(message), "pin %d", p);
+        TEST_ASSERT_UINT32_WITHIN_MESSAGE(1000000 / MAX_DUTY, duty_of(p) * 1000000 / MAX_DUTY, share, message);
+    }
+    if( MODE == Bam ) TEST_ASSERT_EQUAL(BAM_INTERVALS * BAM_BITS, count);
+    printf("bam: %d leds as %s pins, %lu interrupts/s, %lu.%02lu%% cpu\n", BAM_PINS, MODE == Bam ? "Bam" : "Interrupt",
+        (unsigned long)((uint64_t)count * MOCK_SYS_HZ / (mock_cycles() - from)),
+        (unsigned long)(cycles * 100 / core), (unsigned long)(cycles * 10000 / core % 100));
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_interrupts_and_load);
+    return UNITY_END();
+}
@@ -0,0 +1,6 @@
+/*
+test_bam with 16 leds as Bam pins.
+*/
+
+#define BAM_PINS 16
+#include "../test_bam/test_main.c"
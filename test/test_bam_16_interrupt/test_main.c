@@ -0,0 +1,7 @@
+/*
+test_bam with 16 leds as Interrupt pins, a channel each on TIMER1-4.
+*/
+
+#define BAM_PINS 16
+#define BAM_AS_INTERRUPT
+#include "../test_bam/test_main.c"
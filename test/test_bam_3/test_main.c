@@ -0,0 +1,6 @@
+/*
+test_bam with the board's three leds as Bam pins.
+*/
+
+#define BAM_PINS 3
+#include "../test_bam/test_main.c"
@@ -0,0 +1,7 @@
+/*
+test_bam with the board's three leds as Interrupt pins on TIMER1.
+*/
+
+#define BAM_PINS 3
+#define BAM_AS_INTERRUPT
+#include "../test_bam/test_main.c"
@@ -0,0 +1,120 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Brightness curves of _pin_levels: rows are monotonic, sized to MAX_DUTY and match the curve
+of their pin's gamma and gain computed at runtime. On the pins, set_pwm_duty() shows the level
+of the table as the long-run share of the on time.
+test_brightness_255 and test_brightness_4000 include this test with other MAX_DUTY and PRESCALE,
+the tables have to follow.
+*/
+
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinA1,  AnyTimer, AnyChannel, BankA, Auto, GPIO_PIN_1,  CIE, 60  ) \
+    PIN( x, PinA2,  AnyTimer, AnyChannel, BankA, Auto, GPIO_PIN_2,  2.0, 100 ) \
+    PIN( x, PinC13, AnyTimer, AnyChannel, BankC, Auto, GPIO_PIN_13, CIE, 100 )
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define SHARE_INTERVALS 256
+
+#define PIN_CURVE(x, name, timer, channel, bank, mode, pin, gamma, gain) { gamma, gain },
+
+static const struct curve {
+    double gamma;
+    double gain;
+} _curves[] = {
+    CFG_PINS(PIN_CURVE, 0)
+};
+
+// Level of a brightness without the compiler's help: CIE lightness or a square
+static double expected_level( const struct curve *curve, uint32_t brightness ) {
+    double x = brightness >= MAX_DUTY ? 1.0 : (double)brightness / MAX_DUTY;
+    double y;
+    if( curve->gamma == 2.0 ) {
+        y = x * x;
+    }
+    else {
+        double l = 100.0 * x;
+        double t = (l + 16.0) / 116.0;
+        y = l <= 8.0 ? l / 903.3 : t * t * t;
+    }
+    return 65535.0 * curve->gain / 100.0 * y;
+}
+
+// CK_SYS cycles of a pwm interval
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_rows_fit_max_duty() {
+    TEST_ASSERT_TRUE(LEVEL_STEPS > MAX_DUTY);
+    TEST_ASSERT_EQUAL(0, LEVEL_STEPS & (LEVEL_STEPS - 1));
+    TEST_ASSERT_TRUE(LEVEL_STEPS == 256 || LEVEL_STEPS / 2 <= MAX_DUTY);
+}
+
+void test_rows_are_monotonic() {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        const uint16_t *row = _pin_levels[p];
+        TEST_ASSERT_EQUAL(0, row[0]);
+        for( uint32_t i = 1; i <= MAX_DUTY; i++ ) {
+            char message[32];
+            snprintf(message, sizeof(message), "pin %d brightness %lu", p, (unsigned long)i);
+            TEST_ASSERT_TRUE_MESSAGE(row[i] >= row[i - 1], message);
+        }
+        TEST_ASSERT_EQUAL((uint16_t)(65535 * _curves[p].gain / 100 + 0.5), row[MAX_DUTY]);
+        for( uint32_t i = MAX_DUTY; i < LEVEL_STEPS; i++ ) TEST_ASSERT_EQUAL(row[MAX_DUTY], row[i]);
+    }
+}
+
+void test_rows_match_their_curve() {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        for( uint32_t i = 0; i <= MAX_DUTY; i++ ) {
+            char message[32];
+            snprintf(message, sizeof(message), "pin %d brightness %lu", p, (unsigned long)i);
+            TEST_ASSERT_UINT32_WITHIN_MESSAGE(1, (uint32_t)(expected_level(&_curves[p], i) + 0.5), _pin_levels[p][i], message);
+        }
+    }
+}
+
+void test_brightness_on_the_pins() {
+    TEST_ASSERT_EQUAL(MAX_DUTY, _pwm_ticks);
+    const uint16_t brightness[] = { 1, MAX_DUTY / 10, MAX_DUTY / 2, MAX_DUTY - 1, MAX_DUTY };
+    for( int b = 0; b < ARRAY_SIZE(brightness); b++ ) {
+        for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) set_pwm_duty(p, brightness[b]);
+        mock_run_until(mock_cycles() + 2 * interval());
+        uint64_t from = mock_cycles();
+        mock_run_until(from + SHARE_INTERVALS * interval());
+        for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+            uint32_t level = _pin_levels[p][brightness[b]];
+            uint32_t share = mock_pin_share((enum Mock_Banks)_cfg_pins[p].bank, __builtin_ctz(_cfg_pins[p].pin), 0, from, mock_cycles());
+            char message[48];
+            snprintf(message, sizeof(message), "pin %d brightness %u level %lu", p, brightness[b], (unsigned long)level);
+            // dithering gets within a tick over the intervals
+            TEST_ASSERT_UINT32_WITHIN_MESSAGE(1000000 / MAX_DUTY / 8 + 1, (uint64_t)level * 1000000 / 65535, share, message);
+            uint32_t ticks = pwm_brightness_ticks(p, brightness[b]);
+            TEST_ASSERT_UINT32_WITHIN(1, (uint64_t)level * _pwm_ticks / 65535, ticks);
+        }
+    }
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_rows_fit_max_duty);
+    RUN_TEST(test_rows_are_monotonic);
+    RUN_TEST(test_rows_match_their_curve);
+    RUN_TEST(test_brightness_on_the_pins);
+    return UNITY_END();
+}
@@ -0,0 +1,7 @@
+/*
+test_brightness with MAX_DUTY 255 and PRESCALE 800: tables of 256 levels per pin.
+*/
+
+#define MAX_DUTY 255
+#define PRESCALE 800
+#include "../test_brightness/test_main.c"
@@ -0,0 +1,7 @@
+/*
+test_brightness with MAX_DUTY 4000 and PRESCALE 250: tables of 4096 levels per pin.
+*/
+
+#define MAX_DUTY 4000
+#define PRESCALE 250
+#include "../test_brightness/test_main.c"
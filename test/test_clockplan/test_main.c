@@ -0,0 +1,162 @@
+#include <unity.h>
+#include <clockplan.h>
+
+/*
+lib/clockplan over combinations of pwm timing, Interrupt pins, even prescalers and baud rates.
+Each plan clockplan_select() returns is checked against the needs, and no slower core clock may meet them.
+*/
+
+#define SYS_HZ 108000000
+
+static const uint16_t _ahb_divs[] = { 1, 2, 4, 8, 16, 64, 128, 256, 512 };
+static const uint8_t _apb_divs[] = { 1, 2, 4, 8, 16 };
+
+// Needs of the program at its default clocks (SystemInit: APB1 /2, timers at 108MHz)
+static struct clockplan_needs needs( uint32_t prescale, uint32_t ticks ) {
+    struct clockplan_needs n = {
+        .sys_hz          = SYS_HZ,
+        .timer_hz        = SYS_HZ,
+        .prescale        = prescale,
+        .ticks           = ticks,
+        .interval_cycles = 2000,
+        .baud_ppm        = 20000 };
+    return n;
+}
+
+static void interrupt_pins( struct clockplan_needs *n, uint32_t banks ) {
+    n->tick_cycles = 172;
+    n->tick_apb1 = 4;
+    n->tick_apb2 = banks;
+}
+
+static uint32_t timer_div( uint32_t apb_div ) {
+    return (apb_div == 1) ? 1 : apb_div / 2;
+}
+
+// The plan meets the needs
+static void check_plan( const struct clockplan_needs *n, const struct clockplan *plan ) {
+    char message[192]; // every number at its widest
+    snprintf(message, sizeof(message), "prescale %lu ticks %lu even %u tick %lu baud %lu: ahb %u apb1 %u apb2 %u",
+        (unsigned long)n->prescale, (unsigned long)n->ticks, n->even, (unsigned long)n->tick_cycles,
+        (unsigned long)n->baud, plan->ahb_div, plan->apb1_div, plan->apb2_div);
+    TEST_ASSERT_EQUAL_MESSAGE(n->sys_hz / plan->ahb_div, plan->core_hz, message);
+    TEST_ASSERT_TRUE_MESSAGE(plan->apb1_hz <= CLOCKPLAN_MAX_APB1_HZ, message);
+    TEST_ASSERT_EQUAL_MESSAGE(timer_div(plan->apb1_div), timer_div(plan->apb2_div), message);
+    TEST_ASSERT_EQUAL_MESSAGE(plan->core_hz / timer_div(plan->apb1_div), plan->timer_hz, message);
+    // same tick rate, exactly
+    TEST_ASSERT_TRUE_MESSAGE((uint64_t)plan->prescale * n->timer_hz == (uint64_t)n->prescale * plan->timer_hz, message);
+    if( n->even ) TEST_ASSERT_EQUAL_MESSAGE(0, plan->prescale & 1, message);
+    uint32_t tick = plan->prescale * timer_div(plan->apb1_div);
+    if( n->tick_cycles ) {
+        uint32_t need = n->tick_cycles + n->tick_apb1 * CLOCKPLAN_APB_CYCLES(plan->apb1_div)
+            + n->tick_apb2 * CLOCKPLAN_APB_CYCLES(plan->apb2_div);
+        TEST_ASSERT_TRUE_MESSAGE(tick >= need, message);
+    }
+    TEST_ASSERT_TRUE_MESSAGE((uint64_t)tick * n->ticks >= n->interval_cycles, message);
+    if( n->baud ) TEST_ASSERT_TRUE_MESSAGE(plan->baud_ppm <= n->baud_ppm, message);
+}
+
+// No slower core clock meets the needs with any bus dividers
+static void check_slowest( const struct clockplan_needs *n, const struct clockplan *plan ) {
+    struct clockplan other;
+    for( int a = 0; a < sizeof(_ahb_divs) / sizeof(_ahb_divs[0]); a++ ) {
+        if( _ahb_divs[a] <= plan->ahb_div ) continue;
+        for( int b1 = 0; b1 < sizeof(_apb_divs); b1++ ) {
+            for( int b2 = 0; b2 < sizeof(_apb_divs); b2++ ) {
+                TEST_ASSERT_FALSE(clockplan_check(n, _ahb_divs[a], _apb_divs[b1], _apb_divs[b2], &other));
+            }
+        }
+    }
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_timer_pins_drop_the_core_clock() {
+    struct clockplan_needs n = needs(200, 1000);
+    n.baud = 115200;
+    struct clockplan plan;
+    TEST_ASSERT_TRUE(clockplan_select(&n, &plan));
+    check_plan(&n, &plan);
+    TEST_ASSERT_EQUAL(13500000, plan.core_hz);
+}
+
+void test_interrupt_pins_keep_the_apb_clocks_fast() {
+    struct clockplan_needs n = needs(200, 1000);
+    interrupt_pins(&n, 1);
+    struct clockplan plan;
+    TEST_ASSERT_TRUE(clockplan_select(&n, &plan));
+    check_plan(&n, &plan);
+    TEST_ASSERT_EQUAL(SYS_HZ, plan.core_hz);
+    // APB1 /16 would give the same tick rate, but its register accesses don't fit in a tick
+    TEST_ASSERT_EQUAL(2, plan.apb1_div);
+    TEST_ASSERT_EQUAL(1, plan.apb2_div);
+}
+
+void test_apb_stalls_need_a_longer_tick() {
+    struct clockplan_needs n = needs(200, 1000);
+    interrupt_pins(&n, 3); // 200 cycles at the default clocks are too few for three gpio banks
+    struct clockplan plan;
+    TEST_ASSERT_FALSE(clockplan_select(&n, &plan));
+    n.prescale = 400;
+    TEST_ASSERT_TRUE(clockplan_select(&n, &plan));
+    check_plan(&n, &plan);
+}
+
+void test_even_prescale() {
+    // 108MHz / 8 timer clocks: prescale 200 becomes 25, an even plan can't divide that far
+    struct clockplan_needs n = needs(200, 1000);
+    struct clockplan plan;
+    TEST_ASSERT_TRUE(clockplan_select(&n, &plan));
+    TEST_ASSERT_EQUAL(1, plan.prescale & 1);
+    n.even = 1;
+    TEST_ASSERT_TRUE(clockplan_select(&n, &plan));
+    check_plan(&n, &plan);
+    TEST_ASSERT_EQUAL(0, plan.prescale & 1);
+}
+
+void test_combinations() {
+    static const uint16_t prescales[] = { 2, 6, 54, 100, 108, 200, 216, 400, 540, 1000, 1080, 4320, 65535 };
+    static const uint16_t ticks[] = { 2, 100, 1000, 65535 };
+    static const uint32_t bauds[] = { 0, 9600, 115200, 921600 };
+    uint32_t plans = 0, none = 0;
+    for( int p = 0; p < sizeof(prescales) / sizeof(prescales[0]); p++ ) {
+        for( int t = 0; t < sizeof(ticks) / sizeof(ticks[0]); t++ ) {
+            for( int b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++ ) {
+                for( int even = 0; even < 2; even++ ) {
+                    for( int banks = -1; banks <= 3; banks++ ) { // -1: no Interrupt pins
+                        struct clockplan_needs n = needs(prescales[p], ticks[t]);
+                        n.baud = bauds[b];
+                        n.even = even;
+                        if( banks >= 0 ) interrupt_pins(&n, banks);
+                        struct clockplan plan;
+                        if( clockplan_select(&n, &plan) ) {
+                            check_plan(&n, &plan);
+                            check_slowest(&n, &plan);
+                            plans++;
+                        }
+                        else {
+                            check_slowest(&n, &(struct clockplan){ .ahb_div = 0 });
+                            none++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("clockplan: %lu plans, %lu without\n", (unsigned long)plans, (unsigned long)none);
+    TEST_ASSERT_GREATER_THAN(0, plans);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_timer_pins_drop_the_core_clock);
+    RUN_TEST(test_interrupt_pins_keep_the_apb_clocks_fast);
+    RUN_TEST(test_apb_stalls_need_a_longer_tick);
+    RUN_TEST(test_even_prescale);
+    RUN_TEST(test_combinations);
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Serial commands of src/main.c fed from a recorded command stream: duty, level, speed and fps lines
+with blanks, CR LF and LF endings like a terminal or a script sends them.
+test_parser_throughput puts the lines straight into the receive lines and counts the instructions
+(see mock_count()) of poll_commands(): tokenizing in place, the command table and the command itself.
+test_interrupt_receive sends the stream over the wire at SERIAL_BAUD into the line interrupt
+(usart_rx_init()) and takes the worst USART0_IRQHandler() per byte.
+test_dma_receive does the same for the circular dma the program uses: no interrupt per byte,
+poll_serial() every SERIAL_POLL_US hands the bytes to the lines.
+
+Counted x86 instructions stand in for RISC-V ones (see mock_count()), at -O2 and -O1:
+                                    |    -O2 |    -O1
+parser per command, instructions    |    621 |    688
+parser commands/s at 108 MHz        | 173680 | 156806
+interrupt per byte, core cycles     |    206 |    225  average, entry, exit and registers included
+interrupt per byte, worst           |    632 |    726  a pwm timer handler preempted it
+dma receive per byte, instructions  |     48 |     58  in poll_serial()
+The parser count includes what the command does, e.g. set_pwm_duty(). 115200 baud brings
+about 960 of these lines per second: the parser takes 0.6% of the core, receiving by interrupt
+2.2%, by dma 0.5%.
+*/
+
+#define WITH_SERIAL
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define REPEAT 100 // times the recorded stream is sent
+
+static const char _recorded[] =
+    "duty 0 500\r\n"
+    "duty 1 0\r\n"
+    "  duty   2  1000  \r\n"
+    "level 0 12345\n"
+    "level 2 65535\n"
+    "speed 5000\n"
+    "fps 30\n"
+    "duty 1 999\n"
+    "level 1 1\n"
+    "speed 20000\n";
+
+#define RECORDED_LINES 10
+
+// Run the command lines received so far, returns how many
+static uint32_t run_lines() {
+    uint32_t lines = 0;
+    while( usart_rx_line() ) {
+        poll_commands();
+        lines++;
+    }
+    return lines;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_commands_take_effect() {
+    usart_rx_init(USART0);
+    uint32_t commands = 0;
+    for( const char *c = _recorded; *c; c++ ) {
+        usart_rx_add(*c);
+        commands += run_lines();
+    }
+    TEST_ASSERT_EQUAL(RECORDED_LINES, commands);
+    TEST_ASSERT_EQUAL(0, usart_rx_overruns());
+    TEST_ASSERT_EQUAL(12345 * _pwm_ticks / 65535, _frame_duty[0]);
+    TEST_ASSERT_EQUAL(0, _frame_duty[1]);
+    TEST_ASSERT_EQUAL(_pwm_ticks, _frame_duty[2]);
+    TEST_ASSERT_EQUAL(20000, _duty_us);
+    TEST_ASSERT_EQUAL(30, _stream_fps);
+    TEST_ASSERT_FALSE(_paused); // speed resumes fading
+}
+
+void test_parser_throughput() {
+    usart_rx_init(USART0);
+    uint32_t commands = 0;
+    uint64_t instructions = 0;
+    for( int r = 0; r < REPEAT; r++ ) {
+        const char *c = _recorded;
+        while( *c ) {
+            while( *c && usart_rx_line() == 0 ) usart_rx_add(*c++); // up to the next complete line
+            while( *c == '\r' || *c == '\n' ) usart_rx_add(*c++);
+            uint64_t from = mock_instructions();
+            mock_count(1);
+            commands += run_lines();
+            mock_count(0);
+            instructions += mock_instructions() - from;
+        }
+    }
+    TEST_ASSERT_EQUAL(REPEAT * RECORDED_LINES, commands);
+    TEST_ASSERT_EQUAL(0, usart_rx_overruns());
+    printf("commands: parser %lu instructions per command, %lu commands/s at 108 MHz\n",
+        (unsigned long)(instructions / commands), (unsigned long)(108000000ULL * commands / instructions));
+}
+
+void test_interrupt_receive() {
+    usart_rx_init(USART0);
+    uint32_t bytes = REPEAT * (sizeof(_recorded) - 1);
+    for( int r = 0; r < REPEAT; r++ ) mock_usart_inject((const uint8_t *)_recorded, sizeof(_recorded) - 1);
+    mock_irq_stat_reset();
+    uint32_t commands = 0;
+    mock_count(1);
+    while( commands < REPEAT * RECORDED_LINES ) {
+        mock_run_us(1000); // main loop polls about every ms
+        mock_count(0);
+        commands += run_lines();
+        mock_count(1);
+    }
+    mock_count(0);
+    const struct mock_irq_stat *irq = mock_irq_stat(USART0_IRQn);
+    TEST_ASSERT_EQUAL(0, usart_rx_overruns());
+    TEST_ASSERT_EQUAL(bytes, irq->count);
+    printf("commands: %lu bytes at %lu baud, interrupt per byte %lu core cycles average, %lu worst\n",
+        (unsigned long)bytes, (unsigned long)SERIAL_BAUD, (unsigned long)(irq->cycles / irq->count),
+        (unsigned long)irq->max_cycles);
+}
+
+void test_dma_receive() {
+    usart_rx_dma_init(USART0);
+    init_stream();
+    uint32_t bytes = REPEAT * (sizeof(_recorded) - 1);
+    for( int r = 0; r < REPEAT; r++ ) mock_usart_inject((const uint8_t *)_recorded, sizeof(_recorded) - 1);
+    mock_irq_stat_reset();
+    uint32_t commands = 0;
+    uint64_t instructions = 0;
+    while( commands < REPEAT * RECORDED_LINES ) {
+        mock_run_us(SERIAL_POLL_US);
+        uint64_t from = mock_instructions();
+        mock_count(1);
+        poll_serial(&_serial_task);
+        mock_count(0);
+        instructions += mock_instructions() - from;
+        commands += run_lines();
+    }
+    TEST_ASSERT_EQUAL(0, usart_rx_overruns());
+    TEST_ASSERT_EQUAL(0, mock_irq_stat(USART0_IRQn)->count);
+    printf("commands: %lu bytes via dma, poll_serial() %lu instructions per byte\n",
+        (unsigned long)bytes, (unsigned long)(instructions / bytes));
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY); // says what it did on stdout
+    usart_init(USART0, SERIAL_BAUD);
+    usart_tx_dma_init(USART0, USART_TX_DROP);
+    mock_usart_discard(1);
+    eclic_global_interrupt_enable();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_commands_take_effect);
+    RUN_TEST(test_parser_throughput);
+    RUN_TEST(test_interrupt_receive);
+    RUN_TEST(test_dma_receive);
+    return UNITY_END();
+}
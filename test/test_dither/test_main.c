@@ -0,0 +1,99 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Dithering of the board's pins (Auto: two Timer pins, one Interrupt pin) on the mock:
+16 bit levels from set_pwm_duty16() are checked against the long-run average duty the pins show.
+Each on phase of the trace is rounded to whole ticks, so interrupt latency does not count.
+Every interval has the whole or the next duty tick, and over DITHER_INTERVALS intervals the
+on ticks add up to level * ticks / 65535 within a tick: resolution 1 / DITHER_INTERVALS tick.
+*/
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define DITHER_INTERVALS 4096
+
+static const enum Pins _pins[] = { PinA1, PinA2, PinC13 };
+
+// CK_SYS cycles of a pwm tick and interval
+static uint64_t tick() {
+    return (uint64_t)_pwm_prescale * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+static uint64_t interval() {
+    return tick() * _pwm_ticks;
+}
+
+// Register value without simulated cost
+static uint32_t reg( volatile uint32_t *address ) {
+    return mock_reg((uintptr_t)address);
+}
+
+// Run to the next update event of a timer: when its counter starts over
+static uint64_t next_update( enum Timers timer ) {
+    uint32_t port = _cfg_timers[timer].port;
+    while( reg(&TIMER_CNT(port)) != _pwm_ticks - 1U ) mock_run_until(mock_cycles() + tick() / 2);
+    while( reg(&TIMER_CNT(port)) == _pwm_ticks - 1U ) mock_run_until(mock_cycles() + 1);
+    return mock_cycles();
+}
+
+// On ticks of a pin in the intervals from an update on, each on phase rounded to whole ticks.
+// Checks each interval has duty or duty + 1 ticks
+static uint64_t on_ticks( enum Pins pin, uint64_t from, uint32_t intervals, uint32_t duty ) {
+    uint64_t to = from + intervals * interval();
+    uint64_t ticks = 0, on = 0;
+    int in_on = 0;
+    for( uint32_t e = 0; e < mock_trace_count(); e++ ) {
+        const struct mock_edge *edge = mock_trace_get(e);
+        if( edge->bank != _cfg_pins[pin].bank || edge->pin != __builtin_ctz(_cfg_pins[pin].pin) ) continue;
+        if( edge->level == 0 && edge->time >= from && edge->time < to ) { // inverted led on
+            on = edge->time;
+            in_on = 1;
+        }
+        else if( edge->level == 1 && in_on ) {
+            uint32_t phase = (edge->time - on + tick() / 2) / tick();
+            TEST_ASSERT_TRUE_MESSAGE(phase == duty || phase == duty + 1, "interval with another duty");
+            ticks += phase;
+            in_on = 0;
+        }
+    }
+    return ticks;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_long_run_average() {
+    static const uint16_t levels[] = { 1, 33, 1000, 12345, 32768, 54321, 65000 };
+    for( int l = 0; l < ARRAY_SIZE(levels); l++ ) {
+        for( int i = 0; i < ARRAY_SIZE(_pins); i++ ) set_pwm_duty16(_pins[i], levels[l]);
+        mock_run_until(mock_cycles() + 2 * interval());
+        mock_trace_reset();
+        uint64_t from[ARRAY_SIZE(_pins)];
+        for( int i = 0; i < ARRAY_SIZE(_pins); i++ ) from[i] = next_update(_pwm_pins[_pins[i]].timer);
+        mock_run_until(mock_cycles() + (DITHER_INTERVALS + 1) * interval());
+        TEST_ASSERT_FALSE(mock_trace_full());
+        uint64_t expected = (uint64_t)levels[l] * _pwm_ticks * DITHER_INTERVALS * 1000 / 65535; // milli ticks
+        for( int i = 0; i < ARRAY_SIZE(_pins); i++ ) {
+            uint64_t ticks = on_ticks(_pins[i], from[i], DITHER_INTERVALS, (uint32_t)levels[l] * _pwm_ticks / 65535);
+            char message[48];
+            snprintf(message, sizeof(message), "pin %d level %u", _pins[i], levels[l]);
+            TEST_ASSERT_UINT32_WITHIN_MESSAGE(1000, expected, ticks * 1000, message);
+        }
+    }
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_long_run_average);
+    return UNITY_END();
+}
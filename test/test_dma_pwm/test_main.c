@@ -0,0 +1,103 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Dma pins: the GPIO_BOP table update_dma_half() keeps, and the waveform the mock dma plays from it.
+Three Dma pins of bank A get different duties, every duty from 0 to MAX_DUTY is checked
+slot by slot against the pattern it should have: on (inverted led: reset bit) before the duty tick,
+off from there, no other pins touched. The duties move up and down in steps of varying size,
+so the incremental update is checked from many starting points.
+*/
+
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinA1,  Timer2, Channel0, BankA, Dma,       GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer2, Channel0, BankA, Dma,       GPIO_PIN_2,  CIE, 100 ) \
+    PIN( x, PinA3,  Timer2, Channel0, BankA, Dma,       GPIO_PIN_3,  CIE, 100 ) \
+    PIN( x, PinC13, Timer1, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 )
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+static const enum Pins _dma_pins[] = { PinA1, PinA2, PinA3 };
+
+// CK_SYS cycles of a pwm interval
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+// Duties of the three pins for step d: rising, falling and jumping around
+static void duties( uint32_t d, uint16_t *duty ) {
+    duty[0] = d;
+    duty[1] = MAX_DUTY - d;
+    duty[2] = (d * 397) % (MAX_DUTY + 1);
+}
+
+// Each slot of a half has the pins on before their duty and off from there
+static void check_half( const uint32_t *slots, const uint16_t *duty, uint32_t d ) {
+    for( uint32_t s = 0; s < _dma_ticks; s++ ) {
+        uint32_t on = 0;
+        for( int i = 0; i < ARRAY_SIZE(_dma_pins); i++ ) {
+            if( s < duty[i] ) on |= _cfg_pins[_dma_pins[i]].pin;
+        }
+        uint32_t expected = (on << 16) | (DMA_MASK & ~on);
+        if( slots[s] != expected ) {
+            char message[48];
+            snprintf(message, sizeof(message), "step %lu slot %lu", (unsigned long)d, (unsigned long)s);
+            TEST_ASSERT_EQUAL_MESSAGE(expected, slots[s], message);
+        }
+    }
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_table_for_every_duty() {
+    TEST_ASSERT_EQUAL(MAX_DUTY, _dma_ticks);
+    uint32_t slots[2][MAX_DUTY];
+    uint16_t half_duty[2][ARRAY_SIZE(_cfg_pins)];
+    memcpy(slots, _dma_slots, sizeof(slots));
+    memcpy(half_duty, _dma_half_duty, sizeof(half_duty));
+    for( uint32_t d = 0; d <= MAX_DUTY; d++ ) {
+        uint16_t duty[ARRAY_SIZE(_dma_pins)];
+        duties(d, duty);
+        for( int i = 0; i < ARRAY_SIZE(_dma_pins); i++ ) _dma_duty[_dma_pins[i]] = duty[i];
+        for( int h = 0; h < 2; h++ ) {
+            update_dma_half(slots[h], half_duty[h]);
+            check_half(slots[h], duty, d);
+        }
+    }
+}
+
+void test_waveform_for_every_duty() {
+    for( uint32_t d = 0; d <= MAX_DUTY; d++ ) {
+        uint16_t duty[ARRAY_SIZE(_dma_pins)];
+        duties(d, duty);
+        for( int i = 0; i < ARRAY_SIZE(_dma_pins); i++ ) _dma_duty[_dma_pins[i]] = duty[i];
+        mock_run_until(mock_cycles() + 3 * interval()); // both halves updated and played
+        mock_trace_reset();
+        uint64_t from = mock_cycles();
+        mock_run_until(from + 2 * interval());
+        for( int i = 0; i < ARRAY_SIZE(_dma_pins); i++ ) {
+            enum Pins p = _dma_pins[i];
+            uint32_t share = mock_pin_share((enum Mock_Banks)_cfg_pins[p].bank, __builtin_ctz(_cfg_pins[p].pin), 0, from, mock_cycles());
+            char message[48];
+            snprintf(message, sizeof(message), "step %lu pin %d duty %u", (unsigned long)d, p, duty[i]);
+            TEST_ASSERT_UINT32_WITHIN_MESSAGE(1, (uint64_t)duty[i] * 1000000 / MAX_DUTY, share, message);
+        }
+    }
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_table_for_every_duty);
+    RUN_TEST(test_waveform_for_every_duty);
+    return UNITY_END();
+}
@@ -0,0 +1,104 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+lib/fastreg against the sdk calls the hot paths made before it (-DWITH_SDK_REGS), built like
+the default env (-Os) and like the release env (-O2): three Interrupt pins on TIMER1 with
+edges on adjacent ticks, three Dma pins on TIMER2, the board's blue and green led as
+Timer pins on TIMER4 and a frame of set_pwm_duty() calls for all nine.
+Instructions are counted (see mock_count()), the sdk calls cost MOCK_CALL on top.
+
+Core cycles, counted x86 instructions for RISC-V ones:
+                              | -Os sdk | -Os fastreg | -O2 sdk | -O2 fastreg
+timer handler, worst          |    1122 |        1084 |     737 |         712
+timer handler, average        |     969 |         964 |     626 |         623
+max tick rate (test_irq_rate) | 100 kHz |     100 kHz | 163 kHz |     163 kHz
+dma half handler, average     |     376 |         251 |     337 |         252
+frame of 9 duties             |    1062 |        1062 |     945 |         957
+The timer handler wrote most of its registers directly before, so -O2 is what makes it faster
+and raises the tick rate. A dma half loses a quarter to a third with fastreg: four sdk calls less.
+The Timer pins here are dithered, their compare values go out from the timer handler,
+so the frame hardly changes.
+The max tick rate comes from test/test_irq_rate_3 with the same flags.
+*/
+
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinC13, Timer1, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinB0,  Timer1, Channel1, BankB, Interrupt, GPIO_PIN_0,  CIE, 100 ) \
+    PIN( x, PinB1,  Timer1, Channel2, BankB, Interrupt, GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA3,  Timer2, Channel0, BankA, Dma,       GPIO_PIN_3,  CIE, 100 ) \
+    PIN( x, PinA4,  Timer2, Channel0, BankA, Dma,       GPIO_PIN_4,  CIE, 100 ) \
+    PIN( x, PinA5,  Timer2, Channel0, BankA, Dma,       GPIO_PIN_5,  CIE, 100 ) \
+    PIN( x, PinA0,  Timer4, Channel0, BankA, Timer,     GPIO_PIN_0,  CIE, 100 ) \
+    PIN( x, PinA1,  Timer4, Channel1, BankA, Timer,     GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer4, Channel2, BankA, Timer,     GPIO_PIN_2,  CIE, 100 )
+
+#define PRESCALE 2000 // every event is served within its tick
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define INTERVALS 8
+#define FRAMES 100
+
+// CK_SYS cycles of a pwm interval
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+// Set all duties in one frame, Interrupt pins on adjacent ticks
+static void frame( uint32_t base ) {
+    pwm_frame_begin();
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) set_pwm_duty(p, base + p);
+    pwm_frame_commit();
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_handlers() {
+    frame(MAX_DUTY / 2);
+    mock_count(1);
+    mock_run_until(mock_cycles() + 2 * interval());
+    mock_irq_stat_reset();
+    mock_run_until(mock_cycles() + INTERVALS * interval());
+    mock_count(0);
+
+    const struct mock_irq_stat *irq = mock_irq_stat(_cfg_timers[Timer1].eclic_interrupt);
+    const struct mock_irq_stat *dma = mock_irq_stat(_cfg_timers[Timer2].dma_interrupt);
+    TEST_ASSERT_TRUE(irq->count >= INTERVALS * 4); // update and three channels
+    TEST_ASSERT_TRUE(dma->count >= INTERVALS);
+    printf("fastreg: timer handler worst %lu, average %lu core cycles, dma half average %lu\n",
+        (unsigned long)irq->max_cycles, (unsigned long)(irq->cycles / irq->count),
+        (unsigned long)(dma->cycles / dma->count));
+}
+
+void test_frame() {
+    uint64_t cycles = 0;
+    for( uint32_t f = 0; f < FRAMES; f++ ) {
+        uint32_t irq = critical_enter(); // handlers are measured above
+        uint64_t from = mock_core_cycles();
+        mock_count(1);
+        frame(f * 7 % (MAX_DUTY - ARRAY_SIZE(_cfg_pins)));
+        mock_count(0);
+        cycles += mock_core_cycles() - from;
+        critical_exit(irq);
+    }
+    printf("fastreg: frame of %d duties %lu core cycles\n", (int)ARRAY_SIZE(_cfg_pins), (unsigned long)(cycles / FRAMES));
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+    eclic_global_interrupt_enable();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_handlers);
+    RUN_TEST(test_frame);
+    return UNITY_END();
+}
@@ -0,0 +1,174 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Frames committed in the middle of a pwm interval: two Timer pins on TIMER4 and two Interrupt pins
+on TIMER1, a Leading and a Trailing channel each. Every commit swaps all four between a short and
+a long duty, early, halfway and late in an interval. Halfway the new compare value of a Leading pin
+is below the running counter and a Trailing pin would switch on at once if it went out directly.
+Timer pins must keep their old compare value until the update event (shadow registers),
+Interrupt pins get theirs from _irq_next in the handler at the start of the next interval.
+Each on phase of the trace is assigned to the interval of its timer it lies in:
+up to the interval of the commit all four show the old duty, from the next one on the new duty.
+*/
+
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinA1,  Timer4, Channel1, BankA, Timer,     GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer4, Channel2, BankA, Timer,     GPIO_PIN_2,  CIE, 100 ) \
+    PIN( x, PinC13, Timer1, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinB0,  Timer1, Channel1, BankB, Interrupt, GPIO_PIN_0,  CIE, 100 )
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define SHORT 200 // duties in ticks, whole ticks of the default 1000 so nothing is dithered
+#define LONG  800
+
+// CK_SYS cycles of a pwm interval and a tick
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+static uint64_t tick() {
+    return (uint64_t)_pwm_prescale * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+static uint32_t port_of( enum Pins pin ) {
+    return _cfg_timers[_pwm_pins[pin].timer].port;
+}
+
+// Register value without simulated cost
+static uint32_t reg( volatile uint32_t *address ) {
+    return mock_reg((uintptr_t)address);
+}
+
+static uint32_t compare_value( enum Pins pin ) {
+    return reg(&TIMER_CH0CV(port_of(pin)) + _cfg_channels[_pwm_pins[pin].channel].channel);
+}
+
+// Stage a duty of whole ticks
+static void stage( enum Pins pin, uint16_t ticks ) {
+    set_pwm_duty16(pin, (uint32_t)ticks * 65535 / _pwm_ticks);
+    TEST_ASSERT_EQUAL(ticks, _frame_duty[pin]);
+    TEST_ASSERT_EQUAL(0, _frame_frac[pin]);
+}
+
+// Leading pins start long, Trailing pins short, swapped by each commit
+static void frame( int swapped ) {
+    pwm_frame_begin();
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        int leading = _cfg_channels[_pwm_pins[p].channel].phase == Leading;
+        stage(p, leading != swapped ? LONG : SHORT);
+    }
+    pwm_frame_commit();
+}
+
+// Run until the counter of a timer is at count, at the start of that tick
+static void run_to_count( uint32_t port, uint32_t count ) {
+    while( reg(&TIMER_CNT(port)) == count ) mock_run_until(mock_cycles() + tick() / 4);
+    while( reg(&TIMER_CNT(port)) != count ) mock_run_until(mock_cycles() + tick() / 4);
+}
+
+// Check the on phases of a pin: old duty in intervals up to the one of the commit, new duty after it.
+// start is when the interval of the commit began
+static void check_pin( enum Pins pin, uint64_t start, uint16_t old, uint16_t new ) {
+    enum Mock_Banks bank = (enum Mock_Banks)_cfg_pins[pin].bank;
+    uint32_t bit = __builtin_ctz(_cfg_pins[pin].pin);
+    uint64_t on = 0;
+    uint32_t phases[2] = { 0, 0 }; // before and after the commit interval
+    for( uint32_t e = 0; e < mock_trace_count(); e++ ) {
+        const struct mock_edge *edge = mock_trace_get(e);
+        if( edge->bank != bank || edge->pin != bit ) continue;
+        if( edge->level == 0 ) { // inverted leds: low is on
+            on = edge->time;
+            continue;
+        }
+        if( !on ) continue;
+        uint64_t mid = (on + edge->time) / 2;
+        int after = mid >= start + interval();
+        uint64_t ticks = (edge->time - on + tick() / 2) / tick();
+        char message[64];
+        snprintf(message, sizeof(message), "pin %d, interval %+ld", pin, (long)((int64_t)(mid - start) / (int64_t)interval()));
+        TEST_ASSERT_UINT32_WITHIN_MESSAGE(1, after ? new : old, ticks, message);
+        phases[after]++;
+        on = 0;
+    }
+    TEST_ASSERT_TRUE(phases[0] >= 2 && phases[1] >= 2);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_pins_are_placed() {
+    TEST_ASSERT_EQUAL(Timer, _pwm_pins[PinA1].mode);
+    TEST_ASSERT_EQUAL(Timer, _pwm_pins[PinA2].mode);
+    TEST_ASSERT_EQUAL(Interrupt, _pwm_pins[PinC13].mode);
+    TEST_ASSERT_EQUAL(Interrupt, _pwm_pins[PinB0].mode);
+    TEST_ASSERT_FALSE((_irq_timers | _dither_timers) & (1U << Timer4)); // compare values go out in pwm_frame_commit()
+    TEST_ASSERT_TRUE(_irq_timers & (1U << Timer1));
+    TEST_ASSERT_EQUAL(1000, _pwm_ticks);
+}
+
+void test_commit_mid_interval() {
+    const uint32_t at[] = { 100, 500, 900 }; // counter of TIMER4 at the commit
+    uint32_t timer = port_of(PinA1), irq = port_of(PinC13);
+    int swapped = 0;
+    frame(swapped);
+    mock_run_until(mock_cycles() + 3 * interval());
+
+    for( int i = 0; i < ARRAY_SIZE(at); i++ ) {
+        uint16_t old[ARRAY_SIZE(_cfg_pins)];
+        memcpy(old, _pwm_duty, sizeof(old));
+        run_to_count(timer, at[i]);
+        mock_run_until(mock_cycles() + tick() / 2);
+        mock_trace_reset();
+        mock_run_until(mock_cycles() + 2 * interval()); // two intervals with the old duties
+        uint64_t committed = mock_cycles();
+        uint64_t timer_start = committed - reg(&TIMER_CNT(timer)) * tick() - tick() / 2;
+        uint64_t irq_start = committed - reg(&TIMER_CNT(irq)) * tick() - tick() / 2;
+        uint32_t irq_cv[2] = { compare_value(PinC13), compare_value(PinB0) };
+
+        swapped = !swapped;
+        frame(swapped);
+
+        // Timer pins: new values in the shadow registers, update events enabled again
+        TEST_ASSERT_EQUAL(pwm_cv(_pwm_pins[PinA1].channel, _pwm_duty[PinA1]), compare_value(PinA1));
+        TEST_ASSERT_EQUAL(pwm_cv(_pwm_pins[PinA2].channel, _pwm_duty[PinA2]), compare_value(PinA2));
+        TEST_ASSERT_FALSE(reg(&TIMER_CTL0(timer)) & TIMER_CTL0_UPDIS);
+        // Interrupt pins: staged in _irq_next, the timer keeps its compare values
+        TEST_ASSERT_EQUAL(_pwm_duty[PinC13], _irq_next[Timer1][_pwm_pins[PinC13].channel]);
+        TEST_ASSERT_EQUAL(old[PinC13], _irq_duty[Timer1][_pwm_pins[PinC13].channel]);
+        TEST_ASSERT_EQUAL(irq_cv[0], compare_value(PinC13));
+        TEST_ASSERT_EQUAL(irq_cv[1], compare_value(PinB0));
+
+        // the handler takes the frame over at the next update event, some ticks for its latency
+        mock_run_until(irq_start + interval() + 4 * tick());
+        TEST_ASSERT_EQUAL(_pwm_duty[PinC13], _irq_duty[Timer1][_pwm_pins[PinC13].channel]);
+        TEST_ASSERT_EQUAL(_pwm_duty[PinB0], _irq_duty[Timer1][_pwm_pins[PinB0].channel]);
+        TEST_ASSERT_EQUAL(pwm_cv(_pwm_pins[PinC13].channel, _pwm_duty[PinC13]), compare_value(PinC13));
+        TEST_ASSERT_EQUAL(pwm_cv(_pwm_pins[PinB0].channel, _pwm_duty[PinB0]), compare_value(PinB0));
+
+        mock_run_until(committed + 3 * interval());
+        TEST_ASSERT_FALSE(mock_trace_full());
+        check_pin(PinA1, timer_start, old[PinA1], _pwm_duty[PinA1]);
+        check_pin(PinA2, timer_start, old[PinA2], _pwm_duty[PinA2]);
+        check_pin(PinC13, irq_start, old[PinC13], _pwm_duty[PinC13]);
+        check_pin(PinB0, irq_start, old[PinB0], _pwm_duty[PinB0]);
+    }
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+    eclic_global_interrupt_enable();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_pins_are_placed);
+    RUN_TEST(test_commit_mid_interval);
+    return UNITY_END();
+}
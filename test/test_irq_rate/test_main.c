@@ -0,0 +1,206 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Tick rate of Interrupt pins: IRQ_RATE_PINS (1, 3, 4, 8 or 16) pins, four per timer (TIMER1-4)
+in three gpio banks, 3 are the board's leds on one timer. The pins are fixed,
+so handle_pwm_interrupt() gets its masks from CFG_PINS at compile time.
+Duties put the edges of the channels of a timer on adjacent ticks,
+the worst case of a timer: each event has to be served within one tick.
+Handler cycles are counted (see mock_count()). Starting from the worst case of one call,
+the prescale grows until all pins show their duty: the highest sustainable tick rate.
+With equal duties pwm_edge_peak() tells how many edges still coincide despite the phases.
+The table rows other than 16 pins edge aligned are test_irq_rate_1, _3, _3_center, _4, _8 and _center,
+they define IRQ_RATE_PINS and PWM_ALIGN=TIMER_COUNTER_CENTER_BOTH and include this file.
+
+Core cycles of the worst event and highest tick rate (CK_TIMER = 108MHz), counted x86
+instructions stand in for the RISC-V ones, so compare them rather than trust them:
+pins | timers | align  |  -O2 cycles   kHz |  -O1 cycles   kHz | edges at once
+   1 |      1 | edge   |         352   306 |         534   202 | 1
+   3 |      1 | edge   |         661   163 |         946   114 | 3
+   3 |      1 | center |         671   160 |         989   109 | 2
+   4 |      1 | edge   |         729   147 |        1096    98 | 4
+   8 |      2 | edge   |         729   147 |        1104    97 | 4
+  16 |      4 | edge   |         813   132 |        1560    69 | 4
+  16 |      4 | center |         827   130 |        1611    66 | 2
+Cost grows with channels and banks of a timer, not with pins. Timers at the same interrupt level
+wait for each other, the worst event with four timers includes that.
+Center aligned counters call the handler twice as often for about the same cost per event.
+Without phases all 16 pins would switch on with the update event of their timers.
+*/
+
+#ifndef IRQ_RATE_PINS
+#define IRQ_RATE_PINS 16
+#endif
+
+// A channel drives one pin, so a timer has four. The board's color pins first (enum Color in main.c needs them)
+#define IRQ_RATE_PINS_4(PIN, x) \
+    PIN( x, PinC13, Timer1, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinA1,  Timer1, Channel1, BankA, Interrupt, GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer1, Channel2, BankA, Interrupt, GPIO_PIN_2,  CIE, 100 ) \
+    PIN( x, PinA3,  Timer1, Channel3, BankA, Interrupt, GPIO_PIN_3,  CIE, 100 )
+#define IRQ_RATE_PINS_8(PIN, x) IRQ_RATE_PINS_4(PIN, x) \
+    PIN( x, PinA4,  Timer2, Channel0, BankA, Interrupt, GPIO_PIN_4,  CIE, 100 ) \
+    PIN( x, PinA5,  Timer2, Channel1, BankA, Interrupt, GPIO_PIN_5,  CIE, 100 ) \
+    PIN( x, PinA6,  Timer2, Channel2, BankA, Interrupt, GPIO_PIN_6,  CIE, 100 ) \
+    PIN( x, PinA7,  Timer2, Channel3, BankA, Interrupt, GPIO_PIN_7,  CIE, 100 )
+#define IRQ_RATE_PINS_16(PIN, x) IRQ_RATE_PINS_8(PIN, x) \
+    PIN( x, PinB0,  Timer3, Channel0, BankB, Interrupt, GPIO_PIN_0,  CIE, 100 ) \
+    PIN( x, PinB1,  Timer3, Channel1, BankB, Interrupt, GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinB5,  Timer3, Channel2, BankB, Interrupt, GPIO_PIN_5,  CIE, 100 ) \
+    PIN( x, PinB6,  Timer3, Channel3, BankB, Interrupt, GPIO_PIN_6,  CIE, 100 ) \
+    PIN( x, PinB7,  Timer4, Channel0, BankB, Interrupt, GPIO_PIN_7,  CIE, 100 ) \
+    PIN( x, PinB8,  Timer4, Channel1, BankB, Interrupt, GPIO_PIN_8,  CIE, 100 ) \
+    PIN( x, PinC14, Timer4, Channel2, BankC, Interrupt, GPIO_PIN_14, CIE, 100 ) \
+    PIN( x, PinC15, Timer4, Channel3, BankC, Interrupt, GPIO_PIN_15, CIE, 100 )
+
+#if IRQ_RATE_PINS == 1
+// The other color pins are hardware driven by TIMER4 and stay off
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinC13, Timer1, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinA1,  Timer4, Channel1, BankA, Timer,     GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer4, Channel2, BankA, Timer,     GPIO_PIN_2,  CIE, 100 )
+#elif IRQ_RATE_PINS == 3
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinC13, Timer1, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinA1,  Timer1, Channel1, BankA, Interrupt, GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer1, Channel2, BankA, Interrupt, GPIO_PIN_2,  CIE, 100 )
+#elif IRQ_RATE_PINS == 4
+#define CFG_PINS IRQ_RATE_PINS_4
+#elif IRQ_RATE_PINS == 8
+#define CFG_PINS IRQ_RATE_PINS_8
+#elif IRQ_RATE_PINS == 16
+#define CFG_PINS IRQ_RATE_PINS_16
+#else
+#error "IRQ_RATE_PINS must be 1, 3, 4, 8 or 16"
+#endif
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define IRQ_RATE_TICK 500 // edge of channel 0, the others follow tick by tick
+
+static uint32_t _worst; // core cycles of the slowest handler call
+
+// Bit per timer with Interrupt pins
+static uint32_t timers() {
+    uint32_t bits = 0;
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        if( _pwm_pins[p].mode == Interrupt ) bits |= 1U << _pwm_pins[p].timer;
+    }
+    return bits;
+}
+
+// Core cycles per timer clock
+static uint32_t timer_cycles() {
+    return SystemCoreClock / pwm_timer_clock();
+}
+
+// CK_SYS cycles of a pwm interval
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+// Brightness of a pin: its channel's edge tick as share of the interval
+static uint16_t level_of( enum Pins pin ) {
+    return (uint32_t)(IRQ_RATE_TICK + _cfg_pins[pin].channel) * 65535 / _pwm_ticks;
+}
+
+// Let the levels take effect, then count handler instructions for some intervals
+static uint64_t run_counted( uint32_t intervals ) {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        set_pwm_duty16(p, _pwm_pins[p].mode == Interrupt ? level_of(p) : 0);
+    }
+    mock_count(1);
+    mock_run_until(mock_cycles() + 2 * interval());
+    mock_trace_reset();
+    mock_irq_stat_reset();
+    uint64_t from = mock_cycles();
+    mock_run_until(from + intervals * interval());
+    mock_count(0);
+    return from;
+}
+
+// Do all Interrupt pins show their duty within a tick of dithering since from?
+static int pins_keep_up( uint64_t from ) {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        if( _pwm_pins[p].mode != Interrupt ) continue;
+        uint32_t share = mock_pin_share((enum Mock_Banks)_cfg_pins[p].bank, __builtin_ctz(_cfg_pins[p].pin), 0, from, mock_cycles());
+        uint32_t expected = (uint64_t)level_of(p) * 1000000 / 65535;
+        if( share + 1000000 / MAX_DUTY < expected || share > expected + 1000000 / MAX_DUTY ) return 0;
+    }
+    return 1;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_masks_are_constant() {
+    TEST_ASSERT_EQUAL(0, AUTO_PINS);
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        for( int b = 0; b < ARRAY_SIZE(_cfg_gpio_banks); b++ ) {
+            for( int c = 0; c < ARRAY_SIZE(_cfg_channels); c++ ) {
+                TEST_ASSERT_EQUAL(_irq_masks[t][b][c], IRQ_MASK(t, b, c));
+            }
+        }
+    }
+}
+
+void test_worst_handler_cycles() {
+    run_counted(4);
+    uint32_t count = 0;
+    uint64_t cycles = 0;
+    for( int t = 0; t < ARRAY_SIZE(_cfg_timers); t++ ) {
+        if( !(timers() & (1U << t)) ) continue;
+        const struct mock_irq_stat *s = mock_irq_stat(_cfg_timers[t].eclic_interrupt);
+        TEST_ASSERT_GREATER_THAN(4, s->count);
+        count += s->count;
+        cycles += s->cycles;
+        if( s->max_cycles > _worst ) _worst = s->max_cycles;
+    }
+    printf("irq rate: %d pins, %lu events, worst %lu core cycles, average %lu\n", IRQ_RATE_PINS,
+        (unsigned long)count, (unsigned long)_worst, (unsigned long)(cycles / count));
+}
+
+void test_edge_peak() {
+    // Equal duties: only the phases of timers and channels keep edges apart
+    uint32_t pins = 0;
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        if( _pwm_pins[p].mode == Interrupt ) pins++;
+        set_pwm_duty16(p, _pwm_pins[p].mode == Interrupt ? 0x4000 : 0);
+    }
+    uint32_t peak = pwm_edge_peak();
+    printf("irq rate: %d pins, at most %lu edges at once with equal duties\n", IRQ_RATE_PINS, (unsigned long)peak);
+    TEST_ASSERT_TRUE(peak >= 1 && peak <= IRQ_CHANNELS && peak <= pins);
+}
+
+void test_max_tick_rate() {
+    TEST_ASSERT_GREATER_THAN(0, _worst);
+    uint32_t prescale = (_worst + timer_cycles() - 1) / timer_cycles();
+    for( ;; ) {
+        prescale += prescale & 1; // center aligned counters need it even
+        TEST_ASSERT_TRUE(pwm_retime(prescale, MAX_DUTY));
+        if( pins_keep_up(run_counted(8)) ) break;
+        prescale += prescale / 8;
+        TEST_ASSERT_LESS_THAN(16 * _worst, prescale * timer_cycles());
+    }
+    printf("irq rate: %d pins, prescale %lu, max tick rate %lu kHz\n", IRQ_RATE_PINS,
+        (unsigned long)prescale, (unsigned long)(pwm_timer_clock() / prescale / 1000));
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_masks_are_constant);
+    RUN_TEST(test_worst_handler_cycles);
+    RUN_TEST(test_edge_peak);
+    RUN_TEST(test_max_tick_rate);
+    return UNITY_END();
+}
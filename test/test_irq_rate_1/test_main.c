@@ -0,0 +1,6 @@
+/*
+test_irq_rate with one Interrupt pin, the red led on C13.
+*/
+
+#define IRQ_RATE_PINS 1
+#include "../test_irq_rate/test_main.c"
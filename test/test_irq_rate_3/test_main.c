@@ -0,0 +1,6 @@
+/*
+test_irq_rate with the board's three leds as Interrupt pins on TIMER1.
+*/
+
+#define IRQ_RATE_PINS 3
+#include "../test_irq_rate/test_main.c"
@@ -0,0 +1,7 @@
+/*
+test_irq_rate with the board's three leds as Interrupt pins on a center aligned TIMER1.
+*/
+
+#define IRQ_RATE_PINS 3
+#define PWM_ALIGN TIMER_COUNTER_CENTER_BOTH
+#include "../test_irq_rate/test_main.c"
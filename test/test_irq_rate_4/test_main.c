@@ -0,0 +1,6 @@
+/*
+test_irq_rate with four Interrupt pins, all channels of TIMER1.
+*/
+
+#define IRQ_RATE_PINS 4
+#include "../test_irq_rate/test_main.c"
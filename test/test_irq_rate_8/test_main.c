@@ -0,0 +1,6 @@
+/*
+test_irq_rate with eight Interrupt pins on TIMER1 and TIMER2.
+*/
+
+#define IRQ_RATE_PINS 8
+#include "../test_irq_rate/test_main.c"
@@ -0,0 +1,6 @@
+/*
+test_irq_rate with 16 Interrupt pins on four center aligned timers.
+*/
+
+#define PWM_ALIGN TIMER_COUNTER_CENTER_BOTH
+#include "../test_irq_rate/test_main.c"
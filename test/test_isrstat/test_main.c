@@ -0,0 +1,182 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+lib/isrstat with handler durations at the bucket limits, latencies and missed events,
+and its frames round-tripped through tools/isrstat_decode.py between lines of text,
+one with a flipped bit the decoder must drop. Durations come from the mock mcycle.
+lib/isrstat only exists with WITH_ISR_STATS, the test builds it in.
+The decoder runs with python3 like the PlatformIO tooling, the test is ignored without it.
+*/
+
+#define WITH_ISR_STATS
+#include "../../lib/isrstat/isrstat.c"
+
+#include <unistd.h>
+
+#define ARRAY_SIZE(a) (sizeof(a)/sizeof(*(a)))
+
+// Bytes isrstat_send() put
+static uint8_t _bytes[1024];
+static uint32_t _byte_count;
+
+static void put( uint8_t ch ) {
+    TEST_ASSERT_TRUE(_byte_count < sizeof(_bytes));
+    _bytes[_byte_count++] = ch;
+}
+
+static void put_text( const char *text ) {
+    while( *text ) put(*text++);
+}
+
+// A handler call of exactly cycles on the mcycle counter
+static void handled( uint32_t id, uint32_t cycles ) {
+    isrstat_exit(id, (uint32_t)read_csr(mcycle) - (cycles - MOCK_CSR)); // the read in isrstat_exit() costs MOCK_CSR
+}
+
+// Handler 3: every bucket limit up to the last, latencies and missed events
+static void record_handler_3() {
+    const uint32_t durations[] = { 31, 32, 63, 64, 1000, 1000, 1000, 600000 };
+    for( int i = 0; i < ARRAY_SIZE(durations); i++ ) handled(3, durations[i]);
+    isrstat_latency(3, 12);
+    isrstat_latency(3, 340);
+    isrstat_latency(3, 57);
+    isrstat_missed(3);
+    isrstat_missed(3);
+}
+
+static uint32_t le32( const uint8_t *b ) {
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+void setUp() {
+    isrstat_init();
+    _byte_count = 0;
+}
+
+void tearDown() {
+}
+
+void test_buckets_and_limits() {
+    record_handler_3();
+    struct isrstat s;
+    isrstat_snapshot(3, &s, 0);
+    TEST_ASSERT_EQUAL(8, s.count);
+    TEST_ASSERT_EQUAL(31, s.min);
+    TEST_ASSERT_EQUAL(600000, s.max);
+    TEST_ASSERT_EQUAL(603190, s.sum);
+    TEST_ASSERT_EQUAL(12, s.latency_min);
+    TEST_ASSERT_EQUAL(340, s.latency_max);
+    TEST_ASSERT_EQUAL(2, s.missed);
+    const uint16_t hist[ISRSTAT_BUCKETS] = { 1, 2, 1, 0, 0, 3, [ISRSTAT_BUCKETS - 1] = 1 }; // < 32, < 64, < 128, ..., < 1024, ..., the rest
+    TEST_ASSERT_EQUAL_MEMORY(hist, s.hist, sizeof(hist));
+}
+
+void test_histogram_saturates() {
+    for( uint32_t i = 0; i < UINT16_MAX + 10; i++ ) handled(1, 20);
+    struct isrstat s;
+    isrstat_snapshot(1, &s, 1);
+    TEST_ASSERT_EQUAL(UINT16_MAX + 10, s.count);
+    TEST_ASSERT_EQUAL(UINT16_MAX, s.hist[0]);
+    isrstat_snapshot(1, &s, 0); // reset by the snapshot before
+    TEST_ASSERT_EQUAL(0, s.count);
+    TEST_ASSERT_EQUAL(UINT32_MAX, s.min);
+    TEST_ASSERT_EQUAL(UINT32_MAX, s.latency_min);
+}
+
+void test_macros_use_mcycle() {
+    ISRSTAT_ENTER();
+    mock_run(500);
+    ISRSTAT_EXIT(2);
+    struct isrstat s;
+    isrstat_snapshot(2, &s, 0);
+    TEST_ASSERT_EQUAL(1, s.count);
+    TEST_ASSERT_EQUAL(500 + MOCK_CSR, s.min);
+}
+
+void test_frame() {
+    record_handler_3();
+    ISRSTAT_SEND(3, put);
+    TEST_ASSERT_EQUAL(5 + PAYLOAD_SIZE, _byte_count);
+    TEST_ASSERT_EQUAL_HEX32(0xA5, _bytes[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x5A, _bytes[1]);
+    TEST_ASSERT_EQUAL(3, _bytes[2]);
+    TEST_ASSERT_EQUAL(64, _bytes[3]);
+    const uint8_t *p = &_bytes[4];
+    TEST_ASSERT_EQUAL(8, le32(p));
+    TEST_ASSERT_EQUAL(31, le32(p + 4));
+    TEST_ASSERT_EQUAL(600000, le32(p + 8));
+    TEST_ASSERT_EQUAL(603190, le32(p + 12)); // sum low and high word
+    TEST_ASSERT_EQUAL(0, le32(p + 16));
+    TEST_ASSERT_EQUAL(12, le32(p + 20));
+    TEST_ASSERT_EQUAL(340, le32(p + 24));
+    TEST_ASSERT_EQUAL(2, le32(p + 28));
+    TEST_ASSERT_EQUAL(3, p[32 + 2 * 5] | (p[33 + 2 * 5] << 8)); // bucket 5
+    uint8_t crc = 0;
+    for( uint32_t i = 2; i < 4 + PAYLOAD_SIZE; i++ ) crc = crc8(crc, _bytes[i]);
+    TEST_ASSERT_EQUAL_HEX32(crc, _bytes[4 + PAYLOAD_SIZE]);
+
+    // sending resets
+    _byte_count = 0;
+    ISRSTAT_SEND(3, put);
+    TEST_ASSERT_EQUAL(0, le32(&_bytes[4]));
+}
+
+void test_decoder_round_trip() {
+    if( system("python3 -c '' 2>/dev/null") != 0 ) TEST_IGNORE_MESSAGE("no python3");
+
+    record_handler_3();
+    handled(9, 100);
+    handled(7, 100);
+    put_text("stats\n");
+    ISRSTAT_SEND(3, put);
+    ISRSTAT_SEND(5, put);
+    uint32_t corrupt = _byte_count + 4 + 8;
+    ISRSTAT_SEND(7, put);
+    _bytes[corrupt] ^= 0x04; // min of handler 7
+    put_text("ok\n");
+    ISRSTAT_SEND(9, put);
+
+    // the decoder is in tools/ next to test/
+    char path[256], frames[] = "/tmp/isrstat_XXXXXX";
+    int dir = strrchr(__FILE__, '/') - __FILE__;
+    int fd = mkstemp(frames);
+    TEST_ASSERT_TRUE(fd >= 0);
+    snprintf(path, sizeof(path), "python3 %.*s/../../tools/isrstat_decode.py %s", dir, __FILE__, frames);
+    TEST_ASSERT_EQUAL(_byte_count, write(fd, _bytes, _byte_count));
+    close(fd);
+    FILE *decoder = popen(path, "r");
+    TEST_ASSERT_NOT_NULL(decoder);
+    char out[2048];
+    size_t length = fread(out, 1, sizeof(out), decoder);
+    int status = pclose(decoder);
+    unlink(frames);
+    TEST_ASSERT_EQUAL(0, status);
+
+    const char *expected[] = {
+        "stats\n",
+        "isr 3: calls 8, cycles min/avg/max 31/75398/600000, p50 <128 p99 <inf, latency 12..340, missed 2\n",
+        "isr 5: no calls\n",
+        "ok\n",
+        "isr 9: calls 1, cycles min/avg/max 100/100/100, p50 <128 p99 <128, latency -, missed 0\n"
+    };
+    const char *at = out; // the dropped frame comes out as text, zeros included
+    for( int i = 0; i < ARRAY_SIZE(expected); i++ ) {
+        const char *line = memmem(at, out + length - at, expected[i], strlen(expected[i]));
+        TEST_ASSERT_NOT_NULL_MESSAGE(line, expected[i]);
+        at = line + strlen(expected[i]);
+    }
+    TEST_ASSERT_NULL(memmem(out, length, "isr 7:", 6)); // crc mismatch
+}
+
+int main() {
+    mock_init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_buckets_and_limits);
+    RUN_TEST(test_histogram_saturates);
+    RUN_TEST(test_macros_use_mcycle);
+    RUN_TEST(test_frame);
+    RUN_TEST(test_decoder_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,102 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+Interrupt entry to pin toggle latency like the README measures it with a scope:
+a Timer pin (PA2) and an Interrupt pin (PC13) on two leading channels of TIMER4 with the same duty.
+The timer switches PA2 at the compare event, the handler PC13 some cycles later.
+Each PC13 edge is paired with the PA2 edge to the same level before it.
+Build with -DWITH_RAM_ISR for the vectored sram handlers, the mock charges
+MOCK_IRQ_ENTRY/EXIT_VECTORED instead of MOCK_IRQ_ENTRY/EXIT for them. Flash wait states
+are modelled only as MOCK_FLASH_WAIT extra cycles per instruction outside the RAM_ISR
+section (-DMOCK_FLASH_WAIT=n, 0 by default). Nothing else runs at PWM_IRQ_LEVEL, so the
+delay is entry plus the handler up to its gpio write.
+
+Core cycles at PRESCALE 200, counted x86 instructions for RISC-V ones, best/average/worst:
+MOCK_FLASH_WAIT | -O2 flash     | -O2 WITH_RAM_ISR | -O1 flash       | -O1 WITH_RAM_ISR
+              0 | 200/256/328   | 172/228/300      |  375/438/516    | 347/410/488
+              1 | 338/448/582   | 174/230/302      |  688/811/958    | 355/419/500
+              2 | 476/640/836   | 176/232/304      | 1001/1184/1400  | 363/427/512
+These are no before/after result. With 0 wait cycles only the 28 cycles of vectored entry
+the mock charges less show up. Each wait cycle costs a flash handler about as many cycles
+as it has instructions, but the mock counts x86 instructions and knows nothing of the
+prefetch of the real core, so how much of that the board pays is open.
+The sram handlers still pay for helpers not inlined into them, see -O1.
+Only the scope measurement in the README, on the board, tells what WITH_RAM_ISR saves.
+The spread comes from what the handler does before its gpio write, more at an interval start.
+*/
+
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinC13, Timer4, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 ) \
+    PIN( x, PinA1,  Timer4, Channel1, BankA, Timer,     GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer4, Channel2, BankA, Timer,     GPIO_PIN_2,  CIE, 100 )
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define INTERVALS 64
+
+#define TIMER_PIN 2      // PA2
+#define INTERRUPT_PIN 13 // PC13
+
+// CK_SYS cycles of a pwm interval
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_edge_delay() {
+    TEST_ASSERT_EQUAL(Interrupt, _pwm_pins[PinC13].mode);
+    TEST_ASSERT_EQUAL(Timer, _pwm_pins[PinA2].mode);
+    set_pwm_duty(PinC13, MAX_DUTY / 3);
+    set_pwm_duty(PinA2, MAX_DUTY / 3);
+    mock_run_until(mock_cycles() + 2 * interval());
+    mock_trace_reset();
+    mock_count(1);
+    mock_run_until(mock_cycles() + INTERVALS * interval());
+    mock_count(0);
+    TEST_ASSERT_FALSE(mock_trace_full());
+
+    uint64_t reference[2] = { 0, 0 }; // last PA2 edge to each level
+    uint64_t best = UINT64_MAX, worst = 0, sum = 0;
+    uint32_t edges = 0;
+    for( uint32_t e = 0; e < mock_trace_count(); e++ ) {
+        const struct mock_edge *edge = mock_trace_get(e);
+        if( edge->bank == MockA && edge->pin == TIMER_PIN ) {
+            reference[edge->level] = edge->time;
+        }
+        else if( edge->bank == MockC && edge->pin == INTERRUPT_PIN && reference[edge->level] ) {
+            uint64_t delay = edge->time - reference[edge->level];
+            TEST_ASSERT_TRUE(delay < interval() / 2);
+            if( delay < best ) best = delay;
+            if( delay > worst ) worst = delay;
+            sum += delay;
+            edges++;
+        }
+    }
+    TEST_ASSERT_TRUE(edges >= 2 * INTERVALS - 2);
+    printf("latency: %s, %d flash wait cycles, edge delay best %lu, average %lu, worst %lu core cycles\n",
+        #ifdef WITH_RAM_ISR
+        "WITH_RAM_ISR",
+        #else
+        "flash",
+        #endif
+        MOCK_FLASH_WAIT, (unsigned long)best, (unsigned long)(sum / edges), (unsigned long)worst);
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+    eclic_global_interrupt_enable();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_edge_delay);
+    return UNITY_END();
+}
@@ -0,0 +1,170 @@
+#include <unity.h>
+#include <probe.h>
+
+/*
+lib/probe on synthetic traces: a square wave of the 16 bit capture counter,
+its edge timestamps written to a ring like the dma does, polled like poll_probe() does.
+No register mock needed, lib/probe has no hardware access.
+*/
+
+#define RING 64
+
+static struct probe _p;
+static uint16_t _ring[RING];
+static uint32_t _written; // stamps written to the ring
+static uint32_t _read;    // stamps handed to probe_poll()
+static uint64_t _now;     // counts since start
+static uint8_t _level;    // pin level
+static uint32_t _skip;    // edges to toggle the pin without a stamp (missed captures)
+
+static void start( uint8_t level, uint32_t expect ) {
+    _written = _read = 0;
+    _now = 0;
+    _level = level;
+    _skip = 0;
+    probe_start(&_p, level, 0, expect);
+}
+
+static void poll() {
+    probe_poll(&_p, _ring, RING, _read % RING, _written % RING, (uint16_t)_now, _level);
+    _read = _written;
+}
+
+// Let counts pass with a level, then an edge. Polls every poll_every counts
+static void level_for( uint32_t counts, uint32_t poll_every ) {
+    while( counts > poll_every ) {
+        _now += poll_every;
+        counts -= poll_every;
+        poll();
+    }
+    _now += counts;
+    _level ^= 1;
+    if( _skip ) _skip--;
+    else _ring[_written++ % RING] = (uint16_t)_now;
+}
+
+// Periods of a square wave from the current level, polled every poll_every counts and each period
+static void wave_polled( uint32_t high, uint32_t low, uint32_t periods, uint32_t poll_every ) {
+    for( uint32_t i = 0; i < periods; i++ ) {
+        level_for(_level ? high : low, poll_every);
+        level_for(_level ? high : low, poll_every);
+        poll();
+    }
+}
+
+static void wave( uint32_t high, uint32_t low, uint32_t periods ) {
+    wave_polled(high, low, periods, 20000);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_square_wave() {
+    start(0, 1000);
+    wave(250, 750, 100); // low first: rise at 750, fall at 1000...
+    struct probe_stats s;
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(99, s.periods); // timing starts with the first rising edge
+    TEST_ASSERT_EQUAL(200, s.edges);
+    TEST_ASSERT_EQUAL(1000, s.min);
+    TEST_ASSERT_EQUAL(1000, s.max);
+    TEST_ASSERT_EQUAL(0, s.odd);
+    TEST_ASSERT_EQUAL(0, s.resyncs);
+    TEST_ASSERT_EQUAL(0, s.level);
+    TEST_ASSERT_EQUAL(0x10000 * 250 / 1000, probe_share(&s, 1));
+}
+
+void test_take_starts_over() {
+    start(0, 1000);
+    wave(500, 500, 10);
+    struct probe_stats s;
+    probe_take(&_p, &s);
+    wave(100, 900, 10);
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(10, s.periods);
+    TEST_ASSERT_TRUE(s.high == 500 + 9 * 100); // timing continues over a take
+    TEST_ASSERT_TRUE(s.low == 10 * 900);
+}
+
+void test_long_report_does_not_wrap() {
+    // 50000 counts per period, 100000 periods: 5e9 counts > 2^32 for high + low,
+    // high alone 1.25e9 * 2 > 2^31. Like an hour of reports at 1.4MHz counts
+    start(0, 50000);
+    wave(12500, 37500, 100000);
+    struct probe_stats s;
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(99999, s.periods);
+    TEST_ASSERT_TRUE(s.high + s.low > UINT32_MAX);
+    TEST_ASSERT_TRUE(s.high == 99999ULL * 12500);
+    TEST_ASSERT_TRUE(s.low == 99999ULL * 37500);
+    TEST_ASSERT_EQUAL(0x10000 / 4, probe_share(&s, 1));
+    TEST_ASSERT_EQUAL(0x10000 * 3 / 4, probe_share(&s, 0));
+}
+
+void test_odd_periods_are_counted() {
+    start(0, 1000);
+    wave(500, 500, 10);
+    wave(500, 700, 1);  // 1200 from rise to rise
+    wave(500, 400, 1);  // 900 is within 1/8
+    wave(500, 500, 10);
+    struct probe_stats s;
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(1, s.odd);
+    TEST_ASSERT_EQUAL(900, s.min);
+    TEST_ASSERT_EQUAL(1200, s.max);
+}
+
+void test_missed_edge_resyncs() {
+    start(0, 1000);
+    wave(300, 700, 10);
+    _skip = 1; // the next rising edge is not captured: level inverted from here on
+    wave_polled(300, 700, 20, 100);
+    struct probe_stats s;
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(1, s.resyncs);
+    wave(300, 700, 10);
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(0, s.resyncs);
+    TEST_ASSERT_EQUAL(0x10000 * 3 / 10, probe_share(&s, 1));
+}
+
+void test_stuck_pin_has_its_level() {
+    start(1, 1000);
+    for( int i = 0; i < 10; i++ ) {
+        _now += 30000; // counter wraps without edges
+        poll();
+    }
+    struct probe_stats s;
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(0, s.periods);
+    TEST_ASSERT_EQUAL(0x10000, probe_share(&s, 1));
+    TEST_ASSERT_EQUAL(0, probe_share(&s, 0));
+}
+
+void test_idle_wrap_restarts_timing() {
+    start(0, 1000);
+    wave(500, 500, 5);
+    for( int i = 0; i < 4; i++ ) { // low for more than a counter wrap
+        _now += 20000;
+        poll();
+    }
+    wave(500, 500, 5);
+    struct probe_stats s;
+    probe_take(&_p, &s);
+    TEST_ASSERT_EQUAL(1000, s.max); // the long low period is not timed
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_square_wave);
+    RUN_TEST(test_take_starts_over);
+    RUN_TEST(test_long_report_does_not_wrap);
+    RUN_TEST(test_odd_periods_are_counted);
+    RUN_TEST(test_missed_edge_resyncs);
+    RUN_TEST(test_stuck_pin_has_its_level);
+    RUN_TEST(test_idle_wrap_restarts_timing);
+    return UNITY_END();
+}
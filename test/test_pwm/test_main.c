@@ -0,0 +1,185 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+The pwm of src/main.c with the pins of the board on the register mock:
+Auto pins become Timer pins (alternate function) and an Interrupt pin (handle_pwm_interrupt()).
+The edge trace shows what a scope on the pins would show.
+init_pwm() runs once, tests change duties of the running pwm like the program does.
+*/
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+// CK_SYS cycles of a pwm interval
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+static enum Mock_Banks bank_of( enum Pins pin ) {
+    return (enum Mock_Banks)_cfg_pins[pin].bank;
+}
+
+static uint32_t pin_of( enum Pins pin ) {
+    return __builtin_ctz(_cfg_pins[pin].pin);
+}
+
+// Expected on share in ppm of a duty
+static uint32_t expected_ppm( enum Pins pin, uint16_t duty ) {
+    return (uint64_t)_pin_levels[pin][duty < MAX_DUTY ? duty : MAX_DUTY] * 1000000 / 65535;
+}
+
+// Set a duty on all pins, let it take effect and trace some intervals
+static uint64_t run_duty( uint16_t duty, uint32_t intervals ) {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) set_pwm_duty(p, duty);
+    mock_run_until(mock_cycles() + 2 * interval());
+    mock_trace_reset();
+    uint64_t from = mock_cycles();
+    mock_run_until(from + intervals * interval());
+    return from;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_auto_pins_are_placed() {
+    TEST_ASSERT_EQUAL(Timer, _pwm_pins[PinA1].mode);
+    TEST_ASSERT_EQUAL(Timer, _pwm_pins[PinA2].mode);
+    TEST_ASSERT_EQUAL(Interrupt, _pwm_pins[PinC13].mode);
+    TEST_ASSERT_EQUAL(0, _pwm_unplaced);
+}
+
+void test_allocate_again_keeps_placement() {
+    struct pwm_pins pins[ARRAY_SIZE(_pwm_pins)];
+    uint16_t masks[IRQ_TIMERS][IRQ_BANKS][IRQ_CHANNELS];
+    memcpy(pins, _pwm_pins, sizeof(pins));
+    memcpy(masks, _irq_masks, sizeof(masks));
+    uint32_t timers = _irq_timers;
+    allocate_pwm();
+    TEST_ASSERT_EQUAL_MEMORY(pins, _pwm_pins, sizeof(pins));
+    TEST_ASSERT_EQUAL_MEMORY(masks, _irq_masks, sizeof(masks));
+    TEST_ASSERT_EQUAL(timers, _irq_timers);
+    TEST_ASSERT_EQUAL(0, _pwm_unplaced);
+}
+
+void test_pins_start_off() {
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        TEST_ASSERT_EQUAL(1, mock_pin(bank_of(p), pin_of(p))); // inverted leds
+    }
+}
+
+void test_duty_zero_has_no_edges() {
+    run_duty(0, 4);
+    for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+        TEST_ASSERT_EQUAL(0, mock_pin_edges(bank_of(p), pin_of(p), 0, UINT64_MAX));
+        TEST_ASSERT_EQUAL(1, mock_pin(bank_of(p), pin_of(p)));
+    }
+}
+
+void test_duty_share_of_all_pins() {
+    static const uint16_t duties[] = { 1, 10, 100, 333, 500, 777, 999, MAX_DUTY };
+    for( int d = 0; d < ARRAY_SIZE(duties); d++ ) {
+        uint32_t intervals = 16;
+        uint64_t from = run_duty(duties[d], intervals);
+        for( int p = 0; p < ARRAY_SIZE(_cfg_pins); p++ ) {
+            uint32_t share = mock_pin_share(bank_of(p), pin_of(p), 0, from, mock_cycles());
+            char message[64];
+            snprintf(message, sizeof(message), "pin %d duty %u", p, duties[d]);
+            // dithering varies the duty by one tick per interval
+            TEST_ASSERT_UINT32_WITHIN_MESSAGE(1000000 / MAX_DUTY, expected_ppm(p, duties[d]), share, message);
+        }
+    }
+}
+
+void test_interrupt_pin_switches_twice_per_interval() {
+    uint32_t intervals = 16;
+    uint32_t irq = _cfg_timers[_pwm_pins[PinC13].timer].eclic_interrupt;
+    mock_irq_stat_reset();
+    uint64_t from = run_duty(500, intervals);
+    uint32_t edges = mock_pin_edges(bank_of(PinC13), pin_of(PinC13), from, mock_cycles());
+    TEST_ASSERT_EQUAL(2 * intervals, edges);
+    // handle_pwm_interrupt() runs at the update and the compare event of each interval,
+    // center aligned at both ends of the count and the compare event up and down
+    uint32_t events = (PWM_ALIGN == TIMER_COUNTER_EDGE) ? 2 : 4;
+    TEST_ASSERT_UINT32_WITHIN(events, events * (intervals + 2), mock_irq_stat(irq)->count);
+}
+
+void test_duty_change_takes_effect_next_interval() {
+    run_duty(200, 2);
+    set_pwm_duty(PinC13, 800);
+    mock_run_until(mock_cycles() + interval()); // the current interval ends as it started
+    mock_trace_reset();
+    uint64_t from = mock_cycles();
+    mock_run_until(from + 4 * interval());
+    uint32_t share = mock_pin_share(bank_of(PinC13), pin_of(PinC13), 0, from, mock_cycles());
+    TEST_ASSERT_UINT32_WITHIN(1000000 / MAX_DUTY, expected_ppm(PinC13, 800), share);
+}
+
+void test_edge_peak_of_long_intervals() {
+    // One pin never switches on and off at the same time, also above 32767 ticks (65535 half ticks)
+    uint16_t duties[ARRAY_SIZE(_pwm_pins)];
+    uint16_t ticks = _pwm_ticks;
+    memcpy(duties, _pwm_duty, sizeof(duties));
+    memset(_pwm_duty, 0, sizeof(_pwm_duty));
+    _pwm_ticks = 40000;
+    uint32_t peak = 0;
+    for( uint32_t duty = 1; duty < _pwm_ticks; duty++ ) {
+        _pwm_duty[PinC13] = duty;
+        uint32_t edges = pwm_edge_peak();
+        if( edges > peak ) peak = edges;
+    }
+    _pwm_ticks = ticks;
+    memcpy(_pwm_duty, duties, sizeof(duties));
+    TEST_ASSERT_EQUAL(1, peak);
+}
+
+// Register value without simulated cost
+static uint32_t reg( volatile uint32_t *address ) {
+    return mock_reg((uintptr_t)address);
+}
+
+void test_retime_keeps_update_events() {
+    // Retime at offsets over the last counter step of an interval, so some of them hit its end
+    // while update events are disabled. Each interval after it must still start with the on phase
+    uint32_t port = _cfg_timers[_pwm_pins[PinC13].timer].port;
+    uint32_t step = (reg(&TIMER_PSC(port)) + 1) * (MOCK_SYS_HZ / pwm_timer_clock());
+    int edge = (PWM_ALIGN == TIMER_COUNTER_EDGE);
+    uint32_t before = edge ? _pwm_ticks - 2 : 2; // count before the last step: up to the top or down to 0
+    run_duty(500, 1);
+    for( uint32_t offset = 0; offset < step; offset += 2 ) {
+        while( reg(&TIMER_CNT(port)) != before || !(edge || (reg(&TIMER_CTL0(port)) & TIMER_CTL0_DIR)) ) {
+            mock_run_until(mock_cycles() + step / 2);
+        }
+        while( reg(&TIMER_CNT(port)) == before ) mock_run_until(mock_cycles() + 1);
+        mock_run_until(mock_cycles() + offset);
+        mock_trace_reset();
+        uint64_t from = mock_cycles();
+        TEST_ASSERT_TRUE(pwm_retime(_pwm_prescale, _pwm_ticks));
+        mock_run_until(from + 3 * interval());
+        char message[32];
+        snprintf(message, sizeof(message), "offset %lu", (unsigned long)offset);
+        TEST_ASSERT_EQUAL_MESSAGE(6, mock_pin_edges(bank_of(PinC13), pin_of(PinC13), from, mock_cycles()), message);
+    }
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_auto_pins_are_placed);
+    RUN_TEST(test_allocate_again_keeps_placement);
+    RUN_TEST(test_pins_start_off);
+    RUN_TEST(test_duty_zero_has_no_edges);
+    RUN_TEST(test_duty_share_of_all_pins);
+    RUN_TEST(test_interrupt_pin_switches_twice_per_interval);
+    RUN_TEST(test_duty_change_takes_effect_next_interval);
+    RUN_TEST(test_edge_peak_of_long_intervals);
+    RUN_TEST(test_retime_keeps_update_events);
+    return UNITY_END();
+}
@@ -0,0 +1,7 @@
+/*
+test_pwm with center aligned counters: on phases are centered on the start or the middle
+of an interval, handle_pwm_interrupt() runs at both ends of the count.
+*/
+
+#define PWM_ALIGN TIMER_COUNTER_CENTER_BOTH
+#include "../test_pwm/test_main.c"
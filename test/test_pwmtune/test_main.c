@@ -0,0 +1,137 @@
+#include <unity.h>
+#include "../mock/mock.c"
+#include <pwmtune.h>
+
+/*
+pwmtune_select() on made up samples: the prescaler it picks keeps the load within budget
+and the longest interrupt within a tick, and the next smaller one doesn't.
+The mock is only linked for the csr access of pwmtune_measure().
+*/
+
+#define CORE_HZ 108000000
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static struct pwmtune_sample sample( uint32_t cycles, uint32_t stolen, uint32_t max ) {
+    struct pwmtune_sample s = { .cycles = cycles, .stolen = stolen, .max = max, .gaps = 1 };
+    return s;
+}
+
+static struct pwmtune_limits limits( uint32_t prescale, uint16_t budget ) {
+    struct pwmtune_limits l = {
+        .prescale     = prescale,
+        .core_hz      = CORE_HZ,
+        .timer_hz     = CORE_HZ,
+        .min_prescale = 2,
+        .max_prescale = 65536,
+        .budget       = budget };
+    return l;
+}
+
+// Does a prescaler meet the limits?
+static int fits( const struct pwmtune_sample *s, const struct pwmtune_limits *l, uint64_t prescale ) {
+    if( prescale < l->min_prescale || prescale > l->max_prescale ) return 0;
+    if( l->even && (prescale & 1) ) return 0;
+    if( (uint64_t)s->stolen * l->prescale * 1000 > (uint64_t)l->budget * s->cycles * prescale ) return 0;
+    return (uint64_t)s->max * l->timer_hz <= prescale * l->core_hz;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_load_sets_the_prescaler() {
+    // 10% at prescale 200, 5% allowed: half the interval rate
+    struct pwmtune_sample s = sample(1000000, 100000, 300);
+    struct pwmtune_limits l = limits(200, 50);
+    TEST_ASSERT_EQUAL(400, pwmtune_select(&s, &l));
+    TEST_ASSERT_EQUAL(50, pwmtune_load(&s, 200, 400));
+    TEST_ASSERT_EQUAL(51, pwmtune_load(&s, 200, 399)); // rounds up
+}
+
+void test_longest_interrupt_sets_the_prescaler() {
+    struct pwmtune_sample s = sample(1000000, 1000, 1001);
+    struct pwmtune_limits l = limits(200, 500);
+    TEST_ASSERT_EQUAL(1001, pwmtune_select(&s, &l));
+    l.timer_hz = CORE_HZ / 2; // 500.5 timer clocks
+    TEST_ASSERT_EQUAL(501, pwmtune_select(&s, &l));
+    l.even = 1;
+    TEST_ASSERT_EQUAL(502, pwmtune_select(&s, &l));
+}
+
+void test_min_and_max_prescale() {
+    struct pwmtune_sample s = sample(1000000, 0, 10);
+    struct pwmtune_limits l = limits(200, 500);
+    l.min_prescale = 123;
+    TEST_ASSERT_EQUAL(123, pwmtune_select(&s, &l));
+    l.min_prescale = 0;
+    TEST_ASSERT_EQUAL(10, pwmtune_select(&s, &l));
+    s.max = 0;
+    TEST_ASSERT_EQUAL(1, pwmtune_select(&s, &l));
+    s = sample(1000000, 600000, 100); // 60% at prescale 200 with a 50% budget
+    l.max_prescale = 239;
+    TEST_ASSERT_EQUAL(0, pwmtune_select(&s, &l));
+    l.max_prescale = 240;
+    TEST_ASSERT_EQUAL(240, pwmtune_select(&s, &l));
+}
+
+void test_nothing_to_go_by() {
+    struct pwmtune_sample s = sample(0, 0, 0);
+    struct pwmtune_limits l = limits(200, 500);
+    TEST_ASSERT_EQUAL(0, pwmtune_select(&s, &l));
+    TEST_ASSERT_EQUAL(0, pwmtune_load(&s, 200, 400));
+    s = sample(1000000, 1000, 100);
+    l.budget = 0;
+    TEST_ASSERT_EQUAL(0, pwmtune_select(&s, &l));
+}
+
+void test_smallest_that_fits() {
+    static const uint32_t stolen[] = { 0, 1, 999, 12345, 250000, 999999 };
+    static const uint32_t max[] = { 0, 1, 173, 1540, 70000 };
+    static const uint32_t prescales[] = { 1, 2, 200, 4321 };
+    static const uint16_t budgets[] = { 1, 333, 500, 1000 };
+    static const uint32_t timer_divs[] = { 1, 2, 8 };
+    uint32_t picked = 0;
+    for( int a = 0; a < COUNT(stolen); a++ )
+    for( int b = 0; b < COUNT(max); b++ )
+    for( int c = 0; c < COUNT(prescales); c++ )
+    for( int d = 0; d < COUNT(budgets); d++ )
+    for( int e = 0; e < COUNT(timer_divs); e++ )
+    for( int even = 0; even < 2; even++ ) {
+        struct pwmtune_sample s = sample(1000000, stolen[a], max[b]);
+        struct pwmtune_limits l = limits(prescales[c], budgets[d]);
+        l.timer_hz = CORE_HZ / timer_divs[e];
+        l.even = even;
+        uint32_t p = pwmtune_select(&s, &l);
+        char message[192]; // every number at its widest
+        snprintf(message, sizeof(message), "stolen %lu max %lu prescale %lu budget %u div %lu even %d: %lu",
+            (unsigned long)stolen[a], (unsigned long)max[b], (unsigned long)prescales[c], budgets[d],
+            (unsigned long)timer_divs[e], even, (unsigned long)p);
+        if( p == 0 ) {
+            for( uint64_t q = l.min_prescale; q <= l.max_prescale; q += 1 + (q >> 4) ) {
+                TEST_ASSERT_FALSE_MESSAGE(fits(&s, &l, q), message);
+            }
+            TEST_ASSERT_FALSE_MESSAGE(fits(&s, &l, l.max_prescale), message);
+            continue;
+        }
+        TEST_ASSERT_TRUE_MESSAGE(fits(&s, &l, p), message);
+        TEST_ASSERT_TRUE_MESSAGE(pwmtune_load(&s, l.prescale, p) <= l.budget, message);
+        TEST_ASSERT_FALSE_MESSAGE(fits(&s, &l, p - 1), message);
+        TEST_ASSERT_FALSE_MESSAGE(fits(&s, &l, p - 2), message);
+        picked++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, picked);
+}
+
+int main() {
+    mock_init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_load_sets_the_prescaler);
+    RUN_TEST(test_longest_interrupt_sets_the_prescaler);
+    RUN_TEST(test_min_and_max_prescale);
+    RUN_TEST(test_nothing_to_go_by);
+    RUN_TEST(test_smallest_that_fits);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+#include <unity.h>
+#include "../mock/mock.c"
+#include <systick.h>
+
+/*
+Fade steps of src/main.c from lib/scheduler against the busy-wait loop it replaced
+(set the duties, then delay_1us(_duty_us)). Both do STEPS steps of the fade animation
+at the default DUTY_US while the pwm interrupts of the default pins go on.
+The core is busy while mcycle counts: the scheduler sleeps in wfi between steps,
+the old loop spins in delay_1us(). Jitter is how far the time between two steps is from
+_duty_us, drift how far the last step is from where STEPS periods put it.
+Instructions are counted as x86 instructions (see mock_count()): for the scheduler all of
+sched_run() including the pwm interrupts that wake it, for the old loop the steps only
+(the busy wait is all spinning anyway).
+
+At PRESCALE 200, MAX_DUTY 1000, 5ms per step, over 200 steps:
+          | -O2 busy | jitter | drift  | instructions | -O1 busy | jitter  | drift  | instructions
+scheduler |    0.71% | 2.9us  |    1us |   2720/step  |    0.84% |  3.5us  |    1us |   3385/step
+busy-wait |   99.99% | 6.8us  | 1308us |    660/step  |   99.99% | 10.9us  | 1572us |    804/step
+The busy-wait steps come late by what a step and the interrupts in it take, every time,
+so the fade runs 0.1% slow and the core never rests. Scheduler steps are due on a fixed grid:
+they are late by the wake up and an interrupt at most and don't add up.
+*/
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define STEPS 200
+
+static uint64_t _times[STEPS + 1]; // CK_SYS cycles at each step
+static uint32_t _steps;
+
+// Scheduler task: a fade step that notes its time
+static void timed_fade( struct sched_task *task ) {
+    if( _steps <= STEPS ) _times[_steps++] = mock_cycles();
+    fade(task);
+}
+
+static struct sched_task _timed_task = { timed_fade };
+
+// CK_SYS cycles between two fade steps
+static uint64_t period_cycles() {
+    return (uint64_t)_duty_us * (MOCK_SYS_HZ / 1000000);
+}
+
+// Print busy share, worst jitter and drift of the steps taken, returns the drift in CK_SYS cycles
+static int64_t report( const char *name, uint64_t from, uint32_t awake, uint64_t instructions ) {
+    uint64_t period = period_cycles();
+    uint64_t jitter = 0;
+    for( uint32_t s = 1; s <= STEPS; s++ ) {
+        uint64_t step = _times[s] - _times[s - 1];
+        uint64_t off = step > period ? step - period : period - step;
+        if( off > jitter ) jitter = off;
+    }
+    int64_t drift = _times[STEPS] - _times[0] - STEPS * period;
+    uint64_t core = mock_core_cycles() - from;
+    printf("scheduler: %s %lu.%02lu%% busy, jitter %lu ns, drift %ld us, %lu instructions per step\n", name,
+        (unsigned long)((uint64_t)awake * 100 / core), (unsigned long)((uint64_t)awake * 10000 / core % 100),
+        (unsigned long)(jitter * 1000 / (MOCK_SYS_HZ / 1000000)), (long)(drift / (int64_t)(MOCK_SYS_HZ / 1000000)),
+        (unsigned long)(instructions / STEPS));
+    return drift;
+}
+
+void setUp() {
+    _steps = 0;
+    anim_start(&_fade_layer);
+    mock_irq_stat_reset();
+}
+
+void tearDown() {
+}
+
+void test_scheduler_sleeps() {
+    sched_add(&_timed_task, 0, _duty_us);
+    uint64_t from = mock_core_cycles();
+    uint32_t cycles = read_csr(mcycle);
+    uint64_t instructions = mock_instructions();
+    mock_count(1);
+    while( _steps <= STEPS ) sched_run();
+    mock_count(0);
+    uint32_t awake = (uint32_t)read_csr(mcycle) - cycles;
+    sched_remove(&_timed_task);
+
+    TEST_ASSERT_EQUAL(0, sched_overruns());
+    TEST_ASSERT_TRUE(awake < (mock_core_cycles() - from) / 10);
+    int64_t drift = report("scheduler", from, awake, mock_instructions() - instructions);
+    TEST_ASSERT_TRUE(llabs(drift) < MOCK_SYS_HZ / 100000); // within 10us over all steps
+}
+
+void test_busy_wait() {
+    struct sched_task task = { fade };
+    uint64_t from = mock_core_cycles();
+    uint32_t cycles = read_csr(mcycle);
+    uint64_t instructions = 0;
+    while( _steps <= STEPS ) {
+        _times[_steps++] = mock_cycles();
+        uint64_t at = mock_instructions();
+        mock_count(1);
+        fade(&task);
+        mock_count(0);
+        instructions += mock_instructions() - at;
+        delay_1us(_duty_us);
+    }
+    uint32_t awake = (uint32_t)read_csr(mcycle) - cycles;
+
+    TEST_ASSERT_UINT32_WITHIN(8, mock_core_cycles() - from, awake); // mcycle counts in ahb clocks
+    int64_t drift = report("busy-wait", from, awake, instructions);
+    TEST_ASSERT_TRUE(drift > STEPS * MOCK_IRQ_ENTRY); // every step adds its own time
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+    sched_init();
+    eclic_global_interrupt_enable();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_scheduler_sleeps);
+    RUN_TEST(test_busy_wait);
+    return UNITY_END();
+}
@@ -0,0 +1,214 @@
+#include <unity.h>
+#include <stream.h>
+#include <string.h>
+
+/*
+lib/stream on recorded byte streams: frames with text around them, broken frames
+the decoder has to sync past, and the frame and underrun counters of the double buffer.
+No register mock needed, lib/stream only parses bytes.
+*/
+
+static struct stream _s;
+static char _text[256]; // bytes the decoder passed on as text
+static uint32_t _text_count;
+
+static void text( char ch ) {
+    if( _text_count < sizeof(_text) - 1 ) _text[_text_count++] = ch;
+}
+
+// Append a frame with a valid crc, returns the bytes written
+static uint32_t frame( uint8_t *out, const uint8_t *payload, uint8_t length ) {
+    uint16_t crc = stream_crc16(0xffff, length);
+    uint32_t n = 0;
+    out[n++] = STREAM_SYNC0;
+    out[n++] = STREAM_SYNC1;
+    out[n++] = length;
+    for( uint8_t i = 0; i < length; i++ ) {
+        out[n++] = payload[i];
+        crc = stream_crc16(crc, payload[i]);
+    }
+    out[n++] = crc & 0xff;
+    out[n++] = crc >> 8;
+    return n;
+}
+
+static void feed_frame( const uint8_t *payload, uint8_t length ) {
+    uint8_t bytes[STREAM_MAX_PAYLOAD + 5];
+    stream_feed(&_s, bytes, frame(bytes, payload, length));
+}
+
+static void feed_text( const char *str ) {
+    stream_feed(&_s, (const uint8_t *)str, strlen(str));
+}
+
+// Take the next frame and check it is the expected one
+static void expect_frame( const uint8_t *payload, uint8_t length ) {
+    uint32_t got = 0;
+    const uint8_t *data = stream_frame(&_s, &got);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_EQUAL(length, got);
+    TEST_ASSERT_EQUAL_MEMORY(payload, data, length);
+}
+
+static const uint8_t _a[] = { 1, 2, 3, 4, 5, 6 };
+static const uint8_t _b[] = { 0xAA, 0x55, 0xAA, 0x55 }; // sync bytes in the payload
+static const uint8_t _c[] = { 42 };
+
+void setUp() {
+    stream_init(&_s, text);
+    memset(_text, 0, sizeof(_text));
+    _text_count = 0;
+}
+
+void tearDown() {
+}
+
+void test_crc16_is_ccitt() {
+    uint16_t crc = 0xffff;
+    for( const char *p = "123456789"; *p; p++ ) crc = stream_crc16(crc, *p);
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc);
+}
+
+void test_frame_between_text() {
+    feed_text("duty 1 500\n");
+    feed_frame(_a, sizeof(_a));
+    feed_text("stats\n");
+    TEST_ASSERT_EQUAL_STRING("duty 1 500\nstats\n", _text);
+    expect_frame(_a, sizeof(_a));
+    TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+    TEST_ASSERT_EQUAL(1, _s.frames);
+}
+
+void test_sync_bytes_in_payload() {
+    feed_frame(_b, sizeof(_b));
+    expect_frame(_b, sizeof(_b));
+    TEST_ASSERT_EQUAL(0, _text_count);
+}
+
+void test_frame_fed_byte_by_byte() {
+    uint8_t bytes[STREAM_MAX_PAYLOAD + 5];
+    uint32_t n = frame(bytes, _a, sizeof(_a));
+    for( uint32_t i = 0; i < n; i++ ) {
+        TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+        stream_feed(&_s, &bytes[i], 1);
+    }
+    expect_frame(_a, sizeof(_a));
+}
+
+void test_repeated_sync0_still_syncs() {
+    const uint8_t lead[] = { STREAM_SYNC0, STREAM_SYNC0 };
+    stream_feed(&_s, lead, sizeof(lead)); // 0xAA 0xAA 0x55...: the second 0xAA starts the frame
+    feed_frame(_c, sizeof(_c));
+    expect_frame(_c, sizeof(_c));
+    TEST_ASSERT_EQUAL(0, _text_count);
+}
+
+void test_lone_sync0_drops_next_byte() {
+    const uint8_t noise[] = { STREAM_SYNC0, 'x' };
+    stream_feed(&_s, noise, sizeof(noise));
+    feed_text("ok\n");
+    TEST_ASSERT_EQUAL_STRING("ok\n", _text);
+    feed_frame(_c, sizeof(_c));
+    expect_frame(_c, sizeof(_c));
+}
+
+void test_length_errors_resync() {
+    const uint8_t zero[] = { STREAM_SYNC0, STREAM_SYNC1, 0 };
+    const uint8_t long_[] = { STREAM_SYNC0, STREAM_SYNC1, STREAM_MAX_PAYLOAD + 1 };
+    stream_feed(&_s, zero, sizeof(zero));
+    stream_feed(&_s, long_, sizeof(long_));
+    TEST_ASSERT_EQUAL(2, _s.length_errors);
+    feed_frame(_a, sizeof(_a));
+    expect_frame(_a, sizeof(_a));
+    TEST_ASSERT_EQUAL(1, _s.frames);
+}
+
+void test_longest_payload() {
+    uint8_t payload[STREAM_MAX_PAYLOAD];
+    for( int i = 0; i < STREAM_MAX_PAYLOAD; i++ ) payload[i] = i * 3;
+    feed_frame(payload, STREAM_MAX_PAYLOAD);
+    expect_frame(payload, STREAM_MAX_PAYLOAD);
+    TEST_ASSERT_EQUAL(0, _s.length_errors);
+}
+
+void test_crc_error_drops_frame() {
+    uint8_t bytes[STREAM_MAX_PAYLOAD + 5];
+    uint32_t n = frame(bytes, _a, sizeof(_a));
+    bytes[4] ^= 0x10; // a flipped payload bit
+    stream_feed(&_s, bytes, n);
+    TEST_ASSERT_EQUAL(1, _s.crc_errors);
+    TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+
+    n = frame(bytes, _a, sizeof(_a));
+    bytes[n - 1] ^= 0x01; // and a flipped crc bit
+    stream_feed(&_s, bytes, n);
+    TEST_ASSERT_EQUAL(2, _s.crc_errors);
+    TEST_ASSERT_EQUAL(0, _s.frames);
+
+    feed_frame(_c, sizeof(_c));
+    expect_frame(_c, sizeof(_c));
+    TEST_ASSERT_EQUAL(0, _text_count);
+}
+
+void test_newest_frame_wins_and_counts_dropped() {
+    feed_frame(_a, sizeof(_a));
+    feed_frame(_b, sizeof(_b));
+    feed_frame(_c, sizeof(_c));
+    TEST_ASSERT_EQUAL(3, _s.frames);
+    TEST_ASSERT_EQUAL(2, _s.dropped);
+    expect_frame(_c, sizeof(_c));
+    TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+}
+
+void test_taken_frame_stays_valid_while_next_arrives() {
+    feed_frame(_a, sizeof(_a));
+    uint32_t length = 0;
+    const uint8_t *data = stream_frame(&_s, &length);
+    uint8_t bytes[STREAM_MAX_PAYLOAD + 5];
+    uint32_t n = frame(bytes, _b, sizeof(_b));
+    stream_feed(&_s, bytes, n - 1); // all but the last crc byte
+    TEST_ASSERT_EQUAL_MEMORY(_a, data, sizeof(_a));
+    stream_feed(&_s, &bytes[n - 1], 1);
+    expect_frame(_b, sizeof(_b));
+}
+
+void test_underruns_count_gaps_within_a_stream() {
+    // the first frame after a pause is no underrun
+    for( int i = 0; i < 3; i++ ) TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+    feed_frame(_a, sizeof(_a));
+    expect_frame(_a, sizeof(_a));
+    TEST_ASSERT_EQUAL(0, _s.underruns);
+
+    // a frame every call, then two calls without
+    feed_frame(_b, sizeof(_b));
+    expect_frame(_b, sizeof(_b));
+    TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+    TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+    feed_frame(_c, sizeof(_c));
+    expect_frame(_c, sizeof(_c));
+    TEST_ASSERT_EQUAL(2, _s.underruns);
+
+    // STREAM_ACTIVE calls without frame end the stream, the next one starts a new stream
+    for( int i = 0; i < STREAM_ACTIVE + 5; i++ ) TEST_ASSERT_NULL(stream_frame(&_s, &(uint32_t){ 0 }));
+    feed_frame(_a, sizeof(_a));
+    expect_frame(_a, sizeof(_a));
+    TEST_ASSERT_EQUAL(2, _s.underruns);
+    TEST_ASSERT_EQUAL(0, _s.dropped);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc16_is_ccitt);
+    RUN_TEST(test_frame_between_text);
+    RUN_TEST(test_sync_bytes_in_payload);
+    RUN_TEST(test_frame_fed_byte_by_byte);
+    RUN_TEST(test_repeated_sync0_still_syncs);
+    RUN_TEST(test_lone_sync0_drops_next_byte);
+    RUN_TEST(test_length_errors_resync);
+    RUN_TEST(test_longest_payload);
+    RUN_TEST(test_crc_error_drops_frame);
+    RUN_TEST(test_newest_frame_wins_and_counts_dropped);
+    RUN_TEST(test_taken_frame_stays_valid_while_next_arrives);
+    RUN_TEST(test_underruns_count_gaps_within_a_stream);
+    return UNITY_END();
+}
@@ -0,0 +1,49 @@
+#include <unity.h>
+#include "../mock/mock.c"
+#include <systick.h>
+
+/*
+lib/systick on the mock machine timer: timebase and drift free delays.
+*/
+
+void setUp() {
+    mock_init();
+    systick_init();
+}
+
+void tearDown() {
+}
+
+void test_micros_and_millis() {
+    for( int i = 0; i < 100; i++ ) {
+        mock_run_us(12345);
+        TEST_ASSERT_UINT32_WITHIN(1, mock_us(), micros());
+        TEST_ASSERT_UINT32_WITHIN(1, mock_us() / 1000, millis());
+    }
+}
+
+void test_delay_until_does_not_drift() {
+    uint64_t deadline = 0;
+    uint64_t from = mock_us();
+    for( int i = 0; i < 100; i++ ) {
+        mock_run_us(i * 7 % 900); // work between the calls
+        delay_until(&deadline, 1000);
+    }
+    TEST_ASSERT_UINT32_WITHIN(1, from + 100 * 1000, mock_us());
+}
+
+void test_delay() {
+    uint64_t from = mock_us();
+    delay_1us(250);
+    TEST_ASSERT_UINT32_WITHIN(1, from + 250, mock_us());
+    delay_1ms(3);
+    TEST_ASSERT_UINT32_WITHIN(1, from + 3250, mock_us());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_micros_and_millis);
+    RUN_TEST(test_delay_until_does_not_drift);
+    RUN_TEST(test_delay);
+    return UNITY_END();
+}
@@ -0,0 +1,265 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+lib/tlog records from writers that interrupt each other anywhere, frames as tools/tlog_decode.py
+reads them, wraparound of the ring and the record telling about dropped ones.
+lib/tlog only exists with WITH_TLOG, the test builds it in. The mock is here to count
+instructions and to interrupt a write at each of its instructions (mock_preempt()).
+
+Per call, counted x86 instructions for RISC-V ones, 2 arguments:
+                       |  -O2 |  -O1 | bytes sent
+TLOG()                 |   50 |   57 |         14
+tlog_flush() of it     | 1033 | 1121 |
+snprintf() of the text | 1715 | 1755 |         15
+TLOG() is what a handler pays, tlog_flush() runs in the main loop, most of it in the bitwise crc8.
+DEBUG_OUT as printf() formats like snprintf() and then waits for the uart, 87us a byte at 115200 baud.
+Flash and ram sizes come from the build summary of a board env with and without -DWITH_TLOG.
+*/
+
+#define WITH_TLOG
+#include "../../lib/tlog/tlog.c"
+
+#define MAX_FRAMES 256
+
+struct frame {
+    uint16_t id;
+    uint8_t count;
+    uint32_t args[TLOG_MAX_ARGS];
+};
+
+// Bytes tlog_flush() sent, decoded into frames
+static uint8_t _bytes[MAX_FRAMES * 30];
+static uint32_t _byte_count;
+static struct frame _frames[MAX_FRAMES];
+static uint32_t _frame_count;
+static uint32_t _decoded; // bytes decoded into frames
+
+static void put( uint8_t ch ) {
+    TEST_ASSERT_TRUE(_byte_count < sizeof(_bytes));
+    _bytes[_byte_count++] = ch;
+}
+
+// Decode what was sent since the last call, every byte must belong to a valid frame
+static void decode() {
+    while( _decoded < _byte_count ) {
+        uint32_t pos = _decoded;
+        TEST_ASSERT_TRUE(pos + 6 <= _byte_count);
+        TEST_ASSERT_EQUAL_HEX32(TLOG_SYNC0, _bytes[pos]);
+        TEST_ASSERT_EQUAL_HEX32(TLOG_SYNC1, _bytes[pos + 1]);
+        struct frame *f = &_frames[_frame_count++];
+        TEST_ASSERT_TRUE(_frame_count <= MAX_FRAMES);
+        f->id = _bytes[pos + 2] | (_bytes[pos + 3] << 8);
+        f->count = _bytes[pos + 4];
+        TEST_ASSERT_TRUE(f->count <= TLOG_MAX_ARGS);
+        uint32_t size = 5 + 4 * f->count + 1;
+        TEST_ASSERT_TRUE(pos + size <= _byte_count);
+        uint8_t crc = 0;
+        for( uint32_t i = 2; i < size - 1; i++ ) crc = crc8(crc, _bytes[pos + i]);
+        TEST_ASSERT_EQUAL_HEX32(crc, _bytes[pos + size - 1]);
+        for( uint32_t a = 0; a < f->count; a++ ) {
+            const uint8_t *b = &_bytes[pos + 5 + 4 * a];
+            f->args[a] = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+        }
+        _decoded += size;
+    }
+}
+
+static void flush() {
+    tlog_flush(put);
+    decode();
+}
+
+static void expect_frame( uint32_t index, uint16_t id, uint8_t count, uint32_t arg0 ) {
+    TEST_ASSERT_TRUE(index < _frame_count);
+    TEST_ASSERT_EQUAL_HEX32(id, _frames[index].id);
+    TEST_ASSERT_EQUAL(count, _frames[index].count);
+    for( uint32_t a = 0; a < count; a++ ) TEST_ASSERT_EQUAL(arg0 + a, _frames[index].args[a]);
+}
+
+// Write a record with made up id and arguments arg0, arg0 + 1, ...
+static int log_record( uint16_t id, uint8_t count, uint32_t arg0 ) {
+    uint32_t record[1 + TLOG_MAX_ARGS] = { TLOG_HEADER(id, count) };
+    for( uint32_t a = 0; a < count; a++ ) record[1 + a] = arg0 + a;
+    return tlog_write(record, 1 + count);
+}
+
+static void reset() {
+    _byte_count = _decoded = _frame_count = 0;
+}
+
+void setUp() {
+    tlog_flush(put);
+    reset();
+}
+
+void tearDown() {
+}
+
+void test_frame_encoding() {
+    const uint32_t record[] = { TLOG_HEADER(0x1234, 2), 0x11223344, 0xdeadbeef };
+    TEST_ASSERT_TRUE(tlog_write(record, 3));
+    tlog_flush(put);
+    const uint8_t expected[] = { 0xA5, 0x4C, 0x34, 0x12, 2, 0x44, 0x33, 0x22, 0x11, 0xef, 0xbe, 0xad, 0xde, 0xfa };
+    TEST_ASSERT_EQUAL(sizeof(expected), _byte_count);
+    TEST_ASSERT_EQUAL_MEMORY(expected, _bytes, sizeof(expected));
+}
+
+void test_tlog_macro() {
+    for( int i = 0; i < 2; i++ ) {
+        TLOG("pin %d duty %u\n", 3, 500 + i);
+        TLOG("frame\n");
+    }
+    flush();
+    TEST_ASSERT_EQUAL(4, _frame_count);
+    TEST_ASSERT_EQUAL(2, _frames[0].count);
+    TEST_ASSERT_EQUAL(3, _frames[0].args[0]);
+    TEST_ASSERT_EQUAL(501, _frames[2].args[1]);
+    TEST_ASSERT_EQUAL(0, _frames[1].count);
+    TEST_ASSERT_EQUAL(_frames[0].id, _frames[2].id); // an id per call site
+    TEST_ASSERT_EQUAL(_frames[1].id, _frames[3].id);
+    TEST_ASSERT_TRUE(_frames[0].id != _frames[1].id);
+}
+
+void test_wraparound() {
+    // records of 1 to 7 words straddle the end of the ring, flushed now and then
+    uint32_t written = 0;
+    for( uint32_t r = 0; r < 4 * TLOG_WORDS / 4; r++ ) {
+        TEST_ASSERT_TRUE(log_record(r, r % 7, r * 10));
+        if( r % 5 == 4 ) flush();
+        written++;
+    }
+    flush();
+    TEST_ASSERT_EQUAL(written, _frame_count);
+    for( uint32_t r = 0; r < written; r++ ) expect_frame(r, r, r % 7, r * 10);
+    TEST_ASSERT_EQUAL(0, tlog_dropped());
+}
+
+void test_counters_wrap() {
+    _head = _tail = UINT32_MAX - 10; // empty, positions about to wrap
+    for( uint32_t r = 0; r < 8; r++ ) TEST_ASSERT_TRUE(log_record(r, 3, r));
+    flush();
+    TEST_ASSERT_EQUAL(8, _frame_count);
+    for( uint32_t r = 0; r < 8; r++ ) expect_frame(r, r, 3, r);
+    TEST_ASSERT_EQUAL(_head, _tail);
+}
+
+void test_dropped_record() {
+    // 3 words each: 85 records fill 255 of 256 words
+    uint32_t fit = 0;
+    for( uint32_t r = 0; r < 90; r++ ) fit += log_record(r, 2, r);
+    TEST_ASSERT_EQUAL(TLOG_WORDS / 3, fit);
+    TEST_ASSERT_TRUE(log_record(100, 0, 0)); // the last word still takes a record without arguments
+    TEST_ASSERT_EQUAL(90 - fit, tlog_dropped());
+    flush();
+    TEST_ASSERT_EQUAL(fit + 2, _frame_count);
+    for( uint32_t r = 0; r < fit; r++ ) expect_frame(r, r, 2, r);
+    expect_frame(fit, 100, 0, 0);
+    expect_frame(fit + 1, TLOG_DROPPED, 1, 90 - fit);
+
+    // reported once, later losses count from there
+    flush();
+    TEST_ASSERT_EQUAL(fit + 2, _frame_count);
+    TEST_ASSERT_EQUAL(90 - fit, tlog_dropped());
+    for( uint32_t r = 0; r < 90; r++ ) log_record(r, 2, r);
+    flush();
+    expect_frame(_frame_count - 1, TLOG_DROPPED, 1, 90 - fit);
+}
+
+// Interrupting writer: its own record, and a flush that sees the interrupted write half done
+static uint32_t _seen_mid;  // frames the flush from the interrupt sent
+static void interrupt() {
+    TEST_ASSERT_TRUE(log_record(2, 2, 200));
+    uint32_t frames = _frame_count;
+    flush();
+    _seen_mid = _frame_count - frames;
+}
+
+void test_interrupted_at_every_instruction() {
+    // the write alone, the first one also pays for warming up
+    uint64_t at, alone = 0;
+    for( int i = 0; i < 2; i++ ) {
+        at = mock_instructions();
+        mock_count(1);
+        log_record(1, 3, 100);
+        mock_count(0);
+        alone = mock_instructions() - at;
+        flush();
+    }
+
+    uint32_t before = 0, after = 0, retries = 0, pending = 0;
+    for( uint64_t n = 0; n < alone; n++ ) {
+        reset();
+        _seen_mid = UINT32_MAX;
+        at = mock_instructions();
+        mock_preempt(n, interrupt);
+        mock_count(1);
+        log_record(1, 3, 100);
+        mock_count(0);
+        uint64_t took = mock_instructions() - at;
+        flush();
+        TEST_ASSERT_TRUE(_seen_mid != UINT32_MAX);
+
+        // both records complete, once each
+        TEST_ASSERT_EQUAL(2, _frame_count);
+        int inner = _frames[0].id == 2 ? 0 : 1;
+        expect_frame(inner, 2, 2, 200);
+        expect_frame(1 - inner, 1, 3, 100);
+        if( inner == 0 ) {
+            before++;                    // the interrupt reserved first and sent its record
+            TEST_ASSERT_EQUAL(1, _seen_mid);
+            if( took > alone ) retries++; // lost the compare and swap
+        }
+        else {
+            after++;                     // the interrupted write reserved first
+            TEST_ASSERT_TRUE(_seen_mid == 0 || _seen_mid == 2);
+            if( !_seen_mid ) pending++;  // its header not yet written: the flush stops there
+        }
+    }
+    printf("tlog: write interrupted at %lu instructions: %u times before, %u after reservation, %u compare and swap retries, %u half written\n",
+        (unsigned long)alone, before, after, retries, pending);
+    TEST_ASSERT_TRUE(before > 0 && after > 0 && retries > 0 && pending > 0);
+}
+
+void test_cost() {
+    uint64_t at = mock_instructions();
+    mock_count(1);
+    TLOG("pin %d duty %u\n", 3, 500);
+    mock_count(0);
+    uint64_t tlog = mock_instructions() - at;
+    uint32_t bytes = _byte_count;
+
+    at = mock_instructions();
+    mock_count(1);
+    tlog_flush(put);
+    mock_count(0);
+    uint64_t flush = mock_instructions() - at;
+    bytes = _byte_count - bytes;
+    decode();
+
+    char text[32];
+    at = mock_instructions();
+    mock_count(1);
+    int length = snprintf(text, sizeof(text), "pin %d duty %u\n", 3, 500);
+    mock_count(0);
+    uint64_t format = mock_instructions() - at;
+
+    TEST_ASSERT_EQUAL(14, bytes);
+    TEST_ASSERT_TRUE(tlog < format / 10);
+    printf("tlog: TLOG() %lu instructions, tlog_flush() %lu for %u bytes, snprintf() %lu for %d bytes\n",
+        (unsigned long)tlog, (unsigned long)flush, bytes, (unsigned long)format, length);
+}
+
+int main() {
+    mock_init();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_encoding);
+    RUN_TEST(test_tlog_macro);
+    RUN_TEST(test_wraparound);
+    RUN_TEST(test_counters_wrap);
+    RUN_TEST(test_dropped_record);
+    RUN_TEST(test_interrupted_at_every_instruction);
+    RUN_TEST(test_cost);
+    return UNITY_END();
+}
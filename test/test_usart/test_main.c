@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <usart.h>
+#include "../mock/mock.c"
+
+/*
+Buffered dma transmit of lib/usart on the register mock: what arrives on the line
+for each policy when the ring buffer overflows, and a throughput run that reports
+bytes per second and the worst time a caller spends in usart_put_char().
+*/
+
+#ifndef USART_TEST_BYTES
+#define USART_TEST_BYTES (1UL << 20) // throughput run, half a minute on the mock
+#endif
+
+#define BURST (USART_TX_BUFFER_SIZE + 40)
+
+static uint8_t _sent[BURST];
+static uint8_t _received[BURST];
+
+void setUp() {
+    mock_init();
+    usart_init(USART0, 115200);
+    eclic_global_interrupt_enable();
+}
+
+void tearDown() {
+}
+
+// Queue a burst much faster than the line sends and collect what comes out
+static uint32_t burst( enum usart_tx_policy policy ) {
+    usart_tx_dma_init(USART0, policy);
+    for( int i = 0; i < BURST; i++ ) {
+        _sent[i] = i * 7 + 1;
+        usart_put_char(USART0, _sent[i]);
+    }
+    usart_tx_flush(USART0);
+    return mock_usart_take(_received, sizeof(_received));
+}
+
+void test_block_sends_all() {
+    uint32_t count = burst(USART_TX_BLOCK);
+    TEST_ASSERT_EQUAL(BURST, count);
+    TEST_ASSERT_EQUAL_MEMORY(_sent, _received, BURST);
+    TEST_ASSERT_EQUAL(0, usart_tx_dropped());
+}
+
+void test_drop_loses_newest() {
+    uint32_t count = burst(USART_TX_DROP);
+    uint32_t dropped = usart_tx_dropped();
+    TEST_ASSERT_EQUAL(BURST, count + dropped);
+    TEST_ASSERT_LESS_THAN(BURST - USART_TX_BUFFER_SIZE + 4, dropped); // a few were sent meanwhile
+    TEST_ASSERT_EQUAL_MEMORY(_sent, _received, count);
+}
+
+void test_overwrite_loses_newest_pending_only() {
+    uint32_t count = burst(USART_TX_OVERWRITE);
+    uint32_t dropped = usart_tx_dropped();
+    TEST_ASSERT_EQUAL(BURST, count + dropped);
+    TEST_ASSERT_GREATER_THAN(0, dropped);
+    TEST_ASSERT_LESS_THAN(BURST - USART_TX_BUFFER_SIZE + 4, dropped);
+    TEST_ASSERT_EQUAL(_sent[BURST - 1], _received[count - 1]); // the newest byte is never lost
+
+    // what arrives is in order, each lost byte gave way to a later one
+    uint32_t s = 0;
+    for( uint32_t r = 0; r < count; r++, s++ ) {
+        while( s < BURST && _sent[s] != _received[r] ) s++;
+        TEST_ASSERT_LESS_THAN(BURST, s);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(_sent, _received, USART_TX_BUFFER_SIZE - 1); // the buffer before it overflowed
+}
+
+// Queue bytes as fast as the caller can, return the worst core cycles a usart_put_char() took
+static uint32_t feed( uint32_t bytes ) {
+    uint32_t worst = 0;
+    for( uint32_t i = 0; i < bytes; i++ ) {
+        uint64_t call = mock_core_cycles();
+        usart_put_char(USART0, (uint8_t)i);
+        uint32_t took = mock_core_cycles() - call;
+        if( took > worst ) worst = took;
+    }
+    return worst;
+}
+
+// Bytes per second at the highest baud rate and the worst caller latency.
+// Block: the wait for room in the buffer. Drop and overwrite: the buffer overflows at
+// a slow baud rate while every instruction is counted
+static void throughput( enum usart_tx_policy policy, const char *name ) {
+    TEST_ASSERT_TRUE(usart_baud(USART0, usart_max_baud(USART0)));
+    usart_tx_dma_init(USART0, policy);
+    mock_usart_discard(1);
+    mock_skip_waits(policy == USART_TX_BLOCK);
+    uint32_t before = mock_usart_sent();
+    uint64_t start = mock_core_cycles();
+    uint32_t worst = feed(USART_TEST_BYTES);
+    usart_tx_flush(USART0);
+    uint32_t sent = mock_usart_sent() - before;
+    uint32_t dropped = usart_tx_dropped();
+    uint64_t rate = sent * (uint64_t)SystemCoreClock / (mock_core_cycles() - start);
+
+    if( policy != USART_TX_BLOCK ) {
+        usart_baud(USART0, 115200);
+        mock_count(1);
+        worst = feed(4 * USART_TX_BUFFER_SIZE);
+        mock_count(0);
+        TEST_ASSERT_GREATER_THAN(dropped, usart_tx_dropped());
+        usart_tx_flush(USART0);
+    }
+
+    printf("%s: %lu bytes queued, %lu sent, %lu dropped, %llu bytes/s at %lu baud, worst usart_put_char() %lu core cycles\n",
+        name, (unsigned long)USART_TEST_BYTES, (unsigned long)sent, (unsigned long)dropped,
+        (unsigned long long)rate, (unsigned long)usart_max_baud(USART0), (unsigned long)worst);
+    TEST_ASSERT_EQUAL(USART_TEST_BYTES, sent + dropped);
+    // 10 bits per byte: the line is busy all the time
+    TEST_ASSERT_UINT32_WITHIN(usart_max_baud(USART0) / 100, usart_max_baud(USART0) / 10, rate);
+}
+
+void test_throughput_block() {
+    throughput(USART_TX_BLOCK, "block");
+}
+
+void test_throughput_drop() {
+    throughput(USART_TX_DROP, "drop");
+}
+
+void test_throughput_overwrite() {
+    throughput(USART_TX_OVERWRITE, "overwrite");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_block_sends_all);
+    RUN_TEST(test_drop_loses_newest);
+    RUN_TEST(test_overwrite_loses_newest_pending_only);
+    RUN_TEST(test_throughput_block);
+    RUN_TEST(test_throughput_drop);
+    RUN_TEST(test_throughput_overwrite);
+    return UNITY_END();
+}
@@ -0,0 +1,175 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+The waveform player on the mock dma: three Timer pins on channels 1 to 3 of TIMER4 play a table
+endlessly (circular) and a generated sequence refilled half by half (ping-pong).
+The compare registers are sampled once per interval, each sample must be the next step.
+TIMER0 shares DMA0 channel 4 with the receive dma of USART0: wave_start() has to refuse it
+while serial input runs there, and received bytes still arrive.
+*/
+
+#define CFG_PINS(PIN, x) \
+    PIN( x, PinA8,  Timer0, Channel0, BankA, Timer,     GPIO_PIN_8,  CIE, 100 ) \
+    PIN( x, PinA1,  Timer4, Channel1, BankA, Timer,     GPIO_PIN_1,  CIE, 100 ) \
+    PIN( x, PinA2,  Timer4, Channel2, BankA, Timer,     GPIO_PIN_2,  CIE, 100 ) \
+    PIN( x, PinA3,  Timer4, Channel3, BankA, Timer,     GPIO_PIN_3,  CIE, 100 ) \
+    PIN( x, PinC13, Timer1, Channel0, BankC, Interrupt, GPIO_PIN_13, CIE, 100 )
+
+#define WITH_SERIAL
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define CHANNELS 3
+#define STEPS 9 // odd: the halves differ in size
+
+static uint16_t _table[STEPS * CHANNELS];
+
+// CK_SYS cycles of a pwm interval and a tick
+static uint64_t interval() {
+    return (uint64_t)_pwm_prescale * _pwm_ticks * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+static uint64_t tick() {
+    return (uint64_t)_pwm_prescale * (MOCK_SYS_HZ / pwm_timer_clock());
+}
+
+// Register value without simulated cost
+static uint32_t reg( volatile uint32_t *address ) {
+    return mock_reg((uintptr_t)address);
+}
+
+// Compare value of step s on channel c of the wave
+static uint16_t step_cv( uint32_t s, uint32_t c ) {
+    return (s * 37 + c * 300) % _pwm_ticks;
+}
+
+// Compare registers of the wave channels once per interval, from the first update event on.
+// Each sample must be the step after the one before, the sequence given by step()
+static void check_steps( uint32_t intervals, uint32_t (*step)( uint32_t k ) ) {
+    uint32_t port = _cfg_timers[Timer4].port;
+    uint64_t update = mock_cycles() + (_pwm_ticks - reg(&TIMER_CNT(port))) * tick();
+    for( uint32_t k = 0; k < intervals; k++ ) {
+        mock_run_until(update + k * interval() + interval() / 2);
+        for( uint32_t c = 0; c < CHANNELS; c++ ) {
+            char message[48];
+            snprintf(message, sizeof(message), "interval %lu channel %lu", (unsigned long)k, (unsigned long)c + 1);
+            TEST_ASSERT_EQUAL_MESSAGE(step_cv(step(k), c), reg(&TIMER_CH1CV(port) + c), message);
+        }
+    }
+}
+
+static uint32_t circular( uint32_t k ) {
+    return k % STEPS;
+}
+
+static uint32_t sequence( uint32_t k ) {
+    return k;
+}
+
+// Ping-pong refill: the steps of an endless sequence, noting which part of the table it was asked for
+static uint32_t _generated;
+static uint32_t _refills;
+static uint16_t *_refill_at[64];
+static uint32_t _refill_count[64];
+
+static void generate( enum Timers timer, uint16_t *steps, uint32_t count ) {
+    TEST_ASSERT_EQUAL(Timer4, timer);
+    if( _refills < ARRAY_SIZE(_refill_at) ) {
+        _refill_at[_refills] = steps;
+        _refill_count[_refills] = count;
+    }
+    _refills++;
+    for( uint32_t s = 0; s < count; s++, _generated++ ) {
+        for( uint32_t c = 0; c < CHANNELS; c++ ) steps[s * CHANNELS + c] = step_cv(_generated, c);
+    }
+}
+
+void setUp() {
+    mock_irq_stat_reset();
+}
+
+void tearDown() {
+    wave_stop(Timer4);
+}
+
+void test_circular() {
+    for( uint32_t s = 0; s < STEPS; s++ ) {
+        for( uint32_t c = 0; c < CHANNELS; c++ ) _table[s * CHANNELS + c] = step_cv(s, c);
+    }
+    TEST_ASSERT_TRUE(wave_start(Timer4, Channel1, CHANNELS, _table, STEPS, 0));
+    TEST_ASSERT_FALSE(wave_start(Timer4, Channel1, CHANNELS, _table, STEPS, 0)); // already playing
+    check_steps(3 * STEPS + 2, circular);
+    TEST_ASSERT_EQUAL(0, mock_irq_stat(_cfg_timers[Timer4].dma_interrupt)->count); // the cpu is not involved
+}
+
+void test_ping_pong_refills_played_half() {
+    _generated = _refills = 0;
+    TEST_ASSERT_TRUE(wave_start(Timer4, Channel1, CHANNELS, _table, STEPS, generate));
+    TEST_ASSERT_EQUAL(1, _refills); // the whole table up front
+    TEST_ASSERT_EQUAL(STEPS, _generated);
+
+    check_steps(4 * STEPS + 2, sequence);
+    TEST_ASSERT_EQUAL(1 + 2 * 4, _refills); // a half transfer and a full transfer per round
+    for( uint32_t r = 1; r < _refills; r++ ) {
+        int second = (r % 2) == 0;
+        TEST_ASSERT_EQUAL_PTR(second ? &_table[STEPS / 2 * CHANNELS] : _table, _refill_at[r]);
+        TEST_ASSERT_EQUAL(second ? STEPS - STEPS / 2 : STEPS / 2, _refill_count[r]);
+    }
+    TEST_ASSERT_EQUAL(2 * 4, mock_irq_stat(_cfg_timers[Timer4].dma_interrupt)->count);
+}
+
+void test_stop_keeps_last_step() {
+    for( uint32_t s = 0; s < STEPS; s++ ) {
+        for( uint32_t c = 0; c < CHANNELS; c++ ) _table[s * CHANNELS + c] = step_cv(s, c);
+    }
+    TEST_ASSERT_TRUE(wave_start(Timer4, Channel1, CHANNELS, _table, STEPS, 0));
+    mock_run_until(mock_cycles() + 5 * interval() + interval() / 2);
+    wave_stop(Timer4);
+    uint32_t port = _cfg_timers[Timer4].port;
+    uint32_t cv = reg(&TIMER_CH1CV(port));
+    mock_run_until(mock_cycles() + 3 * interval());
+    TEST_ASSERT_EQUAL(cv, reg(&TIMER_CH1CV(port)));
+    TEST_ASSERT_EQUAL(pwm_cv(Channel1, cv), _pwm_duty[PinA1]);
+    TEST_ASSERT_FALSE(_wave_timers & (1U << Timer4));
+}
+
+void test_refused_while_usart_receives_on_dma0_ch4() {
+    TEST_ASSERT_EQUAL(DMA0, _cfg_timers[Timer0].dma);
+    TEST_ASSERT_EQUAL(DMA_CH4, _cfg_timers[Timer0].dma_channel);
+    init_usart0();
+
+    TEST_ASSERT_FALSE(wave_start(Timer0, Channel0, 1, _table, STEPS, 0));
+    TEST_ASSERT_FALSE(_wave_timers & (1U << Timer0));
+    TEST_ASSERT_EQUAL((uint32_t)&USART_DATA(USART0), reg(&DMA_CHPADDR(DMA0, DMA_CH4)));
+
+    // serial input goes on
+    mock_usart_inject((const uint8_t *)"duty 1 500\n", 11);
+    mock_run_until(mock_cycles() + MOCK_SYS_HZ / 1000 * 2);
+    const uint8_t *data;
+    TEST_ASSERT_EQUAL(11, usart_rx_dma_peek(&data));
+    TEST_ASSERT_EQUAL_MEMORY("duty 1 500\n", data, 11);
+    usart_rx_dma_consume(11);
+
+    // once the channel is free TIMER0 can play
+    dma_channel_disable(DMA0, DMA_CH4);
+    TEST_ASSERT_TRUE(wave_start(Timer0, Channel0, 1, _table, STEPS, 0));
+    TEST_ASSERT_EQUAL((uint32_t)&TIMER_DMATB(TIMER0), reg(&DMA_CHPADDR(DMA0, DMA_CH4)));
+    wave_stop(Timer0);
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+    eclic_global_interrupt_enable();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_circular);
+    RUN_TEST(test_ping_pong_refills_played_half);
+    RUN_TEST(test_stop_keeps_last_step);
+    RUN_TEST(test_refused_while_usart_receives_on_dma0_ch4);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+#include <unity.h>
+#include "../mock/mock.c"
+
+/*
+lib/ws2812 driving the led strip of src/main.c (LED_STRIP_TIMER channel 0: PA0) on the mock.
+The edge trace of PA0 is decoded like a strip would: each bit is a period of 1.25us
+with a high time that has to be in the T0H or T1H window of both WS2812B and SK6812,
+after the pixels the line stays low for the reset time.
+test_frame_rate sends strips of 1 to 1000 pixels from the same small dma buffer, the dma
+interrupt counted as x86 instructions (see mock_count()) at -O2 and -O1:
+
+pixels | frame us | frames/s | interrupts | -O2 cpu | max cycles | -O1 cpu | max cycles
+     1 |      326 |     3059 |          4 |   2.11% |        202 |   7.06% |        782
+    10 |      658 |     1519 |          8 |   4.01% |        959 |   8.69% |       1049
+   100 |     3298 |      303 |         41 |   9.85% |        960 |  11.51% |       1050
+  1000 |    30338 |       32 |        379 |  10.95% |        960 |  12.07% |       1050
+A frame takes 30us per pixel plus the reset time, rounded up to whole halves of the buffer.
+An interrupt encodes WS2812_HALF_BYTES bytes in 80us, the worst case stays far below that.
+*/
+
+#define LED_STRIP_PIXELS 8
+
+#define main app_main
+#include "../../src/main.c"
+#undef main
+
+#define STRIP_PIN 0 // PA0
+#define MAX_PIXELS 1000
+
+#define T0H_MIN 250 // ns, WS2812B and SK6812 both accept these
+#define T0H_MAX 450
+#define T1H_MIN 650
+#define T1H_MAX 750
+#define PERIOD_NS 1250
+
+static uint8_t _pixels[2][MAX_PIXELS * LED_STRIP_COLORS];
+
+static uint64_t ns( uint64_t sys_cycles ) {
+    return sys_cycles * 1000 / (MOCK_SYS_HZ / 1000000);
+}
+
+// Show the back buffer and wait until the frame including its reset time is sent
+static uint64_t send() {
+    uint64_t from = mock_cycles();
+    TEST_ASSERT_TRUE(ws2812_show(&_strip));
+    while( _strip.busy ) mock_run_until(mock_cycles() + MOCK_SYS_HZ / 1000000);
+    return from;
+}
+
+// Bytes of the frame on the wire since from, checks bit timing. Returns the bytes decoded
+static uint32_t decode( uint64_t from, uint8_t *bytes, uint32_t max, uint64_t *last_fall ) {
+    uint32_t bits = 0;
+    uint64_t rise = 0;
+    for( uint32_t e = 0; e < mock_trace_count(); e++ ) {
+        const struct mock_edge *edge = mock_trace_get(e);
+        if( edge->bank != MockA || edge->pin != STRIP_PIN || edge->time < from ) continue;
+        if( edge->level ) {
+            // the first bit of a frame follows the reset time
+            if( rise && ns(edge->time - rise) < 1000 * WS2812_RESET_US ) TEST_ASSERT_UINT32_WITHIN(20, PERIOD_NS, ns(edge->time - rise));
+            rise = edge->time;
+            continue;
+        }
+        uint64_t high = ns(edge->time - rise);
+        TEST_ASSERT_TRUE_MESSAGE((high >= T0H_MIN && high <= T0H_MAX) || (high >= T1H_MIN && high <= T1H_MAX), "high time");
+        TEST_ASSERT_TRUE(bits < 8 * max);
+        if( bits % 8 == 0 ) bytes[bits / 8] = 0;
+        if( high >= T1H_MIN ) bytes[bits / 8] |= 0x80 >> (bits % 8);
+        bits++;
+        *last_fall = edge->time;
+    }
+    TEST_ASSERT_EQUAL(0, bits % 8);
+    return bits / 8;
+}
+
+// Use the test's pixel buffers for a strip of pixels
+static void strip( uint32_t pixels ) {
+    ws2812_init(&_strip, pwm_timer_clock(), _pixels[0], _pixels[1], pixels * LED_STRIP_COLORS);
+}
+
+void setUp() {
+    mock_trace_reset();
+}
+
+void tearDown() {
+}
+
+void test_encode() {
+    static const uint8_t data[] = { 0xa5, 0x00, 0xff };
+    uint16_t cv[8 * sizeof(data) + 1];
+    cv[8 * sizeof(data)] = 0x1234;
+    ws2812_encode(cv, data, sizeof(data), 3, 7);
+    static const uint16_t expected[] = { 7, 3, 7, 3, 3, 7, 3, 7, 3, 3, 3, 3, 3, 3, 3, 3, 7, 7, 7, 7, 7, 7, 7, 7, 0x1234 };
+    TEST_ASSERT_EQUAL_MEMORY(expected, cv, sizeof(cv));
+    ws2812_encode(cv, 0, 2, 3, 7); // reset: line low
+    for( int i = 0; i < 16; i++ ) TEST_ASSERT_EQUAL(0, cv[i]);
+}
+
+void test_compare_values_fit_the_windows() {
+    // timer clocks the program may run the strip timer at, down to LOW_POWER_STRIP_HZ
+    static const uint32_t clocks[] = { 108000000, 96000000, 72000000, 54000000, 27000000, LOW_POWER_STRIP_HZ };
+    for( int c = 0; c < ARRAY_SIZE(clocks); c++ ) {
+        struct ws2812 s = _strip;
+        ws2812_init(&s, clocks[c], _pixels[0], _pixels[1], 3);
+        uint32_t t0h = (uint64_t)s.t0h * 1000000000 / clocks[c];
+        uint32_t t1h = (uint64_t)s.t1h * 1000000000 / clocks[c];
+        TEST_ASSERT_TRUE(t0h >= T0H_MIN && t0h <= T0H_MAX);
+        TEST_ASSERT_TRUE(t1h >= T1H_MIN && t1h <= T1H_MAX);
+        TEST_ASSERT_EQUAL(clocks[c] / WS2812_HZ - 1, mock_reg((uintptr_t)&TIMER_CAR(s.timer)));
+    }
+    strip(LED_STRIP_PIXELS);
+}
+
+void test_frame_on_the_wire() {
+    strip(LED_STRIP_PIXELS);
+    send(); // clears what init_strip() sent
+    uint8_t *pixel = ws2812_back(&_strip);
+    for( int i = 0; i < LED_STRIP_PIXELS * LED_STRIP_COLORS; i++ ) pixel[i] = i * 37 + 1;
+    mock_trace_reset();
+    uint64_t from = send();
+    uint8_t bytes[LED_STRIP_PIXELS * LED_STRIP_COLORS];
+    uint64_t last_fall = 0;
+    TEST_ASSERT_EQUAL(sizeof(bytes), decode(from, bytes, sizeof(bytes), &last_fall));
+    TEST_ASSERT_EQUAL_MEMORY(pixel, bytes, sizeof(bytes));
+    TEST_ASSERT_TRUE(ns(mock_cycles() - last_fall) >= 1000 * WS2812_RESET_US);
+    TEST_ASSERT_EQUAL(0, mock_pin(MockA, STRIP_PIN));
+}
+
+void test_back_buffer_is_not_sent() {
+    strip(LED_STRIP_PIXELS);
+    uint8_t *pixel = ws2812_back(&_strip);
+    memset(pixel, 0xff, LED_STRIP_PIXELS * LED_STRIP_COLORS);
+    uint64_t from = send();
+    TEST_ASSERT_TRUE(ws2812_back(&_strip) != pixel);
+    memset(ws2812_back(&_strip), 0x00, LED_STRIP_PIXELS * LED_STRIP_COLORS);
+    TEST_ASSERT_TRUE(ws2812_show(&_strip));
+    TEST_ASSERT_FALSE(ws2812_show(&_strip)); // still sending
+    while( _strip.busy ) mock_run_until(mock_cycles() + MOCK_SYS_HZ / 1000000);
+    uint8_t bytes[2 * LED_STRIP_PIXELS * LED_STRIP_COLORS];
+    uint64_t last_fall = 0;
+    TEST_ASSERT_EQUAL(sizeof(bytes), decode(from, bytes, sizeof(bytes), &last_fall));
+    for( int i = 0; i < sizeof(bytes); i++ ) TEST_ASSERT_EQUAL(i < sizeof(bytes) / 2 ? 0xff : 0x00, bytes[i]);
+}
+
+void test_frame_rate() {
+    static const uint32_t pixels[] = { 1, 10, 100, MAX_PIXELS };
+    for( int p = 0; p < ARRAY_SIZE(pixels); p++ ) {
+        uint32_t bytes = pixels[p] * LED_STRIP_COLORS;
+        strip(pixels[p]);
+        for( uint32_t i = 0; i < bytes; i++ ) ws2812_back(&_strip)[i] = i * 13;
+        mock_trace_reset();
+        mock_irq_stat_reset();
+        mock_count(1);
+        uint64_t from = send();
+        mock_count(0);
+        uint64_t frame = mock_cycles() - from;
+        const struct mock_irq_stat *irq = mock_irq_stat(_cfg_timers[LED_STRIP_TIMER].dma_interrupt);
+
+        static uint8_t wire[MAX_PIXELS * LED_STRIP_COLORS];
+        uint64_t last_fall = 0;
+        TEST_ASSERT_EQUAL(bytes, decode(from, wire, sizeof(wire), &last_fall));
+        for( uint32_t i = 0; i < bytes; i++ ) TEST_ASSERT_EQUAL((uint8_t)(i * 13), wire[i]);
+        // bits, reset time and at most a half buffer to notice the end
+        uint64_t least = (uint64_t)8 * bytes * PERIOD_NS + 1000 * WS2812_RESET_US;
+        TEST_ASSERT_TRUE(ns(frame) >= least);
+        TEST_ASSERT_TRUE(ns(frame) <= least + 2 * 8 * WS2812_HALF_BYTES * PERIOD_NS);
+        // the encoder must be done long before its half plays
+        TEST_ASSERT_TRUE(irq->max_cycles < 8 * WS2812_HALF_BYTES * PERIOD_NS / 1000 * (MOCK_SYS_HZ / 1000000) / 4);
+        printf("ws2812: %4lu pixels, frame %5lu us, %4lu frames/s, dma interrupts %lu, %lu.%02lu%% cpu, max %lu cycles\n",
+            (unsigned long)pixels[p], (unsigned long)(ns(frame) / 1000), (unsigned long)(1000000000 / ns(frame)),
+            (unsigned long)irq->count, (unsigned long)(irq->cycles * 100 / frame),
+            (unsigned long)(irq->cycles * 10000 / frame % 100), (unsigned long)irq->max_cycles);
+    }
+    strip(LED_STRIP_PIXELS);
+}
+
+int main() {
+    mock_init();
+    preinit_pwm();
+    init_pwm(PRESCALE, MAX_DUTY);
+    init_strip();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_encode);
+    RUN_TEST(test_compare_values_fit_the_windows);
+    RUN_TEST(test_frame_on_the_wire);
+    RUN_TEST(test_back_buffer_is_not_sent);
+    RUN_TEST(test_frame_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Decode interrupt handler stats frames (lib/isrstat) from the serial output.
+Other output (text from printf) is passed through unchanged.
+
+Usage: isrstat_decode.py [device or file] [baud]
+Reads stdin if no device is given. Needs pyserial for devices.
+"""
+
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+BUCKETS = 16
+FIELDS = "<IIIQIII%dH" % BUCKETS
+PAYLOAD_SIZE = struct.calcsize(FIELDS)
+
+
+def crc8(data, crc=0):
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def percentile(hist, fraction):
+    """Upper bound in cycles of the bucket holding the given fraction of calls"""
+    total = sum(hist)
+    if not total:
+        return 0
+    seen = 0
+    for b, n in enumerate(hist):
+        seen += n
+        if seen >= fraction * total:
+            return 2 ** (b + 5) if b < BUCKETS - 1 else float("inf")
+    return float("inf")
+
+
+def show(id, payload):
+    count, cmin, cmax, csum, lmin, lmax, missed, *hist = struct.unpack(FIELDS, payload)
+    if not count:
+        print("isr %d: no calls" % id)
+        return
+    latency = "%d..%d" % (lmin, lmax) if lmin != 0xFFFFFFFF else "-"
+    print("isr %d: calls %d, cycles min/avg/max %d/%d/%d, p50 <%s p99 <%s, latency %s, missed %d"
+          % (id, count, cmin, csum // count, cmax, percentile(hist, 0.5), percentile(hist, 0.99),
+             latency, missed))
+
+
+def decode(read):
+    buf = b""
+    while True:
+        data = read()
+        if not data:
+            break
+        buf += data
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                keep = 1 if buf.endswith(SYNC[:1]) else 0
+                sys.stdout.write(buf[:len(buf) - keep].decode("ascii", "replace"))
+                buf = buf[len(buf) - keep:]
+                break
+            sys.stdout.write(buf[:start].decode("ascii", "replace"))
+            buf = buf[start:]
+            if len(buf) < 4:
+                break
+            id, size = buf[2], buf[3]
+            if size != PAYLOAD_SIZE:
+                buf = buf[1:]  # not a frame
+                continue
+            if len(buf) < 5 + size:
+                break
+            payload = buf[4:4 + size]
+            if crc8(payload, crc8(buf[2:4])) == buf[4 + size]:
+                show(id, payload)
+                buf = buf[5 + size:]
+            else:
+                buf = buf[1:]
+        sys.stdout.flush()
+
+
+def main():
+    if len(sys.argv) < 2:
+        decode(lambda: sys.stdin.buffer.read1(256))
+    elif sys.argv[1].startswith("/dev/"):
+        import serial
+        baud = int(sys.argv[2]) if len(sys.argv) > 2 else 115200
+        port = serial.Serial(sys.argv[1], baud, timeout=1)
+
+        def read():
+            while True:
+                data = port.read(max(1, port.in_waiting))
+                if data:
+                    return data
+
+        decode(read)
+    else:
+        with open(sys.argv[1], "rb") as f:
+            decode(lambda: f.read(256))
+
+
+if __name__ == "__main__":
+    main()
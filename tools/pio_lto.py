@@ -0,0 +1,4 @@
+# PlatformIO pre script: link time optimization needs its flags at link time too
+Import("env")
+
+env.Append(LINKFLAGS=["-O2", "-flto", "-Wl,--gc-sections"])
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+Stand-in for the board to benchmark stream_send.py on Linux without hardware.
+Opens a pty, prints its path and parses frames like lib/stream does. Frames are
+taken at the given frame rate like take_stream_frame() in the firmware (0: at once)
+and acknowledged with 0xAC seq. Prints the same counters as the stats command on exit.
+
+Usage: stream_loopback.py [fps]
+Then: stream_send.py /dev/pts/N 0 [fps] ...
+"""
+
+import os
+import select
+import signal
+import sys
+import time
+import tty
+
+from stream_send import ACK, crc16
+
+MAX_PAYLOAD = 64
+ACTIVE = 10
+
+
+class Stream:
+    def __init__(self):
+        self.buf = b""
+        self.ready = None
+        self.idle = ACTIVE
+        self.frames = self.crc_errors = self.length_errors = self.dropped = self.underruns = 0
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            start = self.buf.find(b"\xaa\x55")
+            if start < 0:
+                self.buf = self.buf[-1:] if self.buf.endswith(b"\xaa") else b""
+                return
+            self.buf = self.buf[start:]
+            if len(self.buf) < 3:
+                return
+            length = self.buf[2]
+            if length == 0 or length > MAX_PAYLOAD:
+                self.length_errors += 1
+                self.buf = self.buf[2:]
+                continue
+            if len(self.buf) < 5 + length:
+                return
+            body = self.buf[2:3 + length]
+            if crc16(body) != self.buf[3 + length] | self.buf[4 + length] << 8:
+                self.crc_errors += 1
+                self.buf = self.buf[2:]
+                continue
+            self.frames += 1
+            if self.ready is not None:
+                self.dropped += 1
+            self.ready = body[1:]
+            self.buf = self.buf[5 + length:]
+
+    def take(self):
+        if self.ready is None:
+            self.idle = min(self.idle + 1, ACTIVE)
+            return None
+        if self.idle < ACTIVE:
+            self.underruns += self.idle
+        self.idle = 0
+        payload, self.ready = self.ready, None
+        return payload
+
+
+def main():
+    fps = float(sys.argv[1]) if len(sys.argv) > 1 else 60
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    print(os.ttyname(slave), flush=True)
+
+    signal.signal(signal.SIGTERM, signal.default_int_handler)
+    stream = Stream()
+    due = time.monotonic()
+    try:
+        while True:
+            wait = max(0, due - time.monotonic()) if fps else None
+            ready, _, _ = select.select([master], [], [], wait)
+            if ready:
+                stream.feed(os.read(master, 4096))
+            if fps and time.monotonic() < due:
+                continue
+            due += 1 / fps if fps else 0
+            while True:
+                payload = stream.take()
+                if payload is None:
+                    break
+                os.write(master, bytes([ACK, payload[0]]))
+                if fps:
+                    break
+    except KeyboardInterrupt:
+        pass
+    print("stream frames/crc/length/dropped/underruns: %d/%d/%d/%d/%d" % (
+        stream.frames, stream.crc_errors, stream.length_errors, stream.dropped, stream.underruns))
+
+
+if __name__ == "__main__":
+    main()
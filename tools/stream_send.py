@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+Stream live led levels to the board (lib/stream framing) and measure throughput.
+Sends a rainbow over the first pins as 16 bit levels, paced to the given frame rate
+(0: as fast as the line takes them). With an ack from the receiver, e.g. from
+stream_loopback.py, it also measures the latency from sending to applying a frame.
+
+Usage: stream_send.py device [baud] [fps] [pins] [seconds]
+Linux only (termios), works with serial devices and ptys.
+"""
+
+import math
+import os
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+
+SYNC = b"\xaa\x55"
+ACK = 0xAC  # receiver answers ACK seq when it applied frame seq
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def frame(seq, first, levels):
+    payload = bytes([seq & 0xFF, first]) + struct.pack("<%dH" % len(levels), *levels)
+    body = bytes([len(payload)]) + payload
+    return SYNC + body + struct.pack("<H", crc16(body))
+
+
+def open_port(device, baud):
+    fd = os.open(device, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    if baud:
+        attr = termios.tcgetattr(fd)
+        speed = getattr(termios, "B%d" % baud)
+        attr[4] = attr[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attr)
+    return fd
+
+
+def rainbow(t, pins):
+    return [int(32767.5 + 32767.5 * math.sin(t + p * 2 * math.pi / pins)) for p in range(pins)]
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    device = sys.argv[1]
+    baud = int(sys.argv[2]) if len(sys.argv) > 2 else 115200
+    fps = float(sys.argv[3]) if len(sys.argv) > 3 else 60
+    pins = int(sys.argv[4]) if len(sys.argv) > 4 else 3
+    seconds = float(sys.argv[5]) if len(sys.argv) > 5 else 10
+
+    fd = open_port(device, baud if device.startswith("/dev/tty") else 0)
+    sent = {}       # seq -> send time
+    latencies = []
+    acks = b""
+    frames = 0
+    size = 0
+    start = time.monotonic()
+    while time.monotonic() - start < seconds:
+        now = time.monotonic()
+        data = frame(frames, 0, rainbow(now - start, pins))
+        sent[frames & 0xFF] = now
+        os.write(fd, data)
+        frames += 1
+        size += len(data)
+
+        due = start + frames / fps if fps else now
+        while True:
+            wait = max(0, due - time.monotonic())
+            ready, _, _ = select.select([fd], [], [], wait)
+            if not ready:
+                break
+            acks += os.read(fd, 256)
+            while len(acks) >= 2:
+                pos = acks.find(bytes([ACK]))
+                if pos < 0 or pos + 1 >= len(acks):
+                    acks = acks[pos:] if pos >= 0 else b""
+                    break
+                seq = acks[pos + 1]
+                if seq in sent:
+                    latencies.append(time.monotonic() - sent.pop(seq))
+                acks = acks[pos + 2:]
+            if not fps:
+                break
+
+    elapsed = time.monotonic() - start
+    print("%d frames in %.1fs: %.1f frames/s, %.0f bytes/s" % (frames, elapsed, frames / elapsed, size / elapsed))
+    if latencies:
+        latencies.sort()
+        print("latency ms min/p50/p99/max: %.2f/%.2f/%.2f/%.2f (%d acks)" % (
+            latencies[0] * 1e3, latencies[len(latencies) // 2] * 1e3,
+            latencies[int(len(latencies) * 0.99)] * 1e3, latencies[-1] * 1e3, len(latencies)))
+
+
+if __name__ == "__main__":
+    main()
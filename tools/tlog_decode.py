@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Decode tokenized log frames (lib/tlog) from the serial output into text,
+using the format strings from the .tlog section of the firmware elf file.
+Other output is passed through unchanged, so it can be piped into isrstat_decode.py.
+
+Usage: tlog_decode.py firmware.elf [device or file] [baud]
+Reads stdin if no device is given. Needs pyserial for devices.
+PlatformIO puts the elf at .pio/build/<env>/firmware.elf
+"""
+
+import re
+import struct
+import sys
+
+SYNC = b"\xa5\x4c"
+DROPPED = 0xFFFF
+MAX_ARGS = 6
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf:
+    """Sections of an elf file by name, and reading constant strings by address"""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF":
+            sys.exit("%s is not an elf file" % path)
+        bits64 = data[4] == 2
+        end = "<" if data[5] == 1 else ">"
+        if bits64:
+            shoff, = struct.unpack_from(end + "Q", data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", data, 0x3A)
+            header = end + "IIQQQQIIQQ"
+        else:
+            shoff, = struct.unpack_from(end + "I", data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", data, 0x2E)
+            header = end + "IIIIIIIIII"
+        sections = [struct.unpack_from(header, data, shoff + i * shentsize) for i in range(shnum)]
+        names = sections[shstrndx]
+        self.sections = {}
+        self.loaded = []  # (address, bytes) of allocated sections with content
+        for name, kind, flags, addr, offset, size, *_ in sections:
+            name = data[names[4] + name:data.index(b"\0", names[4] + name)].decode()
+            content = data[offset:offset + size] if kind != 8 else b""  # 8: nobits
+            self.sections[name] = content
+            if flags & 2 and content:  # alloc
+                self.loaded.append((addr, content))
+
+    def string(self, addr):
+        for start, content in self.loaded:
+            if start <= addr < start + len(content):
+                pos = addr - start
+                return content[pos:content.index(b"\0", pos)].decode("ascii", "replace")
+        return "<0x%08x>" % addr
+
+
+def crc8(data, crc=0):
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def format_record(elf, formats, id, args):
+    if id == DROPPED:
+        return "<%d log records dropped>\n" % args[0]
+    if id >= len(formats):
+        return "<unknown log id 0x%04x>\n" % id
+    fmt = formats[id:formats.index(b"\0", id)].decode("ascii", "replace")
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, kind = match.groups()
+        if kind == "%":
+            return "%"
+        if not args:
+            return "<missing>"
+        arg = args.pop(0)
+        spec = "%" + flags + width + ("." + precision if precision else "")
+        if kind in "di":
+            return (spec + "d") % (arg - (1 << 32) if arg & 0x80000000 else arg)
+        if kind == "u":
+            return (spec + "d") % arg
+        if kind == "c":
+            return (spec + "c") % chr(arg & 0xFF)
+        if kind == "s":
+            return (spec + "s") % elf.string(arg)
+        if kind == "p":
+            return (spec + "s") % ("0x%08x" % arg)
+        return (spec + kind) % arg
+
+    return SPEC.sub(convert, fmt)
+
+
+def decode(elf, read):
+    formats = elf.sections.get(".tlog")
+    if formats is None:
+        sys.exit("no .tlog section, firmware built without -DWITH_TLOG?")
+    out = sys.stdout.buffer
+    buf = b""
+    while True:
+        data = read()
+        if not data:
+            break
+        buf += data
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                keep = 1 if buf.endswith(SYNC[:1]) else 0
+                out.write(buf[:len(buf) - keep])
+                buf = buf[len(buf) - keep:]
+                break
+            out.write(buf[:start])
+            buf = buf[start:]
+            if len(buf) < 5:
+                break
+            count = buf[4]
+            if count > MAX_ARGS and buf[2:4] != b"\xff\xff":
+                out.write(buf[:1])  # not a frame
+                buf = buf[1:]
+                continue
+            size = 5 + 4 * count + 1
+            if len(buf) < size:
+                break
+            if crc8(buf[2:size - 1]) == buf[size - 1]:
+                id, = struct.unpack_from("<H", buf, 2)
+                args = struct.unpack_from("<%dI" % count, buf, 5)
+                out.write(format_record(elf, formats, id, args).encode())
+                buf = buf[size:]
+            else:
+                out.write(buf[:1])
+                buf = buf[1:]
+        out.flush()
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    elf = Elf(sys.argv[1])
+    if len(sys.argv) < 3:
+        decode(elf, lambda: sys.stdin.buffer.read1(256))
+    elif sys.argv[2].startswith("/dev/"):
+        import serial
+        baud = int(sys.argv[3]) if len(sys.argv) > 3 else 115200
+        port = serial.Serial(sys.argv[2], baud, timeout=1)
+
+        def read():
+            while True:
+                data = port.read(max(1, port.in_waiting))
+                if data:
+                    return data
+
+        decode(elf, read)
+    else:
+        with open(sys.argv[2], "rb") as f:
+            decode(elf, lambda: f.read(256))
+
+
+if __name__ == "__main__":
+    main()